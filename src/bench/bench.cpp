@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "bench.h"
+
+static volatile uint64_t sink;
+
+void benchSink(uint64_t value)
+{
+    sink = sink + value;
+}
+
+void BenchReport::add(const std::string &name, double value, const std::string &unit)
+{
+    metrics.push_back({name, value, unit});
+}
+
+uint64_t peakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void BenchReport::addDistribution(const std::string &name, std::vector<double> samples, const std::string &unit)
+{
+    if (samples.empty())
+    {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p)
+    {
+        return samples[static_cast<size_t>(p * (samples.size() - 1) + 0.5)];
+    };
+    double sum = 0.0;
+    for (double sample : samples)
+    {
+        sum += sample;
+    }
+
+    add(name + ".min", samples.front(), unit);
+    add(name + ".avg", sum / samples.size(), unit);
+    add(name + ".p50", percentile(0.50), unit);
+    add(name + ".p90", percentile(0.90), unit);
+    add(name + ".p99", percentile(0.99), unit);
+    add(name + ".max", samples.back(), unit);
+}
+
+void BenchReport::setInfo(const std::string &key, const std::string &value)
+{
+    for (auto &entry : info)
+    {
+        if (entry.first == key)
+        {
+            entry.second = value;
+            return;
+        }
+    }
+    info.emplace_back(key, value);
+}
+
+static void writeJsonString(std::ostream &out, const std::string &text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+void BenchReport::writeJson(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("failed to open " + path + " for writing!");
+    }
+
+    file << "{\n  \"info\": {";
+    for (size_t i = 0; i < info.size(); i++)
+    {
+        file << (i == 0 ? "\n    " : ",\n    ");
+        writeJsonString(file, info[i].first);
+        file << ": ";
+        writeJsonString(file, info[i].second);
+    }
+    file << (info.empty() ? "},\n" : "\n  },\n");
+
+    file << "  \"metrics\": {";
+    file << std::setprecision(6);
+    for (size_t i = 0; i < metrics.size(); i++)
+    {
+        file << (i == 0 ? "\n    " : ",\n    ");
+        writeJsonString(file, metrics[i].name);
+        file << ": {\"value\": ";
+        if (std::isfinite(metrics[i].value))
+        {
+            file << metrics[i].value;
+        }
+        else
+        {
+            file << "null";
+        }
+        file << ", \"unit\": ";
+        writeJsonString(file, metrics[i].unit);
+        file << "}";
+    }
+    file << (metrics.empty() ? "}\n}\n" : "\n  }\n}\n");
+
+    if (!file)
+    {
+        throw std::runtime_error("failed to write " + path + "!");
+    }
+}
+
+void BenchReport::print(std::ostream &out) const
+{
+    for (const BenchMetric &metric : metrics)
+    {
+        out << std::left << std::setw(48) << metric.name << std::right << std::setw(14) << std::fixed
+            << std::setprecision(2) << metric.value << " " << metric.unit << "\n";
+    }
+}
+
+void runBenchmarks(const std::string &name, BenchReport &report)
+{
+    bool all = name == "all";
+    bool found = false;
+
+    if (all || name == "world")
+    {
+        runWorldBenchmark(report);
+        found = true;
+    }
+    if (all || name == "mesher")
+    {
+        runMesherBenchmark(report);
+        found = true;
+    }
+    if (all || name == "jobs")
+    {
+        runJobsBenchmark(report);
+        found = true;
+    }
+    if (all || name == "raytracer")
+    {
+        runRaytracerBenchmark(report);
+        found = true;
+    }
+    if (all || name == "codec")
+    {
+        runCodecBenchmark(report);
+        found = true;
+    }
+    if (all || name == "terrain")
+    {
+        runTerrainBenchmark(report);
+        found = true;
+    }
+
+    if (!found)
+    {
+        throw std::runtime_error("unknown benchmark: " + name);
+    }
+}
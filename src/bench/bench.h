@@ -0,0 +1,71 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchMetric
+{
+    std::string name;
+    double value;
+    std::string unit;
+};
+
+// Results of one benchmark run, named like "world.palette16.random_get"
+class BenchReport
+{
+public:
+    void add(const std::string &name, double value, const std::string &unit);
+    // Adds name.min, .avg, .p50, .p90, .p99 and .max of the samples
+    void addDistribution(const std::string &name, std::vector<double> samples, const std::string &unit);
+    // Describes the run, e.g. the scene or resolution, written along with the metrics
+    void setInfo(const std::string &key, const std::string &value);
+
+    void print(std::ostream &out) const;
+    // One object with the info and the metrics keyed by name, in the order
+    // they were added, so reports of two commits diff line by line
+    void writeJson(const std::string &path) const;
+
+    const std::vector<BenchMetric> &getMetrics() const { return metrics; }
+
+private:
+    std::vector<std::pair<std::string, std::string>> info;
+    std::vector<BenchMetric> metrics;
+};
+
+class BenchTimer
+{
+public:
+    BenchTimer() : start(std::chrono::steady_clock::now()) {}
+
+    double elapsedSeconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Keeps the compiler from optimizing away results that are never used otherwise
+void benchSink(uint64_t value);
+
+// Peak resident memory of the process so far, 0 where it cannot be queried
+uint64_t peakResidentBytes();
+
+// CPU-only benchmarks, they never touch Vulkan or GLFW
+void runWorldBenchmark(BenchReport &report);
+void runMesherBenchmark(BenchReport &report);
+void runJobsBenchmark(BenchReport &report);
+void runRaytracerBenchmark(BenchReport &report);
+void runCodecBenchmark(BenchReport &report);
+void runTerrainBenchmark(BenchReport &report);
+
+// Runs the named benchmark, or every benchmark for "all"
+void runBenchmarks(const std::string &name, BenchReport &report);
+
+#endif
@@ -0,0 +1,32 @@
+#include <stdexcept>
+
+#include "check.h"
+
+bool runChecks(const std::string &name, std::ostream &out)
+{
+    bool all = name == "all";
+    bool found = false;
+    bool passed = true;
+
+    if (all || name == "mesher")
+    {
+        passed &= runMesherCheck(out);
+        found = true;
+    }
+    if (all || name == "light")
+    {
+        passed &= runLightCheck(out);
+        found = true;
+    }
+    if (all || name == "suballocator")
+    {
+        passed &= runSubAllocatorCheck(out);
+        found = true;
+    }
+
+    if (!found)
+    {
+        throw std::runtime_error("unknown check: " + name);
+    }
+    return passed;
+}
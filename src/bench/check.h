@@ -0,0 +1,17 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <ostream>
+#include <string>
+
+// Self-checks of CPU code against slow reference implementations, they never
+// touch Vulkan or GLFW. Each prints what failed to out and returns whether
+// everything passed.
+bool runMesherCheck(std::ostream &out);
+bool runLightCheck(std::ostream &out);
+bool runSubAllocatorCheck(std::ostream &out);
+
+// Runs the named check, or every check for "all"
+bool runChecks(const std::string &name, std::ostream &out);
+
+#endif
@@ -0,0 +1,68 @@
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../world/terrain.h"
+
+// Chunks of generated terrain, compressed and decompressed as a whole the way
+// the loader's cold tier and the region files handle them. Speeds are in bytes
+// of 16-bit voxels, so they compare to copying the voxels around.
+void runCodecBenchmark(BenchReport &report)
+{
+    World world;
+    generateTerrain(world, {0, 0, 0}, {16, 8, 16});
+
+    std::vector<const Chunk *> chunks;
+    size_t packedBytes = 0;
+    world.forEachChunk([&](const ChunkCoord &, const Chunk &chunk)
+                       {
+                           chunks.push_back(&chunk);
+                           packedBytes += chunk.memoryUsage();
+                       });
+
+    std::vector<std::vector<uint8_t>> compressed(chunks.size());
+    const int passes = 4;
+    BenchTimer encodeTimer;
+    for (int pass = 0; pass < passes; pass++)
+    {
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            chunks[i]->compress(compressed[i]);
+        }
+    }
+    double encodeSeconds = encodeTimer.elapsedSeconds();
+
+    size_t compressedBytes = 0;
+    for (const std::vector<uint8_t> &data : compressed)
+    {
+        compressedBytes += data.size();
+    }
+
+    Chunk chunk;
+    uint64_t checksum = 0;
+    BenchTimer decodeTimer;
+    for (int pass = 0; pass < passes; pass++)
+    {
+        for (const std::vector<uint8_t> &data : compressed)
+        {
+            if (!chunk.decompress(data.data(), data.size()))
+            {
+                throw std::runtime_error("codec bench failed to decompress a chunk!");
+            }
+            checksum += chunk.get(0);
+        }
+    }
+    double decodeSeconds = decodeTimer.elapsedSeconds();
+    benchSink(checksum);
+
+    double chunkCount = static_cast<double>(chunks.size());
+    double rawBytes = chunkCount * Chunk::VOLUME * sizeof(Voxel);
+    report.add("codec.terrain.bytes_per_chunk", compressedBytes / chunkCount, "B");
+    report.add("codec.terrain.ratio_vs_raw", rawBytes / compressedBytes, "x");
+    report.add("codec.terrain.ratio_vs_palette", static_cast<double>(packedBytes) / compressedBytes, "x");
+    report.add("codec.terrain.encode_gb_per_second", rawBytes * passes / encodeSeconds / 1e9, "GB/s");
+    report.add("codec.terrain.decode_gb_per_second", rawBytes * passes / decodeSeconds / 1e9, "GB/s");
+    report.add("codec.terrain.decode_us_per_chunk", decodeSeconds * 1e6 / (chunkCount * passes), "us");
+}
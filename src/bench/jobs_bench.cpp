@@ -0,0 +1,188 @@
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "../jobs/job_system.h"
+#include "../world/chunk_loader.h"
+#include "../world/light.h"
+#include "../world/mesher.h"
+#include "../world/terrain.h"
+
+static const ChunkCoord areaMin = {-8, 0, -8};
+static const ChunkCoord areaMax = {8, 6, 8};
+
+static const ChunkCoord neighbourOffsets[FACE_COUNT] = {
+    {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+static bool isInArea(const ChunkCoord &coord)
+{
+    return coord.x >= areaMin.x && coord.y >= areaMin.y && coord.z >= areaMin.z && coord.x < areaMax.x &&
+           coord.y < areaMax.y && coord.z < areaMax.z;
+}
+
+// Open sky the way ChunkLoader sees it once the area is loaded: air chunks of
+// the area, and nothing above it
+static uint8_t openFacesOf(const World &world, const ChunkCoord &coord)
+{
+    uint8_t openFaces = 0;
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        const ChunkCoord &offset = neighbourOffsets[face];
+        ChunkCoord neighbour = {coord.x + offset.x, coord.y + offset.y, coord.z + offset.z};
+        if (isInArea(neighbour) ? !world.getChunk(neighbour) : face == FACE_POS_Y)
+        {
+            openFaces |= 1u << face;
+        }
+    }
+    return openFaces;
+}
+
+// Lights every chunk with ChunkLighter like the loader's light jobs, passing
+// the light that crosses a border on until no chunk sends any more
+static void lightArea(World &world)
+{
+    std::unordered_map<ChunkCoord, ChunkLightWork, ChunkCoordHash> work;
+    world.forEachChunk([&](const ChunkCoord &coord, const Chunk &) { work[coord].initial = true; });
+
+    ChunkLighter lighter;
+    ChunkLightResult result;
+    while (!work.empty())
+    {
+        std::unordered_map<ChunkCoord, ChunkLightWork, ChunkCoordHash> current;
+        current.swap(work);
+        for (const auto &pending : current)
+        {
+            const ChunkCoord &coord = pending.first;
+            lighter.light(*world.getChunk(coord), pending.second, openFacesOf(world, coord), result);
+            for (uint32_t face = 0; face < FACE_COUNT; face++)
+            {
+                const ChunkCoord &offset = neighbourOffsets[face];
+                ChunkCoord neighbour = {coord.x + offset.x, coord.y + offset.y, coord.z + offset.z};
+                if (!result.outgoing[face].empty() && world.getChunk(neighbour))
+                {
+                    ChunkLightWork messages;
+                    messages.messages = std::move(result.outgoing[face]);
+                    work[neighbour].merge(std::move(messages));
+                }
+            }
+        }
+    }
+}
+
+// The same area generated, lit and meshed on the calling thread, as the
+// baseline. Lighting settles before meshing, so no chunk is meshed twice.
+static double loadSingleThreaded(size_t &meshedChunks)
+{
+    BenchTimer timer;
+    World world;
+    generateTerrain(world, areaMin, areaMax);
+    lightArea(world);
+
+    ChunkMesher mesher;
+    ChunkMesh mesh;
+    meshedChunks = 0;
+    world.forEachChunk([&](const ChunkCoord &coord, const Chunk &)
+                       {
+                           mesher.mesh(world, coord, mesh);
+                           benchSink(mesh.quadCount());
+                           meshedChunks++;
+                       });
+    return timer.elapsedSeconds();
+}
+
+static double loadWithJobs(JobSystem &jobs, size_t &meshedChunks)
+{
+    BenchTimer timer;
+    World world;
+    ChunkLoader loader;
+    loader.init(world, jobs);
+    loader.requestArea(areaMin, areaMax, {0, 3, 0});
+
+    // Polls the way the main loop does, without ever blocking on a job
+    std::vector<LoadedMesh> meshes;
+    while (!loader.isIdle())
+    {
+        meshes.clear();
+        loader.update(meshes);
+        for (const LoadedMesh &loaded : meshes)
+        {
+            benchSink(loaded.mesh.quadCount());
+        }
+        std::this_thread::yield();
+    }
+    double seconds = timer.elapsedSeconds();
+
+    meshedChunks = loader.getMeshedCount();
+    loader.shutdown();
+    return seconds;
+}
+
+static void benchChunkLoading(JobSystem &jobs, BenchReport &report)
+{
+    size_t singleChunks = 0, jobChunks = 0;
+    double singleSeconds = loadSingleThreaded(singleChunks);
+    double jobSeconds = loadWithJobs(jobs, jobChunks);
+
+    report.add("jobs.load.single_thread_chunks_per_second", singleChunks / singleSeconds, "chunks/s");
+    report.add("jobs.load.job_system_chunks_per_second", jobChunks / jobSeconds, "chunks/s");
+    report.add("jobs.load.speedup", singleSeconds / jobSeconds, "x");
+}
+
+// Overhead of submit, scheduling and counters with empty jobs. They stay empty
+// because benchSink is not thread-safe, the std::function call is not elided.
+static void benchTinyJobs(JobSystem &jobs, BenchReport &report)
+{
+    const int jobCount = 200000;
+    JobSystemStats before = jobs.getStats();
+
+    JobCounter counter;
+    BenchTimer timer;
+    for (int i = 0; i < jobCount; i++)
+    {
+        jobs.submit([] {}, JobPriority::Normal, &counter);
+    }
+    jobs.wait(counter);
+    double seconds = timer.elapsedSeconds();
+
+    JobSystemStats after = jobs.getStats();
+    report.add("jobs.tiny.jobs_per_second", jobCount / seconds / 1e6, "Mjobs/s");
+    report.add("jobs.tiny.stolen_fraction", static_cast<double>(after.stolen - before.stolen) / jobCount * 100.0,
+               "%");
+}
+
+// A chain where every stage depends on the previous one, so only counters order the work
+static void benchDependencies(JobSystem &jobs, BenchReport &report)
+{
+    const int stages = 2000;
+    const int jobsPerStage = 16;
+    std::vector<JobCounter> counters(stages);
+
+    BenchTimer timer;
+    for (int stage = 0; stage < stages; stage++)
+    {
+        JobCounter *dependency = stage > 0 ? &counters[stage - 1] : nullptr;
+        for (int i = 0; i < jobsPerStage; i++)
+        {
+            jobs.submit([] {}, JobPriority::High, &counters[stage], dependency);
+        }
+    }
+    jobs.wait(counters[stages - 1]);
+    double seconds = timer.elapsedSeconds();
+
+    report.add("jobs.dependencies.stages_per_second", stages / seconds, "stages/s");
+}
+
+void runJobsBenchmark(BenchReport &report)
+{
+    JobSystem jobs;
+    jobs.init();
+    report.add("jobs.workers", jobs.getWorkerCount(), "threads");
+
+    benchChunkLoading(jobs, report);
+    benchTinyJobs(jobs, report);
+    benchDependencies(jobs, report);
+
+    jobs.shutdown();
+}
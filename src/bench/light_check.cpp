@@ -0,0 +1,475 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "check.h"
+#include "../world/light.h"
+#include "../world/terrain.h"
+#include "../world/world.h"
+
+// Mismatches printed per comparison before the rest are only counted
+static const int maxReportedFailures = 4;
+
+// The volume is this many stored chunks across and high, with a layer of air
+// chunks above it, so sky light enters through the air chunks' open faces
+static const int chunksAcross = 2;
+static const int chunksHigh = 2;
+static const int volumeSize = chunksAcross * Chunk::SIZE;
+static const int volumeHeight = chunksHigh * Chunk::SIZE;
+
+static const ChunkCoord neighbourOffsets[FACE_COUNT] = {
+    {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+static const int faceSteps[FACE_COUNT][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+static ChunkCoord offsetCoord(const ChunkCoord &coord, uint32_t face)
+{
+    const ChunkCoord &offset = neighbourOffsets[face];
+    return {coord.x + offset.x, coord.y + offset.y, coord.z + offset.z};
+}
+
+static size_t volumeIndex(int x, int y, int z)
+{
+    return static_cast<size_t>(x + volumeSize * (y + volumeHeight * z));
+}
+
+// Light of every voxel of the volume, packed like a chunk's, by a naive flood
+// fill over the whole volume at once: every air voxel takes the brightest level
+// a neighbour offers until nothing changes anymore
+static std::vector<uint8_t> naiveLight(const std::vector<Voxel> &voxels)
+{
+    std::vector<uint8_t> light(voxels.size(), 0);
+    for (uint32_t channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+    {
+        std::vector<uint8_t> levels(voxels.size(), 0);
+        if (channel == LIGHT_BLOCK)
+        {
+            for (size_t i = 0; i < voxels.size(); i++)
+            {
+                levels[i] = materialEmission(voxels[i]);
+            }
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (int z = 0; z < volumeSize; z++)
+            {
+                for (int y = volumeHeight - 1; y >= 0; y--)
+                {
+                    for (int x = 0; x < volumeSize; x++)
+                    {
+                        size_t index = volumeIndex(x, y, z);
+                        if (voxels[index] != MATERIAL_AIR)
+                        {
+                            continue;
+                        }
+
+                        // Open sky above the volume, nothing beside or below it
+                        int best = levels[index];
+                        if (channel == LIGHT_SKY && y == volumeHeight - 1)
+                        {
+                            best = LIGHT_MAX;
+                        }
+                        for (uint32_t face = 0; face < FACE_COUNT; face++)
+                        {
+                            int next[3] = {x + faceSteps[face][0], y + faceSteps[face][1], z + faceSteps[face][2]};
+                            if (next[0] < 0 || next[1] < 0 || next[2] < 0 || next[0] >= volumeSize ||
+                                next[1] >= volumeHeight || next[2] >= volumeSize)
+                            {
+                                continue;
+                            }
+                            int level = levels[volumeIndex(next[0], next[1], next[2])];
+                            bool straightDown = channel == LIGHT_SKY && face == FACE_POS_Y && level == LIGHT_MAX;
+                            best = std::max(best, straightDown ? level : level - 1);
+                        }
+                        if (best != levels[index])
+                        {
+                            levels[index] = static_cast<uint8_t>(best);
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < voxels.size(); i++)
+        {
+            light[i] |= channel == LIGHT_SKY ? levels[i] << 4 : levels[i];
+        }
+    }
+    return light;
+}
+
+// The volume split into chunks that ChunkLighter lights one at a time, with
+// light crossing borders only as messages. Follows ChunkLoader's protocol:
+// chunks arrive in any order, each tells its arrived neighbours what is across
+// their face, and whichever chunks have pending work are lit in any order, the
+// way light jobs finish.
+class LightScene
+{
+public:
+    explicit LightScene(uint32_t seed) : random(seed) {}
+
+    Voxel &at(int x, int y, int z) { return voxels[volumeIndex(x, y, z)]; }
+
+    // Every chunk arrives in a random order, lighting some pending chunks after
+    // each. Staged requests the bottom layer alone first, so it is lit under open
+    // sky that the layers requested after it close again.
+    void load(bool staged)
+    {
+        for (int32_t top : {staged ? 0 : chunksHigh, chunksHigh})
+        {
+            std::vector<ChunkCoord> order;
+            for (int32_t z = 0; z < chunksAcross; z++)
+            {
+                for (int32_t y = requestedTop + 1; y <= top; y++)
+                {
+                    for (int32_t x = 0; x < chunksAcross; x++)
+                    {
+                        order.push_back({x, y, z});
+                    }
+                }
+            }
+            requestedTop = top;
+            std::shuffle(order.begin(), order.end(), random);
+            for (const ChunkCoord &coord : order)
+            {
+                arrive(coord);
+                lightSome();
+            }
+            settle();
+        }
+    }
+
+    void edit(int x, int y, int z, Voxel value)
+    {
+        at(x, y, z) = value;
+        ChunkCoord coord = {x / Chunk::SIZE, y / Chunk::SIZE, z / Chunk::SIZE};
+        int index = Chunk::index(x % Chunk::SIZE, y % Chunk::SIZE, z % Chunk::SIZE);
+        world.getChunk(coord)->set(index, value);
+
+        ChunkLightWork edited;
+        edited.edited.push_back(static_cast<uint16_t>(index));
+        addWork(coord, std::move(edited));
+    }
+
+    void settle()
+    {
+        while (!work.empty())
+        {
+            lightSome();
+        }
+    }
+
+    // Whether every voxel's light matches the naive flood fill
+    bool compare(const std::string &name, std::ostream &out) const
+    {
+        std::vector<uint8_t> expected = naiveLight(voxels);
+        int failures = 0;
+        for (int z = 0; z < volumeSize; z++)
+        {
+            for (int y = 0; y < volumeHeight; y++)
+            {
+                for (int x = 0; x < volumeSize; x++)
+                {
+                    const Chunk *chunk = world.getChunk({x / Chunk::SIZE, y / Chunk::SIZE, z / Chunk::SIZE});
+                    uint8_t light = chunk->getLight(Chunk::index(x % Chunk::SIZE, y % Chunk::SIZE, z % Chunk::SIZE));
+                    uint8_t want = expected[volumeIndex(x, y, z)];
+                    if (light == want)
+                    {
+                        continue;
+                    }
+                    if (failures < maxReportedFailures)
+                    {
+                        out << "check: light." << name << ": voxel (" << x << ", " << y << ", " << z << ") has sky "
+                            << int(lightLevel(light, LIGHT_SKY)) << " block " << int(lightLevel(light, LIGHT_BLOCK))
+                            << ", expected sky " << int(lightLevel(want, LIGHT_SKY)) << " block "
+                            << int(lightLevel(want, LIGHT_BLOCK)) << "\n";
+                    }
+                    failures++;
+                }
+            }
+        }
+        if (failures > maxReportedFailures)
+        {
+            out << "check: light." << name << ": " << failures - maxReportedFailures << " more mismatches\n";
+        }
+        return failures == 0;
+    }
+
+private:
+    std::mt19937 random;
+    std::vector<Voxel> voxels = std::vector<Voxel>(static_cast<size_t>(volumeSize) * volumeHeight * volumeSize);
+    World world;
+    // Chunk layers up to this one are requested
+    int32_t requestedTop = -1;
+    // Arrived chunks, with the faces whose open sky their light still holds
+    std::unordered_map<ChunkCoord, uint8_t, ChunkCoordHash> arrived;
+    std::unordered_map<ChunkCoord, ChunkLightWork, ChunkCoordHash> work;
+    ChunkLighter lighter;
+    ChunkLightResult result;
+
+    bool isRequested(const ChunkCoord &coord) const
+    {
+        return coord.x >= 0 && coord.y >= 0 && coord.z >= 0 && coord.x < chunksAcross && coord.y <= requestedTop &&
+               coord.z < chunksAcross;
+    }
+    bool isStored(const ChunkCoord &coord) const { return isRequested(coord) && coord.y < chunksHigh; }
+
+    // Arrived air chunks are open sky, as is everything above the requested area
+    uint8_t openFacesOf(const ChunkCoord &coord) const
+    {
+        uint8_t openFaces = 0;
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            ChunkCoord neighbour = offsetCoord(coord, face);
+            bool open = isRequested(neighbour) ? arrived.count(neighbour) && !isStored(neighbour) : face == FACE_POS_Y;
+            if (open)
+            {
+                openFaces |= 1u << face;
+            }
+        }
+        return openFaces;
+    }
+
+    void addWork(const ChunkCoord &coord, ChunkLightWork &&added)
+    {
+        if (arrived.count(coord) && isStored(coord))
+        {
+            work[coord].merge(std::move(added));
+        }
+    }
+
+    void arrive(const ChunkCoord &coord)
+    {
+        arrived[coord] = 0;
+        bool stored = isStored(coord);
+        if (stored)
+        {
+            std::vector<Voxel> chunkVoxels(Chunk::VOLUME);
+            for (int i = 0; i < Chunk::VOLUME; i++)
+            {
+                int x = coord.x * Chunk::SIZE + (i & (Chunk::SIZE - 1));
+                int y = coord.y * Chunk::SIZE + ((i >> Chunk::SIZE_BITS) & (Chunk::SIZE - 1));
+                int z = coord.z * Chunk::SIZE + (i >> (2 * Chunk::SIZE_BITS));
+                chunkVoxels[i] = at(x, y, z);
+            }
+            world.getOrCreateChunk(coord).encode(chunkVoxels.data());
+
+            ChunkLightWork initial;
+            initial.initial = true;
+            addWork(coord, std::move(initial));
+        }
+
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            ChunkCoord neighbour = offsetCoord(coord, face);
+            auto it = arrived.find(neighbour);
+            if (it == arrived.end())
+            {
+                continue;
+            }
+            uint8_t towards = static_cast<uint8_t>(1u << (face ^ 1));
+            ChunkLightWork across;
+            if (stored)
+            {
+                across.exportFaces = towards;
+                across.closedFaces = it->second & towards;
+            }
+            else
+            {
+                across.openedFaces = towards;
+            }
+            addWork(neighbour, std::move(across));
+        }
+    }
+
+    // A random half of the chunks with pending work, in a random order
+    void lightSome()
+    {
+        std::vector<ChunkCoord> pending;
+        for (const auto &entry : work)
+        {
+            pending.push_back(entry.first);
+        }
+        std::shuffle(pending.begin(), pending.end(), random);
+        pending.resize((pending.size() + 1) / 2);
+
+        for (const ChunkCoord &coord : pending)
+        {
+            ChunkLightWork chunkWork = std::move(work[coord]);
+            work.erase(coord);
+            uint8_t openFaces = openFacesOf(coord);
+            arrived[coord] = openFaces | (arrived[coord] & ~chunkWork.closedFaces);
+            lighter.light(*world.getChunk(coord), chunkWork, openFaces, result);
+
+            for (uint32_t face = 0; face < FACE_COUNT; face++)
+            {
+                if (!result.outgoing[face].empty())
+                {
+                    ChunkLightWork messages;
+                    messages.messages = std::move(result.outgoing[face]);
+                    addWork(offsetCoord(coord, face), std::move(messages));
+                }
+            }
+        }
+    }
+};
+
+// Uneven ground with a cave and a shaft down into it that both cross chunk
+// borders, a lamp in the cave and one at the corner of four chunks, and a pit
+// roofed over in the layer above, so it is only dark once that layer arrived
+static void buildTerrain(LightScene &scene)
+{
+    for (int z = 0; z < volumeSize; z++)
+    {
+        for (int x = 0; x < volumeSize; x++)
+        {
+            int height = 30 + (x * 7 + z * 3) % 13 + (x > 40 && z > 40 ? 14 : 0);
+            for (int y = 0; y < volumeHeight; y++)
+            {
+                scene.at(x, y, z) = y < height ? MATERIAL_STONE : MATERIAL_AIR;
+            }
+        }
+    }
+    for (int z = 20; z < 45; z++)
+    {
+        for (int y = 8; y < 20; y++)
+        {
+            for (int x = 10; x < 44; x++)
+            {
+                scene.at(x, y, z) = MATERIAL_AIR;
+            }
+        }
+    }
+    for (int z = 28; z < 36; z++)
+    {
+        for (int y = 20; y < volumeHeight; y++)
+        {
+            for (int x = 20; x < 30; x++)
+            {
+                scene.at(x, y, z) = MATERIAL_AIR;
+            }
+        }
+    }
+    for (int z = 0; z < 16; z++)
+    {
+        for (int x = 0; x < 16; x++)
+        {
+            bool pit = x >= 2 && z >= 2 && x < 14 && z < 14;
+            for (int y = 24; y < 40; y++)
+            {
+                if (y >= 36)
+                {
+                    scene.at(x, y, z) = MATERIAL_STONE;
+                }
+                else if (pit)
+                {
+                    scene.at(x, y, z) = MATERIAL_AIR;
+                }
+            }
+        }
+    }
+    scene.at(15, 9, 25) = MATERIAL_LAMP;
+    scene.at(32, 8, 32) = MATERIAL_LAMP;
+}
+
+bool runLightCheck(std::ostream &out)
+{
+    bool passed = true;
+
+    // Placement: the same volume lit with chunks arriving in different orders,
+    // half of the time with the bottom layer lit under open sky first
+    for (uint32_t seed = 0; seed < 4; seed++)
+    {
+        LightScene scene(seed);
+        buildTerrain(scene);
+        scene.load(seed % 2 == 1);
+        passed &= scene.compare("placement_" + std::to_string(seed), out);
+    }
+
+    LightScene scene(1337);
+    buildTerrain(scene);
+    scene.load(true);
+
+    // Removal: the shaft roofed over takes the sky light out of the cave below
+    for (int z = 28; z < 36; z++)
+    {
+        for (int x = 20; x < 30; x++)
+        {
+            scene.edit(x, 50, z, MATERIAL_STONE);
+        }
+    }
+    scene.settle();
+    passed &= scene.compare("roof_placed", out);
+
+    scene.edit(15, 9, 25, MATERIAL_STONE);
+    scene.settle();
+    passed &= scene.compare("lamp_removed", out);
+
+    // Borders: a lamp next to the corner of four chunks, the corner lamp removed
+    scene.edit(31, 12, 31, MATERIAL_LAMP);
+    scene.settle();
+    passed &= scene.compare("border_lamp_placed", out);
+    scene.edit(32, 8, 32, MATERIAL_AIR);
+    scene.settle();
+    passed &= scene.compare("corner_lamp_removed", out);
+
+    // Sky back down the shaft through a hole in the roof at a chunk border
+    scene.edit(25, 50, 31, MATERIAL_AIR);
+    scene.edit(25, 50, 32, MATERIAL_AIR);
+    scene.settle();
+    passed &= scene.compare("roof_opened", out);
+
+    // Random placement and removal, settled only every few edits
+    std::mt19937 random(1337);
+    std::uniform_int_distribution<int> across(0, volumeSize - 1);
+    std::uniform_int_distribution<int> high(0, volumeHeight - 1);
+    std::uniform_int_distribution<int> material(0, 4);
+    for (int i = 0; i < 400; i++)
+    {
+        int kind = material(random);
+        Voxel value = kind == 0 ? MATERIAL_LAMP : kind < 3 ? MATERIAL_STONE : MATERIAL_AIR;
+        scene.edit(across(random), high(random), across(random), value);
+        if (i % 10 == 9)
+        {
+            scene.settle();
+        }
+    }
+    scene.settle();
+    passed &= scene.compare("random_edits", out);
+
+    // A whole chunk filled solid next to lit ones, then emptied again
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int y = Chunk::SIZE; y < 2 * Chunk::SIZE; y++)
+        {
+            for (int x = 0; x < Chunk::SIZE; x++)
+            {
+                scene.edit(x, y, z, MATERIAL_STONE);
+            }
+        }
+    }
+    scene.settle();
+    passed &= scene.compare("chunk_filled", out);
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int y = Chunk::SIZE; y < 2 * Chunk::SIZE; y++)
+        {
+            for (int x = 0; x < Chunk::SIZE; x++)
+            {
+                scene.edit(x, y, z, MATERIAL_AIR);
+            }
+        }
+    }
+    scene.settle();
+    passed &= scene.compare("chunk_emptied", out);
+
+    out << "check: light " << (passed ? "passed" : "FAILED") << "\n";
+    return passed;
+}
@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../world/mesher.h"
+#include "../world/terrain.h"
+
+static void benchTerrain(BenchReport &report)
+{
+    const int chunksX = 16, chunksY = 8, chunksZ = 16;
+    World world;
+    generateTerrain(world, {0, 0, 0}, {chunksX, chunksY, chunksZ});
+
+    std::vector<ChunkCoord> coords;
+    world.forEachChunk([&](const ChunkCoord &coord, const Chunk &)
+                       { coords.push_back(coord); });
+
+    ChunkMesher mesher;
+    ChunkMesh mesh;
+    uint64_t quads = 0;
+    size_t meshed = 0;
+
+    // A few passes so the first one warming up the scratch buffers does not dominate
+    const int passes = 4;
+    BenchTimer timer;
+    for (int pass = 0; pass < passes; pass++)
+    {
+        for (const ChunkCoord &coord : coords)
+        {
+            mesher.mesh(world, coord, mesh);
+            quads += mesh.quadCount();
+            meshed++;
+        }
+    }
+    double seconds = timer.elapsedSeconds();
+
+    report.add("mesher.terrain.chunks_per_second", meshed / seconds, "chunks/s");
+    report.add("mesher.terrain.quads_per_chunk", static_cast<double>(quads) / meshed, "quads");
+    report.add("mesher.terrain.mquads_per_second", quads / seconds / 1e6, "Mquads/s");
+    report.add("mesher.terrain.bytes_per_chunk",
+               static_cast<double>(quads) / meshed * (4 * sizeof(ChunkVertex) + 6 * sizeof(uint32_t)), "B");
+}
+
+// 3D checkerboard, the worst case: every voxel is its own quad on all six sides
+static void benchCheckerboard(BenchReport &report)
+{
+    std::vector<Voxel> voxels(Chunk::VOLUME);
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int y = 0; y < Chunk::SIZE; y++)
+        {
+            for (int x = 0; x < Chunk::SIZE; x++)
+            {
+                voxels[Chunk::index(x, y, z)] = ((x + y + z) & 1) ? MATERIAL_STONE : MATERIAL_AIR;
+            }
+        }
+    }
+
+    Chunk chunk;
+    chunk.encode(voxels.data());
+    const Chunk *neighbours[FACE_COUNT] = {};
+
+    ChunkMesher mesher;
+    ChunkMesh mesh;
+    const int iterations = 64;
+    BenchTimer timer;
+    for (int i = 0; i < iterations; i++)
+    {
+        mesher.mesh(chunk, neighbours, mesh);
+    }
+    double seconds = timer.elapsedSeconds();
+
+    report.add("mesher.checkerboard.chunks_per_second", iterations / seconds, "chunks/s");
+    report.add("mesher.checkerboard.quads_per_chunk", static_cast<double>(mesh.quadCount()), "quads");
+}
+
+void runMesherBenchmark(BenchReport &report)
+{
+    benchTerrain(report);
+    benchCheckerboard(report);
+}
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../world/light.h"
+#include "../world/mesher.h"
+#include "../world/terrain.h"
+
+// Failures printed per case before the rest are only counted
+static const int maxReportedFailures = 4;
+
+struct MesherCase
+{
+    std::string name;
+    Chunk chunk;
+    Chunk neighbourChunks[FACE_COUNT];
+    bool hasNeighbour[FACE_COUNT] = {};
+    // Quads the greedy mesh must have, -1 when only its faces are compared
+    int expectedQuads = -1;
+};
+
+static void decodePosition(uint32_t position, int coords[3])
+{
+    coords[0] = static_cast<int>(position & 63);
+    coords[1] = static_cast<int>((position >> 6) & 63);
+    coords[2] = static_cast<int>((position >> 12) & 63);
+}
+
+// The packed material of every visible unit face, indexed by voxel index * FACE_COUNT + face,
+// 0 where there is none. One face per solid voxel side that borders air, lit by that air.
+static std::vector<uint32_t> naiveFaces(const Chunk &chunk, const Chunk *const neighbours[FACE_COUNT])
+{
+    std::vector<uint32_t> faces(static_cast<size_t>(Chunk::VOLUME) * FACE_COUNT, 0);
+    for (int index = 0; index < Chunk::VOLUME; index++)
+    {
+        Voxel voxel = chunk.get(index);
+        if (voxel == 0)
+        {
+            continue;
+        }
+        int coords[3] = {index & (Chunk::SIZE - 1), (index >> Chunk::SIZE_BITS) & (Chunk::SIZE - 1),
+                         index >> (2 * Chunk::SIZE_BITS)};
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            int next[3] = {coords[0], coords[1], coords[2]};
+            next[face / 2] += (face & 1) ? 1 : -1;
+
+            uint8_t light = LIGHT_OPEN_SKY;
+            if (next[face / 2] >= 0 && next[face / 2] < Chunk::SIZE)
+            {
+                int nextIndex = Chunk::index(next[0], next[1], next[2]);
+                if (chunk.get(nextIndex) != 0)
+                {
+                    continue;
+                }
+                light = chunk.getLight(nextIndex);
+            }
+            else if (const Chunk *neighbour = neighbours[face])
+            {
+                next[face / 2] &= Chunk::SIZE - 1;
+                int nextIndex = Chunk::index(next[0], next[1], next[2]);
+                if (neighbour->get(nextIndex) != 0)
+                {
+                    continue;
+                }
+                light = neighbour->getLight(nextIndex);
+            }
+            faces[static_cast<size_t>(index) * FACE_COUNT + face] = ChunkVertex::packMaterial(voxel, light);
+        }
+    }
+    return faces;
+}
+
+static int checkQuad(const ChunkMesh &mesh, size_t quad, std::vector<uint32_t> &expected, std::string &error)
+{
+    const ChunkVertex *vertices = &mesh.vertices[quad * 4];
+    uint32_t face = vertices[0].position >> 18;
+    uint32_t material = vertices[0].material;
+    if (face >= FACE_COUNT)
+    {
+        error = "invalid face " + std::to_string(face);
+        return 1;
+    }
+
+    // All four corners on one plane of the face's axis, spanning a rectangle in the other two
+    uint32_t axis = face / 2;
+    bool positive = (face & 1) != 0;
+    int corners[4][3];
+    int low[3] = {Chunk::SIZE, Chunk::SIZE, Chunk::SIZE};
+    int high[3] = {0, 0, 0};
+    for (int i = 0; i < 4; i++)
+    {
+        if ((vertices[i].position >> 18) != face || vertices[i].material != material)
+        {
+            error = "corners disagree on face or material";
+            return 1;
+        }
+        decodePosition(vertices[i].position, corners[i]);
+        for (int a = 0; a < 3; a++)
+        {
+            low[a] = std::min(low[a], corners[i][a]);
+            high[a] = std::max(high[a], corners[i][a]);
+        }
+    }
+    if (low[axis] != high[axis] || high[0] > Chunk::SIZE || high[1] > Chunk::SIZE || high[2] > Chunk::SIZE)
+    {
+        error = "corners do not lie on one plane inside the chunk";
+        return 1;
+    }
+    int depth = low[axis] - (positive ? 1 : 0);
+    if (depth < 0 || depth >= Chunk::SIZE)
+    {
+        error = "plane outside the chunk";
+        return 1;
+    }
+
+    // Both triangles counter-clockwise seen from outside, facing along the face normal
+    for (int triangle = 0; triangle < 2; triangle++)
+    {
+        int p[3][3];
+        for (int i = 0; i < 3; i++)
+        {
+            uint32_t vertex = mesh.indices[quad * 6 + triangle * 3 + i];
+            if (vertex < quad * 4 || vertex >= quad * 4 + 4)
+            {
+                error = "index outside its quad";
+                return 1;
+            }
+            decodePosition(mesh.vertices[vertex].position, p[i]);
+        }
+        int e1[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+        int e2[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+        int normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        bool facing = positive ? normal[axis] > 0 : normal[axis] < 0;
+        if (!facing || normal[(axis + 1) % 3] != 0 || normal[(axis + 2) % 3] != 0)
+        {
+            error = "triangle " + std::to_string(triangle) + " wound the wrong way";
+            return 1;
+        }
+    }
+
+    // Every unit face the quad covers must be expected with this material, and not covered twice
+    int failures = 0;
+    uint32_t uAxis = (axis + 1) % 3;
+    uint32_t vAxis = (axis + 2) % 3;
+    for (int u = low[uAxis]; u < high[uAxis]; u++)
+    {
+        for (int v = low[vAxis]; v < high[vAxis]; v++)
+        {
+            int coords[3];
+            coords[axis] = depth;
+            coords[uAxis] = u;
+            coords[vAxis] = v;
+            uint32_t &slot = expected[static_cast<size_t>(Chunk::index(coords[0], coords[1], coords[2])) * FACE_COUNT + face];
+            if (slot != material)
+            {
+                if (failures == 0)
+                {
+                    error = "face " + std::to_string(face) + " of voxel (" + std::to_string(coords[0]) + ", " +
+                            std::to_string(coords[1]) + ", " + std::to_string(coords[2]) + ") has material " +
+                            std::to_string(material) + ", expected " +
+                            (slot == 0 ? std::string("no face or one quad") : std::to_string(slot));
+                }
+                failures++;
+            }
+            // Cleared so a second quad over the same face fails, and leftovers are missing faces
+            slot = 0;
+        }
+    }
+    return failures;
+}
+
+static bool checkCase(ChunkMesher &mesher, const MesherCase &test, std::ostream &out)
+{
+    const Chunk *neighbours[FACE_COUNT];
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        neighbours[face] = test.hasNeighbour[face] ? &test.neighbourChunks[face] : nullptr;
+    }
+
+    ChunkMesh mesh;
+    mesher.mesh(test.chunk, neighbours, mesh);
+    std::vector<uint32_t> expected = naiveFaces(test.chunk, neighbours);
+
+    int failures = 0;
+    auto fail = [&](const std::string &message)
+    {
+        if (failures < maxReportedFailures)
+        {
+            out << "check: mesher." << test.name << ": " << message << "\n";
+        }
+        failures++;
+    };
+
+    if (mesh.vertices.size() % 4 != 0 || mesh.indices.size() != mesh.quadCount() * 6)
+    {
+        fail(std::to_string(mesh.vertices.size()) + " vertices and " + std::to_string(mesh.indices.size()) +
+             " indices are not whole quads");
+        return false;
+    }
+    if (test.expectedQuads >= 0 && mesh.quadCount() != static_cast<size_t>(test.expectedQuads))
+    {
+        fail(std::to_string(mesh.quadCount()) + " quads, expected " + std::to_string(test.expectedQuads));
+    }
+
+    for (size_t quad = 0; quad < mesh.quadCount(); quad++)
+    {
+        std::string error;
+        int quadFailures = checkQuad(mesh, quad, expected, error);
+        if (quadFailures > 0)
+        {
+            fail("quad " + std::to_string(quad) + ": " + error);
+            failures += quadFailures - 1;
+        }
+    }
+
+    size_t missing = 0;
+    for (uint32_t material : expected)
+    {
+        missing += material != 0;
+    }
+    if (missing > 0)
+    {
+        fail(std::to_string(missing) + " visible faces not covered by any quad");
+    }
+
+    if (failures > maxReportedFailures)
+    {
+        out << "check: mesher." << test.name << ": " << failures - maxReportedFailures << " more failures\n";
+    }
+    return failures == 0;
+}
+
+static void fillCheckerboard(Chunk &chunk)
+{
+    std::vector<Voxel> voxels(Chunk::VOLUME);
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int y = 0; y < Chunk::SIZE; y++)
+        {
+            for (int x = 0; x < Chunk::SIZE; x++)
+            {
+                voxels[Chunk::index(x, y, z)] = ((x + y + z) & 1) ? MATERIAL_STONE : MATERIAL_AIR;
+            }
+        }
+    }
+    chunk.encode(voxels.data());
+}
+
+// Blocks of blockSize^3 voxels share a value, so larger blocks give the greedy merge more to do.
+// Air gets one of a few light values, solid voxels one of the terrain materials.
+static void fillRandom(Chunk &chunk, std::mt19937 &random, float density, int blockSize)
+{
+    static const uint8_t lights[] = {0, LIGHT_OPEN_SKY, 0x3A, 0x0F};
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+    std::uniform_int_distribution<int> material(MATERIAL_STONE, MATERIAL_GRASS);
+    std::uniform_int_distribution<int> light(0, 3);
+
+    std::vector<Voxel> voxels(Chunk::VOLUME);
+    std::vector<uint8_t> voxelLights(Chunk::VOLUME);
+    for (int z = 0; z < Chunk::SIZE; z += blockSize)
+    {
+        for (int y = 0; y < Chunk::SIZE; y += blockSize)
+        {
+            for (int x = 0; x < Chunk::SIZE; x += blockSize)
+            {
+                Voxel value = chance(random) < density ? static_cast<Voxel>(material(random)) : static_cast<Voxel>(MATERIAL_AIR);
+                uint8_t level = value == MATERIAL_AIR ? lights[light(random)] : 0;
+                for (int i = 0; i < blockSize * blockSize * blockSize; i++)
+                {
+                    int index = Chunk::index(x + i % blockSize, y + i / blockSize % blockSize, z + i / (blockSize * blockSize));
+                    voxels[index] = value;
+                    voxelLights[index] = level;
+                }
+            }
+        }
+    }
+    chunk.encode(voxels.data());
+    for (int i = 0; i < Chunk::VOLUME; i++)
+    {
+        chunk.setLight(i, voxelLights[i]);
+    }
+    chunk.compactLight();
+}
+
+static std::vector<MesherCase> fixedCases()
+{
+    std::vector<MesherCase> cases;
+
+    // A lone voxel has six faces that cannot merge
+    cases.emplace_back();
+    cases.back().name = "single_voxel";
+    cases.back().chunk.set(Chunk::SIZE / 2, Chunk::SIZE / 2, Chunk::SIZE / 2, MATERIAL_DIRT);
+    cases.back().expectedQuads = 6;
+
+    // A solid chunk under open sky merges into one quad per side
+    cases.emplace_back();
+    cases.back().name = "solid_open";
+    cases.back().chunk.fill(MATERIAL_STONE);
+    cases.back().expectedQuads = 6;
+
+    // Solid neighbours on every side cull every border face
+    cases.emplace_back();
+    cases.back().name = "solid_enclosed";
+    cases.back().chunk.fill(MATERIAL_STONE);
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        cases.back().neighbourChunks[face].fill(MATERIAL_DIRT);
+        cases.back().hasNeighbour[face] = true;
+    }
+    cases.back().expectedQuads = 0;
+
+    // Lower half solid with a solid chunk on -x: -x is culled, the other five
+    // sides are one quad each
+    cases.emplace_back();
+    cases.back().name = "half_culled";
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int y = 0; y < Chunk::SIZE / 2; y++)
+        {
+            for (int x = 0; x < Chunk::SIZE; x++)
+            {
+                cases.back().chunk.set(x, y, z, MATERIAL_STONE);
+            }
+        }
+    }
+    cases.back().neighbourChunks[FACE_NEG_X].fill(MATERIAL_STONE);
+    cases.back().hasNeighbour[FACE_NEG_X] = true;
+    cases.back().expectedQuads = 5;
+
+    // Light splits otherwise mergeable faces: two light levels over a flat floor, two quads on top
+    cases.emplace_back();
+    cases.back().name = "light_split";
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int x = 0; x < Chunk::SIZE; x++)
+        {
+            cases.back().chunk.set(x, 0, z, MATERIAL_GRASS);
+            cases.back().chunk.setLight(Chunk::index(x, 1, z), x < Chunk::SIZE / 2 ? LIGHT_OPEN_SKY : 0x07);
+        }
+    }
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        cases.back().neighbourChunks[face].fill(face == FACE_POS_Y ? MATERIAL_AIR : MATERIAL_STONE);
+        cases.back().hasNeighbour[face] = true;
+    }
+    cases.back().expectedQuads = 2;
+
+    // The worst case, every solid voxel is its own quad on all six sides
+    cases.emplace_back();
+    cases.back().name = "checkerboard";
+    fillCheckerboard(cases.back().chunk);
+    cases.back().expectedQuads = Chunk::VOLUME / 2 * 6;
+
+    return cases;
+}
+
+bool runMesherCheck(std::ostream &out)
+{
+    // Vertex layout the shaders decode, see ChunkVertex
+    bool passed = ChunkVertex::pack(32, 1, 17, FACE_POS_Z) == (32u | 1u << 6 | 17u << 12 | 5u << 18) &&
+                  ChunkVertex::packMaterial(0xFFFF, 0xAB) == (0xFFFFu | 0xABu << 16);
+    if (!passed)
+    {
+        out << "check: mesher.packing: ChunkVertex packs differently than the shaders decode\n";
+    }
+
+    ChunkMesher mesher;
+    int cases = 0;
+    for (const MesherCase &test : fixedCases())
+    {
+        passed &= checkCase(mesher, test, out);
+        cases++;
+    }
+
+    // Random chunks with random neighbours: none, uniform air or stone, or random as well
+    std::mt19937 random(1337);
+    const float densities[] = {0.1f, 0.5f, 0.9f};
+    const int blockSizes[] = {1, 2, 4};
+    std::uniform_int_distribution<int> neighbourKind(0, 3);
+    for (int seed = 0; seed < 8; seed++)
+    {
+        for (float density : densities)
+        {
+            for (int blockSize : blockSizes)
+            {
+                MesherCase test;
+                test.name = "random_" + std::to_string(seed) + "_" + std::to_string(static_cast<int>(density * 100)) +
+                            "_" + std::to_string(blockSize);
+                fillRandom(test.chunk, random, density, blockSize);
+                for (uint32_t face = 0; face < FACE_COUNT; face++)
+                {
+                    int kind = neighbourKind(random);
+                    test.hasNeighbour[face] = kind != 0;
+                    if (kind == 1)
+                    {
+                        test.neighbourChunks[face].fill(MATERIAL_AIR);
+                        test.neighbourChunks[face].fillLight(0x5C);
+                    }
+                    else if (kind == 2)
+                    {
+                        test.neighbourChunks[face].fill(MATERIAL_STONE);
+                    }
+                    else if (kind == 3)
+                    {
+                        fillRandom(test.neighbourChunks[face], random, density, blockSize);
+                    }
+                }
+                passed &= checkCase(mesher, test, out);
+                cases++;
+            }
+        }
+    }
+
+    out << "check: mesher " << (passed ? "passed" : "FAILED") << ", " << cases << " cases\n";
+    return passed;
+}
@@ -0,0 +1,97 @@
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../jobs/job_system.h"
+#include "../render/cpu_raytracer.h"
+#include "../world/terrain.h"
+#include "../world/voxel_volume.h"
+
+static const uint32_t imageWidth = 640;
+static const uint32_t imageHeight = 360;
+
+// The app's orbit camera at a few points of its orbit
+static void orbitCamera(int view, Vec3 &position, Mat4 &viewProjection)
+{
+    float angle = static_cast<float>(view) * 1.3f;
+    position = Vec3(std::cos(angle) * 160.0f, 170.0f, std::sin(angle) * 160.0f);
+    float aspect = static_cast<float>(imageWidth) / imageHeight;
+    viewProjection = perspectiveReverseZ(1.0472f, aspect, 0.5f) *
+                     lookAt(position, Vec3(0.0f, 96.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Total time of every view at one SIMD level, the images of the last pass kept for comparison
+static CpuRenderStats renderViews(const CpuRaytracer &raytracer, JobSystem *jobs, int views,
+                                  std::vector<std::vector<uint8_t>> &images)
+{
+    CpuRenderStats total;
+    images.resize(views);
+    for (int view = 0; view < views; view++)
+    {
+        Vec3 position;
+        Mat4 viewProjection;
+        orbitCamera(view, position, viewProjection);
+        CpuRenderStats stats = raytracer.render(viewProjection, position, imageWidth, imageHeight, images[view], jobs);
+        total.seconds += stats.seconds;
+        total.rays += stats.rays;
+        total.threads = stats.threads;
+    }
+    return total;
+}
+
+void runRaytracerBenchmark(BenchReport &report)
+{
+    World world;
+    generateTerrain(world, {-4, 0, -4}, {4, 6, 4});
+    VoxelVolume volume;
+    volume.build(world);
+
+    CpuRaytracer raytracer;
+    raytracer.setVolume(volume);
+
+    JobSystem jobs;
+    jobs.init();
+
+    const int views = 4;
+    uint32_t threads = 1;
+    std::vector<std::vector<uint8_t>> reference;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2})
+    {
+        if (!isSimdLevelSupported(level))
+        {
+            continue;
+        }
+        raytracer.setSimdLevel(level);
+        std::string prefix = std::string("raytracer.") + simdLevelName(level) + ".";
+
+        std::vector<std::vector<uint8_t>> images;
+        CpuRenderStats single = renderViews(raytracer, nullptr, views, images);
+        CpuRenderStats threaded = renderViews(raytracer, &jobs, views, images);
+        report.add(prefix + "single_thread", single.megaraysPerSecond(), "Mrays/s");
+        report.add(prefix + "threaded", threaded.megaraysPerSecond(), "Mrays/s");
+        report.add(prefix + "threaded_per_thread", threaded.megaraysPerSecondPerThread(), "Mrays/s");
+        threads = threaded.threads;
+
+        // Every level must reproduce the scalar image exactly
+        if (reference.empty())
+        {
+            reference = images;
+            continue;
+        }
+        uint64_t mismatched = 0;
+        for (int view = 0; view < views; view++)
+        {
+            for (size_t i = 0; i < images[view].size(); i += 4)
+            {
+                mismatched += images[view][i] != reference[view][i] || images[view][i + 1] != reference[view][i + 1] ||
+                              images[view][i + 2] != reference[view][i + 2];
+            }
+        }
+        report.add(prefix + "pixels_differing_from_scalar", static_cast<double>(mismatched), "px");
+    }
+
+    report.add("raytracer.threads", threads, "threads");
+    jobs.shutdown();
+}
@@ -0,0 +1,107 @@
+#include <cmath>
+
+#include "scene.h"
+#include "../world/chunk.h"
+
+static const BenchScene scenes[] = {
+    {"hills", {-4, 0, -4}, {4, 6, 4}, {0, 3, 0}},
+    {"wide", {-12, 0, -12}, {12, 6, 12}, {0, 3, 0}},
+};
+
+// Rough middle of the terrain's height range, see terrain.cpp
+static const float groundHeight = 96.0f;
+
+const BenchScene *findBenchScene(const std::string &name)
+{
+    for (const BenchScene &scene : scenes)
+    {
+        if (name == scene.name)
+        {
+            return &scene;
+        }
+    }
+    return nullptr;
+}
+
+std::string benchSceneNames()
+{
+    std::string names;
+    for (const BenchScene &scene : scenes)
+    {
+        names += names.empty() ? "" : ", ";
+        names += scene.name;
+    }
+    return names;
+}
+
+const char *cameraPathName(CameraPath path)
+{
+    switch (path)
+    {
+    case CameraPath::Flyover:
+        return "flyover";
+    case CameraPath::Dive:
+        return "dive";
+    default:
+        return "orbit";
+    }
+}
+
+bool parseCameraPath(const std::string &name, CameraPath &path)
+{
+    for (CameraPath candidate : {CameraPath::Orbit, CameraPath::Flyover, CameraPath::Dive})
+    {
+        if (name == cameraPathName(candidate))
+        {
+            path = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+CameraPose cameraPose(CameraPath path, const BenchScene &scene, uint64_t frame)
+{
+    float size = static_cast<float>(Chunk::SIZE);
+    float centerX = (scene.min.x + scene.max.x) * 0.5f * size;
+    float centerZ = (scene.min.z + scene.max.z) * 0.5f * size;
+    float halfWidth = (scene.max.x - scene.min.x) * 0.5f * size;
+
+    CameraPose pose;
+    switch (path)
+    {
+    case CameraPath::Flyover:
+    {
+        // 800 frames per pass, then back along the same line
+        const uint64_t passFrames = 800;
+        float t = static_cast<float>(frame % passFrames) / passFrames;
+        bool back = (frame / passFrames) % 2 == 1;
+        float x = centerX - halfWidth + 2.0f * halfWidth * (back ? 1.0f - t : t);
+        float ahead = back ? -64.0f : 64.0f;
+        pose.position = Vec3(x, groundHeight + 40.0f, centerZ);
+        pose.target = Vec3(x + ahead, groundHeight, centerZ);
+        break;
+    }
+    case CameraPath::Dive:
+    {
+        // 600 frames from the top of the spiral to the bottom, then again
+        const uint64_t diveFrames = 600;
+        float t = static_cast<float>(frame % diveFrames) / diveFrames;
+        float angle = t * 6.2832f;
+        float radius = halfWidth * (1.0f - 0.8f * t);
+        pose.position = Vec3(centerX + std::cos(angle) * radius, groundHeight + 300.0f * (1.0f - t) + 30.0f,
+                             centerZ + std::sin(angle) * radius);
+        pose.target = Vec3(centerX, groundHeight, centerZ);
+        break;
+    }
+    default:
+    {
+        float angle = static_cast<float>(frame) * 0.005f;
+        float radius = halfWidth * 1.25f;
+        pose.position = Vec3(centerX + std::cos(angle) * radius, 170.0f, centerZ + std::sin(angle) * radius);
+        pose.target = Vec3(centerX, groundHeight, centerZ);
+        break;
+    }
+    }
+    return pose;
+}
@@ -0,0 +1,47 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <string>
+
+#include "../math/matrix.h"
+#include "../world/world.h"
+
+// Fixed worlds and scripted camera paths for reproducible runs. Cameras are a
+// function of the frame number only, never of wall time, so two runs with the
+// same arguments render the same frames on any machine.
+
+// Chunks in [min, max) are loaded, nearest to focus first
+struct BenchScene
+{
+    const char *name;
+    ChunkCoord min;
+    ChunkCoord max;
+    ChunkCoord focus;
+};
+
+// Null if there is no scene with that name
+const BenchScene *findBenchScene(const std::string &name);
+// Comma-separated, for error messages
+std::string benchSceneNames();
+
+enum class CameraPath
+{
+    Orbit,   // slow circle around the middle of the scene
+    Flyover, // low straight pass across the scene and back
+    Dive     // spiral from high above down to the ground
+};
+
+const char *cameraPathName(CameraPath path);
+// False if the name is unknown
+bool parseCameraPath(const std::string &name, CameraPath &path);
+
+struct CameraPose
+{
+    Vec3 position;
+    Vec3 target;
+};
+
+CameraPose cameraPose(CameraPath path, const BenchScene &scene, uint64_t frame);
+
+#endif
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../vulkan/suballocator.h"
+
+struct Range
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Live ranges keyed by offset, to catch overlaps between allocations
+class RangeTracker
+{
+public:
+    explicit RangeTracker(uint64_t capacity) : capacity(capacity) {}
+
+    // Empty if the range is inside the block and overlaps nothing live, the problem otherwise
+    std::string add(uint64_t offset, uint64_t size)
+    {
+        if (offset + size > capacity)
+        {
+            return "range " + describe(offset, size) + " ends past the block";
+        }
+        auto next = ranges.lower_bound(offset);
+        if (next != ranges.end() && next->first < offset + size)
+        {
+            return "range " + describe(offset, size) + " overlaps " + describe(next->first, next->second);
+        }
+        if (next != ranges.begin() && std::prev(next)->first + std::prev(next)->second > offset)
+        {
+            return "range " + describe(offset, size) + " overlaps " +
+                   describe(std::prev(next)->first, std::prev(next)->second);
+        }
+        ranges[offset] = size;
+        return "";
+    }
+    void remove(uint64_t offset) { ranges.erase(offset); }
+
+private:
+    uint64_t capacity;
+    std::map<uint64_t, uint64_t> ranges;
+
+    static std::string describe(uint64_t offset, uint64_t size)
+    {
+        return "[" + std::to_string(offset) + ", " + std::to_string(offset + size) + ")";
+    }
+};
+
+class CheckLog
+{
+public:
+    explicit CheckLog(std::ostream &out) : out(out) {}
+
+    void expect(bool condition, const std::string &name, const std::string &message)
+    {
+        if (!condition)
+        {
+            out << "check: suballocator." << name << ": " << message << "\n";
+            passed = false;
+        }
+    }
+    bool hasPassed() const { return passed; }
+
+private:
+    std::ostream &out;
+    bool passed = true;
+};
+
+static void checkLinear(CheckLog &log)
+{
+    const uint64_t capacity = 4096;
+    LinearSubAllocator linear(capacity);
+    RangeTracker tracker(capacity);
+
+    // Alignments are honoured and bumping stops at the end of the block
+    const uint64_t sizes[][2] = {{100, 1}, {64, 256}, {1, 1}, {300, 16}, {512, 512}};
+    for (const auto &request : sizes)
+    {
+        std::optional<uint64_t> offset = linear.allocate(request[0], request[1]);
+        log.expect(offset.has_value(), "linear", "allocation of " + std::to_string(request[0]) + " failed");
+        if (offset)
+        {
+            log.expect(*offset % request[1] == 0, "linear", "offset " + std::to_string(*offset) + " not aligned");
+            std::string error = tracker.add(*offset, request[0]);
+            log.expect(error.empty(), "linear", error);
+        }
+    }
+    log.expect(!linear.allocate(capacity, 1), "linear", "allocation past the end of the block succeeded");
+    log.expect(linear.getAllocationCount() == 5, "linear", "allocation count is not 5");
+
+    // Only freeing everything rewinds the block
+    for (int i = 0; i < 4; i++)
+    {
+        linear.free(0, 0);
+    }
+    log.expect(!linear.isEmpty() && !linear.allocate(capacity, 1), "linear", "block rewound before the last free");
+    linear.free(0, 0);
+    log.expect(linear.isEmpty() && linear.getUsedBytes() == 0, "linear", "block not empty after the last free");
+    std::optional<uint64_t> whole = linear.allocate(capacity, 1);
+    log.expect(whole && *whole == 0, "linear", "whole block not available after the last free");
+    linear.free(0, 0);
+
+    bool threw = false;
+    try
+    {
+        linear.free(0, 0);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    log.expect(threw, "linear", "freeing more than was allocated did not throw");
+}
+
+static void checkPool(CheckLog &log)
+{
+    const uint64_t capacity = 64 * 1024;
+    const uint64_t slotSize = 1024;
+    PoolSubAllocator pool(capacity, slotSize);
+    RangeTracker tracker(capacity);
+
+    log.expect(!pool.allocate(slotSize + 1, 1), "pool", "allocation larger than a slot succeeded");
+    log.expect(!pool.allocate(16, slotSize * 2), "pool", "alignment larger than a slot succeeded");
+
+    // Every slot once, slot aligned, then the pool is exhausted
+    std::vector<uint64_t> offsets;
+    while (std::optional<uint64_t> offset = pool.allocate(slotSize / 2, 16))
+    {
+        log.expect(*offset % slotSize == 0, "pool", "offset " + std::to_string(*offset) + " not slot aligned");
+        std::string error = tracker.add(*offset, slotSize);
+        log.expect(error.empty(), "pool", error);
+        offsets.push_back(*offset);
+        if (offsets.size() > capacity / slotSize)
+        {
+            break;
+        }
+    }
+    log.expect(offsets.size() == capacity / slotSize, "pool",
+               std::to_string(offsets.size()) + " slots handed out, expected " + std::to_string(capacity / slotSize));
+    log.expect(pool.getUsedBytes() == capacity, "pool", "used bytes of a full pool differ from its capacity");
+
+    // A freed slot is the next one handed out
+    pool.free(offsets[7], slotSize / 2);
+    std::optional<uint64_t> reused = pool.allocate(slotSize, 1);
+    log.expect(reused && *reused == offsets[7], "pool", "freed slot not reused");
+    offsets[7] = reused ? *reused : offsets[7];
+
+    for (uint64_t offset : offsets)
+    {
+        pool.free(offset, slotSize);
+    }
+    log.expect(pool.isEmpty() && pool.getUsedBytes() == 0, "pool", "pool not empty after freeing every slot");
+
+    bool threw = false;
+    try
+    {
+        PoolSubAllocator invalid(capacity, 1000);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    log.expect(threw, "pool", "slot size that is not a power of two did not throw");
+}
+
+// Random allocations and frees, checked for overlaps and natural alignment,
+// then everything is freed and must coalesce back into one block
+static void checkBuddy(CheckLog &log)
+{
+    const uint64_t capacity = 1024 * 1024;
+    const uint64_t minBlockSize = 256;
+    BuddySubAllocator buddy(capacity, minBlockSize);
+    RangeTracker tracker(capacity);
+
+    // Filled with minimum blocks exactly, then empty again
+    std::vector<uint64_t> offsets;
+    while (std::optional<uint64_t> offset = buddy.allocate(1, 1))
+    {
+        offsets.push_back(*offset);
+    }
+    log.expect(offsets.size() == capacity / minBlockSize, "buddy",
+               std::to_string(offsets.size()) + " minimum blocks fit, expected " +
+                   std::to_string(capacity / minBlockSize));
+    log.expect(buddy.getLargestFreeBlock() == 0, "buddy", "full allocator reports a free block");
+    for (uint64_t offset : offsets)
+    {
+        buddy.free(offset, 1);
+    }
+    log.expect(buddy.getLargestFreeBlock() == capacity, "buddy", "minimum blocks did not coalesce back into one");
+
+    std::mt19937 random(1337);
+    std::uniform_int_distribution<uint64_t> sizeBits(0, 16);
+    std::uniform_int_distribution<uint64_t> alignmentBits(0, 12);
+    std::uniform_int_distribution<int> action(0, 2);
+    std::vector<Range> live;
+    for (int step = 0; step < 20000; step++)
+    {
+        if (!live.empty() && action(random) == 0)
+        {
+            size_t pick = std::uniform_int_distribution<size_t>(0, live.size() - 1)(random);
+            buddy.free(live[pick].offset, live[pick].size);
+            tracker.remove(live[pick].offset);
+            live[pick] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        uint64_t size = std::uniform_int_distribution<uint64_t>(1, 1ull << sizeBits(random))(random);
+        uint64_t alignment = 1ull << alignmentBits(random);
+        std::optional<uint64_t> offset = buddy.allocate(size, alignment);
+        if (!offset)
+        {
+            continue;
+        }
+        uint64_t rounded = std::max({nextPowerOfTwo(size), alignment, minBlockSize});
+        log.expect(*offset % rounded == 0, "buddy",
+                   "offset " + std::to_string(*offset) + " not aligned to its rounded size " + std::to_string(rounded));
+        std::string error = tracker.add(*offset, rounded);
+        log.expect(error.empty(), "buddy", error);
+        if (!error.empty())
+        {
+            return;
+        }
+        live.push_back({*offset, size});
+    }
+
+    uint64_t used = buddy.getUsedBytes();
+    for (const Range &range : live)
+    {
+        buddy.free(range.offset, range.size);
+    }
+    log.expect(used > 0, "buddy", "random run left nothing allocated to free");
+    log.expect(buddy.isEmpty() && buddy.getUsedBytes() == 0, "buddy", "allocator not empty after freeing everything");
+    log.expect(buddy.getLargestFreeBlock() == capacity, "buddy", "free blocks did not coalesce back into one");
+
+    bool threw = false;
+    try
+    {
+        buddy.free(minBlockSize, 1);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    log.expect(threw, "buddy", "freeing an unknown offset did not throw");
+}
+
+bool runSubAllocatorCheck(std::ostream &out)
+{
+    CheckLog log(out);
+    checkLinear(log);
+    checkPool(log);
+    checkBuddy(log);
+    out << "check: suballocator " << (log.hasPassed() ? "passed" : "FAILED") << "\n";
+    return log.hasPassed();
+}
@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../jobs/job_system.h"
+#include "../world/terrain.h"
+
+// Generates the chunks of a 16x8x16 area, which spans the terrain's surface
+// band and the air and stone around it, at every supported SIMD level, single
+// threaded and across the job system
+void runTerrainBenchmark(BenchReport &report)
+{
+    const ChunkCoord min{0, 0, 0}, max{16, 8, 16};
+    std::vector<ChunkCoord> coords;
+    for (int32_t z = min.z; z < max.z; z++)
+    {
+        for (int32_t y = min.y; y < max.y; y++)
+        {
+            for (int32_t x = min.x; x < max.x; x++)
+            {
+                coords.push_back({x, y, z});
+            }
+        }
+    }
+
+    JobSystem jobs;
+    jobs.init();
+
+    SimdLevel original = getTerrainSimdLevel();
+    std::vector<Voxel> reference;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2})
+    {
+        if (!isSimdLevelSupported(level))
+        {
+            continue;
+        }
+        setTerrainSimdLevel(level);
+        std::string prefix = std::string("terrain.") + simdLevelName(level) + ".";
+
+        std::vector<Voxel> voxels(coords.size() * Chunk::VOLUME);
+        BenchTimer single;
+        for (size_t i = 0; i < coords.size(); i++)
+        {
+            generateTerrainChunk(coords[i], voxels.data() + i * Chunk::VOLUME);
+        }
+        report.add(prefix + "single_thread", coords.size() / single.elapsedSeconds(), "chunks/s");
+
+        JobCounter counter;
+        BenchTimer threaded;
+        for (size_t i = 0; i < coords.size(); i++)
+        {
+            jobs.submit([&, i] { generateTerrainChunk(coords[i], voxels.data() + i * Chunk::VOLUME); },
+                        JobPriority::Normal, &counter);
+        }
+        jobs.wait(counter);
+        report.add(prefix + "threaded", coords.size() / threaded.elapsedSeconds(), "chunks/s");
+
+        // The same seed has to give the same world at every level
+        if (reference.empty())
+        {
+            reference = voxels;
+            continue;
+        }
+        uint64_t mismatched = 0;
+        for (size_t i = 0; i < voxels.size(); i++)
+        {
+            mismatched += voxels[i] != reference[i];
+        }
+        report.add(prefix + "voxels_differing_from_scalar", static_cast<double>(mismatched), "voxels");
+    }
+
+    setTerrainSimdLevel(original);
+    jobs.shutdown();
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../world/terrain.h"
+#include "../world/world.h"
+
+// xorshift32, so every run measures the same data
+static uint32_t nextRandom(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Runs of random length over `distinct` materials, closer to real data than per-voxel noise
+static std::vector<Voxel> makePattern(uint32_t distinct, uint32_t seed)
+{
+    std::vector<Voxel> voxels(Chunk::VOLUME);
+    uint32_t state = seed;
+    int i = 0;
+    while (i < Chunk::VOLUME)
+    {
+        Voxel value = static_cast<Voxel>(1 + nextRandom(state) % distinct);
+        int run = 1 + static_cast<int>(nextRandom(state) % 16);
+        for (int j = 0; j < run && i < Chunk::VOLUME; j++)
+        {
+            voxels[i++] = value;
+        }
+    }
+    return voxels;
+}
+
+static void benchChunk(BenchReport &report, const std::string &name, uint32_t distinct)
+{
+    const std::string prefix = "world." + name + ".";
+    std::vector<Voxel> voxels = makePattern(distinct, 0x1234567u + distinct);
+
+    Chunk chunk;
+    chunk.encode(voxels.data());
+    report.add(prefix + "bytes_per_chunk", static_cast<double>(chunk.memoryUsage()), "B");
+    report.add(prefix + "bits_per_voxel", chunk.getBitsPerVoxel(), "bits");
+
+    const int accessCount = 1 << 22;
+    std::vector<int> indices(accessCount);
+    uint32_t state = 42;
+    for (int &index : indices)
+    {
+        index = static_cast<int>(nextRandom(state) % Chunk::VOLUME);
+    }
+
+    uint64_t sum = 0;
+    BenchTimer getTimer;
+    for (int index : indices)
+    {
+        sum += chunk.get(index);
+    }
+    report.add(prefix + "random_get", getTimer.elapsedSeconds() * 1e9 / accessCount, "ns/op");
+
+    const int decodeCount = 256;
+    std::vector<Voxel> decoded(Chunk::VOLUME);
+    BenchTimer decodeTimer;
+    for (int i = 0; i < decodeCount; i++)
+    {
+        chunk.decode(decoded.data());
+        sum += decoded[i];
+    }
+    double decodeSeconds = decodeTimer.elapsedSeconds();
+    report.add(prefix + "bulk_decode", static_cast<double>(decodeCount) * Chunk::VOLUME / decodeSeconds / 1e6,
+               "Mvoxel/s");
+
+    // Rewrites voxels with values already in the palette, so the width stays the same
+    BenchTimer setTimer;
+    for (int i = 0; i < accessCount; i++)
+    {
+        chunk.set(indices[i], voxels[indices[(i + 1) & (accessCount - 1)]]);
+    }
+    report.add(prefix + "random_set", setTimer.elapsedSeconds() * 1e9 / accessCount, "ns/op");
+
+    benchSink(sum);
+}
+
+static void benchWorld(BenchReport &report)
+{
+    // Rolling heightmap terrain, 16x8x16 chunks
+    const int chunksX = 16, chunksY = 8, chunksZ = 16;
+    World world;
+
+    BenchTimer buildTimer;
+    generateTerrain(world, {0, 0, 0}, {chunksX, chunksY, chunksZ});
+    report.add("world.terrain.build", buildTimer.elapsedSeconds() * 1e3, "ms");
+
+    WorldMemoryStats stats = world.getMemoryStats();
+    report.add("world.terrain.chunks", static_cast<double>(stats.chunkCount), "chunks");
+    report.add("world.terrain.uniform_chunks", static_cast<double>(stats.uniformChunks), "chunks");
+    report.add("world.terrain.bytes_per_chunk",
+               static_cast<double>(stats.chunkBytes) / std::max<size_t>(stats.chunkCount, 1), "B");
+    report.add("world.terrain.compression",
+               static_cast<double>(stats.rawBytes) / std::max<size_t>(stats.chunkBytes + stats.mapBytes, 1), "x");
+
+    const int accessCount = 1 << 22;
+    uint32_t state = 7;
+    uint64_t sum = 0;
+    BenchTimer getTimer;
+    for (int i = 0; i < accessCount; i++)
+    {
+        int32_t x = static_cast<int32_t>(nextRandom(state) % (chunksX * Chunk::SIZE));
+        int32_t y = static_cast<int32_t>(nextRandom(state) % (chunksY * Chunk::SIZE));
+        int32_t z = static_cast<int32_t>(nextRandom(state) % (chunksZ * Chunk::SIZE));
+        sum += world.getVoxel(x, y, z);
+    }
+    report.add("world.terrain.random_get", getTimer.elapsedSeconds() * 1e9 / accessCount, "ns/op");
+
+    BenchTimer lookupTimer;
+    for (int i = 0; i < accessCount; i++)
+    {
+        ChunkCoord coord{static_cast<int32_t>(nextRandom(state) % (chunksX * 2)),
+                         static_cast<int32_t>(nextRandom(state) % chunksY),
+                         static_cast<int32_t>(nextRandom(state) % chunksZ)};
+        sum += world.getChunk(coord) != nullptr ? 1 : 0;
+    }
+    report.add("world.map.lookup", lookupTimer.elapsedSeconds() * 1e9 / accessCount, "ns/op");
+
+    benchSink(sum);
+}
+
+void runWorldBenchmark(BenchReport &report)
+{
+    benchChunk(report, "uniform", 1);
+    benchChunk(report, "palette2", 2);
+    benchChunk(report, "palette16", 16);
+    benchChunk(report, "palette256", 256);
+    benchChunk(report, "direct", 4096);
+    benchWorld(report);
+}
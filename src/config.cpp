@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cstdlib>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+#include "config.h"
+
+const char *renderPathName(RenderPath path)
+{
+    switch (path)
+    {
+    case RenderPath::Raymarch:
+        return "raymarch";
+    case RenderPath::Cpu:
+        return "cpu";
+    default:
+        return "raster";
+    }
+}
+
+const char *presentModeName(PresentMode mode)
+{
+    switch (mode)
+    {
+    case PresentMode::Immediate:
+        return "immediate";
+    case PresentMode::Fifo:
+        return "fifo";
+    case PresentMode::FifoRelaxed:
+        return "fifo-relaxed";
+    default:
+        return "mailbox";
+    }
+}
+
+bool parsePresentMode(const std::string &name, PresentMode &mode)
+{
+    for (PresentMode candidate : {PresentMode::Immediate, PresentMode::Mailbox, PresentMode::Fifo, PresentMode::FifoRelaxed})
+    {
+        if (name == presentModeName(candidate))
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::string nextArg(int &i, int argc, char **argv)
+{
+    if (i + 1 >= argc)
+    {
+        throw std::runtime_error(std::string("missing value for ") + argv[i]);
+    }
+    return argv[++i];
+}
+
+Config Config::parse(int argc, char **argv)
+{
+    Config config;
+
+    if (const char *device = std::getenv("VOXIN_DEVICE"))
+    {
+        config.device = device;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--frames-in-flight")
+        {
+            int frames = std::stoi(nextArg(i, argc, argv));
+            config.framesInFlight = static_cast<uint32_t>(std::clamp(frames, 1, 3));
+        }
+        else if (arg == "--present-mode")
+        {
+            if (!parsePresentMode(nextArg(i, argc, argv), config.presentMode))
+            {
+                throw std::runtime_error("--present-mode expects immediate, mailbox, fifo or fifo-relaxed");
+            }
+        }
+        else if (arg == "--swapchain-images")
+        {
+            config.swapchainImages = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--headless")
+        {
+            config.headless = true;
+        }
+        else if (arg == "--size")
+        {
+            std::string size = nextArg(i, argc, argv);
+            size_t separator = size.find('x');
+            if (separator == std::string::npos)
+            {
+                throw std::runtime_error("--size expects WIDTHxHEIGHT");
+            }
+            config.width = static_cast<uint32_t>(std::stoul(size.substr(0, separator)));
+            config.height = static_cast<uint32_t>(std::stoul(size.substr(separator + 1)));
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--lod-radius")
+        {
+            config.lodRadius = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--world-dir")
+        {
+            config.worldDirectory = nextArg(i, argc, argv);
+        }
+        else if (arg == "--view-distance")
+        {
+            config.viewDistance = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--chunk-cache-mb")
+        {
+            config.chunkCacheMegabytes = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--edit-every")
+        {
+            config.editInterval = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--frames")
+        {
+            config.frameCount = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--capture")
+        {
+            config.capturePath = nextArg(i, argc, argv);
+        }
+        else if (arg == "--pipeline-cache")
+        {
+            config.pipelineCachePath = nextArg(i, argc, argv);
+        }
+        else if (arg == "--no-pipeline-cache")
+        {
+            config.pipelineCachePath.clear();
+        }
+        else if (arg == "--shader-dir")
+        {
+            config.shaderDirectory = nextArg(i, argc, argv);
+        }
+        else if (arg == "--renderer")
+        {
+            std::string path = nextArg(i, argc, argv);
+            if (path == "raster")
+            {
+                config.renderPath = RenderPath::Raster;
+            }
+            else if (path == "raymarch")
+            {
+                config.renderPath = RenderPath::Raymarch;
+            }
+            else if (path == "cpu")
+            {
+                config.renderPath = RenderPath::Cpu;
+            }
+            else
+            {
+                throw std::runtime_error("--renderer expects raster, raymarch or cpu");
+            }
+        }
+        else if (arg == "--depth-prepass")
+        {
+            config.depthPrepass = true;
+        }
+        else if (arg == "--no-occlusion-culling")
+        {
+            config.occlusionCulling = false;
+        }
+        else if (arg == "--workers")
+        {
+            config.workerThreads = static_cast<uint32_t>(std::stoul(nextArg(i, argc, argv)));
+        }
+        else if (arg == "--bench")
+        {
+            config.benchmark = nextArg(i, argc, argv);
+        }
+        else if (arg == "--check")
+        {
+            config.check = nextArg(i, argc, argv);
+        }
+        else if (arg == "--scene")
+        {
+            config.scene = nextArg(i, argc, argv);
+            if (!findBenchScene(config.scene))
+            {
+                throw std::runtime_error("--scene expects one of " + benchSceneNames());
+            }
+        }
+        else if (arg == "--camera-path")
+        {
+            if (!parseCameraPath(nextArg(i, argc, argv), config.cameraPath))
+            {
+                throw std::runtime_error("--camera-path expects orbit, flyover or dive");
+            }
+        }
+        else if (arg == "--device")
+        {
+            config.device = nextArg(i, argc, argv);
+        }
+        else if (arg == "--bench-json")
+        {
+            config.benchJsonPath = nextArg(i, argc, argv);
+        }
+        else if (arg == "--profile")
+        {
+            config.profilePath = nextArg(i, argc, argv);
+        }
+        else
+        {
+            throw std::runtime_error("unknown argument: " + arg);
+        }
+    }
+
+    // The CPU raytracer has no way to present, it only renders captures
+    if (config.renderPath == RenderPath::Cpu && !config.headless)
+    {
+        throw std::runtime_error("--renderer cpu needs --headless");
+    }
+
+    if (config.headless && config.frameCount == 0)
+    {
+        config.frameCount = 100;
+    }
+
+    // Frame time percentiles of an endless run would depend on when the window was closed
+    if (!config.benchJsonPath.empty() && config.benchmark.empty() && config.frameCount == 0)
+    {
+        throw std::runtime_error("--bench-json needs --frames or --headless when rendering");
+    }
+
+    return config;
+}
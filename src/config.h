@@ -0,0 +1,107 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <cstdint>
+#include <string>
+
+#include "bench/scene.h"
+#include "world/terrain.h"
+
+enum class RenderPath
+{
+    Raster,
+    Raymarch,
+    Cpu // CpuRaytracer, headless only, also taken when no Vulkan device is usable
+};
+
+const char *renderPathName(RenderPath path);
+
+// Swapchain present modes, from lowest latency to lowest power. Falls back to
+// Fifo, which every surface supports, when the surface lacks the chosen one.
+enum class PresentMode
+{
+    Immediate,   // no vsync, may tear
+    Mailbox,     // no tearing, the newest frame replaces a queued one
+    Fifo,        // vsync
+    FifoRelaxed, // vsync, but a late frame is shown right away and may tear
+};
+
+const char *presentModeName(PresentMode mode);
+bool parsePresentMode(const std::string &name, PresentMode &mode);
+
+struct Config
+{
+    uint32_t framesInFlight = 2;
+
+    // Windowed only, P cycles the present mode at runtime
+    PresentMode presentMode = PresentMode::Mailbox;
+    // Swapchain images to ask for, 0 asks for one more than the surface minimum
+    uint32_t swapchainImages = 0;
+
+    // Headless runs render a fixed number of frames into offscreen images
+    // A zero size falls back to WIDTH x HEIGHT
+    bool headless = false;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Windowed runs stop after this many frames unless it is 0
+    uint32_t frameCount = 0;
+    std::string capturePath;
+
+    // Empty disables the on-disk pipeline cache
+    std::string pipelineCachePath = "pipeline_cache.bin";
+
+    // Loads SPIR-V from <dir>/<name>.spv instead of the embedded copies
+    std::string shaderDirectory;
+
+    // Render path at startup, Tab switches between raster and raymarch at runtime in windowed mode
+    RenderPath renderPath = RenderPath::Raster;
+    // Raster path draws the chunks depth-only first, so the color pass shades
+    // each pixel once. Z toggles it at runtime in windowed mode.
+    bool depthPrepass = false;
+    // Raster path skips chunks hidden behind the ones drawn last frame, tested
+    // against a Hi-Z pyramid on the GPU. O toggles it at runtime in windowed mode.
+    bool occlusionCulling = true;
+
+    // Vulkan device by index or part of its name, defaults to VOXIN_DEVICE. Empty
+    // picks the best scoring one, see VulkanUtils::rateDevice
+    std::string device;
+
+    // Job system workers, 0 picks one per hardware thread minus the main thread
+    uint32_t workerThreads = 0;
+
+    // Runs the named CPU benchmark instead of the renderer
+    std::string benchmark;
+    // Runs the named self-check instead of the renderer, see bench/check.h
+    std::string check;
+
+    // World and scripted camera, see bench/scene.h
+    std::string scene = "hills";
+    CameraPath cameraPath = CameraPath::Orbit;
+    uint32_t seed = DEFAULT_TERRAIN_SEED;
+
+    // Chunks around the camera meshed at full resolution, every coarser mesh
+    // level reaches twice as far, see ChunkLodSelector. 0 disables LOD.
+    uint32_t lodRadius = 4;
+
+    // Region files chunks are loaded from and saved to, empty generates every chunk
+    std::string worldDirectory;
+    // Non-zero streams the chunks within this many chunks of the camera instead
+    // of loading the whole scene at startup
+    uint32_t viewDistance = 0;
+    // Chunk data kept loaded while streaming before chunks outside the view distance are unloaded
+    uint32_t chunkCacheMegabytes = 256;
+    // Non-zero carves or fills a sphere in front of the camera every this many
+    // frames, to measure edit-to-visible latency. E edits once in windowed mode.
+    uint32_t editInterval = 0;
+
+    // Writes the --bench metrics, or the frame times, startup time and peak
+    // memory of a fixed-length render run, as JSON
+    std::string benchJsonPath;
+
+    // Non-empty enables the profiler, prints its frame stats at exit and writes a Chrome trace here
+    std::string profilePath;
+
+    static Config parse(int argc, char **argv);
+};
+
+#endif
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include "../profile/profiler.h"
+#include "job_system.h"
+
+struct Job
+{
+    std::function<void()> function;
+    JobPriority priority;
+    JobCounter *counter;
+};
+
+// Worker running on this thread, -1 on threads that are not workers
+static thread_local const JobSystem *currentSystem = nullptr;
+static thread_local int32_t currentWorker = -1;
+
+JobSystem::~JobSystem()
+{
+    shutdown();
+}
+
+void JobSystem::init(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    // One foreground and one background worker at the very least
+    workerCount = std::max(workerCount, 2u);
+    backgroundWorkerCount = std::max(workerCount / 4, 1u);
+    uint32_t foregroundCount = workerCount - backgroundWorkerCount;
+
+    groups[0].first = 0;
+    groups[0].count = foregroundCount;
+    groups[1].first = foregroundCount;
+    groups[1].count = backgroundWorkerCount;
+
+    stopping = false;
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        uint32_t groupIndex = i < foregroundCount ? 0 : 1;
+        workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i, groupIndex);
+    }
+}
+
+void JobSystem::shutdown()
+{
+    if (workers.empty())
+    {
+        return;
+    }
+
+    stopping = true;
+    for (Group &group : groups)
+    {
+        std::lock_guard<std::mutex> lock(group.mutex);
+        group.wake.notify_all();
+    }
+    for (auto &worker : workers)
+    {
+        worker->thread.join();
+    }
+
+    // Dropped jobs still count as finished, so continuations parked on their
+    // counters are released into the deques and dropped in the next pass
+    bool dropped = true;
+    while (dropped)
+    {
+        dropped = false;
+        for (auto &worker : workers)
+        {
+            for (LaneDeque &lane : worker->lanes)
+            {
+                std::deque<Job *> jobs;
+                jobs.swap(lane.jobs);
+                for (Job *job : jobs)
+                {
+                    JobCounter *counter = job->counter;
+                    delete job;
+                    if (counter)
+                    {
+                        finish(counter);
+                    }
+                    dropped = true;
+                }
+            }
+        }
+    }
+    workers.clear();
+    for (Group &group : groups)
+    {
+        group.queued = 0;
+    }
+}
+
+JobSystem::Group &JobSystem::groupFor(JobPriority priority)
+{
+    return groups[priority == JobPriority::Background ? 1 : 0];
+}
+
+void JobSystem::submit(std::function<void()> function, JobPriority priority, JobCounter *counter,
+                       JobCounter *dependency)
+{
+    Job *job = new Job{std::move(function), priority, counter};
+    if (counter)
+    {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (dependency)
+    {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->pending.load(std::memory_order_acquire) != 0)
+        {
+            dependency->continuations.push_back(job);
+            return;
+        }
+    }
+
+    schedule(job);
+}
+
+void JobSystem::schedule(Job *job)
+{
+    Group &group = groupFor(job->priority);
+    uint32_t lane = static_cast<uint32_t>(job->priority);
+
+    // Jobs spawned by a worker stay on its own deque if it serves the lane,
+    // others are spread round-robin and rebalanced by stealing
+    uint32_t target;
+    if (currentSystem == this && static_cast<uint32_t>(currentWorker) >= group.first &&
+        static_cast<uint32_t>(currentWorker) < group.first + group.count)
+    {
+        target = static_cast<uint32_t>(currentWorker);
+    }
+    else
+    {
+        target = group.first + group.nextWorker.fetch_add(1, std::memory_order_relaxed) % group.count;
+    }
+
+    // Counted before it becomes visible, so a thief can never take queued below zero
+    {
+        std::lock_guard<std::mutex> lock(group.mutex);
+        group.queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        LaneDeque &deque = workers[target]->lanes[lane];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.jobs.push_back(job);
+    }
+    group.wake.notify_one();
+}
+
+Job *JobSystem::popFrom(LaneDeque &lane, bool steal)
+{
+    std::lock_guard<std::mutex> lock(lane.mutex);
+    if (lane.jobs.empty())
+    {
+        return nullptr;
+    }
+
+    Job *job;
+    if (steal)
+    {
+        job = lane.jobs.back();
+        lane.jobs.pop_back();
+    }
+    else
+    {
+        job = lane.jobs.front();
+        lane.jobs.pop_front();
+    }
+    return job;
+}
+
+// Highest lane first: the own deque, then the back of every other worker in the group
+Job *JobSystem::findJob(uint32_t groupIndex, int32_t self)
+{
+    Group &group = groups[groupIndex];
+    if (group.queued.load(std::memory_order_relaxed) == 0)
+    {
+        return nullptr;
+    }
+
+    for (uint32_t lane = 0; lane < LANE_COUNT; lane++)
+    {
+        if (self >= 0)
+        {
+            if (Job *job = popFrom(workers[self]->lanes[lane], false))
+            {
+                group.queued.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        for (uint32_t i = 0; i < group.count; i++)
+        {
+            // Start after self so thieves do not all hit worker 0
+            uint32_t victim = group.first + (static_cast<uint32_t>(self + 1) + i) % group.count;
+            if (static_cast<int32_t>(victim) == self)
+            {
+                continue;
+            }
+            if (Job *job = popFrom(workers[victim]->lanes[lane], true))
+            {
+                group.queued.fetch_sub(1, std::memory_order_relaxed);
+                if (self >= 0)
+                {
+                    workers[self]->stolen.fetch_add(1, std::memory_order_relaxed);
+                }
+                return job;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// A job without a counter has nobody to hand its exception to
+static void reportLostError(std::exception_ptr error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "job failed: " << e.what() << "\n";
+    }
+    catch (...)
+    {
+        std::cerr << "job failed with an unknown exception\n";
+    }
+}
+
+void JobSystem::execute(Job *job)
+{
+    // Caught here so a throwing job cannot take down the worker, see JobCounter
+    std::exception_ptr error;
+    try
+    {
+        job->function();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    JobCounter *counter = job->counter;
+    delete job;
+
+    if (counter)
+    {
+        finish(counter, error);
+    }
+    else if (error)
+    {
+        reportLostError(error);
+    }
+}
+
+void JobSystem::finish(JobCounter *counter, std::exception_ptr error)
+{
+    std::vector<Job *> ready;
+    {
+        // The lock orders this against submit() parking a continuation
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (error && !counter->error)
+        {
+            counter->error = error;
+        }
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            ready.swap(counter->continuations);
+        }
+    }
+
+    for (Job *job : ready)
+    {
+        schedule(job);
+    }
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+    while (!counter.isDone())
+    {
+        if (Job *job = findJob(0, -1))
+        {
+            execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    if (std::exception_ptr error = counter.takeError())
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::workerLoop(uint32_t index, uint32_t groupIndex)
+{
+    currentSystem = this;
+    currentWorker = static_cast<int32_t>(index);
+    Profiler::get().setThreadName((groupIndex == 0 ? "worker " : "background worker ") + std::to_string(index));
+    Group &group = groups[groupIndex];
+    Worker &worker = *workers[index];
+
+    while (!stopping)
+    {
+        if (Job *job = findJob(groupIndex, static_cast<int32_t>(index)))
+        {
+            execute(job);
+            worker.executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(group.mutex);
+        group.wake.wait(lock, [&]
+                        { return stopping || group.queued.load(std::memory_order_relaxed) > 0; });
+    }
+}
+
+JobSystemStats JobSystem::getStats() const
+{
+    JobSystemStats stats;
+    for (const auto &worker : workers)
+    {
+        stats.executed += worker->executed.load(std::memory_order_relaxed);
+        stats.stolen += worker->stolen.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
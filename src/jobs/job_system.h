@@ -0,0 +1,197 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Lanes in the order workers look at them. Background jobs (streaming, disk
+// IO, compression) only run on the background workers, everything else only
+// on the foreground workers, so a long background job can never hold up work
+// a frame is waiting for.
+enum class JobPriority : uint32_t
+{
+    Critical = 0, // needed by the frame being built
+    High,         // near the camera
+    Normal,
+    Background,
+    Count
+};
+
+struct Job;
+
+// Counts unfinished jobs. Every job submitted with a counter increments it and
+// decrements it when done, and jobs submitted with a counter as their
+// dependency only start once it is back at zero. The owner must keep the
+// counter alive until isDone() and must not move it.
+//
+// A job that throws still counts as done. The counter keeps the first
+// exception, which wait() rethrows on the waiting thread.
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    // Once this returns true the last job is done touching the counter, so it may be destroyed
+    bool isDone() const
+    {
+        if (pending.load(std::memory_order_acquire) != 0)
+        {
+            return false;
+        }
+        // The last job drops pending to zero while holding the mutex
+        std::lock_guard<std::mutex> lock(mutex);
+        return true;
+    }
+    uint32_t getPending() const { return pending.load(std::memory_order_acquire); }
+
+    // The first exception a job of this counter threw since the last call, or null.
+    // For owners that poll isDone() instead of calling wait().
+    std::exception_ptr takeError()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::exception_ptr taken = error;
+        error = nullptr;
+        return taken;
+    }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> pending{0};
+    mutable std::mutex mutex;
+    // Jobs waiting for this counter to reach zero
+    std::vector<Job *> continuations;
+    std::exception_ptr error;
+};
+
+struct JobSystemStats
+{
+    uint64_t executed = 0;
+    uint64_t stolen = 0;
+};
+
+// Work-stealing thread pool. Each worker owns one deque per lane, pops its own
+// jobs from the front and steals from the back of other workers' deques in the
+// same group. Owners pop in submission order rather than LIFO so that callers
+// can order jobs within a lane, e.g. nearest chunk first.
+//
+// submit() never blocks on running jobs and may be called from any thread,
+// including from inside a job. Results are usually handed back to the main
+// thread through a CompletionQueue.
+class JobSystem
+{
+public:
+    ~JobSystem();
+
+    // 0 picks one worker per hardware thread, minus one for the main thread.
+    // A quarter of the workers, at least one, serve the background lane.
+    void init(uint32_t workerCount = 0);
+    // Joins the workers and drops jobs that have not started, continuations
+    // included. Their counters count them as finished.
+    void shutdown();
+
+    void submit(std::function<void()> function, JobPriority priority = JobPriority::Normal,
+                JobCounter *counter = nullptr, JobCounter *dependency = nullptr);
+
+    // Runs foreground jobs on the calling thread until counter is done, then
+    // rethrows the first exception its jobs threw. Must not be called from inside
+    // a job, and counter must not depend on background jobs unless background
+    // workers exist to run them.
+    void wait(JobCounter &counter);
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+    uint32_t getBackgroundWorkerCount() const { return backgroundWorkerCount; }
+    JobSystemStats getStats() const;
+
+private:
+    static const uint32_t LANE_COUNT = static_cast<uint32_t>(JobPriority::Count);
+
+    struct LaneDeque
+    {
+        std::mutex mutex;
+        std::deque<Job *> jobs;
+    };
+
+    struct Worker
+    {
+        LaneDeque lanes[LANE_COUNT];
+        std::thread thread;
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+    };
+
+    // Foreground workers are [0, foregroundCount), background workers the rest
+    struct Group
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+        std::atomic<uint32_t> nextWorker{0};
+        // Queued jobs of this group, guarded by mutex for sleeping and waking
+        std::atomic<uint64_t> queued{0};
+        std::mutex mutex;
+        std::condition_variable wake;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    Group groups[2];
+    uint32_t backgroundWorkerCount = 0;
+    std::atomic<bool> stopping{false};
+
+    Group &groupFor(JobPriority priority);
+    void schedule(Job *job);
+    Job *findJob(uint32_t groupIndex, int32_t self);
+    Job *popFrom(LaneDeque &lane, bool steal);
+    void execute(Job *job);
+    void finish(JobCounter *counter, std::exception_ptr error = nullptr);
+    void workerLoop(uint32_t index, uint32_t groupIndex);
+};
+
+// Thread-safe handoff of results from jobs to the thread that collects them
+template <typename T>
+class CompletionQueue
+{
+public:
+    void push(T &&item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.push_back(std::move(item));
+    }
+
+    // Moves at most maxItems finished items into out and returns how many.
+    // Never waits for jobs, an empty queue returns right away.
+    size_t drain(std::vector<T> &out, size_t maxItems = SIZE_MAX)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t count = std::min(maxItems, items.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            out.push_back(std::move(items.front()));
+            items.pop_front();
+        }
+        return count;
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.empty();
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::deque<T> items;
+};
+
+#endif
@@ -9,20 +9,74 @@
 #include <limits>
 #include <vector>
 #include <set>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <initializer_list>
 
 #include "vulkan/vulkan.h"
+#include "vulkan/allocator.h"
+#include "vulkan/transfer.h"
 #include "globals.h"
+#include "config.h"
+#include "shaders/shader_registry.h"
+#include "bench/bench.h"
+#include "bench/check.h"
+#include "bench/scene.h"
+#include "math/matrix.h"
+#include "profile/profiler.h"
+#include "render/chunk_renderer.h"
+#include "render/cpu_raytracer.h"
+#include "render/hiz_pyramid.h"
+#include "render/voxel_raymarcher.h"
+#include "vulkan/command_pools.h"
+#include "vulkan/gpu_profiler.h"
+#include "jobs/job_system.h"
+#include "world/chunk_loader.h"
+#include "world/mesher.h"
+#include "world/region_store.h"
+#include "world/voxel_volume.h"
+#include "world/world.h"
 
 // TODO: add VK_EXT_debug_utils and VK_EXT_debug_report extensions if one of them is available https://vulkan-tutorial.com/en/Drawing_a_triangle/Setup/Validation_layers
-// TODO: add pickdevice for best gpu https://vulkan-tutorial.com/en/Drawing_a_triangle/Setup/Physical_devices_and_queue_families
-// TODO: render triangle https://vulkan-tutorial.com/en/Drawing_a_triangle/Graphics_pipeline_basics/Shader_modules
 
 class Application
 {
 public:
-    void init()
+    void init(const Config &appConfig)
     {
-        init_window();
+        initStart = std::chrono::steady_clock::now();
+        config = appConfig;
+        scene = findBenchScene(config.scene);
+        if (config.width == 0 || config.height == 0)
+        {
+            config.width = WIDTH;
+            config.height = HEIGHT;
+        }
+        vulkan.maxFramesInFlight = config.framesInFlight;
+        vulkan.headless = config.headless;
+        shaders = ShaderRegistry(config.shaderDirectory);
+        if (!config.profilePath.empty())
+        {
+            if (!VOXIN_PROFILE)
+            {
+                std::cout << "profile: built with VOXIN_NO_PROFILE, --profile records nothing\n";
+            }
+            Profiler::get().setEnabled(true);
+            Profiler::get().setCapturing(true);
+            Profiler::get().setThreadName("main");
+        }
+        jobs.init(config.workerThreads);
+
+        if (!vulkan.headless)
+        {
+            init_window(config.width, config.height);
+        }
+        if (config.renderPath == RenderPath::Cpu)
+        {
+            init_cpu();
+            return;
+        }
         init_vulcan();
     }
 
@@ -33,117 +87,962 @@ public:
     }
 
 private:
+    Config config;
     GLFWwindow *window;
     VulkanContext vulkan;
+    GpuAllocator allocator;
+    TransferUploader uploader;
+    ShaderRegistry shaders;
+
+    JobSystem jobs;
+    World world;
+    RegionStore regionStore;
+    ChunkLoader chunkLoader;
+    ChunkRenderer chunkRenderer;
+    FrameCommandPools commandPools;
+    std::vector<LoadedMesh> loadedMeshes;
+    std::vector<ChunkCoord> unloadedChunks;
+    std::vector<EditedChunk> editedChunks;
+    std::chrono::steady_clock::time_point worldLoadStart;
+    bool worldLoaded = false;
+    uint64_t frameNumber = 0;
+    // Headless only: copy this frame's image to its readback buffer for --capture
+    bool readbackFrame = false;
+    const BenchScene *scene = nullptr;
+
+    // Startup and frame times, the per-frame ones only kept for --bench-json
+    std::chrono::steady_clock::time_point initStart;
+    double startupMs = -1.0;
+    double worldLoadMs = 0.0;
+    std::vector<double> frameTimesMs;
+    std::vector<double> gpuFrameTimesMs;
+    std::vector<double> gpuPrepassTimesMs;
+    std::vector<double> gpuRasterTimesMs;
+    std::vector<double> gpuHiZTimesMs;
+
+    // Voxel edits, see applyEdit(). The time of each edit waits in
+    // editsAwaitingFrame until a frame draws its result, then in frameEditTimes
+    // until that frame's fence, which ends its edit-to-visible latency.
+    uint64_t editCount = 0;
+    uint64_t lastEditFrame = UINT64_MAX;
+    bool editKeyDown = false;
+    bool editRequested = false;
+    std::vector<uint64_t> editsAwaitingFrame;
+    std::vector<std::vector<uint64_t>> frameEditTimes;
+    std::vector<double> editLatenciesMs;
+
+    VkFormat depthFormat;
+    GpuImage depthImage;
+    VkImageView depthImageView;
 
-    VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;
+    // --depth-prepass, see recordRasterPass()
+    VkRenderPass depthPrepassRenderPass;
+    VkRenderPass depthLoadRenderPass;
+    VkFramebuffer depthPrepassFramebuffer;
+    VkPipeline depthPrepassPipeline;
+    bool prepassKeyDown = false;
+    // Occlusion culling, see recordRasterPass(). The first pass keeps color and
+    // depth for the second, the prepass variant loads the first prepass's depth.
+    HiZPyramid hiZPyramid;
+    VkRenderPass occlusionFirstRenderPass;
+    VkRenderPass occlusionSecondRenderPass;
+    VkRenderPass depthPrepassLoadRenderPass;
+    bool occlusionKeyDown = false;
+    bool pipelineCacheWarm = false;
+
+    // Raster draws the chunk meshes, raymarch traces the voxel volume in
+    // compute, cpu traces it without Vulkan
+    RenderPath renderPath = RenderPath::Raster;
+    VoxelRaymarcher raymarcher;
+    CpuRaytracer cpuRaytracer;
+    GpuProfiler gpuProfiler;
+    struct RenderPathStats
+    {
+        uint64_t frames = 0;
+        double gpuMs = 0.0;
+    };
+
+    // Path each frame slot was last recorded with, so its GPU time is booked to the right one
+    std::vector<RenderPath> framePaths;
+    RenderPathStats pathStats[2];
+    bool toggleKeyDown = false;
+
+    // Set on resize and present mode changes, the swapchain is recreated after the next present
+    bool swapChainOutdated = false;
+    bool presentKeyDown = false;
 
     void init_window(int window_width = WIDTH, int window_height = HEIGHT, const char *window_title = TITLE)
     {
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        // TODO: add resize
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
         window = glfwCreateWindow(window_width, window_height, window_title, nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    }
+
+    // Some platforms never report the swapchain out of date on resize
+    static void framebufferResizeCallback(GLFWwindow *window, int, int)
+    {
+        static_cast<Application *>(glfwGetWindowUserPointer(window))->swapChainOutdated = true;
     }
 
     void init_vulcan()
     {
+        PROFILE_SCOPE("initVulkan");
         VulkanUtils::createVulkanInstance(vulkan);
-        VulkanUtils::createSurface(vulkan, window);
-        VulkanUtils::pickPhysicalDevice(vulkan);
+        if (!vulkan.headless)
+        {
+            VulkanUtils::createSurface(vulkan, window);
+        }
+        try
+        {
+            VulkanUtils::pickPhysicalDevice(vulkan, config.device);
+        }
+        catch (const std::runtime_error &e)
+        {
+            if (!vulkan.headless)
+            {
+                throw std::runtime_error(std::string(e.what()) + " (--headless --renderer cpu renders without a GPU)");
+            }
+            // Headless runs still produce their frames and capture, just on the CPU
+            std::cout << "render: " << e.what() << " falling back to the cpu raytracer\n";
+            vkDestroyInstance(vulkan.instance, nullptr);
+            init_cpu();
+            return;
+        }
         VulkanUtils::createLogicalDevice(vulkan);
-        createSwapChain();
+        allocator.init(vulkan);
+        uploader.init(vulkan, allocator);
+        createPipelineCache();
+        chunkRenderer.init(vulkan, allocator, uploader, shaders);
+        std::cout << "render: chunks drawn with " << chunkDrawModeName(chunkRenderer.getDrawMode()) << "\n";
+        if (vulkan.headless)
+        {
+            // One offscreen image per frame in flight, so imageIndex == currentFrame
+            VulkanUtils::createOffscreenTargets(vulkan, VK_FORMAT_R8G8B8A8_SRGB,
+                                               {config.width, config.height}, vulkan.maxFramesInFlight);
+        }
+        else
+        {
+            createSwapChain();
+        }
         createImageViews();
+        createDepthResources();
         createRenderPass();
         createGraphicsPipeline();
         createFramebuffers();
-        createCommandPool();
-        createCommandBuffer();
-        createSemaphores();
+        hiZPyramid.init(vulkan, allocator, shaders, depthFormat);
+        hiZPyramid.createTarget(vulkan.swapChainExtent, depthImageView);
+        chunkRenderer.setOcclusionPyramid(hiZPyramid);
+        // One recorder per thread that can run a Critical job, the main thread included
+        commandPools.init(vulkan, jobs.getWorkerCount() - jobs.getBackgroundWorkerCount() + 1);
+        createSyncObjects();
+        gpuProfiler.init(vulkan);
+        raymarcher.init(vulkan, allocator, uploader, shaders);
+        framePaths.assign(vulkan.maxFramesInFlight, RenderPath::Raster);
+        frameEditTimes.assign(vulkan.maxFramesInFlight, {});
+        selectRenderPath(config.renderPath);
+        createWorld();
+    }
+
+    void init_cpu()
+    {
+        renderPath = RenderPath::Cpu;
+        std::cout << "render: cpu path, " << simdLevelName(cpuRaytracer.getSimdLevel()) << " packets\n";
+        createWorld();
+    }
+
+    void selectRenderPath(RenderPath path)
+    {
+        if (path == RenderPath::Raymarch && !raymarcher.isSupported())
+        {
+            std::cout << "render: raymarch path needs blits into the swapchain format, staying on raster\n";
+            path = RenderPath::Raster;
+        }
+        renderPath = path;
+        std::cout << "render: " << renderPathName(renderPath) << " path\n";
+    }
+
+    void printRenderStats()
+    {
+        for (RenderPath path : {RenderPath::Raster, RenderPath::Raymarch})
+        {
+            const RenderPathStats &stats = pathStats[static_cast<size_t>(path)];
+            if (stats.frames == 0)
+            {
+                continue;
+            }
+            // One primary ray per pixel, so the raster number is directly comparable
+            double msPerFrame = stats.gpuMs / stats.frames;
+            double rays = static_cast<double>(renderExtent().width) * renderExtent().height;
+            std::cout << "render: " << renderPathName(path) << " " << msPerFrame << " ms GPU/frame, "
+                      << rays / (msPerFrame / 1000.0) / 1e6 << " Mrays/s over " << stats.frames << " frames\n";
+        }
+        if (chunkRenderer.getVisibleChunkCount() >= 0)
+        {
+            std::cout << "render: " << chunkRenderer.getVisibleChunkCount() << " of " << chunkRenderer.getChunkCount()
+                      << " chunks visible in the last culled frame, " << chunkRenderer.getOccludedChunkCount()
+                      << " hidden by occlusion\n";
+        }
+        if (!editLatenciesMs.empty())
+        {
+            std::vector<double> sorted = editLatenciesMs;
+            std::sort(sorted.begin(), sorted.end());
+            std::cout << "edit: " << editCount << " edits, " << sorted[sorted.size() / 2] << " ms median and "
+                      << sorted.back() << " ms max from edit to drawn frame\n";
+        }
+    }
+
+    // Generation and meshing run on the job system, updateWorld() picks up the results
+    void createWorld()
+    {
+        std::cout << "jobs: " << jobs.getWorkerCount() << " workers, " << jobs.getBackgroundWorkerCount()
+                  << " of them for background work\n";
+
+        worldLoadStart = std::chrono::steady_clock::now();
+        if (!config.worldDirectory.empty())
+        {
+            regionStore.open(config.worldDirectory);
+        }
+        chunkLoader.init(world, jobs, static_cast<int32_t>(config.lodRadius),
+                         regionStore.isOpen() ? &regionStore : nullptr);
+        chunkLoader.setTerrainSeed(config.seed);
+        chunkLoader.setMemoryBudget(static_cast<size_t>(config.chunkCacheMegabytes) * 1024 * 1024);
+        // Streaming requests chunks from updateWorld() as the camera moves
+        if (config.viewDistance == 0)
+        {
+            // The camera paths circle the middle of the scene, so it loads first
+            chunkLoader.requestArea(scene->min, scene->max, scene->focus);
+        }
+    }
+
+    // Called once per frame before uploads are flushed, never waits on jobs
+    void updateWorld()
+    {
+        PROFILE_SCOPE("updateWorld");
+        // Bounds the staging ring space and upload time a single frame can take
+        const size_t maxMeshUploadsPerFrame = 64;
+
+        Vec3 camera = cameraPosition();
+        ChunkCoord cameraChunk = World::chunkCoordOf(static_cast<int32_t>(std::floor(camera.x)),
+                                                     static_cast<int32_t>(std::floor(camera.y)),
+                                                     static_cast<int32_t>(std::floor(camera.z)));
+        if (config.viewDistance > 0)
+        {
+            chunkLoader.stream(cameraChunk, static_cast<int32_t>(config.viewDistance), scene->min, scene->max);
+        }
+        chunkLoader.setLodCenter(cameraChunk);
+
+        loadedMeshes.clear();
+        unloadedChunks.clear();
+        chunkLoader.update(loadedMeshes, maxMeshUploadsPerFrame);
+        chunkLoader.takeUnloaded(unloadedChunks);
+
+        bool editDue = config.editInterval > 0 && frameNumber % config.editInterval == 0;
+        if (worldLoaded && (editRequested || editDue) && frameNumber != lastEditFrame)
+        {
+            applyEdit();
+        }
+        editedChunks.clear();
+        chunkLoader.takeEdited(editedChunks);
+
+        if (renderPath != RenderPath::Cpu)
+        {
+            for (const ChunkCoord &coord : unloadedChunks)
+            {
+                chunkRenderer.removeMesh(coord);
+            }
+            // Only the edited chunks' meshes are replaced, in their own vertex ranges
+            for (const LoadedMesh &loaded : loadedMeshes)
+            {
+                chunkRenderer.uploadMesh(loaded.coord, loaded.mesh);
+                if (loaded.editTime != 0 && renderPath == RenderPath::Raster)
+                {
+                    editsAwaitingFrame.push_back(loaded.editTime);
+                }
+            }
+            updateVolumeChunks();
+        }
+
+        // The volume is built once the world is complete, and only if the path is
+        // used. While streaming it keeps the chunks that were loaded at that point.
+        if (worldLoaded && renderPath == RenderPath::Raymarch && !raymarcher.hasVolume())
+        {
+            VoxelVolume volume;
+            volume.build(world);
+            raymarcher.uploadVolume(volume);
+            std::cout << "raymarch: volume uploaded, " << raymarcher.getVolumeBytes() / (1024 * 1024) << " MiB\n";
+        }
+
+        if (!worldLoaded && chunkLoader.isIdle())
+        {
+            worldLoaded = true;
+            double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - worldLoadStart).count();
+            worldLoadMs = loadMs;
+            std::cout << "world: " << world.getChunkCount() << " chunks loaded in " << loadMs << " ms ("
+                      << chunkLoader.getMeshedCount() / (loadMs / 1000.0) << " meshed chunks/s), "
+                      << chunkLoader.getLightJobCount() << " light jobs, " << chunkRenderer.getQuadCount() << " quads\n";
+            std::array<size_t, LOD_LEVEL_COUNT> levels = chunkLoader.getLevelCounts();
+            std::cout << "lod: chunks per level";
+            for (size_t count : levels)
+            {
+                std::cout << " " << count;
+            }
+            std::cout << "\n";
+        }
+    }
+
+    // Alternately carves a sphere out of the ground the camera looks at, with
+    // a lamp at its bottom, and fills it back with stone, the same edits for
+    // the same frames every run
+    void applyEdit()
+    {
+        const float editRadius = 6.0f;
+
+        CameraPose pose = cameraPose(config.cameraPath, *scene, frameNumber);
+        VoxelEditBatch batch;
+        bool carve = editCount % 2 == 0;
+        batch.sphere(pose.target.x, pose.target.y, pose.target.z, editRadius,
+                     carve ? static_cast<Voxel>(0) : static_cast<Voxel>(MATERIAL_STONE));
+        if (carve)
+        {
+            batch.setVoxel(static_cast<int32_t>(std::floor(pose.target.x)),
+                           static_cast<int32_t>(std::floor(pose.target.y - editRadius + 1.0f)),
+                           static_cast<int32_t>(std::floor(pose.target.z)), MATERIAL_LAMP);
+        }
+        chunkLoader.edit(batch);
+        editCount++;
+        lastEditFrame = frameNumber;
+        editRequested = false;
+    }
+
+    // Patches the edited chunks into the raymarcher's volume, which is only
+    // rebuilt when an edit reaches a chunk the volume has no slot for
+    void updateVolumeChunks()
+    {
+        if (editedChunks.empty() || !raymarcher.hasVolume())
+        {
+            return;
+        }
+
+        bool rebuild = false;
+        for (const EditedChunk &edited : editedChunks)
+        {
+            rebuild |= !raymarcher.updateChunk(edited.coord, world.getChunk(edited.coord));
+            if (renderPath == RenderPath::Raymarch)
+            {
+                editsAwaitingFrame.push_back(edited.editTime);
+            }
+        }
+        if (rebuild)
+        {
+            VoxelVolume volume;
+            volume.build(world);
+            raymarcher.uploadVolume(volume);
+        }
+    }
+
+    // Ends the edit-to-visible latency of the edits the frame slot drew, its fence has signaled
+    void collectEditLatencies(uint32_t frame)
+    {
+        uint64_t now = Profiler::now();
+        for (uint64_t time : frameEditTimes[frame])
+        {
+            editLatenciesMs.push_back(static_cast<double>(now - time) / 1e6);
+        }
+        frameEditTimes[frame].clear();
+    }
+
+    // Driven by the frame number so headless captures are reproducible
+    Vec3 cameraPosition() const
+    {
+        return cameraPose(config.cameraPath, *scene, frameNumber).position;
+    }
+
+    // The swapchain's, or the configured size when the CPU renders without one
+    VkExtent2D renderExtent() const
+    {
+        if (renderPath == RenderPath::Cpu)
+        {
+            return {config.width, config.height};
+        }
+        return vulkan.swapChainExtent;
+    }
+
+    Mat4 cameraViewProjection() const
+    {
+        CameraPose pose = cameraPose(config.cameraPath, *scene, frameNumber);
+        float aspect = static_cast<float>(renderExtent().width) / renderExtent().height;
+        return perspectiveReverseZ(1.0472f, aspect, 0.5f) * lookAt(pose.position, pose.target, Vec3(0.0f, 1.0f, 0.0f));
     }
 
     void main_loop()
     {
-        while (!glfwWindowShouldClose(window))
+        if (renderPath == RenderPath::Cpu)
+        {
+            cpu_loop();
+            return;
+        }
+        if (vulkan.headless)
+        {
+            headless_loop();
+            return;
+        }
+
+        // Fixed-length runs measure rendering, not loading
+        if (config.frameCount > 0)
+        {
+            finishLoading();
+        }
+
+        uint32_t framesDrawn = 0;
+        while (!glfwWindowShouldClose(window) && (config.frameCount == 0 || framesDrawn < config.frameCount))
         {
             glfwPollEvents();
 
-            uint32_t imageIndex;
-            vkAcquireNextImageKHR(vulkan.device, vulkan.swapChain, UINT64_MAX,
-                                  vulkan.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            // Tab switches between the raster and raymarch paths
+            bool toggleDown = glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS;
+            if (toggleDown && !toggleKeyDown)
+            {
+                selectRenderPath(renderPath == RenderPath::Raster ? RenderPath::Raymarch : RenderPath::Raster);
+            }
+            toggleKeyDown = toggleDown;
 
-            VkSubmitInfo submitInfo{};
-            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            // P cycles through the present modes
+            bool presentDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+            if (presentDown && !presentKeyDown)
+            {
+                config.presentMode = static_cast<PresentMode>((static_cast<int>(config.presentMode) + 1) % 4);
+                swapChainOutdated = true;
+            }
+            presentKeyDown = presentDown;
 
-            VkSemaphore waitSemaphores[] = {vulkan.imageAvailableSemaphore};
-            VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-            submitInfo.waitSemaphoreCount = 1;
-            submitInfo.pWaitSemaphores = waitSemaphores;
-            submitInfo.pWaitDstStageMask = waitStages;
-            submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &vulkan.commandBuffer;
+            // Z toggles the depth prepass
+            bool prepassDown = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+            if (prepassDown && !prepassKeyDown)
+            {
+                config.depthPrepass = !config.depthPrepass;
+                std::cout << "render: depth prepass " << (config.depthPrepass ? "on" : "off") << "\n";
+            }
+            prepassKeyDown = prepassDown;
 
-            VkSemaphore signalSemaphores[] = {vulkan.renderFinishedSemaphore};
-            submitInfo.signalSemaphoreCount = 1;
-            submitInfo.pSignalSemaphores = signalSemaphores;
+            // O toggles occlusion culling
+            bool occlusionDown = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+            if (occlusionDown && !occlusionKeyDown)
+            {
+                config.occlusionCulling = !config.occlusionCulling;
+                std::cout << "render: occlusion culling " << (config.occlusionCulling ? "on" : "off") << "\n";
+            }
+            occlusionKeyDown = occlusionDown;
 
-            vkQueueSubmit(vulkan.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+            // E carves or fills a sphere where the camera looks
+            bool editDown = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+            if (editDown && !editKeyDown)
+            {
+                editRequested = true;
+            }
+            editKeyDown = editDown;
 
-            VkPresentInfoKHR presentInfo{};
-            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-            presentInfo.waitSemaphoreCount = 1;
-            presentInfo.pWaitSemaphores = signalSemaphores;
-            presentInfo.swapchainCount = 1;
-            presentInfo.pSwapchains = &vulkan.swapChain;
-            presentInfo.pImageIndices = &imageIndex;
+            runFrame();
+            framesDrawn++;
+        }
 
-            vkQueuePresentKHR(vulkan.presentQueue, &presentInfo);
-            vkDeviceWaitIdle(vulkan.device);
+        vkDeviceWaitIdle(vulkan.device);
+        for (uint32_t frame = 0; frame < vulkan.maxFramesInFlight; frame++)
+        {
+            collectEditLatencies(frame);
         }
+        printRenderStats();
+        writeBenchReport();
     }
 
-    void cleanup()
+    void finishLoading()
     {
-        vkDestroyPipeline(vulkan.device, graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(vulkan.device, pipelineLayout, nullptr);
-        vkDestroyShaderModule(vulkan.device, vertShaderModule, nullptr);
-        vkDestroyShaderModule(vulkan.device, fragShaderModule, nullptr);
+        while (!worldLoaded)
+        {
+            if (!vulkan.headless)
+            {
+                glfwPollEvents();
+            }
+            updateWorld();
+            std::this_thread::yield();
+        }
+    }
+
+    // One frame of the windowed or headless loop, timed for --bench-json
+    void runFrame()
+    {
+        auto start = std::chrono::steady_clock::now();
+        drawFrame();
+        Profiler::get().endFrame();
+        recordFrameTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    void recordFrameTime(double ms)
+    {
+        if (startupMs < 0.0)
+        {
+            startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initStart).count();
+        }
+        if (!config.benchJsonPath.empty())
+        {
+            frameTimesMs.push_back(ms);
+        }
+    }
+
+    void headless_loop()
+    {
+        // Captures should not depend on how far loading got, so finish it first
+        finishLoading();
+
+        auto start = std::chrono::steady_clock::now();
+
+        // Only the captured frame pays for the readback copy
+        for (uint32_t i = 0; i < config.frameCount; i++)
+        {
+            readbackFrame = !config.capturePath.empty() && i + 1 == config.frameCount;
+            runFrame();
+        }
+        vkDeviceWaitIdle(vulkan.device);
+        for (uint32_t frame = 0; frame < vulkan.maxFramesInFlight; frame++)
+        {
+            collectEditLatencies(frame);
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        double totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "headless: " << config.frameCount << " frames at " << config.width << "x" << config.height
+                  << ", " << totalMs / config.frameCount << " ms/frame\n";
+        printRenderStats();
+        writeBenchReport();
+
+        if (!config.capturePath.empty())
+        {
+            uint32_t lastImage = (vulkan.currentFrame + vulkan.maxFramesInFlight - 1) % vulkan.maxFramesInFlight;
+            VulkanUtils::writePPM(config.capturePath, vulkan.swapChainExtent,
+                                  VulkanUtils::readbackImage(vulkan, lastImage));
+            std::cout << "headless: wrote " << config.capturePath << "\n";
+        }
+    }
+
+    // Headless loop of the CPU path: same frames, camera and capture as headless_loop()
+    void cpu_loop()
+    {
+        finishLoading();
+
+        VoxelVolume volume;
+        volume.build(world);
+        cpuRaytracer.setVolume(volume);
+        std::cout << "cpu: volume built, " << volume.memoryUsage() / (1024 * 1024) << " MiB\n";
+
+        std::vector<uint8_t> pixels;
+        CpuRenderStats total;
+        for (uint32_t i = 0; i < config.frameCount; i++)
+        {
+            {
+                PROFILE_SCOPE("frame");
+                CpuRenderStats stats = cpuRaytracer.render(cameraViewProjection(), cameraPosition(), config.width,
+                                                           config.height, pixels, &jobs);
+                total.seconds += stats.seconds;
+                total.rays += stats.rays;
+                total.threads = stats.threads;
+                recordFrameTime(stats.seconds * 1000.0);
+            }
+            frameNumber++;
+            Profiler::get().endFrame();
+        }
+
+        std::cout << "headless: " << config.frameCount << " frames at " << config.width << "x" << config.height
+                  << ", " << total.seconds * 1000.0 / config.frameCount << " ms/frame\n";
+        std::cout << "render: cpu " << total.megaraysPerSecond() << " Mrays/s, " << total.megaraysPerSecondPerThread()
+                  << " Mrays/s per thread over " << total.threads << " threads ("
+                  << simdLevelName(cpuRaytracer.getSimdLevel()) << ")\n";
+        writeBenchReport();
+
+        if (!config.capturePath.empty())
+        {
+            VulkanUtils::writePPM(config.capturePath, renderExtent(), pixels);
+            std::cout << "headless: wrote " << config.capturePath << "\n";
+        }
+    }
+
+    void drawFrame()
+    {
+        PROFILE_SCOPE("frame");
+        updateWorld();
+
+        // Uploads queued since the last frame go out on the transfer queue first
+        uploader.flush();
+
+        uint32_t frame = vulkan.currentFrame;
+        {
+            PROFILE_SCOPE("waitForFrame");
+            vkWaitForFences(vulkan.device, 1, &vulkan.inFlightFences[frame], VK_TRUE, UINT64_MAX);
+        }
+        collectEditLatencies(frame);
+
+        uint32_t imageIndex = frame;
+        if (!vulkan.headless)
+        {
+            VkResult result = vkAcquireNextImageKHR(vulkan.device, vulkan.swapChain, UINT64_MAX,
+                                                    vulkan.imageAvailableSemaphores[frame], VK_NULL_HANDLE, &imageIndex);
+            // Nothing was acquired, so the frame is skipped and its fence stays signaled.
+            // A suboptimal image can still be presented, the swapchain is recreated after it
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                recreateSwapChain();
+                return;
+            }
+            if (result == VK_SUBOPTIMAL_KHR)
+            {
+                swapChainOutdated = true;
+            }
+            else if (result != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
+        }
+
+        // The swapchain may hand back an image an older frame is still rendering to
+        if (vulkan.imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+        {
+            vkWaitForFences(vulkan.device, 1, &vulkan.imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        }
+        vulkan.imagesInFlight[imageIndex] = vulkan.inFlightFences[frame];
+
+        vkResetFences(vulkan.device, 1, &vulkan.inFlightFences[frame]);
+        chunkRenderer.beginFrame(frame);
+
+        // The outermost scope spans the whole frame
+        const std::vector<GpuScopeTiming> &gpuTimings = gpuProfiler.collect(frame);
+        if (!gpuTimings.empty())
+        {
+            RenderPathStats &stats = pathStats[static_cast<size_t>(framePaths[frame])];
+            stats.frames++;
+            stats.gpuMs += gpuTimings.front().milliseconds;
+            if (!config.benchJsonPath.empty())
+            {
+                gpuFrameTimesMs.push_back(gpuTimings.front().milliseconds);
+                // Occlusion culling splits the prepass and raster scopes in two, counted as one
+                addGpuScopeTime(gpuTimings, gpuPrepassTimesMs, "prepass", "late prepass");
+                addGpuScopeTime(gpuTimings, gpuRasterTimesMs, "raster", "late raster");
+                addGpuScopeTime(gpuTimings, gpuHiZTimesMs, "hiz", "hiz");
+            }
+        }
+
+        commandPools.beginFrame(frame);
+        VkCommandBuffer commandBuffer = commandPools.getPrimary(frame);
+        UploadWait uploadWait = recordCommandBuffer(commandBuffer, imageIndex);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        // Offscreen images are never acquired or presented, so headless frames only signal the fence
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<uint64_t> waitValues;
+        if (!vulkan.headless)
+        {
+            waitSemaphores.push_back(vulkan.imageAvailableSemaphores[frame]);
+            waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            waitValues.push_back(0);
+        }
+
+        // Uploads acquired in this command buffer must have landed before it reads them
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        if (uploadWait.semaphore != VK_NULL_HANDLE)
+        {
+            waitSemaphores.push_back(uploadWait.semaphore);
+            waitStages.push_back(uploadWait.stageMask);
+            waitValues.push_back(uploadWait.value);
+
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+            timelineInfo.pWaitSemaphoreValues = waitValues.data();
+            submitInfo.pNext = &timelineInfo;
+        }
+
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        VkSemaphore signalSemaphores[] = {vulkan.headless ? VK_NULL_HANDLE : vulkan.renderFinishedSemaphores[imageIndex]};
+        submitInfo.signalSemaphoreCount = vulkan.headless ? 0 : 1;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+
+        if (vkQueueSubmit(vulkan.graphicsQueue, 1, &submitInfo, vulkan.inFlightFences[frame]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        frameEditTimes[frame].swap(editsAwaitingFrame);
+
+        if (vulkan.headless)
+        {
+            vulkan.currentFrame = (vulkan.currentFrame + 1) % vulkan.maxFramesInFlight;
+            frameNumber++;
+            return;
+        }
+
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &vulkan.swapChain;
+        presentInfo.pImageIndices = &imageIndex;
+
+        VkResult result = vkQueuePresentKHR(vulkan.presentQueue, &presentInfo);
+
+        vulkan.currentFrame = (vulkan.currentFrame + 1) % vulkan.maxFramesInFlight;
+        frameNumber++;
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || swapChainOutdated)
+        {
+            recreateSwapChain();
+        }
+        else if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+    }
+
+    // Rebuilds the swapchain and everything sized to it, the device, pipelines and
+    // world stay. The old swapchain is handed to the new one so presentation
+    // continues while it is replaced.
+    void recreateSwapChain()
+    {
+        PROFILE_SCOPE("recreateSwapChain");
+
+        // A minimized window has no extent to create a swapchain with
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        while ((width == 0 || height == 0) && !glfwWindowShouldClose(window))
+        {
+            glfwWaitEvents();
+            glfwGetFramebufferSize(window, &width, &height);
+        }
+        if (width == 0 || height == 0)
+        {
+            return;
+        }
+
+        vkDeviceWaitIdle(vulkan.device);
+        swapChainOutdated = false;
+
+        VkFormat oldFormat = vulkan.swapChainImageFormat;
+        destroySwapChainTargets();
+        VkSwapchainKHR oldSwapChain = vulkan.swapChain;
+        createSwapChain(oldSwapChain);
+        vkDestroySwapchainKHR(vulkan.device, oldSwapChain, nullptr);
+
+        createImageViews();
+        createDepthResources();
+        hiZPyramid.createTarget(vulkan.swapChainExtent, depthImageView);
+        chunkRenderer.setOcclusionPyramid(hiZPyramid);
+        // The render passes, and the pipelines built against them, depend on the color format
+        if (vulkan.swapChainImageFormat != oldFormat)
+        {
+            destroyGraphicsPipelines();
+            destroyRenderPasses();
+            createRenderPass();
+            createGraphicsPipeline();
+        }
+        createFramebuffers();
+        if (raymarcher.isSupported())
+        {
+            raymarcher.destroyTarget();
+            raymarcher.createTarget(vulkan.swapChainExtent);
+        }
+        vulkan.imagesInFlight.assign(vulkan.swapChainImages.size(), VK_NULL_HANDLE);
+        if (vulkan.renderFinishedSemaphores.size() != vulkan.swapChainImages.size())
+        {
+            destroyRenderFinishedSemaphores();
+            createRenderFinishedSemaphores();
+        }
+    }
 
-        vkDestroySemaphore(vulkan.device, vulkan.renderFinishedSemaphore, nullptr);
-        vkDestroySemaphore(vulkan.device, vulkan.imageAvailableSemaphore, nullptr);
-        vkDestroyCommandPool(vulkan.device, vulkan.commandPool, nullptr);
+    void destroySwapChainTargets()
+    {
         for (auto framebuffer : vulkan.swapChainFramebuffers)
         {
             vkDestroyFramebuffer(vulkan.device, framebuffer, nullptr);
         }
-        vkDestroyRenderPass(vulkan.device, vulkan.renderPass, nullptr);
-
+        vulkan.swapChainFramebuffers.clear();
+        vkDestroyFramebuffer(vulkan.device, depthPrepassFramebuffer, nullptr);
         for (auto imageView : vulkan.swapChainImageViews)
         {
             vkDestroyImageView(vulkan.device, imageView, nullptr);
         }
+        vulkan.swapChainImageViews.clear();
+        hiZPyramid.destroyTarget();
+        vkDestroyImageView(vulkan.device, depthImageView, nullptr);
+        allocator.destroyImage(depthImage);
+    }
+
+    void cleanup()
+    {
+        chunkLoader.shutdown();
+        jobs.shutdown();
+        writeProfile();
+        if (renderPath == RenderPath::Cpu)
+        {
+            return;
+        }
 
-        vkDestroySwapchainKHR(vulkan.device, vulkan.swapChain, nullptr);
-        vkDestroySurfaceKHR(vulkan.instance, vulkan.surface, nullptr);
+        if (!config.pipelineCachePath.empty())
+        {
+            VulkanUtils::savePipelineCache(vulkan, config.pipelineCachePath);
+        }
+        vkDestroyPipelineCache(vulkan.device, vulkan.pipelineCache, nullptr);
+
+        destroyGraphicsPipelines();
+
+        for (uint32_t i = 0; i < vulkan.maxFramesInFlight; i++)
+        {
+            vkDestroySemaphore(vulkan.device, vulkan.imageAvailableSemaphores[i], nullptr);
+            vkDestroyFence(vulkan.device, vulkan.inFlightFences[i], nullptr);
+        }
+        destroyRenderFinishedSemaphores();
+        commandPools.destroy();
+        destroySwapChainTargets();
+        destroyRenderPasses();
+
+        if (vulkan.headless)
+        {
+            VulkanUtils::destroyOffscreenTargets(vulkan);
+        }
+        else
+        {
+            vkDestroySwapchainKHR(vulkan.device, vulkan.swapChain, nullptr);
+            vkDestroySurfaceKHR(vulkan.instance, vulkan.surface, nullptr);
+        }
+        raymarcher.destroy();
+        hiZPyramid.destroy();
+        gpuProfiler.destroy();
+        chunkRenderer.destroy();
+        uploader.destroy();
+        allocator.printStats(std::cout);
+        allocator.destroy();
         vkDestroyDevice(vulkan.device, nullptr);
         vkDestroyInstance(vulkan.instance, nullptr);
 
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if (!vulkan.headless)
+        {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 
-    void createGraphicsPipeline()
+    // Adds the summed time of a frame's GPU scopes named first or late, if it recorded any
+    static void addGpuScopeTime(const std::vector<GpuScopeTiming> &timings, std::vector<double> &times,
+                                const char *first, const char *late)
     {
-        auto vertShaderCode = readFile("src/shaders/vert.spv");
-        auto fragShaderCode = readFile("src/shaders/frag.spv");
+        double milliseconds = 0.0;
+        bool found = false;
+        for (const GpuScopeTiming &timing : timings)
+        {
+            if (std::strcmp(timing.name, first) == 0 || std::strcmp(timing.name, late) == 0)
+            {
+                milliseconds += timing.milliseconds;
+                found = true;
+            }
+        }
+        if (found)
+        {
+            times.push_back(milliseconds);
+        }
+    }
+
+    // Machine-readable summary of a fixed-length run, diffable across commits
+    void writeBenchReport()
+    {
+        if (config.benchJsonPath.empty())
+        {
+            return;
+        }
+
+        BenchReport report;
+        report.setInfo("renderer", renderPathName(renderPath));
+        report.setInfo("scene", scene->name);
+        report.setInfo("camera_path", cameraPathName(config.cameraPath));
+        report.setInfo("mode", vulkan.headless ? "headless" : "windowed");
+        report.setInfo("resolution", std::to_string(renderExtent().width) + "x" + std::to_string(renderExtent().height));
+        report.setInfo("frames", std::to_string(frameTimesMs.size()));
+        report.setInfo("depth_prepass", config.depthPrepass ? "on" : "off");
+        report.setInfo("occlusion_culling",
+                       config.occlusionCulling && chunkRenderer.isOcclusionCullingSupported() ? "on" : "off");
+        if (renderPath == RenderPath::Cpu)
+        {
+            report.setInfo("device", std::string("cpu ") + simdLevelName(cpuRaytracer.getSimdLevel()));
+        }
+        else
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vulkan.physicalDevice, &properties);
+            report.setInfo("device", properties.deviceName);
+        }
+
+        report.add("run.startup_ms", startupMs, "ms");
+        report.add("run.world_load_ms", worldLoadMs, "ms");
+        report.add("run.peak_memory_mib", peakResidentBytes() / (1024.0 * 1024.0), "MiB");
+        report.add("run.chunks", static_cast<double>(world.getChunkCount()), "chunks");
+        if (chunkRenderer.getVisibleChunkCount() >= 0)
+        {
+            report.add("run.last_frame_visible_chunks", static_cast<double>(chunkRenderer.getVisibleChunkCount()), "chunks");
+            report.add("run.last_frame_occluded_chunks", static_cast<double>(chunkRenderer.getOccludedChunkCount()),
+                       "chunks");
+        }
+        report.addDistribution("frame.cpu_ms", frameTimesMs, "ms");
+        report.addDistribution("frame.gpu_ms", gpuFrameTimesMs, "ms");
+        report.addDistribution("frame.gpu_prepass_ms", gpuPrepassTimesMs, "ms");
+        report.addDistribution("frame.gpu_raster_ms", gpuRasterTimesMs, "ms");
+        report.addDistribution("frame.gpu_hiz_ms", gpuHiZTimesMs, "ms");
+        report.addDistribution("edit.latency_ms", editLatenciesMs, "ms");
+
+        report.writeJson(config.benchJsonPath);
+        std::cout << "bench: wrote " << config.benchJsonPath << "\n";
+    }
+
+    void writeProfile()
+    {
+        if (!Profiler::get().isEnabled())
+        {
+            return;
+        }
+        Profiler::get().endFrame();
+        Profiler::get().printStats(std::cout);
+        Profiler::get().writeChromeTrace(config.profilePath);
+        std::cout << "profile: wrote " << config.profilePath << "\n";
+    }
+
+    void createPipelineCache()
+    {
+        PROFILE_SCOPE("createPipelineCache");
+        if (config.pipelineCachePath.empty())
+        {
+            VkPipelineCacheCreateInfo createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+            if (vkCreatePipelineCache(vulkan.device, &createInfo, nullptr, &vulkan.pipelineCache) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create pipeline cache!");
+            }
+            return;
+        }
 
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+        pipelineCacheWarm = VulkanUtils::loadPipelineCache(vulkan, config.pipelineCachePath);
+    }
+
+    void createGraphicsPipeline()
+    {
+        PROFILE_SCOPE("createGraphicsPipeline");
+        VkShaderModule vertShaderModule = shaders.createShaderModule(vulkan.device, ShaderId::ChunkVert);
+        VkShaderModule fragShaderModule = shaders.createShaderModule(vulkan.device, ShaderId::ChunkFrag);
 
         VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
         vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -159,46 +1058,63 @@ private:
 
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
+        VkPushConstantRange pushConstantRange = ChunkRenderer::getPushConstantRange();
+
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
         vkCreatePipelineLayout(vulkan.device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
 
-        // Missing: Vertex input state
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions = ChunkRenderer::getBindingDescriptions();
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions = ChunkRenderer::getAttributeDescriptions();
+
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         // Missing: Input assembly
         VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
         inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-        // Missing: Viewport and scissor
-        VkViewport viewport{};
-        viewport.width = vulkan.swapChainExtent.width;
-        viewport.height = vulkan.swapChainExtent.height;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor{};
-        scissor.extent = vulkan.swapChainExtent;
-
+        // Viewport and scissor are set when recording, so a resized swapchain keeps this pipeline
         VkPipelineViewportStateCreateInfo viewportState{};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
+
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
 
         // Missing: Rasterizer
         VkPipelineRasterizationStateCreateInfo rasterizer{};
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
         rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
         rasterizer.lineWidth = 1.0f;
+        // Mesh quads are counter-clockwise seen from outside, and the projection flips y
+        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
         // Missing: Multisampling
         VkPipelineMultisampleStateCreateInfo multisampling{};
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        // Reverse-Z, nearer is greater. Equal passes too, so after a depth prepass
+        // only the nearest surface of each pixel is shaded.
+        depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+
         // Missing: Color blending
         VkPipelineColorBlendAttachmentState colorBlendAttachment{};
         colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
@@ -218,12 +1134,49 @@ private:
         pipelineInfo.pViewportState = &viewportState;
         pipelineInfo.pRasterizationState = &rasterizer;
         pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
         pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
         pipelineInfo.layout = pipelineLayout;
         pipelineInfo.renderPass = vulkan.renderPass;
         pipelineInfo.subpass = 0;
 
-        vkCreateGraphicsPipelines(vulkan.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline);
+        // The prepass runs the same vertex shader without a fragment shader or color attachment
+        VkPipelineDepthStencilStateCreateInfo prepassDepthStencil = depthStencil;
+        prepassDepthStencil.depthCompareOp = VK_COMPARE_OP_GREATER;
+        VkPipelineColorBlendStateCreateInfo prepassColorBlending = colorBlending;
+        prepassColorBlending.attachmentCount = 0;
+
+        VkGraphicsPipelineCreateInfo prepassInfo = pipelineInfo;
+        prepassInfo.stageCount = 1;
+        prepassInfo.pDepthStencilState = &prepassDepthStencil;
+        prepassInfo.pColorBlendState = &prepassColorBlending;
+        prepassInfo.renderPass = depthPrepassRenderPass;
+
+        auto start = std::chrono::steady_clock::now();
+        if (vkCreateGraphicsPipelines(vulkan.device, vulkan.pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+        if (vkCreateGraphicsPipelines(vulkan.device, vulkan.pipelineCache, 1, &prepassInfo, nullptr, &depthPrepassPipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth prepass pipeline!");
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        // Modules are only needed while the pipeline is created
+        vkDestroyShaderModule(vulkan.device, vertShaderModule, nullptr);
+        vkDestroyShaderModule(vulkan.device, fragShaderModule, nullptr);
+
+        std::cout << "pipeline cache: " << (pipelineCacheWarm ? "warm" : "cold") << ", graphics pipelines created in "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+    }
+
+    void destroyGraphicsPipelines()
+    {
+        vkDestroyPipeline(vulkan.device, graphicsPipeline, nullptr);
+        vkDestroyPipeline(vulkan.device, depthPrepassPipeline, nullptr);
+        vkDestroyPipelineLayout(vulkan.device, pipelineLayout, nullptr);
     }
 
     void createLogicalDevice()
@@ -277,144 +1230,450 @@ private:
         vkGetDeviceQueue(vulkan.device, indices.presentFamily.value(), 0, &vulkan.presentQueue);
     }
 
-    std::vector<char> readFile(const std::string &filename)
-    {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-        if (!file.is_open())
-            throw std::runtime_error("Failed to open file!");
-
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-        file.close();
-
-        return buffer;
-    }
-
-    VkShaderModule createShaderModule(const std::vector<char> &code)
+    // learn
+    void createRenderPass()
     {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
-
-        VkShaderModule shaderModule;
-        if (vkCreateShaderModule(vulkan.device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to create shader module!");
-        }
-
-        return shaderModule;
+        vulkan.renderPass = createRasterRenderPass(false, false, false);
+        depthLoadRenderPass = createRasterRenderPass(false, true, false);
+        occlusionFirstRenderPass = createRasterRenderPass(false, false, true);
+        occlusionSecondRenderPass = createRasterRenderPass(true, true, false);
+        depthPrepassRenderPass = createDepthPrepassRenderPass(false);
+        depthPrepassLoadRenderPass = createDepthPrepassRenderPass(true);
     }
 
-    // learn
-    void createRenderPass()
+    // Color and depth. loadColor and loadDepth continue from an earlier pass
+    // instead of clearing, keepTargets leaves both for a later one instead of
+    // finishing the image. Load and store ops don't affect render pass
+    // compatibility, so all variants share the framebuffers and the graphics pipeline.
+    VkRenderPass createRasterRenderPass(bool loadColor, bool loadDepth, bool keepTargets)
     {
         VkAttachmentDescription colorAttachment = {};
         colorAttachment.format = vulkan.swapChainImageFormat;
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = loadColor ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.initialLayout = loadColor ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = vulkan.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        if (keepTargets)
+        {
+            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
 
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
         colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+        VkAttachmentDescription depthAttachment = {};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = loadDepth ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = keepTargets ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = loadDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef = {};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
         VkSubpassDescription subpass = {};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         subpass.colorAttachmentCount = 1;
         subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        // The single depth image is shared by all frames in flight, so a frame's
+        // depth clear has to wait for the previous frame's depth tests, and the
+        // loading variants for this frame's earlier pass
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 2;
+        renderPassInfo.pAttachments = attachments;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+
+        VkRenderPass renderPass;
+        if (vkCreateRenderPass(vulkan.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create render pass!");
+        }
+        return renderPass;
+    }
+
+    // Depth only, the raster pass loads what it stores. loadDepth continues the
+    // first prepass after occlusion culling's Hi-Z build.
+    VkRenderPass createDepthPrepassRenderPass(bool loadDepth)
+    {
+        VkAttachmentDescription depthAttachment = {};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = loadDepth ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = loadDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef = {};
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
         VkRenderPassCreateInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.pAttachments = &depthAttachment;
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+
+        VkRenderPass renderPass;
+        if (vkCreateRenderPass(vulkan.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth prepass render pass!");
+        }
+        return renderPass;
+    }
 
-        vkCreateRenderPass(vulkan.device, &renderPassInfo, nullptr, &vulkan.renderPass);
+    void destroyRenderPasses()
+    {
+        vkDestroyRenderPass(vulkan.device, vulkan.renderPass, nullptr);
+        vkDestroyRenderPass(vulkan.device, depthLoadRenderPass, nullptr);
+        vkDestroyRenderPass(vulkan.device, occlusionFirstRenderPass, nullptr);
+        vkDestroyRenderPass(vulkan.device, occlusionSecondRenderPass, nullptr);
+        vkDestroyRenderPass(vulkan.device, depthPrepassRenderPass, nullptr);
+        vkDestroyRenderPass(vulkan.device, depthPrepassLoadRenderPass, nullptr);
     }
+
     void createFramebuffers()
     {
         vulkan.swapChainFramebuffers.resize(vulkan.swapChainImageViews.size());
         for (size_t i = 0; i < vulkan.swapChainImageViews.size(); i++)
         {
-            VkImageView attachments[] = {vulkan.swapChainImageViews[i]};
+            VkImageView attachments[] = {vulkan.swapChainImageViews[i], depthImageView};
 
             VkFramebufferCreateInfo framebufferInfo = {};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
             framebufferInfo.renderPass = vulkan.renderPass;
-            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.attachmentCount = 2;
             framebufferInfo.pAttachments = attachments;
             framebufferInfo.width = vulkan.swapChainExtent.width;
             framebufferInfo.height = vulkan.swapChainExtent.height;
             framebufferInfo.layers = 1;
 
-            vkCreateFramebuffer(vulkan.device, &framebufferInfo, nullptr, &vulkan.swapChainFramebuffers[i]);
+            if (vkCreateFramebuffer(vulkan.device, &framebufferInfo, nullptr, &vulkan.swapChainFramebuffers[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
+        }
+
+        VkFramebufferCreateInfo prepassInfo = {};
+        prepassInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        prepassInfo.renderPass = depthPrepassRenderPass;
+        prepassInfo.attachmentCount = 1;
+        prepassInfo.pAttachments = &depthImageView;
+        prepassInfo.width = vulkan.swapChainExtent.width;
+        prepassInfo.height = vulkan.swapChainExtent.height;
+        prepassInfo.layers = 1;
+        if (vkCreateFramebuffer(vulkan.device, &prepassInfo, nullptr, &depthPrepassFramebuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth prepass framebuffer!");
         }
     }
-    void createCommandPool()
+    UploadWait recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
     {
-        VkCommandPoolCreateInfo poolInfo = {};
-        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.queueFamilyIndex = 0;
-        poolInfo.flags = 0;
+        PROFILE_SCOPE("recordCommandBuffer");
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        vkCreateCommandPool(vulkan.device, &poolInfo, nullptr, &vulkan.commandPool);
-    }
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-    void createCommandBuffer()
-    {
-        VkCommandBufferAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = vulkan.commandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+        UploadWait uploadWait = uploader.recordAcquireBarriers(commandBuffer);
 
-        vkAllocateCommandBuffers(vulkan.device, &allocInfo, &vulkan.commandBuffer);
+        uint32_t frame = vulkan.currentFrame;
+        framePaths[frame] = renderPath;
+        gpuProfiler.beginFrame(commandBuffer, frame);
+        gpuProfiler.begin(commandBuffer, frame, "frame");
 
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        if (renderPath == RenderPath::Raymarch)
+        {
+            VkImageLayout finalLayout = vulkan.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            gpuProfiler.begin(commandBuffer, frame, "raymarch");
+            raymarcher.recordFrame(commandBuffer, vulkan.swapChainImages[imageIndex], finalLayout,
+                                   cameraViewProjection(), cameraPosition());
+            gpuProfiler.end(commandBuffer, frame);
+        }
+        else
+        {
+            recordRasterPass(commandBuffer, frame, imageIndex);
+        }
 
-        vkBeginCommandBuffer(vulkan.commandBuffer, &beginInfo);
+        gpuProfiler.end(commandBuffer, frame);
+
+        if (vulkan.headless && readbackFrame)
+        {
+            gpuProfiler.begin(commandBuffer, frame, "readback");
+            VulkanUtils::recordReadback(vulkan, commandBuffer, imageIndex);
+            gpuProfiler.end(commandBuffer, frame);
+        }
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+
+        return uploadWait;
+    }
+
+    // With occlusion culling the chunks visible last frame are drawn first, into
+    // the prepass or the color pass. Their depth is reduced into the Hi-Z
+    // pyramid, the rest of the chunks are tested against it, and the ones that
+    // show are drawn by a second pass continuing the first.
+    void recordRasterPass(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t imageIndex)
+    {
+        Mat4 viewProjection = cameraViewProjection();
+        bool occlusion = config.occlusionCulling && chunkRenderer.isOcclusionCullingSupported();
+        ChunkCullPhase firstPhase = occlusion ? ChunkCullPhase::Early : ChunkCullPhase::All;
+        gpuProfiler.begin(commandBuffer, frame, "cull");
+        chunkRenderer.recordCulling(commandBuffer, frame, viewProjection, firstPhase);
+        gpuProfiler.end(commandBuffer, frame);
+
+        // Reverse-Z clears depth to the far end, 0
+        VkClearValue clearValues[2] = {};
+        clearValues[0].color = {{0.55f, 0.70f, 0.90f, 1.0f}};
+        clearValues[1].depthStencil = {0.0f, 0};
 
         VkRenderPassBeginInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = vulkan.renderPass;
-        renderPassInfo.framebuffer = vulkan.swapChainFramebuffers[0];
         renderPassInfo.renderArea.offset = {0, 0};
         renderPassInfo.renderArea.extent = vulkan.swapChainExtent;
-        VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
 
-        vkCmdBeginRenderPass(vulkan.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdEndRenderPass(vulkan.commandBuffer);
+        if (config.depthPrepass)
+        {
+            renderPassInfo.renderPass = depthPrepassRenderPass;
+            renderPassInfo.framebuffer = depthPrepassFramebuffer;
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearValues[1];
+
+            gpuProfiler.begin(commandBuffer, frame, "prepass");
+            recordChunkDraws(commandBuffer, frame, renderPassInfo, depthPrepassPipeline, viewProjection, {firstPhase});
+            gpuProfiler.end(commandBuffer, frame);
+        }
+        else if (occlusion)
+        {
+            renderPassInfo.renderPass = occlusionFirstRenderPass;
+            renderPassInfo.framebuffer = vulkan.swapChainFramebuffers[imageIndex];
+            renderPassInfo.clearValueCount = 2;
+            renderPassInfo.pClearValues = clearValues;
+
+            gpuProfiler.begin(commandBuffer, frame, "raster");
+            recordChunkDraws(commandBuffer, frame, renderPassInfo, graphicsPipeline, viewProjection, {firstPhase});
+            gpuProfiler.end(commandBuffer, frame);
+        }
+
+        if (occlusion)
+        {
+            gpuProfiler.begin(commandBuffer, frame, "hiz");
+            hiZPyramid.recordBuild(commandBuffer, depthImage.image);
+            gpuProfiler.end(commandBuffer, frame);
+
+            gpuProfiler.begin(commandBuffer, frame, "late cull");
+            chunkRenderer.recordCulling(commandBuffer, frame, viewProjection, ChunkCullPhase::Late);
+            gpuProfiler.end(commandBuffer, frame);
+
+            if (config.depthPrepass)
+            {
+                renderPassInfo.renderPass = depthPrepassLoadRenderPass;
+                renderPassInfo.framebuffer = depthPrepassFramebuffer;
+                renderPassInfo.clearValueCount = 0;
+                renderPassInfo.pClearValues = nullptr;
+
+                gpuProfiler.begin(commandBuffer, frame, "late prepass");
+                recordChunkDraws(commandBuffer, frame, renderPassInfo, depthPrepassPipeline, viewProjection,
+                                 {ChunkCullPhase::Late});
+                gpuProfiler.end(commandBuffer, frame);
+            }
+        }
+
+        renderPassInfo.framebuffer = vulkan.swapChainFramebuffers[imageIndex];
+        renderPassInfo.clearValueCount = 2;
+        renderPassInfo.pClearValues = clearValues;
+
+        // Timestamps cannot go inside a render pass made of secondary command buffers
+        if (occlusion && !config.depthPrepass)
+        {
+            renderPassInfo.renderPass = occlusionSecondRenderPass;
+            gpuProfiler.begin(commandBuffer, frame, "late raster");
+            recordChunkDraws(commandBuffer, frame, renderPassInfo, graphicsPipeline, viewProjection,
+                             {ChunkCullPhase::Late});
+            gpuProfiler.end(commandBuffer, frame);
+            return;
+        }
+
+        // After a prepass every chunk either phase drew is shaded
+        renderPassInfo.renderPass = config.depthPrepass ? depthLoadRenderPass : vulkan.renderPass;
+        gpuProfiler.begin(commandBuffer, frame, "raster");
+        if (occlusion)
+        {
+            recordChunkDraws(commandBuffer, frame, renderPassInfo, graphicsPipeline, viewProjection,
+                             {ChunkCullPhase::Early, ChunkCullPhase::Late});
+        }
+        else
+        {
+            recordChunkDraws(commandBuffer, frame, renderPassInfo, graphicsPipeline, viewProjection,
+                             {ChunkCullPhase::All});
+        }
+        gpuProfiler.end(commandBuffer, frame);
+    }
+
+    // One render pass of chunk draws, the commands of each of phases in turn.
+    // Each part of the draws is recorded by its own job into a secondary
+    // command buffer from that job's pool
+    void recordChunkDraws(VkCommandBuffer commandBuffer, uint32_t frame, const VkRenderPassBeginInfo &renderPassInfo,
+                          VkPipeline pipeline, const Mat4 &viewProjection, std::initializer_list<ChunkCullPhase> phases)
+    {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        VkCommandBufferInheritanceInfo inheritance{};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = renderPassInfo.renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = renderPassInfo.framebuffer;
+
+        // Secondary command buffers inherit no dynamic state, each sets its own
+        VkViewport viewport{};
+        viewport.width = static_cast<float>(vulkan.swapChainExtent.width);
+        viewport.height = static_cast<float>(vulkan.swapChainExtent.height);
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{};
+        scissor.extent = vulkan.swapChainExtent;
+
+        // Begun here so the jobs cannot fail before recording. A job must not throw,
+        // so each leaves its result in its own slot, checked once they are all done
+        uint32_t partCount = chunkRenderer.getDrawPartCount(commandPools.getRecorderCount());
+        std::vector<VkCommandBuffer> secondaries(partCount);
+        std::vector<VkResult> results(partCount, VK_SUCCESS);
+        // The prepass draws the same chunks as the color pass, only that one is counted
+        bool countVisible = pipeline != depthPrepassPipeline;
+        for (uint32_t part = 0; part < partCount; part++)
+        {
+            secondaries[part] = commandPools.beginSecondary(frame, part, inheritance);
+        }
+        auto recordPart = [&](uint32_t part)
+        {
+            PROFILE_SCOPE("recordChunkDraws");
+            VkCommandBuffer secondary = secondaries[part];
+            vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            vkCmdSetViewport(secondary, 0, 1, &viewport);
+            vkCmdSetScissor(secondary, 0, 1, &scissor);
+            for (ChunkCullPhase phase : phases)
+            {
+                chunkRenderer.recordDraws(secondary, frame, pipelineLayout, viewProjection, part, partCount, phase,
+                                          countVisible);
+            }
+            results[part] = vkEndCommandBuffer(secondary);
+        };
 
-        vkCmdBeginRenderPass(vulkan.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        JobCounter counter;
+        for (uint32_t part = 1; part < partCount; part++)
+        {
+            jobs.submit([&recordPart, part] { recordPart(part); }, JobPriority::Critical, &counter);
+        }
+        recordPart(0);
+        jobs.wait(counter);
+        for (VkResult result : results)
+        {
+            if (result != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to record secondary command buffer!");
+            }
+        }
 
-        vkCmdBindPipeline(vulkan.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-        vkCmdDraw(vulkan.commandBuffer, 3, 1, 0, 0);
+        vkCmdExecuteCommands(commandBuffer, partCount, secondaries.data());
+        vkCmdEndRenderPass(commandBuffer);
+    }
 
-        vkCmdEndRenderPass(vulkan.commandBuffer);
+    void createSyncObjects()
+    {
+        vulkan.imageAvailableSemaphores.resize(vulkan.maxFramesInFlight);
+        vulkan.inFlightFences.resize(vulkan.maxFramesInFlight);
+        vulkan.imagesInFlight.assign(vulkan.swapChainImages.size(), VK_NULL_HANDLE);
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        vkEndCommandBuffer(vulkan.commandBuffer);
+        // Created signaled so the first wait on each frame returns immediately
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (uint32_t i = 0; i < vulkan.maxFramesInFlight; i++)
+        {
+            if (vkCreateSemaphore(vulkan.device, &semaphoreInfo, nullptr, &vulkan.imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(vulkan.device, &fenceInfo, nullptr, &vulkan.inFlightFences[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+        createRenderFinishedSemaphores();
     }
 
-    void createSemaphores()
+    // One per swapchain image, offscreen images are never presented
+    void createRenderFinishedSemaphores()
     {
+        if (vulkan.headless)
+        {
+            return;
+        }
+        vulkan.renderFinishedSemaphores.resize(vulkan.swapChainImages.size());
+
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        for (size_t i = 0; i < vulkan.renderFinishedSemaphores.size(); i++)
+        {
+            if (vkCreateSemaphore(vulkan.device, &semaphoreInfo, nullptr, &vulkan.renderFinishedSemaphores[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create synchronization objects for a swap chain image!");
+            }
+        }
+    }
 
-        vkCreateSemaphore(vulkan.device, &semaphoreInfo, nullptr, &vulkan.imageAvailableSemaphore);
-        vkCreateSemaphore(vulkan.device, &semaphoreInfo, nullptr, &vulkan.renderFinishedSemaphore);
+    void destroyRenderFinishedSemaphores()
+    {
+        for (VkSemaphore semaphore : vulkan.renderFinishedSemaphores)
+        {
+            vkDestroySemaphore(vulkan.device, semaphore, nullptr);
+        }
+        vulkan.renderFinishedSemaphores.clear();
     }
     // learn
 
@@ -446,7 +1705,63 @@ private:
         }
     }
 
-    void createSwapChain()
+    void createDepthResources()
+    {
+        depthFormat = findDepthFormat();
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = depthFormat;
+        imageInfo.extent = {vulkan.swapChainExtent.width, vulkan.swapChainExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Occlusion culling reduces the depth into its Hi-Z pyramid
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(vulkan.physicalDevice, depthFormat, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+        {
+            imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+        depthImage = allocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = depthImage.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = depthFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(vulkan.device, &viewInfo, nullptr, &depthImageView) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth image view!");
+        }
+    }
+
+    VkFormat findDepthFormat()
+    {
+        const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT};
+        for (VkFormat format : candidates)
+        {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(vulkan.physicalDevice, format, &properties);
+            if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            {
+                return format;
+            }
+        }
+
+        throw std::runtime_error("failed to find a supported depth format!");
+    }
+
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE)
     {
         SwapChainSupportDetails swapChainSupport = VulkanUtils::querySwapChainSupport(vulkan.physicalDevice, vulkan.surface);
 
@@ -454,7 +1769,10 @@ private:
         VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        // More images let the CPU run further ahead at the cost of latency and memory
+        uint32_t imageCount = config.swapchainImages > 0 ? config.swapchainImages
+                                                         : swapChainSupport.capabilities.minImageCount + 1;
+        imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
         if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
         {
             imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -469,7 +1787,9 @@ private:
         createInfo.imageColorSpace = surfaceFormat.colorSpace;
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // Transfer writes let the raymarch path blit into the swapchain images
+        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
         QueueFamilyIndices indices = VulkanUtils::findQueueFamilies(vulkan.physicalDevice, vulkan.surface);
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -490,7 +1810,7 @@ private:
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = oldSwapChain;
 
         if (vkCreateSwapchainKHR(vulkan.device, &createInfo, nullptr, &vulkan.swapChain) != VK_SUCCESS)
         {
@@ -503,6 +1823,9 @@ private:
 
         vulkan.swapChainImageFormat = surfaceFormat.format;
         vulkan.swapChainExtent = extent;
+        vulkan.swapChainImageUsage = createInfo.imageUsage;
+        std::cout << "swapchain: " << extent.width << "x" << extent.height << ", " << imageCount << " images, "
+                  << presentModeName(config.presentMode) << "\n";
     }
 
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats)
@@ -518,16 +1841,36 @@ private:
         return availableFormats[0];
     }
 
+    // Falls back to FIFO, and config.presentMode with it so it reports the mode in use
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes)
     {
+        VkPresentModeKHR wanted;
+        switch (config.presentMode)
+        {
+        case PresentMode::Immediate:
+            wanted = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            break;
+        case PresentMode::Fifo:
+            wanted = VK_PRESENT_MODE_FIFO_KHR;
+            break;
+        case PresentMode::FifoRelaxed:
+            wanted = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        default:
+            wanted = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        }
+
         for (const auto &availablePresentMode : availablePresentModes)
         {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+            if (availablePresentMode == wanted)
             {
                 return availablePresentMode;
             }
         }
 
+        std::cout << "swapchain: " << presentModeName(config.presentMode) << " not supported, using fifo\n";
+        config.presentMode = PresentMode::Fifo;
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -554,13 +1897,32 @@ private:
     }
 };
 
-int main()
+int main(int argc, char **argv)
 {
     Application app;
 
     try
     {
-        app.init();
+        Config config = Config::parse(argc, argv);
+        if (!config.check.empty())
+        {
+            return runChecks(config.check, std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (!config.benchmark.empty())
+        {
+            BenchReport report;
+            report.setInfo("benchmark", config.benchmark);
+            runBenchmarks(config.benchmark, report);
+            report.add("run.peak_memory_mib", peakResidentBytes() / (1024.0 * 1024.0), "MiB");
+            report.print(std::cout);
+            if (!config.benchJsonPath.empty())
+            {
+                report.writeJson(config.benchJsonPath);
+            }
+            return EXIT_SUCCESS;
+        }
+
+        app.init(config);
         app.run();
     }
     catch (const std::exception &e)
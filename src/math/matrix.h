@@ -0,0 +1,160 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cmath>
+
+struct Vec3
+{
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+
+    Vec3() = default;
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    Vec3 operator+(const Vec3 &other) const { return {x + other.x, y + other.y, z + other.z}; }
+    Vec3 operator-(const Vec3 &other) const { return {x - other.x, y - other.y, z - other.z}; }
+    Vec3 operator*(float scale) const { return {x * scale, y * scale, z * scale}; }
+};
+
+inline float dot(const Vec3 &a, const Vec3 &b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 cross(const Vec3 &a, const Vec3 &b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+inline Vec3 normalize(const Vec3 &v)
+{
+    float length = std::sqrt(dot(v, v));
+    return length > 0.0f ? v * (1.0f / length) : v;
+}
+
+// Column-major 4x4 matrix, m[column * 4 + row], matching GLSL's mat4 layout
+struct Mat4
+{
+    float m[16] = {};
+
+    static Mat4 identity()
+    {
+        Mat4 result;
+        result.m[0] = result.m[5] = result.m[10] = result.m[15] = 1.0f;
+        return result;
+    }
+
+    float &at(int row, int column) { return m[column * 4 + row]; }
+    float at(int row, int column) const { return m[column * 4 + row]; }
+
+    Mat4 operator*(const Mat4 &other) const
+    {
+        Mat4 result;
+        for (int column = 0; column < 4; column++)
+        {
+            for (int row = 0; row < 4; row++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += at(row, k) * other.at(k, column);
+                }
+                result.at(row, column) = sum;
+            }
+        }
+        return result;
+    }
+};
+
+// General inverse by cofactor expansion, returns the zero matrix if m is singular
+inline Mat4 inverse(const Mat4 &matrix)
+{
+    const float *m = matrix.m;
+    Mat4 result;
+    float *inv = result.m;
+
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float determinant = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (determinant == 0.0f)
+    {
+        return Mat4();
+    }
+
+    float scale = 1.0f / determinant;
+    for (float &value : result.m)
+    {
+        value *= scale;
+    }
+    return result;
+}
+
+// Right-handed view matrix looking from eye towards target
+inline Mat4 lookAt(const Vec3 &eye, const Vec3 &target, const Vec3 &up)
+{
+    Vec3 forward = normalize(target - eye);
+    Vec3 side = normalize(cross(forward, up));
+    Vec3 realUp = cross(side, forward);
+
+    Mat4 result = Mat4::identity();
+    result.at(0, 0) = side.x;
+    result.at(0, 1) = side.y;
+    result.at(0, 2) = side.z;
+    result.at(1, 0) = realUp.x;
+    result.at(1, 1) = realUp.y;
+    result.at(1, 2) = realUp.z;
+    result.at(2, 0) = -forward.x;
+    result.at(2, 1) = -forward.y;
+    result.at(2, 2) = -forward.z;
+    result.at(0, 3) = -dot(side, eye);
+    result.at(1, 3) = -dot(realUp, eye);
+    result.at(2, 3) = dot(forward, eye);
+    return result;
+}
+
+// Vulkan clip space: depth 0 at near, 1 at far, and y flipped so +y is up on screen
+inline Mat4 perspective(float fovY, float aspect, float nearPlane, float farPlane)
+{
+    float f = 1.0f / std::tan(fovY * 0.5f);
+
+    Mat4 result;
+    result.at(0, 0) = f / aspect;
+    result.at(1, 1) = -f;
+    result.at(2, 2) = farPlane / (nearPlane - farPlane);
+    result.at(2, 3) = nearPlane * farPlane / (nearPlane - farPlane);
+    result.at(3, 2) = -1.0f;
+    return result;
+}
+
+// Reverse-Z with the far plane at infinity: depth 1 at the near plane, falling
+// towards 0 with distance, where float depth has most of its precision. Depth
+// tests pass on GREATER and depth clears to 0.
+inline Mat4 perspectiveReverseZ(float fovY, float aspect, float nearPlane)
+{
+    float f = 1.0f / std::tan(fovY * 0.5f);
+
+    Mat4 result;
+    result.at(0, 0) = f / aspect;
+    result.at(1, 1) = -f;
+    result.at(2, 3) = nearPlane;
+    result.at(3, 2) = -1.0f;
+    return result;
+}
+
+#endif
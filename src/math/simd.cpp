@@ -0,0 +1,47 @@
+#include <initializer_list>
+
+#include "simd.h"
+
+bool isSimdLevelSupported(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return true;
+#if defined(__x86_64__) || defined(__i386__)
+    case SimdLevel::Sse41:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+    case SimdLevel::Avx2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+SimdLevel detectSimdLevel()
+{
+    for (SimdLevel level : {SimdLevel::Avx2, SimdLevel::Sse41})
+    {
+        if (isSimdLevelSupported(level))
+        {
+            return level;
+        }
+    }
+    return SimdLevel::Scalar;
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Sse41:
+        return "sse4.1";
+    case SimdLevel::Avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Instruction sets the SIMD kernels (CPU raytracer, terrain noise) are built
+// for, widest last. Each kernel has one translation unit per set that switches
+// the target with a pragma, so the binary runs on any x86-64 and picks the
+// widest set at runtime.
+enum class SimdLevel
+{
+    Scalar, // 1 lane
+    Sse41,  // 4 lanes
+    Avx2    // 8 lanes
+};
+
+// Widest level this CPU runs, always Scalar off x86
+SimdLevel detectSimdLevel();
+bool isSimdLevelSupported(SimdLevel level);
+const char *simdLevelName(SimdLevel level);
+
+#endif
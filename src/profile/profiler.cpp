@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+#include "profiler.h"
+
+void RollingStats::add(double value)
+{
+    if (values.size() < capacity)
+    {
+        values.push_back(value);
+    }
+    else
+    {
+        values[next] = value;
+    }
+    next = (next + 1) % capacity;
+}
+
+double RollingStats::min() const
+{
+    return values.empty() ? 0.0 : *std::min_element(values.begin(), values.end());
+}
+
+double RollingStats::max() const
+{
+    return values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+}
+
+double RollingStats::average() const
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double value : values)
+    {
+        sum += value;
+    }
+    return sum / values.size();
+}
+
+double RollingStats::percentile(double p) const
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    std::vector<double> sorted = values;
+    size_t rank = static_cast<size_t>(std::clamp(p, 0.0, 1.0) * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+Profiler &Profiler::get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+uint64_t Profiler::now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+void Profiler::setCapturing(bool capture)
+{
+    capturing = capture;
+    if (capturing)
+    {
+        trace.reserve(std::min(static_cast<size_t>(MAX_TRACE_EVENTS), static_cast<size_t>(64 * 1024)));
+    }
+}
+
+// Buffers are never freed, so the pointer stays valid for the thread's lifetime
+Profiler::ThreadBuffer &Profiler::threadBuffer()
+{
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threads.push_back(std::make_unique<ThreadBuffer>());
+        buffer = threads.back().get();
+        buffer->index = static_cast<uint32_t>(threads.size() - 1);
+        buffer->name = "thread " + std::to_string(buffer->index);
+    }
+    return *buffer;
+}
+
+void Profiler::setThreadName(const std::string &name)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    buffer.name = name;
+}
+
+void Profiler::recordCpu(const char *name, uint64_t start, uint64_t end)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back({name, start, end - start, buffer.index});
+}
+
+void Profiler::recordGpu(const char *name, uint64_t start, uint64_t duration)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(gpuMutex);
+    gpuEvents.push_back({name, start, duration, GPU_THREAD});
+}
+
+void Profiler::endFrame()
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    frameEvents.clear();
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const std::unique_ptr<ThreadBuffer> &thread : threads)
+        {
+            std::lock_guard<std::mutex> bufferLock(thread->mutex);
+            frameEvents.insert(frameEvents.end(), thread->events.begin(), thread->events.end());
+            thread->events.clear();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(gpuMutex);
+        frameEvents.insert(frameEvents.end(), gpuEvents.begin(), gpuEvents.end());
+        gpuEvents.clear();
+    }
+
+    // Scopes that ran several times this frame, e.g. one per job, count as their sum
+    std::map<std::string, double> cpuTotals;
+    std::map<std::string, double> gpuTotals;
+    for (const ProfileEvent &event : frameEvents)
+    {
+        std::map<std::string, double> &totals = event.thread == GPU_THREAD ? gpuTotals : cpuTotals;
+        totals[event.name] += event.duration / 1e6;
+    }
+    for (const auto &total : cpuTotals)
+    {
+        cpuStats[total.first].add(total.second);
+    }
+    for (const auto &total : gpuTotals)
+    {
+        gpuStats[total.first].add(total.second);
+    }
+
+    if (capturing)
+    {
+        size_t room = MAX_TRACE_EVENTS - std::min(trace.size(), static_cast<size_t>(MAX_TRACE_EVENTS));
+        size_t count = std::min(room, frameEvents.size());
+        trace.insert(trace.end(), frameEvents.begin(), frameEvents.begin() + count);
+    }
+}
+
+void Profiler::printStats(std::ostream &out) const
+{
+    const std::map<std::string, RollingStats> *groups[2] = {&cpuStats, &gpuStats};
+    const char *groupNames[2] = {"cpu", "gpu"};
+    for (int group = 0; group < 2; group++)
+    {
+        for (const auto &entry : *groups[group])
+        {
+            const RollingStats &stats = entry.second;
+            out << "profile: " << groupNames[group] << " " << entry.first << " min " << stats.min() << " avg "
+                << stats.average() << " p99 " << stats.percentile(0.99) << " ms over " << stats.count()
+                << " frames\n";
+        }
+    }
+}
+
+static void writeJsonString(std::ostream &out, const std::string &text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+// Complete ("X") events in microseconds, loadable in chrome://tracing and
+// Perfetto. CPU threads are tracks of process 0, the GPU is process 1.
+void Profiler::writeChromeTrace(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("failed to open " + path + " for writing!");
+    }
+
+    uint64_t origin = UINT64_MAX;
+    for (const ProfileEvent &event : trace)
+    {
+        origin = std::min(origin, event.start);
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separate = [&]()
+    {
+        file << (first ? "" : ",\n");
+        first = false;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const std::unique_ptr<ThreadBuffer> &thread : threads)
+        {
+            separate();
+            file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << thread->index
+                 << ",\"args\":{\"name\":";
+            writeJsonString(file, thread->name);
+            file << "}}";
+        }
+    }
+    separate();
+    file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"args\":{\"name\":\"cpu\"}},\n";
+    file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"gpu\"}}";
+
+    file.precision(3);
+    file << std::fixed;
+    for (const ProfileEvent &event : trace)
+    {
+        separate();
+        file << "{\"ph\":\"X\",\"name\":";
+        writeJsonString(file, event.name);
+        if (event.thread == GPU_THREAD)
+        {
+            file << ",\"pid\":1,\"tid\":0";
+        }
+        else
+        {
+            file << ",\"pid\":0,\"tid\":" << event.thread;
+        }
+        file << ",\"ts\":" << (event.start - origin) / 1e3 << ",\"dur\":" << event.duration / 1e3 << "}";
+    }
+    file << "\n]}\n";
+
+    if (!file)
+    {
+        throw std::runtime_error("failed to write " + path + "!");
+    }
+}
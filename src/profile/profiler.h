@@ -0,0 +1,147 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Building with -DVOXIN_NO_PROFILE compiles every PROFILE_SCOPE out and makes
+// the profiler report itself as disabled, so nothing is recorded
+#ifdef VOXIN_NO_PROFILE
+#define VOXIN_PROFILE 0
+#else
+#define VOXIN_PROFILE 1
+#endif
+
+// Last `capacity` samples of a per-frame value
+class RollingStats
+{
+public:
+    explicit RollingStats(size_t capacity = 240) : capacity(capacity) {}
+
+    void add(double value);
+    size_t count() const { return values.size(); }
+    double min() const;
+    double max() const;
+    double average() const;
+    // p in [0, 1], nearest rank
+    double percentile(double p) const;
+
+private:
+    size_t capacity;
+    size_t next = 0;
+    std::vector<double> values;
+};
+
+// One finished scope, in nanoseconds on Profiler::now()'s clock
+struct ProfileEvent
+{
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+    uint32_t thread;
+};
+
+// Collects named CPU scopes from any thread and GPU pass timings from
+// GpuProfiler. Every thread appends to its own buffer, so recording only takes
+// that thread's uncontended lock. endFrame() folds everything that finished
+// since the previous call into per-name frame totals, the rolling stats, and,
+// while capturing, the trace written by writeChromeTrace().
+//
+// Scope names must be string literals or otherwise outlive the profiler.
+// Disabled profilers record nothing, and a scope then costs one relaxed load.
+class Profiler
+{
+public:
+    // Trace events kept while capturing, later ones are dropped
+    static const size_t MAX_TRACE_EVENTS = 1 << 20;
+    // Thread index GPU events are reported under
+    static const uint32_t GPU_THREAD = UINT32_MAX;
+
+    static Profiler &get();
+
+    void setEnabled(bool enabled) { this->enabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return VOXIN_PROFILE && enabled.load(std::memory_order_relaxed); }
+    void setCapturing(bool capture);
+
+    // Nanoseconds on the profiler's clock
+    static uint64_t now();
+
+    // Names the calling thread in traces, threads default to "thread N"
+    void setThreadName(const std::string &name);
+
+    void recordCpu(const char *name, uint64_t start, uint64_t end);
+    void recordGpu(const char *name, uint64_t start, uint64_t duration);
+
+    // Call once per frame from the main thread
+    void endFrame();
+
+    // Stats only get a sample in frames where the name was recorded
+    void printStats(std::ostream &out) const;
+    void writeChromeTrace(const std::string &path) const;
+
+private:
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        std::vector<ProfileEvent> events;
+        uint32_t index = 0;
+        std::string name;
+    };
+
+    std::atomic<bool> enabled{false};
+    bool capturing = false;
+
+    mutable std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+
+    std::mutex gpuMutex;
+    std::vector<ProfileEvent> gpuEvents;
+
+    // Only touched by endFrame() and the readers on the main thread
+    std::map<std::string, RollingStats> cpuStats;
+    std::map<std::string, RollingStats> gpuStats;
+    std::vector<ProfileEvent> trace;
+    std::vector<ProfileEvent> frameEvents;
+
+    ThreadBuffer &threadBuffer();
+};
+
+// Records the time from construction to destruction under name
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char *name)
+        : name(name), start(Profiler::get().isEnabled() ? Profiler::now() : 0)
+    {
+    }
+    ~ProfileScope()
+    {
+        if (start != 0)
+        {
+            Profiler::get().recordCpu(name, start, Profiler::now());
+        }
+    }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+#if VOXIN_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,734 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../vulkan/vulkan.h"
+#include "chunk_renderer.h"
+
+const char *chunkDrawModeName(ChunkDrawMode mode)
+{
+    switch (mode)
+    {
+    case ChunkDrawMode::IndirectCount:
+        return "indirect count";
+    case ChunkDrawMode::Indirect:
+        return "multi-draw indirect";
+    default:
+        return "direct";
+    }
+}
+
+// Clip-space planes of a Vulkan projection (0 <= z <= w), unnormalized, inside
+// where dot(plane.xyz, p) + plane.w >= 0. With reverse-Z w - z is the near plane,
+// and z the far plane, which an infinite projection makes always pass.
+static void extractFrustumPlanes(const Mat4 &viewProjection, float planes[6][4])
+{
+    for (int column = 0; column < 4; column++)
+    {
+        float x = viewProjection.at(0, column);
+        float y = viewProjection.at(1, column);
+        float z = viewProjection.at(2, column);
+        float w = viewProjection.at(3, column);
+        planes[0][column] = w + x;
+        planes[1][column] = w - x;
+        planes[2][column] = w + y;
+        planes[3][column] = w - y;
+        planes[4][column] = z;
+        planes[5][column] = w - z;
+    }
+}
+
+// Same test as chunk_cull.comp, which derives the planes from the matrix itself
+static bool chunkInFrustum(const float planes[6][4], const float origin[3])
+{
+    for (int i = 0; i < 6; i++)
+    {
+        float distance = planes[i][3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float corner = planes[i][axis] > 0.0f ? origin[axis] + Chunk::SIZE : origin[axis];
+            distance += planes[i][axis] * corner;
+        }
+        if (distance < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ChunkRenderer::init(VulkanContext &vulkanContext, GpuAllocator &gpuAllocator, TransferUploader &transferUploader,
+                         const ShaderRegistry &shaders)
+{
+    vulkan = &vulkanContext;
+    allocator = &gpuAllocator;
+    uploader = &transferUploader;
+
+    // Indirect draws carry the slot in firstInstance, which needs drawIndirectFirstInstance
+    if (vulkan->drawIndirectFirstInstance && vulkan->multiDrawIndirect)
+    {
+        drawMode = vulkan->drawIndirectCount ? ChunkDrawMode::IndirectCount : ChunkDrawMode::Indirect;
+    }
+    else
+    {
+        drawMode = ChunkDrawMode::Direct;
+    }
+
+    frames.resize(vulkan->maxFramesInFlight);
+    createQuadIndices();
+    if (drawMode != ChunkDrawMode::Direct)
+    {
+        createCullPipeline(shaders);
+    }
+}
+
+void ChunkRenderer::destroy()
+{
+    if (!vulkan)
+    {
+        return;
+    }
+
+    for (FrameResources &frame : frames)
+    {
+        destroyFrameBuffers(frame);
+    }
+    frames.clear();
+
+    for (MeshPage &page : pages)
+    {
+        allocator->destroyBuffer(page.vertexBuffer);
+    }
+    pages.clear();
+    allocator->destroyBuffer(quadIndices);
+
+    vkDestroyPipeline(vulkan->device, cullPipeline, nullptr);
+    vkDestroyPipelineLayout(vulkan->device, cullPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(vulkan->device, cullDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(vulkan->device, cullSetLayout, nullptr);
+    cullPipeline = VK_NULL_HANDLE;
+    cullPipelineLayout = VK_NULL_HANDLE;
+    cullDescriptorPool = VK_NULL_HANDLE;
+    cullSetLayout = VK_NULL_HANDLE;
+
+    meshes.clear();
+    retired.clear();
+    records.clear();
+    freeSlots.clear();
+    quadCount = 0;
+    vulkan = nullptr;
+}
+
+std::vector<VkVertexInputBindingDescription> ChunkRenderer::getBindingDescriptions()
+{
+    std::vector<VkVertexInputBindingDescription> bindings(2);
+
+    bindings[0].binding = 0;
+    bindings[0].stride = sizeof(ChunkVertex);
+    bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    bindings[1].binding = 1;
+    bindings[1].stride = sizeof(ChunkDrawRecord);
+    bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindings;
+}
+
+std::vector<VkVertexInputAttributeDescription> ChunkRenderer::getAttributeDescriptions()
+{
+    std::vector<VkVertexInputAttributeDescription> attributes(3);
+
+    attributes[0].binding = 0;
+    attributes[0].location = 0;
+    attributes[0].format = VK_FORMAT_R32_UINT;
+    attributes[0].offset = offsetof(ChunkVertex, position);
+
+    attributes[1].binding = 0;
+    attributes[1].location = 1;
+    attributes[1].format = VK_FORMAT_R32_UINT;
+    attributes[1].offset = offsetof(ChunkVertex, material);
+
+    attributes[2].binding = 1;
+    attributes[2].location = 2;
+    attributes[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributes[2].offset = offsetof(ChunkDrawRecord, origin);
+
+    return attributes;
+}
+
+VkPushConstantRange ChunkRenderer::getPushConstantRange()
+{
+    VkPushConstantRange range{};
+    range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    range.offset = 0;
+    range.size = sizeof(ChunkPushConstants);
+    return range;
+}
+
+// Every mesh is drawn with the same indices, the mesher's two triangles per quad
+void ChunkRenderer::createQuadIndices()
+{
+    const uint32_t quadPattern[6] = {0, 1, 2, 2, 3, 0};
+    std::vector<uint32_t> indices(static_cast<size_t>(MAX_QUADS_PER_CHUNK) * 6);
+    for (uint32_t quad = 0; quad < MAX_QUADS_PER_CHUNK; quad++)
+    {
+        for (uint32_t i = 0; i < 6; i++)
+        {
+            indices[quad * 6 + i] = quad * 4 + quadPattern[i];
+        }
+    }
+
+    VkDeviceSize size = indices.size() * sizeof(uint32_t);
+    quadIndices = allocator->createBuffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uploader->upload(quadIndices, 0, indices.data(), size, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                     VK_ACCESS_INDEX_READ_BIT);
+}
+
+void ChunkRenderer::createCullPipeline(const ShaderRegistry &shaders)
+{
+    // Records, commands, counts and visibility, then the Hi-Z pyramid
+    VkDescriptorSetLayoutBinding bindings[5] = {};
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i < 4 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 5;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(vulkan->device, &layoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create chunk cull descriptor set layout!");
+    }
+
+    uint32_t setCount = static_cast<uint32_t>(frames.size());
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 4 * setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(vulkan->device, &poolInfo, nullptr, &cullDescriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create chunk cull descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(setCount, cullSetLayout);
+    std::vector<VkDescriptorSet> sets(setCount);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = cullDescriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = setLayouts.data();
+    if (vkAllocateDescriptorSets(vulkan->device, &allocInfo, sets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate chunk cull descriptor sets!");
+    }
+    for (uint32_t i = 0; i < setCount; i++)
+    {
+        frames[i].descriptorSet = sets[i];
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ChunkCullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(vulkan->device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create chunk cull pipeline layout!");
+    }
+
+    VkShaderModule shaderModule = shaders.createShaderModule(vulkan->device, ShaderId::ChunkCullComp);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(vulkan->device, vulkan->pipelineCache, 1, &pipelineInfo, nullptr,
+                                               &cullPipeline);
+    vkDestroyShaderModule(vulkan->device, shaderModule, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create chunk cull pipeline!");
+    }
+}
+
+// Grows a frame's buffers to hold every slot and page. Only called while the
+// frame is idle, so the old buffers can go right away.
+void ChunkRenderer::ensureFrameCapacity(FrameResources &frame)
+{
+    uint32_t slotCount = std::max(static_cast<uint32_t>(records.size()), 1u);
+    uint32_t pageCount = std::max(static_cast<uint32_t>(pages.size()), 1u);
+    if (frame.slotCapacity >= slotCount && frame.pageCapacity >= pageCount)
+    {
+        return;
+    }
+
+    uint32_t slotCapacity = std::max(frame.slotCapacity, 1024u);
+    while (slotCapacity < slotCount)
+    {
+        slotCapacity *= 2;
+    }
+    uint32_t pageCapacity = std::max(frame.pageCapacity, pageCount);
+
+    destroyFrameBuffers(frame);
+    frame.slotCapacity = slotCapacity;
+    frame.pageCapacity = pageCapacity;
+    frame.allDirty = true;
+
+    const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    frame.records = allocator->createBuffer(static_cast<VkDeviceSize>(slotCapacity) * sizeof(ChunkDrawRecord),
+                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                           hostVisible);
+    if (drawMode == ChunkDrawMode::Direct)
+    {
+        return;
+    }
+
+    const VkBufferUsageFlags indirectUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                             VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    frame.commands = allocator->createBuffer(2ull * slotCapacity * pageCapacity * sizeof(VkDrawIndexedIndirectCommand),
+                                             indirectUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    frame.counts = allocator->createBuffer((2 * pageCapacity + 1) * sizeof(uint32_t), indirectUsage, hostVisible);
+    // Zeroed by the next cull, so every chunk starts out hidden and is tested by Late
+    frame.visibility = allocator->createBuffer(slotCapacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    frame.visibilityCleared = false;
+
+    VkDescriptorBufferInfo bufferInfos[4] = {};
+    const GpuBuffer *buffers[4] = {&frame.records, &frame.commands, &frame.counts, &frame.visibility};
+    VkWriteDescriptorSet writes[4] = {};
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        bufferInfos[i].buffer = buffers[i]->buffer;
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = frame.descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(vulkan->device, 4, writes, 0, nullptr);
+}
+
+void ChunkRenderer::destroyFrameBuffers(FrameResources &frame)
+{
+    GpuBuffer *buffers[4] = {&frame.records, &frame.commands, &frame.counts, &frame.visibility};
+    for (GpuBuffer *buffer : buffers)
+    {
+        if (buffer->buffer != VK_NULL_HANDLE)
+        {
+            allocator->destroyBuffer(*buffer);
+        }
+    }
+    frame.slotCapacity = 0;
+    frame.pageCapacity = 0;
+    frame.culled = false;
+}
+
+bool ChunkRenderer::allocateRange(VkDeviceSize size, uint32_t &page, VkDeviceSize &offset)
+{
+    for (uint32_t i = 0; i < pages.size(); i++)
+    {
+        if (std::optional<uint64_t> found = pages[i].ranges->allocate(size, sizeof(ChunkVertex)))
+        {
+            page = i;
+            offset = *found;
+            return true;
+        }
+    }
+
+    MeshPage newPage;
+    newPage.vertexBuffer = allocator->createBuffer(PAGE_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    newPage.ranges = std::make_unique<BuddySubAllocator>(PAGE_SIZE, PAGE_MIN_BLOCK);
+    std::optional<uint64_t> found = newPage.ranges->allocate(size, sizeof(ChunkVertex));
+    pages.push_back(std::move(newPage));
+    if (!found)
+    {
+        return false;
+    }
+    page = static_cast<uint32_t>(pages.size() - 1);
+    offset = *found;
+    return true;
+}
+
+uint32_t ChunkRenderer::allocateSlot()
+{
+    if (!freeSlots.empty())
+    {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    records.push_back(ChunkDrawRecord{});
+    return static_cast<uint32_t>(records.size() - 1);
+}
+
+// Frames pick the change up in their next beginFrame()
+void ChunkRenderer::writeRecord(uint32_t slot, const ChunkDrawRecord &record)
+{
+    records[slot] = record;
+    for (FrameResources &frame : frames)
+    {
+        if (!frame.allDirty)
+        {
+            frame.dirtySlots.push_back(slot);
+        }
+    }
+}
+
+void ChunkRenderer::uploadMesh(const ChunkCoord &coord, const ChunkMesh &mesh)
+{
+    removeMesh(coord);
+    if (mesh.empty())
+    {
+        return;
+    }
+    if (mesh.quadCount() > MAX_QUADS_PER_CHUNK)
+    {
+        throw std::runtime_error("chunk mesh has more quads than the shared index buffer covers!");
+    }
+
+    GpuMesh gpuMesh;
+    gpuMesh.size = mesh.vertices.size() * sizeof(ChunkVertex);
+    gpuMesh.indexCount = static_cast<uint32_t>(mesh.quadCount() * 6);
+    if (!allocateRange(gpuMesh.size, gpuMesh.page, gpuMesh.offset))
+    {
+        throw std::runtime_error("chunk mesh does not fit into a vertex page!");
+    }
+    gpuMesh.slot = allocateSlot();
+
+    uploader->upload(pages[gpuMesh.page].vertexBuffer, gpuMesh.offset, mesh.vertices.data(), gpuMesh.size,
+                     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+    ChunkDrawRecord record{};
+    record.origin[0] = static_cast<float>(coord.x * Chunk::SIZE);
+    record.origin[1] = static_cast<float>(coord.y * Chunk::SIZE);
+    record.origin[2] = static_cast<float>(coord.z * Chunk::SIZE);
+    record.indexCount = gpuMesh.indexCount;
+    record.vertexOffset = static_cast<int32_t>(gpuMesh.offset / sizeof(ChunkVertex));
+    record.page = gpuMesh.page;
+    writeRecord(gpuMesh.slot, record);
+
+    quadCount += mesh.quadCount();
+    meshes.emplace(coord, gpuMesh);
+}
+
+void ChunkRenderer::removeMesh(const ChunkCoord &coord)
+{
+    auto it = meshes.find(coord);
+    if (it == meshes.end())
+    {
+        return;
+    }
+
+    // Each frame keeps its own record copy, so the slot is free for reuse right
+    // away. The vertices are shared and wait for the frames in flight.
+    writeRecord(it->second.slot, ChunkDrawRecord{});
+    freeSlots.push_back(it->second.slot);
+
+    quadCount -= it->second.indexCount / 6;
+    retire(it->second);
+    meshes.erase(it);
+}
+
+void ChunkRenderer::beginFrame(uint32_t frameIndex)
+{
+    frameNumber++;
+
+    // A frame slot is only reused after its fence was waited on, so once
+    // maxFramesInFlight more frames have started, the frame that retired a mesh
+    // and the next one, which may still acquire its pending upload, are done
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); i++)
+    {
+        if (retired[i].frame + vulkan->maxFramesInFlight < frameNumber)
+        {
+            destroyMesh(retired[i].mesh);
+        }
+        else
+        {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+
+    if (directRecorded.exchange(false))
+    {
+        visibleChunks = directDraws.exchange(0);
+        occludedChunks = 0;
+    }
+
+    FrameResources &frame = frames[frameIndex];
+    if (frame.culled)
+    {
+        // Early and Late draws, then what Late found occluded
+        const uint32_t *counts = static_cast<const uint32_t *>(frame.counts.allocation.mapped);
+        visibleChunks = 0;
+        for (uint32_t i = 0; i < 2 * frame.pageCapacity; i++)
+        {
+            visibleChunks += counts[i];
+        }
+        occludedChunks = counts[2 * frame.pageCapacity];
+        frame.culled = false;
+    }
+
+    ensureFrameCapacity(frame);
+    auto *mapped = static_cast<ChunkDrawRecord *>(frame.records.allocation.mapped);
+    if (frame.allDirty)
+    {
+        memcpy(mapped, records.data(), records.size() * sizeof(ChunkDrawRecord));
+        frame.allDirty = false;
+    }
+    else
+    {
+        for (uint32_t slot : frame.dirtySlots)
+        {
+            mapped[slot] = records[slot];
+        }
+    }
+    frame.dirtySlots.clear();
+}
+
+void ChunkRenderer::setOcclusionPyramid(const HiZPyramid &pyramid)
+{
+    if (drawMode == ChunkDrawMode::Direct)
+    {
+        return;
+    }
+    occlusionSupported = pyramid.isSupported();
+    pyramidExtent = pyramid.getExtent();
+    pyramidLevels = pyramid.getLevelCount();
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = pyramid.getSampler();
+    imageInfo.imageView = pyramid.getView();
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::vector<VkWriteDescriptorSet> writes(frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = frames[i].descriptorSet;
+        writes[i].dstBinding = 4;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].pImageInfo = &imageInfo;
+    }
+    vkUpdateDescriptorSets(vulkan->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void ChunkRenderer::recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, const Mat4 &viewProjection,
+                                  ChunkCullPhase phase)
+{
+    if (drawMode == ChunkDrawMode::Direct || records.empty())
+    {
+        return;
+    }
+    if (phase == ChunkCullPhase::Late && !isOcclusionCullingSupported())
+    {
+        return;
+    }
+    FrameResources &frame = frames[frameIndex];
+    bool compact = drawMode == ChunkDrawMode::IndirectCount;
+
+    if (phase == ChunkCullPhase::Late)
+    {
+        // Early read the visibility Late overwrites, and Late adds to the counts Early cleared
+        VkMemoryBarrier phaseBarrier{};
+        phaseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        phaseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        phaseBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &phaseBarrier, 0, nullptr, 0, nullptr);
+    }
+    else
+    {
+        // Without a count every command is read, so culled slots must hold zeroes
+        vkCmdFillBuffer(commandBuffer, frame.counts.buffer, 0, VK_WHOLE_SIZE, 0);
+        if (!compact)
+        {
+            vkCmdFillBuffer(commandBuffer, frame.commands.buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+        if (!frame.visibilityCleared)
+        {
+            vkCmdFillBuffer(commandBuffer, frame.visibility.buffer, 0, VK_WHOLE_SIZE, 0);
+            frame.visibilityCleared = true;
+        }
+
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &clearBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    ChunkCullPushConstants constants{};
+    memcpy(constants.viewProjection, viewProjection.m, sizeof(constants.viewProjection));
+    constants.slotCount = static_cast<uint32_t>(records.size());
+    constants.commandsPerPage = frame.slotCapacity;
+    constants.compact = compact ? 1 : 0;
+    constants.phase = static_cast<uint32_t>(phase);
+    constants.pyramidSize[0] = static_cast<float>(pyramidExtent.width);
+    constants.pyramidSize[1] = static_cast<float>(pyramidExtent.height);
+    constants.pyramidLevels = pyramidLevels;
+    constants.pageCapacity = frame.pageCapacity;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1,
+                            &frame.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, (constants.slotCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    // The counts are also read back on the host once the frame's fence signals
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullBarrier, 0,
+                         nullptr, 0, nullptr);
+    frame.culled = true;
+}
+
+uint32_t ChunkRenderer::getDrawPartCount(uint32_t maxParts) const
+{
+    // Indirect draws are one call per page, so pages are the smallest part
+    uint32_t parts = static_cast<uint32_t>(pages.size());
+    if (drawMode == ChunkDrawMode::Direct)
+    {
+        parts = static_cast<uint32_t>((records.size() + MIN_SLOTS_PER_PART - 1) / MIN_SLOTS_PER_PART);
+    }
+    return std::max(1u, std::min(parts, maxParts));
+}
+
+void ChunkRenderer::recordDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineLayout layout,
+                                const Mat4 &viewProjection, uint32_t part, uint32_t partCount, ChunkCullPhase phase,
+                                bool countVisible)
+{
+    if (records.empty())
+    {
+        return;
+    }
+    const FrameResources &frame = frames[frameIndex];
+
+    ChunkPushConstants constants{};
+    memcpy(constants.viewProjection, viewProjection.m, sizeof(constants.viewProjection));
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+    vkCmdBindIndexBuffer(commandBuffer, quadIndices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    const VkDeviceSize commandStride = sizeof(VkDrawIndexedIndirectCommand);
+    const uint32_t slotCount = static_cast<uint32_t>(records.size());
+    const uint32_t pageCount = static_cast<uint32_t>(pages.size());
+
+    // Indirect parts are ranges of pages, direct parts ranges of slots
+    uint32_t firstPage = 0;
+    uint32_t pageEnd = pageCount;
+    uint32_t firstSlot = 0;
+    uint32_t slotEnd = slotCount;
+    if (drawMode == ChunkDrawMode::Direct)
+    {
+        firstSlot = static_cast<uint32_t>(static_cast<uint64_t>(slotCount) * part / partCount);
+        slotEnd = static_cast<uint32_t>(static_cast<uint64_t>(slotCount) * (part + 1) / partCount);
+    }
+    else
+    {
+        firstPage = static_cast<uint32_t>(static_cast<uint64_t>(pageCount) * part / partCount);
+        pageEnd = static_cast<uint32_t>(static_cast<uint64_t>(pageCount) * (part + 1) / partCount);
+    }
+
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+    int64_t drawn = 0;
+
+    // Late draws from the second half of the commands and counts
+    uint32_t regionPages = phase == ChunkCullPhase::Late ? frame.pageCapacity : 0;
+
+    for (uint32_t page = firstPage; page < pageEnd; page++)
+    {
+        VkBuffer vertexBuffers[2] = {pages[page].vertexBuffer.buffer, frame.records.buffer};
+        VkDeviceSize offsets[2] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+
+        VkDeviceSize pageOffset = static_cast<VkDeviceSize>(regionPages + page) * frame.slotCapacity * commandStride;
+        switch (drawMode)
+        {
+        case ChunkDrawMode::IndirectCount:
+            vkCmdDrawIndexedIndirectCount(commandBuffer, frame.commands.buffer, pageOffset, frame.counts.buffer,
+                                          (regionPages + page) * sizeof(uint32_t), std::min(slotCount, vulkan->maxDrawIndirectCount),
+                                          static_cast<uint32_t>(commandStride));
+            break;
+        case ChunkDrawMode::Indirect:
+            for (uint32_t first = 0; first < slotCount; first += vulkan->maxDrawIndirectCount)
+            {
+                uint32_t count = std::min(slotCount - first, vulkan->maxDrawIndirectCount);
+                vkCmdDrawIndexedIndirect(commandBuffer, frame.commands.buffer, pageOffset + first * commandStride,
+                                         count, static_cast<uint32_t>(commandStride));
+            }
+            break;
+        case ChunkDrawMode::Direct:
+            for (uint32_t slot = firstSlot; slot < slotEnd; slot++)
+            {
+                const ChunkDrawRecord &record = records[slot];
+                if (record.indexCount == 0 || record.page != page || !chunkInFrustum(planes, record.origin))
+                {
+                    continue;
+                }
+                vkCmdDrawIndexed(commandBuffer, record.indexCount, 1, 0, record.vertexOffset, slot);
+                drawn++;
+            }
+            break;
+        }
+    }
+
+    if (drawMode == ChunkDrawMode::Direct && countVisible)
+    {
+        directDraws.fetch_add(drawn, std::memory_order_relaxed);
+        directRecorded.store(true, std::memory_order_relaxed);
+    }
+}
+
+void ChunkRenderer::retire(GpuMesh &mesh)
+{
+    retired.push_back({mesh, frameNumber});
+}
+
+void ChunkRenderer::destroyMesh(GpuMesh &mesh)
+{
+    pages[mesh.page].ranges->free(mesh.offset, mesh.size);
+}
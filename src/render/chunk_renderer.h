@@ -0,0 +1,224 @@
+#ifndef CHUNK_RENDERER_H
+#define CHUNK_RENDERER_H
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../math/matrix.h"
+#include "../shaders/shader_registry.h"
+#include "../vulkan/allocator.h"
+#include "../vulkan/suballocator.h"
+#include "../vulkan/transfer.h"
+#include "../world/mesher.h"
+#include "../world/world.h"
+#include "hiz_pyramid.h"
+
+// Layout of the chunk pipeline's push constant block, see chunk.vert
+struct ChunkPushConstants
+{
+    float viewProjection[16];
+};
+
+// One entry per chunk slot, read by chunk_cull.comp and, through its origin,
+// as chunk.vert's per-instance attribute. indexCount 0 marks a free slot.
+struct ChunkDrawRecord
+{
+    float origin[3];
+    uint32_t indexCount;
+    int32_t vertexOffset; // first vertex in the page
+    uint32_t page;
+    uint32_t padding[2];
+};
+
+// Layout of chunk_cull.comp's push constant block
+struct ChunkCullPushConstants
+{
+    float viewProjection[16];
+    uint32_t slotCount;
+    uint32_t commandsPerPage;
+    uint32_t compact;
+    uint32_t phase;
+    float pyramidSize[2];
+    uint32_t pyramidLevels;
+    uint32_t pageCapacity;
+};
+
+// Which chunks a cull emits draws for. Occlusion culling runs in two phases:
+// Early draws what was visible last frame, a HiZPyramid is built from that
+// depth, and Late tests every chunk against it, drawing the ones that just
+// became visible and remembering the result for the next Early.
+enum class ChunkCullPhase
+{
+    All,   // frustum culling only
+    Early, // in the frustum and visible last time
+    Late   // in the frustum, not occluded and not drawn by Early
+};
+
+// How chunk draws are issued, best first
+enum class ChunkDrawMode
+{
+    IndirectCount, // GPU culling compacts commands, one vkCmdDrawIndexedIndirectCount per page
+    Indirect,      // GPU culling zeroes culled commands, one multi-draw indirect per page
+    Direct         // CPU culling, one vkCmdDrawIndexed per visible chunk
+};
+
+const char *chunkDrawModeName(ChunkDrawMode mode);
+
+// Owns the geometry of every meshed chunk and records its culling and draws.
+//
+// Vertices live in large shared pages, sub-allocated per mesh, and every mesh
+// is drawn with one shared index buffer holding the mesher's quad pattern, so
+// a draw is just an index count and a vertex offset. Each chunk gets a slot in
+// a ChunkDrawRecord array. Every frame in flight has its own host-visible copy
+// of that array, brought up to date in beginFrame() once the frame's fence has
+// signaled. chunk_cull.comp tests the records against the frustum and writes
+// the draw commands, and recordDraws() issues them without touching chunks on
+// the CPU. With a Hi-Z pyramid set, chunks hidden behind last frame's visible
+// ones are culled too, see ChunkCullPhase. The slot index travels as firstInstance, which selects the chunk
+// origin from the record array bound as an instance-rate vertex buffer.
+//
+// Meshes are uploaded through the TransferUploader. Replaced vertex ranges are
+// kept until every frame that could still be reading them has finished.
+class ChunkRenderer
+{
+public:
+    void init(VulkanContext &vulkan, GpuAllocator &allocator, TransferUploader &uploader,
+              const ShaderRegistry &shaders);
+    void destroy();
+
+    // Vertex input matching ChunkVertex plus the per-instance chunk origin, for the chunk pipeline
+    static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+    static VkPushConstantRange getPushConstantRange();
+
+    // Replaces the chunk's mesh, an empty mesh removes it
+    void uploadMesh(const ChunkCoord &coord, const ChunkMesh &mesh);
+    void removeMesh(const ChunkCoord &coord);
+
+    // Call once per frame after that frame's fence was waited on
+    void beginFrame(uint32_t frame);
+    // Culls on the GPU, outside of any render pass and before recordDraws() of
+    // the same phase. Late must follow Early in the same frame, after the
+    // pyramid was built.
+    void recordCulling(VkCommandBuffer commandBuffer, uint32_t frame, const Mat4 &viewProjection,
+                       ChunkCullPhase phase = ChunkCullPhase::All);
+
+    // Pyramid the Late phase tests against, set again whenever it is recreated.
+    // The device must be idle.
+    void setOcclusionPyramid(const HiZPyramid &pyramid);
+    // Whether culling can run in phases, direct draws are culled on the CPU
+    bool isOcclusionCullingSupported() const { return drawMode != ChunkDrawMode::Direct && occlusionSupported; }
+
+    // How many parts the draws split into for recording on separate threads,
+    // at most maxParts and at least 1
+    uint32_t getDrawPartCount(uint32_t maxParts) const;
+    // Records one part of the draws, with the chunk pipeline already bound.
+    // Different parts may be recorded concurrently into different command
+    // buffers, nothing else may run on the renderer meanwhile. Direct draws
+    // only count towards the visible chunks with countVisible, so a depth
+    // prepass drawing the same chunks again is left out.
+    void recordDraws(VkCommandBuffer commandBuffer, uint32_t frame, VkPipelineLayout layout,
+                     const Mat4 &viewProjection, uint32_t part = 0, uint32_t partCount = 1,
+                     ChunkCullPhase phase = ChunkCullPhase::All, bool countVisible = true);
+
+    ChunkDrawMode getDrawMode() const { return drawMode; }
+    size_t getChunkCount() const { return meshes.size(); }
+    uint64_t getQuadCount() const { return quadCount; }
+    // Chunks that survived culling in the latest frame whose result is known, -1 before the first
+    int64_t getVisibleChunkCount() const { return visibleChunks; }
+    // Chunks in the frustum that occlusion culling skipped in that frame
+    int64_t getOccludedChunkCount() const { return occludedChunks; }
+
+private:
+    static const VkDeviceSize PAGE_SIZE = 32ull * 1024 * 1024;
+    static const VkDeviceSize PAGE_MIN_BLOCK = 4096;
+    static const uint32_t CULL_WORKGROUP_SIZE = 64;
+    // Fewest slots worth a part of their own when drawing directly
+    static const uint32_t MIN_SLOTS_PER_PART = 256;
+    // A 3D checkerboard, the most quads a chunk can produce
+    static const uint32_t MAX_QUADS_PER_CHUNK = Chunk::VOLUME / 2 * 6;
+
+    struct MeshPage
+    {
+        GpuBuffer vertexBuffer;
+        std::unique_ptr<BuddySubAllocator> ranges;
+    };
+
+    struct GpuMesh
+    {
+        uint32_t slot = 0;
+        uint32_t page = 0;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t indexCount = 0;
+    };
+
+    struct RetiredMesh
+    {
+        GpuMesh mesh;
+        uint64_t frame;
+    };
+
+    // Everything one frame in flight culls and draws from
+    struct FrameResources
+    {
+        GpuBuffer records;  // host visible copy of the record array
+        GpuBuffer commands; // commandsPerPage commands for every page, once for Early and once for Late
+        GpuBuffer counts;   // one draw count per page and phase, then the occluded count, host visible
+        // Per slot, whether the last Late phase of this frame slot found the chunk visible
+        GpuBuffer visibility;
+        bool visibilityCleared = false;
+        uint32_t slotCapacity = 0;
+        uint32_t pageCapacity = 0;
+        std::vector<uint32_t> dirtySlots;
+        bool allDirty = true;
+        // Whether counts holds the result of a cull this frame slot submitted
+        bool culled = false;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    VulkanContext *vulkan = nullptr;
+    GpuAllocator *allocator = nullptr;
+    TransferUploader *uploader = nullptr;
+    ChunkDrawMode drawMode = ChunkDrawMode::Direct;
+
+    GpuBuffer quadIndices;
+    std::vector<MeshPage> pages;
+    std::vector<ChunkDrawRecord> records;
+    std::vector<uint32_t> freeSlots;
+    std::vector<FrameResources> frames;
+
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool cullDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    bool occlusionSupported = false;
+    VkExtent2D pyramidExtent = {0, 0};
+    uint32_t pyramidLevels = 0;
+
+    std::unordered_map<ChunkCoord, GpuMesh, ChunkCoordHash> meshes;
+    std::vector<RetiredMesh> retired;
+    uint64_t frameNumber = 0;
+    uint64_t quadCount = 0;
+    int64_t visibleChunks = -1;
+    int64_t occludedChunks = 0;
+    // Direct draws recorded since the last beginFrame(), summed over all parts
+    std::atomic<int64_t> directDraws{0};
+    std::atomic<bool> directRecorded{false};
+
+    void createQuadIndices();
+    void createCullPipeline(const ShaderRegistry &shaders);
+    void ensureFrameCapacity(FrameResources &frame);
+    void destroyFrameBuffers(FrameResources &frame);
+    bool allocateRange(VkDeviceSize size, uint32_t &page, VkDeviceSize &offset);
+    uint32_t allocateSlot();
+    void writeRecord(uint32_t slot, const ChunkDrawRecord &record);
+    void retire(GpuMesh &mesh);
+    void destroyMesh(GpuMesh &mesh);
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../profile/profiler.h"
+#include "cpu_raytracer.h"
+#include "cpu_raytracer_packet.h"
+
+namespace
+{
+    // One lane in plain C++. Each operation matches its SSE/AVX counterpart bit
+    // for bit, including min/max operand order and out-of-range conversions.
+    struct ScalarLanes
+    {
+        typedef float F;
+        typedef int32_t I;
+        static const int WIDTH = 1;
+
+        static F set(float value) { return value; }
+        static F load(const float *values) { return *values; }
+        static F add(F a, F b) { return a + b; }
+        static F sub(F a, F b) { return a - b; }
+        static F mul(F a, F b) { return a * b; }
+        static F div(F a, F b) { return a / b; }
+        static F min(F a, F b) { return a < b ? a : b; }
+        static F max(F a, F b) { return a > b ? a : b; }
+        static I lt(F a, F b) { return a < b ? -1 : 0; }
+        static I gt(F a, F b) { return a > b ? -1 : 0; }
+        static I ge(F a, F b) { return a >= b ? -1 : 0; }
+        static I eq(F a, F b) { return a == b ? -1 : 0; }
+        static F selectf(I mask, F a, F b) { return mask ? a : b; }
+        static F toFloat(I a) { return static_cast<float>(a); }
+
+        static I floorToInt(F a)
+        {
+            float floored = std::floor(a);
+            // cvttps returns INT32_MIN for NaN and anything out of range
+            if (!(floored >= -2147483648.0f && floored < 2147483648.0f))
+            {
+                return INT32_MIN;
+            }
+            return static_cast<int32_t>(floored);
+        }
+
+        static I seti(int32_t value) { return value; }
+        static I addi(I a, I b) { return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+        static I subi(I a, I b) { return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+        static I mullo(I a, I b) { return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); }
+        static I andi(I a, I b) { return a & b; }
+        static I ori(I a, I b) { return a | b; }
+        static I andnot(I a, I b) { return ~a & b; }
+        static I sra(I a, int count) { return a >> count; }
+        static I sll(I a, int count) { return static_cast<int32_t>(static_cast<uint32_t>(a) << count); }
+        static I srlv(I a, I count) { return static_cast<int32_t>(static_cast<uint32_t>(a) >> count); }
+        static I mini(I a, I b) { return std::min(a, b); }
+        static I maxi(I a, I b) { return std::max(a, b); }
+        static I eqi(I a, I b) { return a == b ? -1 : 0; }
+        static I gti(I a, I b) { return a > b ? -1 : 0; }
+        static I select(I mask, I a, I b) { return mask ? a : b; }
+        static bool any(I mask) { return mask != 0; }
+        static void storei(int32_t *out, I a) { *out = a; }
+
+        static I gather(const uint32_t *base, I index, I mask)
+        {
+            return mask ? static_cast<int32_t>(base[index]) : 0;
+        }
+    };
+
+    struct PacketShape
+    {
+        uint32_t width;
+        uint32_t height;
+        TracePacketFunction trace;
+    };
+
+    PacketShape packetShape(SimdLevel level)
+    {
+        switch (level)
+        {
+#ifdef CPU_RAYTRACER_X86
+        case SimdLevel::Avx2:
+            return {4, 2, tracePacketAvx2};
+        case SimdLevel::Sse41:
+            return {2, 2, tracePacketSse41};
+#endif
+        default:
+            return {1, 1, tracePacketScalar};
+        }
+    }
+
+    // Same palette as chunk.vert and raymarch.comp
+    Vec3 materialColor(uint32_t material)
+    {
+        switch (material)
+        {
+        case 1:
+            return Vec3(0.45f, 0.45f, 0.48f); // stone
+        case 2:
+            return Vec3(0.45f, 0.31f, 0.18f); // dirt
+        case 3:
+            return Vec3(0.30f, 0.60f, 0.22f); // grass
+        case 4:
+            return Vec3(1.00f, 0.85f, 0.55f); // lamp
+        }
+        uint32_t h = material * 2654435761u;
+        return Vec3(h & 255u, (h >> 8) & 255u, (h >> 16) & 255u) * (1.0f / 255.0f);
+    }
+
+    // What the GPU path stores: the compute shader writes RGBA8 UNORM and the
+    // blit into the sRGB target encodes each of those 256 levels
+    uint8_t encodeChannel(float linear)
+    {
+        static const std::vector<uint8_t> srgbTable = []
+        {
+            std::vector<uint8_t> table(256);
+            for (int i = 0; i < 256; i++)
+            {
+                double c = i / 255.0;
+                double encoded = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+                table[i] = static_cast<uint8_t>(std::lround(encoded * 255.0));
+            }
+            return table;
+        }();
+
+        float clamped = std::min(std::max(linear, 0.0f), 1.0f);
+        return srgbTable[static_cast<int>(std::lround(clamped * 255.0f))];
+    }
+
+    void writePixel(uint8_t *pixel, const Vec3 &color)
+    {
+        pixel[0] = encodeChannel(color.x);
+        pixel[1] = encodeChannel(color.y);
+        pixel[2] = encodeChannel(color.z);
+        pixel[3] = 255;
+    }
+
+    const Vec3 skyColor(0.55f, 0.70f, 0.90f);
+
+    struct FrameSetup
+    {
+        TraceContext context;
+        PacketShape shape;
+        Mat4 inverseViewProjection;
+        Vec3 cameraPosition;
+        uint32_t width;
+        uint32_t height;
+        uint8_t *rgba;
+    };
+
+    void traceTile(const FrameSetup &frame, uint32_t tileX, uint32_t tileY)
+    {
+        PROFILE_SCOPE("traceTile");
+        const uint32_t maxLanes = 8;
+        alignas(32) float dirX[maxLanes], dirY[maxLanes], dirZ[maxLanes];
+        alignas(32) int32_t material[maxLanes], axis[maxLanes];
+
+        const PacketShape &shape = frame.shape;
+        const Mat4 &inv = frame.inverseViewProjection;
+        const Vec3 lightDirection = normalize(Vec3(0.4f, 1.0f, 0.3f));
+        uint32_t endX = std::min(tileX + CpuRaytracer::TILE_SIZE, frame.width);
+        uint32_t endY = std::min(tileY + CpuRaytracer::TILE_SIZE, frame.height);
+
+        for (uint32_t packetY = tileY; packetY < endY; packetY += shape.height)
+        {
+            for (uint32_t packetX = tileX; packetX < endX; packetX += shape.width)
+            {
+                // Lanes past the image edge repeat the last pixel and are not written
+                for (uint32_t lane = 0; lane < shape.width * shape.height; lane++)
+                {
+                    uint32_t x = std::min(packetX + lane % shape.width, frame.width - 1);
+                    uint32_t y = std::min(packetY + lane / shape.width, frame.height - 1);
+
+                    float ndcX = (static_cast<float>(x) + 0.5f) / static_cast<float>(frame.width) * 2.0f - 1.0f;
+                    float ndcY = (static_cast<float>(y) + 0.5f) / static_cast<float>(frame.height) * 2.0f - 1.0f;
+                    float target[4];
+                    for (int row = 0; row < 4; row++)
+                    {
+                        target[row] = inv.at(row, 0) * ndcX + inv.at(row, 1) * ndcY + inv.at(row, 2) * 0.5f + inv.at(row, 3);
+                    }
+                    Vec3 direction = normalize(Vec3(target[0] / target[3], target[1] / target[3], target[2] / target[3]) -
+                                               frame.cameraPosition);
+                    dirX[lane] = std::fabs(direction.x) < 1e-7f ? 1e-7f : direction.x;
+                    dirY[lane] = std::fabs(direction.y) < 1e-7f ? 1e-7f : direction.y;
+                    dirZ[lane] = std::fabs(direction.z) < 1e-7f ? 1e-7f : direction.z;
+                }
+
+                shape.trace(frame.context, dirX, dirY, dirZ, material, axis);
+
+                for (uint32_t lane = 0; lane < shape.width * shape.height; lane++)
+                {
+                    uint32_t x = packetX + lane % shape.width;
+                    uint32_t y = packetY + lane / shape.width;
+                    if (x >= endX || y >= endY)
+                    {
+                        continue;
+                    }
+
+                    Vec3 color = skyColor;
+                    if (material[lane] != 0)
+                    {
+                        Vec3 normal(0.0f, 1.0f, 0.0f);
+                        if (axis[lane] != AXIS_INSIDE)
+                        {
+                            const float directions[3] = {dirX[lane], dirY[lane], dirZ[lane]};
+                            float component = directions[axis[lane]] > 0.0f ? -1.0f : 1.0f;
+                            normal = Vec3(axis[lane] == 0 ? component : 0.0f, axis[lane] == 1 ? component : 0.0f,
+                                          axis[lane] == 2 ? component : 0.0f);
+                        }
+                        float light = 0.35f + 0.65f * std::max(dot(normal, lightDirection), 0.0f);
+                        color = materialColor(static_cast<uint32_t>(material[lane])) * light;
+                    }
+                    writePixel(frame.rgba + (static_cast<size_t>(y) * frame.width + x) * 4, color);
+                }
+            }
+        }
+    }
+}
+
+void tracePacketScalar(const TraceContext &context, const float *dirX, const float *dirY, const float *dirZ,
+                       int32_t *material, int32_t *axis)
+{
+    tracePacket<ScalarLanes>(context, dirX, dirY, dirZ, material, axis);
+}
+
+void CpuRaytracer::setSimdLevel(SimdLevel level)
+{
+    if (!isSimdLevelSupported(level))
+    {
+        throw std::runtime_error(std::string("cpu raytracer: ") + simdLevelName(level) + " is not supported here!");
+    }
+    simdLevel = level;
+}
+
+CpuRenderStats CpuRaytracer::render(const Mat4 &viewProjection, const Vec3 &cameraPosition, uint32_t width,
+                                    uint32_t height, std::vector<uint8_t> &rgba, JobSystem *jobs) const
+{
+    auto start = std::chrono::steady_clock::now();
+    rgba.resize(static_cast<size_t>(width) * height * 4);
+
+    CpuRenderStats stats;
+    stats.rays = static_cast<uint64_t>(width) * height;
+
+    if (!volume || volume->empty())
+    {
+        for (size_t i = 0; i < stats.rays; i++)
+        {
+            writePixel(&rgba[i * 4], skyColor);
+        }
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+    FrameSetup frame;
+    const ChunkCoord &minChunk = volume->getMinChunk();
+    const ChunkCoord &chunkCount = volume->getChunkCount();
+    const int32_t minVoxel[3] = {minChunk.x * Chunk::SIZE, minChunk.y * Chunk::SIZE, minChunk.z * Chunk::SIZE};
+    const int32_t counts[3] = {chunkCount.x, chunkCount.y, chunkCount.z};
+    const float camera[3] = {cameraPosition.x, cameraPosition.y, cameraPosition.z};
+    for (int a = 0; a < 3; a++)
+    {
+        frame.context.origin[a] = camera[a] - static_cast<float>(minVoxel[a]);
+        frame.context.chunkCount[a] = counts[a];
+        frame.context.volumeSize[a] = counts[a] * Chunk::SIZE;
+    }
+    frame.context.stepLimit = volume->getStepLimit();
+    frame.context.slots = volume->getSlots().data();
+    frame.context.brickMasks = volume->getBrickMasks().data();
+    frame.context.voxelWords = volume->getVoxelWords().data();
+    frame.shape = packetShape(simdLevel);
+    frame.inverseViewProjection = inverse(viewProjection);
+    frame.cameraPosition = cameraPosition;
+    frame.width = width;
+    frame.height = height;
+    frame.rgba = rgba.data();
+
+    if (jobs)
+    {
+        JobCounter counter;
+        for (uint32_t tileY = 0; tileY < height; tileY += TILE_SIZE)
+        {
+            for (uint32_t tileX = 0; tileX < width; tileX += TILE_SIZE)
+            {
+                jobs->submit([&frame, tileX, tileY]
+                             { traceTile(frame, tileX, tileY); },
+                             JobPriority::Critical, &counter);
+            }
+        }
+        jobs->wait(counter);
+        stats.threads = jobs->getWorkerCount() - jobs->getBackgroundWorkerCount() + 1;
+    }
+    else
+    {
+        for (uint32_t tileY = 0; tileY < height; tileY += TILE_SIZE)
+        {
+            for (uint32_t tileX = 0; tileX < width; tileX += TILE_SIZE)
+            {
+                traceTile(frame, tileX, tileY);
+            }
+        }
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
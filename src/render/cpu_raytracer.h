@@ -0,0 +1,49 @@
+#ifndef CPU_RAYTRACER_H
+#define CPU_RAYTRACER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../jobs/job_system.h"
+#include "../math/matrix.h"
+#include "../math/simd.h"
+#include "../world/voxel_volume.h"
+
+struct CpuRenderStats
+{
+    double seconds = 0.0;
+    uint64_t rays = 0;
+    // Threads that traced tiles, the caller included
+    uint32_t threads = 1;
+
+    double megaraysPerSecond() const { return seconds > 0.0 ? rays / seconds / 1e6 : 0.0; }
+    double megaraysPerSecondPerThread() const { return megaraysPerSecond() / threads; }
+};
+
+// CPU reference for the raymarch path. Traces the same VoxelVolume with the
+// same traversal as raymarch.comp, in packets of neighbouring pixels, so its
+// image is what the GPU paths are compared against, and it renders when no
+// Vulkan device is usable. Every SIMD level produces the same bytes.
+class CpuRaytracer
+{
+public:
+    static const uint32_t TILE_SIZE = 32;
+
+    // The volume must outlive the tracer or the next setVolume()
+    void setVolume(const VoxelVolume &volume) { this->volume = &volume; }
+    // Defaults to detectSimdLevel(), unsupported levels throw
+    void setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const { return simdLevel; }
+
+    // Renders width x height RGBA8 pixels, sRGB-encoded like a readback of the
+    // headless targets. Tiles run as Critical jobs when jobs is given, with the
+    // caller helping, otherwise everything runs on the caller.
+    CpuRenderStats render(const Mat4 &viewProjection, const Vec3 &cameraPosition, uint32_t width, uint32_t height,
+                          std::vector<uint8_t> &rgba, JobSystem *jobs = nullptr) const;
+
+private:
+    const VoxelVolume *volume = nullptr;
+    SimdLevel simdLevel = detectSimdLevel();
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include <cstdint>
+
+#include "cpu_raytracer_kernel.h"
+
+#ifdef CPU_RAYTRACER_X86
+
+#include <immintrin.h>
+
+// Built for AVX2 whatever the compiler flags, CpuRaytracer only calls in here
+// after checking the CPU supports it. FMA is left off on purpose, fused
+// multiply-adds would round differently from the other paths.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "cpu_raytracer_packet.h"
+
+namespace
+{
+    // Eight lanes, with hardware gathers and per-lane shifts
+    struct Avx2Lanes
+    {
+        typedef __m256 F;
+        typedef __m256i I;
+        static const int WIDTH = 8;
+
+        static F set(float value) { return _mm256_set1_ps(value); }
+        static F load(const float *values) { return _mm256_loadu_ps(values); }
+        static F add(F a, F b) { return _mm256_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static F div(F a, F b) { return _mm256_div_ps(a, b); }
+        static F min(F a, F b) { return _mm256_min_ps(a, b); }
+        static F max(F a, F b) { return _mm256_max_ps(a, b); }
+        static I lt(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+        static I gt(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+        static I ge(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+        static I eq(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+        static F selectf(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+        static I floorToInt(F a) { return _mm256_cvttps_epi32(_mm256_floor_ps(a)); }
+        static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+
+        static I seti(int32_t value) { return _mm256_set1_epi32(value); }
+        static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+        static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+        static I mullo(I a, I b) { return _mm256_mullo_epi32(a, b); }
+        static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+        static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+        static I andnot(I a, I b) { return _mm256_andnot_si256(a, b); }
+        static I sra(I a, int count) { return _mm256_srai_epi32(a, count); }
+        static I sll(I a, int count) { return _mm256_slli_epi32(a, count); }
+        static I srlv(I a, I count) { return _mm256_srlv_epi32(a, count); }
+        static I mini(I a, I b) { return _mm256_min_epi32(a, b); }
+        static I maxi(I a, I b) { return _mm256_max_epi32(a, b); }
+        static I eqi(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+        static I gti(I a, I b) { return _mm256_cmpgt_epi32(a, b); }
+        static I select(I mask, I a, I b) { return _mm256_blendv_epi8(b, a, mask); }
+        static bool any(I mask) { return _mm256_movemask_epi8(mask) != 0; }
+        static void storei(int32_t *out, I a) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), a); }
+
+        // Masked-off lanes read nothing and come back as zero
+        static I gather(const uint32_t *base, I index, I mask)
+        {
+            return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(base), index,
+                                               mask, 4);
+        }
+    };
+}
+
+void tracePacketAvx2(const TraceContext &context, const float *dirX, const float *dirY, const float *dirZ,
+                     int32_t *material, int32_t *axis)
+{
+    tracePacket<Avx2Lanes>(context, dirX, dirY, dirZ, material, axis);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef CPU_RAYTRACER_KERNEL_H
+#define CPU_RAYTRACER_KERNEL_H
+
+#include <cstdint>
+
+// Entry points of the per-ISA packet tracers behind CpuRaytracer, see
+// cpu_raytracer_packet.h for the traversal itself. Only cpu_raytracer*.cpp
+// include this.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RAYTRACER_X86 1
+#endif
+
+// Volume and camera in the units raymarch.comp works in
+struct TraceContext
+{
+    float origin[3]; // camera position relative to the volume's min corner
+    int32_t chunkCount[3];
+    int32_t volumeSize[3];
+    int32_t stepLimit;
+    const uint32_t *slots;
+    const uint32_t *brickMasks;
+    const uint32_t *voxelWords;
+};
+
+// Axis of the last boundary crossed before the hit, 0-2 for x/y/z. AXIS_INSIDE
+// if the camera is inside the volume and no boundary was crossed yet, which
+// raymarch.comp shades as facing up.
+static const int32_t AXIS_INSIDE = 3;
+
+// Traces one packet of rays, the directions already normalized and with no
+// component below 1e-7 in magnitude. Misses get material 0.
+typedef void (*TracePacketFunction)(const TraceContext &context, const float *dirX, const float *dirY,
+                                    const float *dirZ, int32_t *material, int32_t *axis);
+
+void tracePacketScalar(const TraceContext &context, const float *dirX, const float *dirY, const float *dirZ,
+                       int32_t *material, int32_t *axis);
+#ifdef CPU_RAYTRACER_X86
+void tracePacketSse41(const TraceContext &context, const float *dirX, const float *dirY, const float *dirZ,
+                      int32_t *material, int32_t *axis);
+void tracePacketAvx2(const TraceContext &context, const float *dirX, const float *dirY, const float *dirZ,
+                     int32_t *material, int32_t *axis);
+#endif
+
+#endif
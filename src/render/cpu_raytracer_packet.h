@@ -0,0 +1,132 @@
+#ifndef CPU_RAYTRACER_PACKET_H
+#define CPU_RAYTRACER_PACKET_H
+
+#include "cpu_raytracer_kernel.h"
+
+// Included by each per-ISA translation unit after it switched the target
+// instruction set, so the template below is compiled for that set.
+
+// raymarch.comp's traversal over S::WIDTH lanes. S provides float lanes F,
+// int32 lanes I, and masks as I with all bits set for true. Every float
+// operation is a separate IEEE op in the shader's order, never fused, so all
+// lane widths produce the same bits.
+//
+// Everything here is a template on S, which each translation unit defines for
+// its own instruction set, so no function compiled for AVX2 can be merged into
+// one meant for the scalar path.
+template <typename S>
+void tracePacket(const TraceContext &context, const float *dirX, const float *dirY, const float *dirZ,
+                 int32_t *materialOut, int32_t *axisOut)
+{
+    typedef typename S::F F;
+    typedef typename S::I I;
+
+    const F zero = S::set(0.0f);
+    const I zeroI = S::seti(0);
+    const I one = S::seti(1);
+
+    F origin[3], direction[3], invDirection[3], tNear[3], tFar[3];
+    I volumeSize[3], positive[3];
+    const float *directions[3] = {dirX, dirY, dirZ};
+    for (int a = 0; a < 3; a++)
+    {
+        origin[a] = S::set(context.origin[a]);
+        direction[a] = S::load(directions[a]);
+        invDirection[a] = S::div(S::set(1.0f), direction[a]);
+        volumeSize[a] = S::seti(context.volumeSize[a]);
+        positive[a] = S::gt(direction[a], zero);
+
+        F t0 = S::mul(S::set(-context.origin[a]), invDirection[a]);
+        F t1 = S::mul(S::sub(S::set(static_cast<float>(context.volumeSize[a])), origin[a]), invDirection[a]);
+        tNear[a] = S::min(t0, t1);
+        tFar[a] = S::max(t0, t1);
+    }
+    F tEnter = S::max(S::max(tNear[0], tNear[1]), S::max(tNear[2], zero));
+    F tExit = S::min(S::min(tFar[0], tFar[1]), tFar[2]);
+    I active = S::lt(tEnter, tExit);
+
+    I entryAxis = S::select(S::eq(tNear[1], tEnter), one, S::seti(2));
+    entryAxis = S::select(S::eq(tNear[0], tEnter), zeroI, entryAxis);
+    I axis = S::select(S::gt(tEnter, zero), entryAxis, S::seti(AXIS_INSIDE));
+
+    I voxel[3];
+    for (int a = 0; a < 3; a++)
+    {
+        I start = S::floorToInt(S::add(origin[a], S::mul(direction[a], tEnter)));
+        voxel[a] = S::mini(S::maxi(start, zeroI), S::subi(volumeSize[a], one));
+    }
+
+    const I chunkCountX = S::seti(context.chunkCount[0]);
+    const I chunkCountY = S::seti(context.chunkCount[1]);
+    const I emptySlot = S::seti(-1);
+    I material = zeroI;
+
+    for (int32_t step = 0; step < context.stepLimit && S::any(active); step++)
+    {
+        I chunkIndex = S::addi(S::sra(voxel[0], 5),
+                               S::mullo(chunkCountX, S::addi(S::sra(voxel[1], 5),
+                                                             S::mullo(chunkCountY, S::sra(voxel[2], 5)))));
+        I slot = S::gather(context.slots, chunkIndex, active);
+        I occupied = S::andnot(S::eqi(slot, emptySlot), active);
+
+        I local[3];
+        for (int a = 0; a < 3; a++)
+        {
+            local[a] = S::andi(voxel[a], S::seti(31));
+        }
+        I brickIndex = S::ori(S::sra(local[0], 3),
+                              S::ori(S::sll(S::sra(local[1], 3), 2), S::sll(S::sra(local[2], 3), 4)));
+        I maskWord = S::gather(context.brickMasks, S::addi(S::sll(slot, 1), S::sra(brickIndex, 5)), occupied);
+        I brickBit = S::andi(S::srlv(maskWord, S::andi(brickIndex, S::seti(31))), one);
+        I solidBrick = S::andnot(S::eqi(brickBit, zeroI), occupied);
+
+        I voxelIndex = S::ori(local[0], S::ori(S::sll(local[1], 5), S::sll(local[2], 10)));
+        I word = S::gather(context.voxelWords, S::addi(S::sll(slot, 14), S::sra(voxelIndex, 1)), solidBrick);
+        I voxelMaterial = S::andi(S::srlv(word, S::sll(S::andi(voxelIndex, one), 4)), S::seti(0xFFFF));
+        I hit = S::andnot(S::eqi(voxelMaterial, zeroI), solidBrick);
+        material = S::select(hit, voxelMaterial, material);
+        active = S::andnot(hit, active);
+
+        // Leave the current cell through its nearest face
+        I cellSize = S::select(solidBrick, one, S::select(occupied, S::seti(8), S::seti(32)));
+        I cellMin[3], cellMax[3];
+        F tCell[3];
+        for (int a = 0; a < 3; a++)
+        {
+            cellMin[a] = S::andnot(S::subi(cellSize, one), voxel[a]);
+            cellMax[a] = S::addi(cellMin[a], cellSize);
+            F bound = S::toFloat(S::select(positive[a], cellMax[a], cellMin[a]));
+            tCell[a] = S::mul(S::sub(bound, origin[a]), invDirection[a]);
+        }
+        I xFirst = S::lt(tCell[0], tCell[1]);
+        I exitAxis = S::select(xFirst, S::select(S::lt(tCell[0], tCell[2]), zeroI, S::seti(2)),
+                               S::select(S::lt(tCell[1], tCell[2]), one, S::seti(2)));
+        F t = S::selectf(S::eqi(exitAxis, zeroI), tCell[0], S::selectf(S::eqi(exitAxis, one), tCell[1], tCell[2]));
+        active = S::andnot(S::ge(t, tExit), active);
+
+        // The exit axis steps explicitly, the others are clamped to the cell
+        I next[3];
+        I inside = active;
+        for (int a = 0; a < 3; a++)
+        {
+            I clamped = S::floorToInt(S::add(origin[a], S::mul(direction[a], t)));
+            clamped = S::mini(S::maxi(clamped, cellMin[a]), S::subi(cellMax[a], one));
+            I stepped = S::select(positive[a], cellMax[a], S::subi(cellMin[a], one));
+            next[a] = S::select(S::eqi(exitAxis, S::seti(a)), stepped, clamped);
+            inside = S::andnot(S::gti(zeroI, next[a]), inside);
+            inside = S::andi(S::gti(volumeSize[a], next[a]), inside);
+        }
+        active = inside;
+
+        for (int a = 0; a < 3; a++)
+        {
+            voxel[a] = S::select(active, next[a], voxel[a]);
+        }
+        axis = S::select(active, exitAxis, axis);
+    }
+
+    S::storei(materialOut, material);
+    S::storei(axisOut, axis);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include <cstdint>
+
+#include "cpu_raytracer_kernel.h"
+
+#ifdef CPU_RAYTRACER_X86
+
+#include <immintrin.h>
+
+// Built for SSE4.1 whatever the compiler flags, CpuRaytracer only calls in
+// here after checking the CPU supports it
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#include "cpu_raytracer_packet.h"
+
+namespace
+{
+    // Four lanes. SSE4.1 has no gathers or per-lane shifts, those go through memory.
+    struct Sse41Lanes
+    {
+        typedef __m128 F;
+        typedef __m128i I;
+        static const int WIDTH = 4;
+
+        static F set(float value) { return _mm_set1_ps(value); }
+        static F load(const float *values) { return _mm_loadu_ps(values); }
+        static F add(F a, F b) { return _mm_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static F div(F a, F b) { return _mm_div_ps(a, b); }
+        static F min(F a, F b) { return _mm_min_ps(a, b); }
+        static F max(F a, F b) { return _mm_max_ps(a, b); }
+        static I lt(F a, F b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+        static I gt(F a, F b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+        static I ge(F a, F b) { return _mm_castps_si128(_mm_cmpge_ps(a, b)); }
+        static I eq(F a, F b) { return _mm_castps_si128(_mm_cmpeq_ps(a, b)); }
+        static F selectf(I mask, F a, F b) { return _mm_blendv_ps(b, a, _mm_castsi128_ps(mask)); }
+        static I floorToInt(F a) { return _mm_cvttps_epi32(_mm_floor_ps(a)); }
+        static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+
+        static I seti(int32_t value) { return _mm_set1_epi32(value); }
+        static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+        static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+        static I mullo(I a, I b) { return _mm_mullo_epi32(a, b); }
+        static I andi(I a, I b) { return _mm_and_si128(a, b); }
+        static I ori(I a, I b) { return _mm_or_si128(a, b); }
+        static I andnot(I a, I b) { return _mm_andnot_si128(a, b); }
+        static I sra(I a, int count) { return _mm_srai_epi32(a, count); }
+        static I sll(I a, int count) { return _mm_slli_epi32(a, count); }
+        static I mini(I a, I b) { return _mm_min_epi32(a, b); }
+        static I maxi(I a, I b) { return _mm_max_epi32(a, b); }
+        static I eqi(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+        static I gti(I a, I b) { return _mm_cmpgt_epi32(a, b); }
+        static I select(I mask, I a, I b) { return _mm_blendv_epi8(b, a, mask); }
+        static bool any(I mask) { return _mm_movemask_epi8(mask) != 0; }
+        static void storei(int32_t *out, I a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(out), a); }
+
+        static I srlv(I a, I count)
+        {
+            alignas(16) uint32_t values[WIDTH];
+            alignas(16) uint32_t counts[WIDTH];
+            _mm_store_si128(reinterpret_cast<__m128i *>(values), a);
+            _mm_store_si128(reinterpret_cast<__m128i *>(counts), count);
+            for (int i = 0; i < WIDTH; i++)
+            {
+                values[i] >>= counts[i];
+            }
+            return _mm_load_si128(reinterpret_cast<const __m128i *>(values));
+        }
+
+        // Masked-off lanes read nothing and come back as zero
+        static I gather(const uint32_t *base, I index, I mask)
+        {
+            alignas(16) int32_t indices[WIDTH];
+            alignas(16) int32_t enabled[WIDTH];
+            alignas(16) uint32_t values[WIDTH];
+            _mm_store_si128(reinterpret_cast<__m128i *>(indices), index);
+            _mm_store_si128(reinterpret_cast<__m128i *>(enabled), mask);
+            for (int i = 0; i < WIDTH; i++)
+            {
+                values[i] = enabled[i] ? base[indices[i]] : 0;
+            }
+            return _mm_load_si128(reinterpret_cast<const __m128i *>(values));
+        }
+    };
+}
+
+void tracePacketSse41(const TraceContext &context, const float *dirX, const float *dirY, const float *dirZ,
+                      int32_t *material, int32_t *axis)
+{
+    tracePacket<Sse41Lanes>(context, dirX, dirY, dirZ, material, axis);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,369 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../vulkan/vulkan.h"
+#include "hiz_pyramid.h"
+
+// Largest power of two not above value
+static uint32_t previousPowerOfTwo(uint32_t value)
+{
+    uint32_t power = 1;
+    while (power * 2 <= value)
+    {
+        power *= 2;
+    }
+    return power;
+}
+
+static bool hasStencil(VkFormat format)
+{
+    return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+void HiZPyramid::init(VulkanContext &vulkanContext, GpuAllocator &gpuAllocator, const ShaderRegistry &shaders,
+                      VkFormat format)
+{
+    vulkan = &vulkanContext;
+    allocator = &gpuAllocator;
+    depthFormat = format;
+
+    VkFormatProperties depthProperties;
+    vkGetPhysicalDeviceFormatProperties(vulkan->physicalDevice, depthFormat, &depthProperties);
+    supported = (depthProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+
+    createSamplers();
+    createPipeline(shaders);
+}
+
+void HiZPyramid::destroy()
+{
+    if (!vulkan)
+    {
+        return;
+    }
+
+    destroyTarget();
+
+    vkDestroyPipeline(vulkan->device, pipeline, nullptr);
+    vkDestroyPipelineLayout(vulkan->device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(vulkan->device, descriptorSetLayout, nullptr);
+    vkDestroySampler(vulkan->device, sampler, nullptr);
+    vkDestroySampler(vulkan->device, depthSampler, nullptr);
+    pipeline = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+    descriptorSetLayout = VK_NULL_HANDLE;
+    sampler = VK_NULL_HANDLE;
+    depthSampler = VK_NULL_HANDLE;
+    vulkan = nullptr;
+}
+
+// Nearest and clamped, texels are never blended across occluders. The culling
+// shader picks its mip level itself, the reduction only reads level 0 of the depth.
+void HiZPyramid::createSamplers()
+{
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(vulkan->device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create hi-z sampler!");
+    }
+
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(vulkan->device, &samplerInfo, nullptr, &depthSampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create hi-z depth sampler!");
+    }
+}
+
+void HiZPyramid::createPipeline(const ShaderRegistry &shaders)
+{
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    for (uint32_t i = 1; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(vulkan->device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create hi-z descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(HiZReducePushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(vulkan->device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create hi-z pipeline layout!");
+    }
+
+    VkShaderModule shaderModule = shaders.createShaderModule(vulkan->device, ShaderId::HizReduceComp);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(vulkan->device, vulkan->pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(vulkan->device, shaderModule, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create hi-z pipeline!");
+    }
+}
+
+VkExtent2D HiZPyramid::levelExtent(uint32_t level) const
+{
+    return {std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u)};
+}
+
+void HiZPyramid::createTarget(VkExtent2D targetDepthExtent, VkImageView depthView)
+{
+    depthExtent = targetDepthExtent;
+    extent = {previousPowerOfTwo(depthExtent.width), previousPowerOfTwo(depthExtent.height)};
+    levelCount = 1;
+    while (std::max(extent.width, extent.height) >> levelCount)
+    {
+        levelCount++;
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image = allocator->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    if (vkCreateImageView(vulkan->device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create hi-z view!");
+    }
+
+    // Storage images bind a single level
+    levelViews.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        if (vkCreateImageView(vulkan->device, &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create hi-z level view!");
+        }
+    }
+
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = levelCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = 2 * levelCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = levelCount;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(vulkan->device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create hi-z descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(levelCount, descriptorSetLayout);
+    levelSets.resize(levelCount);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = levelCount;
+    allocInfo.pSetLayouts = setLayouts.data();
+    if (vkAllocateDescriptorSets(vulkan->device, &allocInfo, levelSets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate hi-z descriptor sets!");
+    }
+
+    writeDescriptors(depthView);
+}
+
+void HiZPyramid::destroyTarget()
+{
+    if (descriptorPool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(vulkan->device, descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+    levelSets.clear();
+    for (VkImageView levelView : levelViews)
+    {
+        vkDestroyImageView(vulkan->device, levelView, nullptr);
+    }
+    levelViews.clear();
+    if (view != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(vulkan->device, view, nullptr);
+        view = VK_NULL_HANDLE;
+    }
+    if (image.image != VK_NULL_HANDLE)
+    {
+        allocator->destroyImage(image);
+    }
+    levelCount = 0;
+}
+
+// Level n reads level n - 1 and writes level n. Level 0 reads the depth buffer
+// instead, its source binding only has to be valid.
+void HiZPyramid::writeDescriptors(VkImageView depthView)
+{
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        VkDescriptorImageInfo imageInfos[3] = {};
+        imageInfos[0].sampler = depthSampler;
+        imageInfos[0].imageView = depthView;
+        imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[1].imageView = levelViews[level == 0 ? 0 : level - 1];
+        imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageInfos[2].imageView = levelViews[level];
+        imageInfos[2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[3] = {};
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = levelSets[level];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo = &imageInfos[i];
+        }
+        vkUpdateDescriptorSets(vulkan->device, 3, writes, 0, nullptr);
+    }
+}
+
+void HiZPyramid::recordBuild(VkCommandBuffer commandBuffer, VkImage depthImage)
+{
+    if (!supported || levelCount == 0)
+    {
+        return;
+    }
+
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (hasStencil(depthFormat))
+    {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    // The previous build's contents are not needed, its readers are done by
+    // the time compute runs again in queue order
+    VkImageMemoryBarrier toRead[2] = {};
+    for (VkImageMemoryBarrier &barrier : toRead)
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+    toRead[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    toRead[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    toRead[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    toRead[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    toRead[0].image = depthImage;
+    toRead[0].subresourceRange = {depthAspect, 0, 1, 0, 1};
+    toRead[1].srcAccessMask = 0;
+    toRead[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toRead[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toRead[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toRead[1].image = image.image;
+    toRead[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, toRead);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        if (level > 0)
+        {
+            VkMemoryBarrier levelBarrier{};
+            levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        VkExtent2D source = level == 0 ? depthExtent : levelExtent(level - 1);
+        VkExtent2D destination = levelExtent(level);
+        HiZReducePushConstants constants{};
+        constants.sourceSize[0] = static_cast<int32_t>(source.width);
+        constants.sourceSize[1] = static_cast<int32_t>(source.height);
+        constants.destinationSize[0] = static_cast<int32_t>(destination.width);
+        constants.destinationSize[1] = static_cast<int32_t>(destination.height);
+        constants.level = level;
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &levelSets[level],
+                                0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (destination.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                      (destination.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+    }
+
+    // Depth goes back to the render passes that load it, the pyramid to the culling shader
+    VkImageMemoryBarrier toDepth = toRead[0];
+    toDepth.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    toDepth.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    toDepth.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    toDepth.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toDepth);
+
+    VkMemoryBarrier pyramidBarrier{};
+    pyramidBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    pyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &pyramidBarrier, 0, nullptr, 0, nullptr);
+}
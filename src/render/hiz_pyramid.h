@@ -0,0 +1,82 @@
+#ifndef HIZ_PYRAMID_H
+#define HIZ_PYRAMID_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+#include "../shaders/shader_registry.h"
+#include "../vulkan/allocator.h"
+
+// Layout of hiz_reduce.comp's push constant block
+struct HiZReducePushConstants
+{
+    int32_t sourceSize[2];
+    int32_t destinationSize[2];
+    uint32_t level;
+};
+
+// Hierarchical depth for occlusion culling. hiz_reduce.comp reduces the depth
+// buffer into an R32F mip chain whose texels hold the farthest depth of the
+// pixels they cover, so a box whose nearest depth is farther than a few texels
+// of the right level is hidden behind what was drawn.
+//
+// Level 0 is the largest power of two that fits into the depth buffer in each
+// dimension, every further level halves it, so a level's texels cover exactly
+// four of the level below. The image stays in GENERAL layout, written as a
+// storage image and sampled with a nearest, clamped sampler.
+class HiZPyramid
+{
+public:
+    static const uint32_t WORKGROUP_SIZE = 8;
+
+    void init(VulkanContext &vulkan, GpuAllocator &allocator, const ShaderRegistry &shaders, VkFormat depthFormat);
+    void destroy();
+
+    // Whether the depth buffer can be sampled, false leaves recordBuild() a no-op.
+    // The pyramid is created either way, so it can always be bound.
+    bool isSupported() const { return supported; }
+
+    // Pyramid for a depth buffer of depthExtent, read through depthView, which
+    // must stay alive until destroyTarget(). The device must be idle.
+    void createTarget(VkExtent2D depthExtent, VkImageView depthView);
+    void destroyTarget();
+
+    // Reduces depthImage into the pyramid, outside of any render pass. The
+    // depth image must be in DEPTH_STENCIL_ATTACHMENT_OPTIMAL with its writes
+    // done, and is left there. The pyramid is readable by compute afterwards.
+    void recordBuild(VkCommandBuffer commandBuffer, VkImage depthImage);
+
+    VkImageView getView() const { return view; }
+    VkSampler getSampler() const { return sampler; }
+    VkExtent2D getExtent() const { return extent; }
+    uint32_t getLevelCount() const { return levelCount; }
+
+private:
+    VulkanContext *vulkan = nullptr;
+    GpuAllocator *allocator = nullptr;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    bool supported = false;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkSampler depthSampler = VK_NULL_HANDLE;
+
+    GpuImage image;
+    VkImageView view = VK_NULL_HANDLE;
+    std::vector<VkImageView> levelViews;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> levelSets;
+    VkExtent2D depthExtent = {0, 0};
+    VkExtent2D extent = {0, 0};
+    uint32_t levelCount = 0;
+
+    void createPipeline(const ShaderRegistry &shaders);
+    void createSamplers();
+    void writeDescriptors(VkImageView depthView);
+    VkExtent2D levelExtent(uint32_t level) const;
+};
+
+#endif
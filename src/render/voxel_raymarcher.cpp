@@ -0,0 +1,463 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../profile/profiler.h"
+#include "../vulkan/vulkan.h"
+#include "voxel_raymarcher.h"
+
+void VoxelRaymarcher::init(VulkanContext &vulkanContext, GpuAllocator &gpuAllocator, TransferUploader &transferUploader,
+                           const ShaderRegistry &shaders)
+{
+    vulkan = &vulkanContext;
+    allocator = &gpuAllocator;
+    uploader = &transferUploader;
+
+    VkFormatProperties storageProperties;
+    vkGetPhysicalDeviceFormatProperties(vulkan->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &storageProperties);
+    VkFormatProperties swapChainProperties;
+    vkGetPhysicalDeviceFormatProperties(vulkan->physicalDevice, vulkan->swapChainImageFormat, &swapChainProperties);
+
+    supported = (storageProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) &&
+                (storageProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) &&
+                (swapChainProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) &&
+                (vulkan->swapChainImageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    if (!supported)
+    {
+        return;
+    }
+
+    createPipeline(shaders);
+    createTarget(vulkan->swapChainExtent);
+}
+
+void VoxelRaymarcher::destroy()
+{
+    if (!vulkan)
+    {
+        return;
+    }
+
+    destroyVolume();
+    destroyTarget();
+
+    vkDestroyPipeline(vulkan->device, pipeline, nullptr);
+    vkDestroyPipelineLayout(vulkan->device, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(vulkan->device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(vulkan->device, descriptorSetLayout, nullptr);
+    pipeline = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSetLayout = VK_NULL_HANDLE;
+    vulkan = nullptr;
+}
+
+void VoxelRaymarcher::createPipeline(const ShaderRegistry &shaders)
+{
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    for (uint32_t i = 1; i < 4; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(vulkan->device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create raymarch descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 3;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(vulkan->device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create raymarch descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkAllocateDescriptorSets(vulkan->device, &allocInfo, &descriptorSet) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate raymarch descriptor set!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(RaymarchPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(vulkan->device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create raymarch pipeline layout!");
+    }
+
+    VkShaderModule shaderModule = shaders.createShaderModule(vulkan->device, ShaderId::RaymarchComp);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(vulkan->device, vulkan->pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(vulkan->device, shaderModule, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create raymarch pipeline!");
+    }
+}
+
+void VoxelRaymarcher::createTarget(VkExtent2D extent)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    target = allocator->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    targetExtent = extent;
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = target.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (vkCreateImageView(vulkan->device, &viewInfo, nullptr, &targetView) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create raymarch target view!");
+    }
+
+    if (hasVolume())
+    {
+        writeDescriptors();
+    }
+}
+
+void VoxelRaymarcher::destroyTarget()
+{
+    if (targetView != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(vulkan->device, targetView, nullptr);
+        targetView = VK_NULL_HANDLE;
+    }
+    if (target.image != VK_NULL_HANDLE)
+    {
+        allocator->destroyImage(target);
+    }
+}
+
+void VoxelRaymarcher::destroyVolume()
+{
+    if (chunkSlots.buffer != VK_NULL_HANDLE)
+    {
+        allocator->destroyBuffer(chunkSlots);
+        allocator->destroyBuffer(brickMasks);
+        allocator->destroyBuffer(voxels);
+    }
+    slotCount = 0;
+    volumeSlots.clear();
+    patches.clear();
+}
+
+void VoxelRaymarcher::uploadVolume(const VoxelVolume &volume)
+{
+    if (!supported)
+    {
+        return;
+    }
+
+    if (hasVolume())
+    {
+        // The previous volume may still be read by frames in flight
+        vkDeviceWaitIdle(vulkan->device);
+        destroyVolume();
+    }
+    if (volume.empty())
+    {
+        return;
+    }
+
+    volumeMin = volume.getMinChunk();
+    volumeChunks = volume.getChunkCount();
+    slotCount = volume.getSlotCount();
+    stepLimit = volume.getStepLimit();
+    volumeSlots = volume.getSlots();
+
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    const std::vector<uint32_t> *sources[3] = {&volume.getSlots(), &volume.getBrickMasks(), &volume.getVoxelWords()};
+    GpuBuffer *buffers[3] = {&chunkSlots, &brickMasks, &voxels};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        VkDeviceSize size = sources[i]->size() * sizeof(uint32_t);
+        *buffers[i] = allocator->createBuffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        uploader->upload(*buffers[i], 0, sources[i]->data(), size, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    writeDescriptors();
+}
+
+void VoxelRaymarcher::writeDescriptors()
+{
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = targetView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorBufferInfo bufferInfos[3] = {};
+    const GpuBuffer *buffers[3] = {&chunkSlots, &brickMasks, &voxels};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bufferInfos[i].buffer = buffers[i]->buffer;
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+    }
+
+    VkWriteDescriptorSet writes[4] = {};
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        if (i == 0)
+        {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo = &imageInfo;
+        }
+        else
+        {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i - 1];
+        }
+    }
+
+    vkUpdateDescriptorSets(vulkan->device, 4, writes, 0, nullptr);
+}
+
+bool VoxelRaymarcher::updateChunk(const ChunkCoord &coord, const Chunk *chunk)
+{
+    if (!hasVolume())
+    {
+        return false;
+    }
+
+    bool solid = chunk && !(chunk->isUniform() && chunk->get(0) == 0);
+    int32_t x = coord.x - volumeMin.x, y = coord.y - volumeMin.y, z = coord.z - volumeMin.z;
+    if (x < 0 || y < 0 || z < 0 || x >= volumeChunks.x || y >= volumeChunks.y || z >= volumeChunks.z)
+    {
+        return !solid;
+    }
+    uint32_t slot = volumeSlots[x + static_cast<size_t>(volumeChunks.x) * (y + static_cast<size_t>(volumeChunks.y) * z)];
+    if (slot == VoxelVolume::EMPTY_SLOT)
+    {
+        return !solid;
+    }
+
+    // A chunk carved down to air keeps its slot, all zero
+    SlotPatch *patch = nullptr;
+    for (SlotPatch &pending : patches)
+    {
+        if (pending.slot == slot)
+        {
+            patch = &pending;
+        }
+    }
+    if (!patch)
+    {
+        patches.push_back({slot, std::vector<uint32_t>(VoxelVolume::WORDS_PER_SLOT), {0, 0}});
+        patch = &patches.back();
+    }
+    if (solid)
+    {
+        VoxelVolume::encodeChunk(*chunk, patch->words.data(), patch->masks);
+    }
+    else
+    {
+        std::fill(patch->words.begin(), patch->words.end(), 0u);
+        patch->masks[0] = 0;
+        patch->masks[1] = 0;
+    }
+    return true;
+}
+
+// TransferUploader ranges must not be in use by the GPU, but earlier frames
+// may still be tracing the volume. The patches are written by the frame's own
+// command buffer instead, ordered after the previous frames' reads.
+void VoxelRaymarcher::recordPatches(VkCommandBuffer commandBuffer)
+{
+    if (patches.empty())
+    {
+        return;
+    }
+    PROFILE_SCOPE("raymarchPatches");
+
+    VkMemoryBarrier toTransfer{};
+    toTransfer.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    toTransfer.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &toTransfer, 0, nullptr, 0, nullptr);
+
+    // vkCmdUpdateBuffer writes at most 65536 bytes at a time
+    const VkDeviceSize maxUpdateBytes = 65536;
+    const VkDeviceSize slotBytes = VoxelVolume::WORDS_PER_SLOT * sizeof(uint32_t);
+    for (const SlotPatch &patch : patches)
+    {
+        const uint8_t *source = reinterpret_cast<const uint8_t *>(patch.words.data());
+        for (VkDeviceSize offset = 0; offset < slotBytes; offset += maxUpdateBytes)
+        {
+            VkDeviceSize size = std::min(maxUpdateBytes, slotBytes - offset);
+            vkCmdUpdateBuffer(commandBuffer, voxels.buffer, patch.slot * slotBytes + offset, size, source + offset);
+        }
+        vkCmdUpdateBuffer(commandBuffer, brickMasks.buffer, patch.slot * sizeof(patch.masks), sizeof(patch.masks),
+                          patch.masks);
+    }
+    patches.clear();
+
+    VkMemoryBarrier toCompute{};
+    toCompute.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    toCompute.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toCompute.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &toCompute, 0, nullptr, 0, nullptr);
+}
+
+static VkImageMemoryBarrier imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                         VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    return barrier;
+}
+
+// Without a volume the frame is just sky
+void VoxelRaymarcher::recordClear(VkCommandBuffer commandBuffer, VkImage dstImage, VkImageLayout finalLayout)
+{
+    VkImageMemoryBarrier toTransfer = imageBarrier(dstImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                   0, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkClearColorValue sky = {{0.55f, 0.70f, 0.90f, 1.0f}};
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdClearColorImage(commandBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &sky, 1, &range);
+
+    VkImageMemoryBarrier toFinal = imageBarrier(dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout,
+                                                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toFinal);
+}
+
+void VoxelRaymarcher::recordFrame(VkCommandBuffer commandBuffer, VkImage dstImage, VkImageLayout finalLayout,
+                                  const Mat4 &viewProjection, const Vec3 &cameraPosition)
+{
+    if (!hasVolume())
+    {
+        recordClear(commandBuffer, dstImage, finalLayout);
+        return;
+    }
+    recordPatches(commandBuffer);
+
+    // The previous frame's blit may still be reading the target, its contents are not needed
+    VkImageMemoryBarrier toGeneral = imageBarrier(target.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                                                  0, VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toGeneral);
+
+    RaymarchPushConstants constants{};
+    Mat4 inverseViewProjection = inverse(viewProjection);
+    memcpy(constants.inverseViewProjection, inverseViewProjection.m, sizeof(constants.inverseViewProjection));
+    constants.cameraPosition[0] = cameraPosition.x;
+    constants.cameraPosition[1] = cameraPosition.y;
+    constants.cameraPosition[2] = cameraPosition.z;
+    constants.volumeMin[0] = volumeMin.x * Chunk::SIZE;
+    constants.volumeMin[1] = volumeMin.y * Chunk::SIZE;
+    constants.volumeMin[2] = volumeMin.z * Chunk::SIZE;
+    constants.volumeChunks[0] = volumeChunks.x;
+    constants.volumeChunks[1] = volumeChunks.y;
+    constants.volumeChunks[2] = volumeChunks.z;
+    constants.volumeChunks[3] = stepLimit;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, (targetExtent.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                  (targetExtent.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+    // The swapchain barrier waits on COLOR_ATTACHMENT_OUTPUT, the stage the acquire semaphore unblocks
+    VkImageMemoryBarrier toBlit[2] = {
+        imageBarrier(target.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+        imageBarrier(dstImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     0, VK_ACCESS_TRANSFER_WRITE_BIT),
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, toBlit);
+
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {static_cast<int32_t>(targetExtent.width), static_cast<int32_t>(targetExtent.height), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {static_cast<int32_t>(vulkan->swapChainExtent.width),
+                          static_cast<int32_t>(vulkan->swapChainExtent.height), 1};
+    vkCmdBlitImage(commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstImage,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+
+    VkImageMemoryBarrier toFinal = imageBarrier(dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout,
+                                                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toFinal);
+}
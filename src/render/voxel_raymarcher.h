@@ -0,0 +1,102 @@
+#ifndef VOXEL_RAYMARCHER_H
+#define VOXEL_RAYMARCHER_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+#include "../math/matrix.h"
+#include "../shaders/shader_registry.h"
+#include "../vulkan/allocator.h"
+#include "../vulkan/transfer.h"
+#include "../world/voxel_volume.h"
+
+// Layout of raymarch.comp's push constant block
+struct RaymarchPushConstants
+{
+    float inverseViewProjection[16];
+    float cameraPosition[4];
+    int32_t volumeMin[4];
+    int32_t volumeChunks[4]; // w is the step limit
+};
+
+// Compute render path. A VoxelVolume is copied into storage buffers,
+// raymarch.comp traces one primary ray per pixel through it into a storage
+// image, and the image is blitted to the swapchain image. The blit converts to
+// the swapchain format, so the storage image can stay RGBA8 UNORM, which every
+// implementation (lavapipe included) supports for storage.
+class VoxelRaymarcher
+{
+public:
+    static const uint32_t WORKGROUP_SIZE = 8;
+
+    void init(VulkanContext &vulkan, GpuAllocator &allocator, TransferUploader &uploader,
+              const ShaderRegistry &shaders);
+    void destroy();
+
+    // Whether the swapchain images can be blitted to, false disables this path
+    bool isSupported() const { return supported; }
+
+    // Storage image matching the swapchain extent
+    void createTarget(VkExtent2D extent);
+    void destroyTarget();
+
+    // Replaces the GPU copy of the volume. Waits for the device if a previous
+    // volume has to be freed.
+    void uploadVolume(const VoxelVolume &volume);
+    bool hasVolume() const { return slotCount > 0; }
+    VkDeviceSize getVolumeBytes() const { return chunkSlots.size + brickMasks.size + voxels.size; }
+    // Rewrites the voxels of the chunk at coord, null for air, from the next
+    // recordFrame() on. False if the chunk has no slot in the uploaded volume
+    // but needs one, the volume has to be rebuilt and uploaded then.
+    bool updateChunk(const ChunkCoord &coord, const Chunk *chunk);
+
+    // Traces the frame and blits it into dstImage, whose previous contents are
+    // discarded. The image must be acquired before COLOR_ATTACHMENT_OUTPUT and
+    // is left in finalLayout.
+    void recordFrame(VkCommandBuffer commandBuffer, VkImage dstImage, VkImageLayout finalLayout,
+                     const Mat4 &viewProjection, const Vec3 &cameraPosition);
+
+private:
+    // New contents of one slot, recorded into the next frame
+    struct SlotPatch
+    {
+        uint32_t slot;
+        std::vector<uint32_t> words;
+        uint32_t masks[2];
+    };
+
+    VulkanContext *vulkan = nullptr;
+    GpuAllocator *allocator = nullptr;
+    TransferUploader *uploader = nullptr;
+    bool supported = false;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    GpuImage target;
+    VkImageView targetView = VK_NULL_HANDLE;
+    VkExtent2D targetExtent = {0, 0};
+
+    GpuBuffer chunkSlots;
+    GpuBuffer brickMasks;
+    GpuBuffer voxels;
+    ChunkCoord volumeMin;
+    ChunkCoord volumeChunks;
+    uint32_t slotCount = 0;
+    int32_t stepLimit = 0;
+    // CPU copy of chunkSlots, to find the slot of an edited chunk
+    std::vector<uint32_t> volumeSlots;
+    std::vector<SlotPatch> patches;
+
+    void createPipeline(const ShaderRegistry &shaders);
+    void destroyVolume();
+    void writeDescriptors();
+    void recordClear(VkCommandBuffer commandBuffer, VkImage dstImage, VkImageLayout finalLayout);
+    void recordPatches(VkCommandBuffer commandBuffer);
+};
+
+#endif
@@ -0,0 +1,22 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in vec2 fragLight;
+
+layout(location = 0) out vec4 outColor;
+
+const vec3 blockLightColor = vec3(1.0, 0.8, 0.55);
+// Light that reaches even fully dark faces, so caves are not pitch black
+const float ambient = 0.06;
+
+// Each level a fifth dimmer than the one above, like light falling off with distance
+float levelBrightness(float level) {
+    return level > 0.0 ? pow(0.8, 15.0 * (1.0 - level)) : 0.0;
+}
+
+void main() {
+    float sky = levelBrightness(fragLight.x);
+    vec3 block = blockLightColor * levelBrightness(fragLight.y);
+    vec3 light = max(vec3(sky), block) + ambient;
+    outColor = vec4(fragColor * min(light, vec3(1.0)), 1.0);
+}
@@ -0,0 +1,54 @@
+#version 450
+
+layout(push_constant) uniform PushConstants {
+    mat4 viewProjection;
+} pc;
+
+// See ChunkVertex in src/world/mesher.h
+layout(location = 0) in uint inPosition;
+layout(location = 1) in uint inMaterial;
+// Per instance, from the chunk's ChunkDrawRecord selected by firstInstance
+layout(location = 2) in vec3 inChunkOrigin;
+
+layout(location = 0) out vec3 fragColor;
+// Sky and block light in front of the face, 0 to 1, see src/world/light.h
+layout(location = 1) flat out vec2 fragLight;
+
+// The depth prepass runs this shader too, and the color pass tests against its depth
+invariant gl_Position;
+
+const vec3 faceNormals[6] = vec3[](
+    vec3(-1.0, 0.0, 0.0),
+    vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, -1.0),
+    vec3(0.0, 0.0, 1.0)
+);
+
+vec3 materialColor(uint material) {
+    switch (material) {
+    case 1u: return vec3(0.45, 0.45, 0.48); // stone
+    case 2u: return vec3(0.45, 0.31, 0.18); // dirt
+    case 3u: return vec3(0.30, 0.60, 0.22); // grass
+    case 4u: return vec3(1.00, 0.85, 0.55); // lamp
+    }
+    // Anything else gets a stable color derived from its id
+    uint h = material * 2654435761u;
+    return vec3(h & 255u, (h >> 8) & 255u, (h >> 16) & 255u) / 255.0;
+}
+
+void main() {
+    vec3 local = vec3(inPosition & 63u, (inPosition >> 6) & 63u, (inPosition >> 12) & 63u);
+    uint face = (inPosition >> 18) & 7u;
+
+    uint material = inMaterial & 0xFFFFu;
+    uint light = (inMaterial >> 16) & 0xFFu;
+
+    gl_Position = pc.viewProjection * vec4(inChunkOrigin + local, 1.0);
+
+    vec3 lightDirection = normalize(vec3(0.4, 1.0, 0.3));
+    float sun = 0.35 + 0.65 * max(dot(faceNormals[face], lightDirection), 0.0);
+    fragColor = materialColor(material) * sun;
+    fragLight = vec2(float(light >> 4), float(light & 15u)) / 15.0;
+}
@@ -0,0 +1,100 @@
+#include <vulkan/vulkan.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "shader_registry.h"
+
+alignas(16) static constexpr uint32_t chunkVertSpirv[] = {
+#include "shaders/chunk.vert.inc"
+};
+
+alignas(16) static constexpr uint32_t chunkFragSpirv[] = {
+#include "shaders/chunk.frag.inc"
+};
+
+alignas(16) static constexpr uint32_t chunkCullCompSpirv[] = {
+#include "shaders/chunk_cull.comp.inc"
+};
+
+alignas(16) static constexpr uint32_t raymarchCompSpirv[] = {
+#include "shaders/raymarch.comp.inc"
+};
+
+alignas(16) static constexpr uint32_t hizReduceCompSpirv[] = {
+#include "shaders/hiz_reduce.comp.inc"
+};
+
+// Indexed by ShaderId
+static const ShaderCode shaderTable[] = {
+    {"chunk.vert", chunkVertSpirv, sizeof(chunkVertSpirv) / sizeof(uint32_t)},
+    {"chunk.frag", chunkFragSpirv, sizeof(chunkFragSpirv) / sizeof(uint32_t)},
+    {"chunk_cull.comp", chunkCullCompSpirv, sizeof(chunkCullCompSpirv) / sizeof(uint32_t)},
+    {"raymarch.comp", raymarchCompSpirv, sizeof(raymarchCompSpirv) / sizeof(uint32_t)},
+    {"hiz_reduce.comp", hizReduceCompSpirv, sizeof(hizReduceCompSpirv) / sizeof(uint32_t)},
+};
+
+static_assert(sizeof(shaderTable) / sizeof(shaderTable[0]) == static_cast<size_t>(ShaderId::Count),
+              "every ShaderId needs an entry in shaderTable");
+
+static std::vector<uint32_t> readSpirvFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open shader " + filename + "!");
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0)
+    {
+        throw std::runtime_error("shader " + filename + " is not valid SPIR-V!");
+    }
+
+    // Read straight into uint32_t storage so pCode is correctly aligned
+    std::vector<uint32_t> words(fileSize / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(words.data()), fileSize);
+
+    return words;
+}
+
+ShaderRegistry::ShaderRegistry(const std::string &overrideDirectory)
+    : overrideDirectory(overrideDirectory)
+{
+}
+
+const ShaderCode &ShaderRegistry::embedded(ShaderId id)
+{
+    return shaderTable[static_cast<size_t>(id)];
+}
+
+VkShaderModule ShaderRegistry::createShaderModule(VkDevice device, ShaderId id) const
+{
+    const ShaderCode &code = embedded(id);
+
+    std::vector<uint32_t> overrideWords;
+    const uint32_t *words = code.words;
+    size_t wordCount = code.wordCount;
+
+    if (!overrideDirectory.empty())
+    {
+        overrideWords = readSpirvFile(overrideDirectory + "/" + code.name + ".spv");
+        words = overrideWords.data();
+        wordCount = overrideWords.size();
+    }
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = wordCount * sizeof(uint32_t);
+    createInfo.pCode = words;
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    {
+        throw std::runtime_error(std::string("failed to create shader module for ") + code.name + "!");
+    }
+
+    return shaderModule;
+}
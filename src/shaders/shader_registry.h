@@ -0,0 +1,42 @@
+#ifndef SHADER_REGISTRY_H
+#define SHADER_REGISTRY_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class ShaderId
+{
+    ChunkVert,
+    ChunkFrag,
+    ChunkCullComp,
+    RaymarchComp,
+    HizReduceComp,
+    Count
+};
+
+struct ShaderCode
+{
+    const char *name; // GLSL file name under src/shaders, e.g. "chunk.vert"
+    const uint32_t *words;
+    size_t wordCount;
+};
+
+// SPIR-V compiled by `make shaders` and embedded into the executable, so
+// creating shader modules needs no file I/O. A non-empty override directory
+// (--shader-dir) makes modules load from <dir>/<name>.spv instead, which lets
+// shaders be recompiled during development without relinking.
+class ShaderRegistry
+{
+public:
+    explicit ShaderRegistry(const std::string &overrideDirectory = "");
+
+    static const ShaderCode &embedded(ShaderId id);
+    VkShaderModule createShaderModule(VkDevice device, ShaderId id) const;
+
+private:
+    std::string overrideDirectory;
+};
+
+#endif
@@ -0,0 +1,361 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vulkan.h"
+#include "allocator.h"
+
+struct MemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint32_t memoryType = 0;
+    AllocationStrategy strategy = AllocationStrategy::Buddy;
+    bool optimalTiling = false;
+    bool dedicated = false;
+    VkDeviceSize slotSize = 0;
+    void *mapped = nullptr;
+    std::unique_ptr<SubAllocator> allocator;
+};
+
+// Smallest pool slot, and the largest slot before Pool requests fall back to Buddy
+static const VkDeviceSize minPoolSlotSize = 256;
+static const VkDeviceSize maxPoolSlotFraction = 64;
+static const VkDeviceSize minBuddyBlockSize = 256;
+
+static bool sameBlockKind(const MemoryBlock &block, uint32_t memoryType, AllocationStrategy strategy,
+                          bool optimalTiling, VkDeviceSize slotSize)
+{
+    return !block.dedicated && block.memoryType == memoryType && block.strategy == strategy &&
+           block.optimalTiling == optimalTiling && block.slotSize == slotSize;
+}
+
+GpuAllocator::GpuAllocator() = default;
+GpuAllocator::~GpuAllocator() = default;
+
+void GpuAllocator::init(VulkanContext &vulkan, VkDeviceSize preferredBlockSize)
+{
+    device = vulkan.device;
+    vkGetPhysicalDeviceMemoryProperties(vulkan.physicalDevice, &memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(vulkan.physicalDevice, &properties);
+    bufferImageGranularity = properties.limits.bufferImageGranularity;
+    maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    // Buddy blocks need a power-of-two capacity
+    blockSize = nextPowerOfTwo(preferredBlockSize);
+}
+
+void GpuAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto &block : blocks)
+    {
+        if (block->mapped != nullptr)
+        {
+            vkUnmapMemory(device, block->memory);
+        }
+        vkFreeMemory(device, block->memory, nullptr);
+    }
+    blocks.clear();
+    deviceAllocationCount = 0;
+}
+
+uint32_t GpuAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+MemoryBlock *GpuAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, AllocationStrategy strategy,
+                                       bool optimalTiling, VkDeviceSize slotSize, bool dedicated)
+{
+    if (deviceAllocationCount >= maxAllocationCount)
+    {
+        throw std::runtime_error("GPU allocator reached maxMemoryAllocationCount!");
+    }
+
+    auto block = std::make_unique<MemoryBlock>();
+    block->memoryType = memoryType;
+    block->strategy = strategy;
+    block->optimalTiling = optimalTiling;
+    block->dedicated = dedicated;
+    block->slotSize = slotSize;
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate device memory block!");
+    }
+    deviceAllocationCount++;
+
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+    }
+
+    if (dedicated)
+    {
+        block->allocator = std::make_unique<LinearSubAllocator>(size);
+    }
+    else if (strategy == AllocationStrategy::Linear)
+    {
+        block->allocator = std::make_unique<LinearSubAllocator>(size);
+    }
+    else if (strategy == AllocationStrategy::Pool)
+    {
+        block->allocator = std::make_unique<PoolSubAllocator>(size, slotSize);
+    }
+    else
+    {
+        block->allocator = std::make_unique<BuddySubAllocator>(size, minBuddyBlockSize);
+    }
+
+    blocks.push_back(std::move(block));
+    return blocks.back().get();
+}
+
+void GpuAllocator::destroyBlock(MemoryBlock *block)
+{
+    if (block->mapped != nullptr)
+    {
+        vkUnmapMemory(device, block->memory);
+    }
+    vkFreeMemory(device, block->memory, nullptr);
+    deviceAllocationCount--;
+
+    blocks.erase(std::find_if(blocks.begin(), blocks.end(),
+                              [block](const std::unique_ptr<MemoryBlock> &b)
+                              { return b.get() == block; }));
+}
+
+bool GpuAllocator::tryAllocateFrom(MemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment, GpuAllocation &allocation)
+{
+    std::optional<uint64_t> offset = block->allocator->allocate(size, alignment);
+    if (!offset)
+    {
+        return false;
+    }
+
+    allocation.memory = block->memory;
+    allocation.offset = *offset;
+    allocation.size = size;
+    allocation.mapped = block->mapped != nullptr ? static_cast<char *>(block->mapped) + *offset : nullptr;
+    allocation.block = block;
+    return true;
+}
+
+GpuAllocation GpuAllocator::allocateLocked(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                           AllocationStrategy strategy, bool optimalTiling)
+{
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    GpuAllocation allocation;
+
+    if (bufferImageGranularity <= 1)
+    {
+        optimalTiling = false;
+    }
+
+    // Keep blocks well below small heaps (e.g. 256 MiB BAR memory) so one block cannot exhaust them
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    VkDeviceSize size = blockSize;
+    while (size > minBuddyBlockSize * 1024 && size > heapSize / 8)
+    {
+        size /= 2;
+    }
+
+    if (requirements.size > size / 2)
+    {
+        MemoryBlock *block = createBlock(memoryType, requirements.size, strategy, optimalTiling, 0, true);
+        tryAllocateFrom(block, requirements.size, requirements.alignment, allocation);
+        return allocation;
+    }
+
+    VkDeviceSize slotSize = 0;
+    if (strategy == AllocationStrategy::Pool)
+    {
+        slotSize = std::max({nextPowerOfTwo(requirements.size), nextPowerOfTwo(requirements.alignment), minPoolSlotSize});
+        if (slotSize > size / maxPoolSlotFraction)
+        {
+            strategy = AllocationStrategy::Buddy;
+            slotSize = 0;
+        }
+    }
+
+    for (auto &block : blocks)
+    {
+        if (sameBlockKind(*block, memoryType, strategy, optimalTiling, slotSize) &&
+            tryAllocateFrom(block.get(), requirements.size, requirements.alignment, allocation))
+        {
+            return allocation;
+        }
+    }
+
+    MemoryBlock *block = createBlock(memoryType, size, strategy, optimalTiling, slotSize, false);
+    if (!tryAllocateFrom(block, requirements.size, requirements.alignment, allocation))
+    {
+        throw std::runtime_error("allocation does not fit into a fresh memory block!");
+    }
+    return allocation;
+}
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                     AllocationStrategy strategy, bool optimalTiling)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocateLocked(requirements, properties, strategy, optimalTiling);
+}
+
+void GpuAllocator::freeLocked(GpuAllocation &allocation)
+{
+    if (allocation.block == nullptr)
+    {
+        return;
+    }
+
+    MemoryBlock *block = allocation.block;
+    block->allocator->free(allocation.offset, allocation.size);
+    if (block->dedicated)
+    {
+        destroyBlock(block);
+    }
+
+    allocation = GpuAllocation{};
+}
+
+void GpuAllocator::free(GpuAllocation &allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    freeLocked(allocation);
+}
+
+GpuBuffer GpuAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                                     AllocationStrategy strategy)
+{
+    GpuBuffer buffer;
+    buffer.size = size;
+    buffer.usage = usage;
+    buffer.properties = properties;
+    buffer.strategy = strategy;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &requirements);
+
+    buffer.allocation = allocate(requirements, properties, strategy, false);
+    vkBindBufferMemory(device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset);
+
+    return buffer;
+}
+
+void GpuAllocator::destroyBuffer(GpuBuffer &buffer)
+{
+    vkDestroyBuffer(device, buffer.buffer, nullptr);
+    free(buffer.allocation);
+    buffer = GpuBuffer{};
+}
+
+GpuImage GpuAllocator::createImage(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties,
+                                   AllocationStrategy strategy)
+{
+    GpuImage image;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &image.image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, image.image, &requirements);
+
+    image.allocation = allocate(requirements, properties, strategy, imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL);
+    vkBindImageMemory(device, image.image, image.allocation.memory, image.allocation.offset);
+
+    return image;
+}
+
+void GpuAllocator::destroyImage(GpuImage &image)
+{
+    vkDestroyImage(device, image.image, nullptr);
+    free(image.allocation);
+    image = GpuImage{};
+}
+
+void GpuAllocator::releaseEmptyBlocks()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (size_t i = blocks.size(); i > 0; i--)
+    {
+        if (!blocks[i - 1]->dedicated && blocks[i - 1]->allocator->isEmpty())
+        {
+            destroyBlock(blocks[i - 1].get());
+        }
+    }
+}
+
+std::vector<HeapStats> GpuAllocator::getHeapStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<HeapStats> stats(memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        stats[i].heapSize = memoryProperties.memoryHeaps[i].size;
+        stats[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    for (const auto &block : blocks)
+    {
+        HeapStats &heap = stats[memoryProperties.memoryTypes[block->memoryType].heapIndex];
+        heap.blockCount++;
+        heap.allocationCount += block->allocator->getAllocationCount();
+        heap.reservedBytes += block->allocator->getCapacity();
+        heap.usedBytes += block->allocator->getUsedBytes();
+    }
+
+    return stats;
+}
+
+void GpuAllocator::printStats(std::ostream &out) const
+{
+    const double mib = 1024.0 * 1024.0;
+    std::vector<HeapStats> stats = getHeapStats();
+
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const HeapStats &heap = stats[i];
+        out << "heap " << i << " (" << (heap.deviceLocal ? "device local" : "host") << ", "
+            << std::fixed << std::setprecision(1) << heap.heapSize / mib << " MiB): "
+            << heap.blockCount << " blocks, " << heap.allocationCount << " allocations, "
+            << heap.reservedBytes / mib << " MiB reserved, " << heap.usedBytes / mib << " MiB used\n";
+    }
+}
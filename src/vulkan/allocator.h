@@ -0,0 +1,112 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "suballocator.h"
+
+struct VulkanContext;
+
+enum class AllocationStrategy
+{
+    Linear, // bump allocated, block recycled when everything in it is freed
+    Pool,   // power-of-two slots, for many small allocations of similar size
+    Buddy   // general purpose
+};
+
+struct MemoryBlock;
+
+struct GpuAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Persistently mapped pointer to offset, null unless the memory is host visible
+    void *mapped = nullptr;
+    MemoryBlock *block = nullptr;
+};
+
+struct GpuBuffer
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    VkBufferUsageFlags usage = 0;
+    VkMemoryPropertyFlags properties = 0;
+    AllocationStrategy strategy = AllocationStrategy::Buddy;
+    GpuAllocation allocation;
+};
+
+struct GpuImage
+{
+    VkImage image = VK_NULL_HANDLE;
+    GpuAllocation allocation;
+};
+
+struct HeapStats
+{
+    VkDeviceSize heapSize = 0;
+    bool deviceLocal = false;
+    uint32_t blockCount = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize reservedBytes = 0; // sum of VkDeviceMemory blocks
+    VkDeviceSize usedBytes = 0;     // sub-allocated out of those blocks
+};
+
+// Sub-allocates buffers and images out of large VkDeviceMemory blocks so the
+// number of vkAllocateMemory calls stays far below maxMemoryAllocationCount.
+// Blocks are kept per memory type and strategy. When bufferImageGranularity is
+// larger than 1, linear resources (buffers) and optimal-tiling images are also
+// kept in separate blocks so they can never share a granularity page.
+// Allocations larger than half a block get a dedicated VkDeviceMemory.
+class GpuAllocator
+{
+public:
+    GpuAllocator();
+    ~GpuAllocator();
+
+    void init(VulkanContext &vulkan, VkDeviceSize blockSize = 64ull * 1024 * 1024);
+    void destroy();
+
+    GpuAllocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                           AllocationStrategy strategy, bool optimalTiling);
+    void free(GpuAllocation &allocation);
+
+    GpuBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                           AllocationStrategy strategy = AllocationStrategy::Buddy);
+    void destroyBuffer(GpuBuffer &buffer);
+
+    GpuImage createImage(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties,
+                         AllocationStrategy strategy = AllocationStrategy::Buddy);
+    void destroyImage(GpuImage &image);
+
+    void releaseEmptyBlocks();
+
+    std::vector<HeapStats> getHeapStats() const;
+    void printStats(std::ostream &out) const;
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize blockSize = 0;
+    VkDeviceSize bufferImageGranularity = 1;
+    uint32_t maxAllocationCount = 0;
+    uint32_t deviceAllocationCount = 0;
+
+    std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    mutable std::mutex mutex;
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    MemoryBlock *createBlock(uint32_t memoryType, VkDeviceSize size, AllocationStrategy strategy,
+                             bool optimalTiling, VkDeviceSize slotSize, bool dedicated);
+    void destroyBlock(MemoryBlock *block);
+    GpuAllocation allocateLocked(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                 AllocationStrategy strategy, bool optimalTiling);
+    bool tryAllocateFrom(MemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment, GpuAllocation &allocation);
+    void freeLocked(GpuAllocation &allocation);
+};
+
+#endif
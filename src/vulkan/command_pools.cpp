@@ -0,0 +1,111 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vulkan.h"
+#include "command_pools.h"
+
+void FrameCommandPools::init(VulkanContext &vulkanContext, uint32_t recorders)
+{
+    vulkan = &vulkanContext;
+    recorderCount = recorders;
+
+    frames.resize(vulkan->maxFramesInFlight);
+    for (FramePools &frame : frames)
+    {
+        frame.primaryPool = createPool();
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frame.primaryPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(vulkan->device, &allocInfo, &frame.primary) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        frame.recorders.resize(recorderCount);
+        for (RecorderPool &recorder : frame.recorders)
+        {
+            recorder.pool = createPool();
+        }
+    }
+}
+
+void FrameCommandPools::destroy()
+{
+    // Destroying a pool frees its command buffers
+    for (FramePools &frame : frames)
+    {
+        vkDestroyCommandPool(vulkan->device, frame.primaryPool, nullptr);
+        for (RecorderPool &recorder : frame.recorders)
+        {
+            vkDestroyCommandPool(vulkan->device, recorder.pool, nullptr);
+        }
+    }
+    frames.clear();
+}
+
+void FrameCommandPools::beginFrame(uint32_t frameIndex)
+{
+    FramePools &frame = frames[frameIndex];
+    vkResetCommandPool(vulkan->device, frame.primaryPool, 0);
+    for (RecorderPool &recorder : frame.recorders)
+    {
+        vkResetCommandPool(vulkan->device, recorder.pool, 0);
+        recorder.used = 0;
+    }
+}
+
+VkCommandBuffer FrameCommandPools::beginSecondary(uint32_t frame, uint32_t recorderIndex,
+                                                  const VkCommandBufferInheritanceInfo &inheritance)
+{
+    RecorderPool &recorder = frames[frame].recorders[recorderIndex];
+    if (recorder.used == recorder.buffers.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = recorder.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(vulkan->device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+        recorder.buffers.push_back(commandBuffer);
+    }
+    VkCommandBuffer commandBuffer = recorder.buffers[recorder.used++];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin secondary command buffer!");
+    }
+    return commandBuffer;
+}
+
+// Pools are reset as a whole, so buffers need no individual reset flag
+VkCommandPool FrameCommandPools::createPool()
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = vulkan->queueFamilies.graphicsFamily.value();
+
+    VkCommandPool pool;
+    if (vkCreateCommandPool(vulkan->device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create command pool!");
+    }
+    return pool;
+}
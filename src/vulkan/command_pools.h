@@ -0,0 +1,59 @@
+#ifndef COMMAND_POOLS_H
+#define COMMAND_POOLS_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+struct VulkanContext;
+
+// Command pools for recording a frame from several threads. Every frame in
+// flight has a pool for its primary command buffer and one pool per recorder,
+// a recorder being one job that records secondary command buffers. A pool is
+// only ever used by one thread at a time, so recording needs no locks.
+//
+// beginFrame() resets all of the frame's pools at once instead of resetting or
+// freeing buffers one by one. The buffers stay allocated and are handed out
+// again on the next use of the frame slot.
+class FrameCommandPools
+{
+public:
+    void init(VulkanContext &vulkan, uint32_t recorderCount);
+    void destroy();
+
+    uint32_t getRecorderCount() const { return recorderCount; }
+
+    // Call after the frame's fence was waited on
+    void beginFrame(uint32_t frame);
+
+    VkCommandBuffer getPrimary(uint32_t frame) const { return frames[frame].primary; }
+
+    // Returns a begun secondary command buffer that continues the render pass
+    // described by inheritance. No other thread may use the recorder's pool
+    // at the same time.
+    VkCommandBuffer beginSecondary(uint32_t frame, uint32_t recorder,
+                                   const VkCommandBufferInheritanceInfo &inheritance);
+
+private:
+    struct RecorderPool
+    {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> buffers;
+        size_t used = 0;
+    };
+
+    struct FramePools
+    {
+        VkCommandPool primaryPool = VK_NULL_HANDLE;
+        VkCommandBuffer primary = VK_NULL_HANDLE;
+        std::vector<RecorderPool> recorders;
+    };
+
+    VulkanContext *vulkan = nullptr;
+    uint32_t recorderCount = 0;
+    std::vector<FramePools> frames;
+
+    VkCommandPool createPool();
+};
+
+#endif
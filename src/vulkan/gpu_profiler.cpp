@@ -0,0 +1,142 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vulkan.h"
+#include "gpu_profiler.h"
+#include "../profile/profiler.h"
+
+void GpuProfiler::init(VulkanContext &vulkanContext)
+{
+    vulkan = &vulkanContext;
+
+    uint32_t validBits = vulkan->capabilities.timestampValidBits;
+    supported = validBits > 0;
+    if (!supported)
+    {
+        return;
+    }
+    nanosecondsPerTick = vulkan->capabilities.timestampPeriod;
+    validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = QUERIES_PER_FRAME * vulkan->maxFramesInFlight;
+    if (vkCreateQueryPool(vulkan->device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+    frames.resize(vulkan->maxFramesInFlight);
+}
+
+void GpuProfiler::destroy()
+{
+    if (queryPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(vulkan->device, queryPool, nullptr);
+        queryPool = VK_NULL_HANDLE;
+    }
+    frames.clear();
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    if (!supported)
+    {
+        return;
+    }
+    FrameQueries &queries = frames[frame];
+    queries.scopes.clear();
+    queries.open.clear();
+    queries.recordTime = Profiler::now();
+    queries.recorded = true;
+    vkCmdResetQueryPool(commandBuffer, queryPool, frame * QUERIES_PER_FRAME, QUERIES_PER_FRAME);
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t frame, const char *name)
+{
+    if (!supported)
+    {
+        return;
+    }
+    FrameQueries &queries = frames[frame];
+    if (queries.scopes.size() == MAX_SCOPES)
+    {
+        // Still tracked so the matching end() closes the right scope
+        queries.open.push_back(UINT32_MAX);
+        return;
+    }
+
+    uint32_t query = static_cast<uint32_t>(queries.scopes.size()) * 2;
+    queries.open.push_back(static_cast<uint32_t>(queries.scopes.size()));
+    queries.scopes.push_back({name, query});
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool,
+                        frame * QUERIES_PER_FRAME + query);
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    if (!supported)
+    {
+        return;
+    }
+    FrameQueries &queries = frames[frame];
+    if (queries.open.empty())
+    {
+        throw std::runtime_error("gpu profiler scope ended without a begin!");
+    }
+    uint32_t scope = queries.open.back();
+    queries.open.pop_back();
+    if (scope == UINT32_MAX)
+    {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool,
+                        frame * QUERIES_PER_FRAME + queries.scopes[scope].query + 1);
+}
+
+const std::vector<GpuScopeTiming> &GpuProfiler::collect(uint32_t frame)
+{
+    static const std::vector<GpuScopeTiming> none;
+    if (!supported)
+    {
+        return none;
+    }
+
+    FrameQueries &queries = frames[frame];
+    queries.timings.clear();
+    if (!queries.recorded || queries.scopes.empty())
+    {
+        return queries.timings;
+    }
+    queries.recorded = false;
+
+    uint32_t queryCount = static_cast<uint32_t>(queries.scopes.size()) * 2;
+    uint64_t timestamps[QUERIES_PER_FRAME];
+    VkResult result = vkGetQueryPoolResults(vulkan->device, queryPool, frame * QUERIES_PER_FRAME, queryCount,
+                                            sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+    {
+        return queries.timings;
+    }
+
+    // GPU and CPU clocks are not calibrated against each other, so the trace
+    // places the frame's first timestamp at the time the frame was recorded
+    uint64_t frameStart = timestamps[0] & validMask;
+    for (const Scope &scope : queries.scopes)
+    {
+        uint64_t begin = timestamps[scope.query] & validMask;
+        uint64_t end = timestamps[scope.query + 1] & validMask;
+        double nanoseconds = ((end - begin) & validMask) * nanosecondsPerTick;
+        queries.timings.push_back({scope.name, nanoseconds / 1e6});
+
+        uint64_t offset = static_cast<uint64_t>(((begin - frameStart) & validMask) * nanosecondsPerTick);
+        Profiler::get().recordGpu(scope.name, queries.recordTime + offset, static_cast<uint64_t>(nanoseconds));
+    }
+    return queries.timings;
+}
@@ -0,0 +1,73 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+struct VulkanContext;
+
+// Named GPU scope timing, milliseconds between its two timestamps
+struct GpuScopeTiming
+{
+    const char *name;
+    double milliseconds;
+};
+
+// Times named, possibly nested spans of GPU work with timestamp query pairs.
+// Every frame in flight owns a slice of one query pool, and a slice is read
+// back in collect() once that frame's fence has signaled, maxFramesInFlight
+// frames later, so reading never stalls. Finished scopes are also handed to
+// the Profiler when it is enabled.
+class GpuProfiler
+{
+public:
+    // Scopes per frame, later ones are not timed
+    static const uint32_t MAX_SCOPES = 16;
+
+    void init(VulkanContext &vulkan);
+    void destroy();
+
+    // False if the graphics queue has no timestamp support, scopes do nothing then
+    bool isSupported() const { return supported; }
+
+    // Resets the frame's queries, call first in the frame's command buffer
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+    // Scopes nest, end() closes the innermost open one. Neither may be called
+    // inside a render pass whose contents are secondary command buffers.
+    void begin(VkCommandBuffer commandBuffer, uint32_t frame, const char *name);
+    void end(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // Timings of the last submission in this frame slot, in the order the
+    // scopes began, so an outermost scope comes first. Empty if there is none.
+    // Call after waiting on the frame's fence.
+    const std::vector<GpuScopeTiming> &collect(uint32_t frame);
+
+private:
+    static const uint32_t QUERIES_PER_FRAME = MAX_SCOPES * 2;
+
+    struct Scope
+    {
+        const char *name;
+        uint32_t query; // first of the pair, relative to the frame's slice
+    };
+
+    struct FrameQueries
+    {
+        std::vector<Scope> scopes;
+        std::vector<uint32_t> open;
+        // CPU time the frame was recorded at, the GPU events are placed relative to it
+        uint64_t recordTime = 0;
+        bool recorded = false;
+        std::vector<GpuScopeTiming> timings;
+    };
+
+    VulkanContext *vulkan = nullptr;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    bool supported = false;
+    double nanosecondsPerTick = 0.0;
+    uint64_t validMask = 0;
+    std::vector<FrameQueries> frames;
+};
+
+#endif
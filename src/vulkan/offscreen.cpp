@@ -0,0 +1,180 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <fstream>
+#include <optional>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "vulkan.h"
+
+void VulkanUtils::createOffscreenTargets(VulkanContext &vulkan, VkFormat format, VkExtent2D extent, uint32_t count)
+{
+    vulkan.swapChainImageFormat = format;
+    vulkan.swapChainExtent = extent;
+    vulkan.swapChainImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                 VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    vulkan.swapChainImages.resize(count);
+    vulkan.offscreenImageMemory.resize(count);
+    vulkan.readbackBuffers.resize(count);
+    vulkan.readbackMemory.resize(count);
+    vulkan.readbackMapped.resize(count);
+
+    VkDeviceSize readbackSize = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = vulkan.swapChainImageUsage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(vulkan.device, &imageInfo, nullptr, &vulkan.swapChainImages[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create offscreen image!");
+        }
+
+        VkMemoryRequirements imageRequirements;
+        vkGetImageMemoryRequirements(vulkan.device, vulkan.swapChainImages[i], &imageRequirements);
+
+        VkMemoryAllocateInfo imageAllocInfo{};
+        imageAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        imageAllocInfo.allocationSize = imageRequirements.size;
+        imageAllocInfo.memoryTypeIndex = findMemoryType(vulkan.physicalDevice, imageRequirements.memoryTypeBits,
+                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (vkAllocateMemory(vulkan.device, &imageAllocInfo, nullptr, &vulkan.offscreenImageMemory[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate offscreen image memory!");
+        }
+        vkBindImageMemory(vulkan.device, vulkan.swapChainImages[i], vulkan.offscreenImageMemory[i], 0);
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = readbackSize;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(vulkan.device, &bufferInfo, nullptr, &vulkan.readbackBuffers[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create readback buffer!");
+        }
+
+        VkMemoryRequirements bufferRequirements;
+        vkGetBufferMemoryRequirements(vulkan.device, vulkan.readbackBuffers[i], &bufferRequirements);
+
+        VkMemoryAllocateInfo bufferAllocInfo{};
+        bufferAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        bufferAllocInfo.allocationSize = bufferRequirements.size;
+        bufferAllocInfo.memoryTypeIndex = findMemoryType(vulkan.physicalDevice, bufferRequirements.memoryTypeBits,
+                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        if (vkAllocateMemory(vulkan.device, &bufferAllocInfo, nullptr, &vulkan.readbackMemory[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate readback memory!");
+        }
+        vkBindBufferMemory(vulkan.device, vulkan.readbackBuffers[i], vulkan.readbackMemory[i], 0);
+        vkMapMemory(vulkan.device, vulkan.readbackMemory[i], 0, readbackSize, 0, &vulkan.readbackMapped[i]);
+    }
+}
+
+void VulkanUtils::destroyOffscreenTargets(VulkanContext &vulkan)
+{
+    for (size_t i = 0; i < vulkan.swapChainImages.size(); i++)
+    {
+        vkUnmapMemory(vulkan.device, vulkan.readbackMemory[i]);
+        vkDestroyBuffer(vulkan.device, vulkan.readbackBuffers[i], nullptr);
+        vkFreeMemory(vulkan.device, vulkan.readbackMemory[i], nullptr);
+        vkDestroyImage(vulkan.device, vulkan.swapChainImages[i], nullptr);
+        vkFreeMemory(vulkan.device, vulkan.offscreenImageMemory[i], nullptr);
+    }
+
+    vulkan.swapChainImages.clear();
+    vulkan.offscreenImageMemory.clear();
+    vulkan.readbackBuffers.clear();
+    vulkan.readbackMemory.clear();
+    vulkan.readbackMapped.clear();
+}
+
+// Copies the finished offscreen image into its readback buffer. Must be
+// recorded after the render pass, which leaves the image in TRANSFER_SRC_OPTIMAL.
+void VulkanUtils::recordReadback(VulkanContext &vulkan, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = vulkan.swapChainImages[imageIndex];
+    imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {vulkan.swapChainExtent.width, vulkan.swapChainExtent.height, 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer, vulkan.swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           vulkan.readbackBuffers[imageIndex], 1, &region);
+
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = vulkan.readbackBuffers[imageIndex];
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+// Returns the tightly packed RGBA8 pixels of the last frame rendered into
+// imageIndex. The caller must have waited on that frame's fence.
+std::vector<uint8_t> VulkanUtils::readbackImage(VulkanContext &vulkan, uint32_t imageIndex)
+{
+    size_t size = static_cast<size_t>(vulkan.swapChainExtent.width) * vulkan.swapChainExtent.height * 4;
+    std::vector<uint8_t> pixels(size);
+    std::memcpy(pixels.data(), vulkan.readbackMapped[imageIndex], size);
+    return pixels;
+}
+
+void VulkanUtils::writePPM(const std::string &filename, VkExtent2D extent, const std::vector<uint8_t> &rgba)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open " + filename + " for writing!");
+    }
+
+    file << "P6\n"
+         << extent.width << ' ' << extent.height << "\n255\n";
+
+    std::vector<uint8_t> rgb(static_cast<size_t>(extent.width) * extent.height * 3);
+    for (size_t i = 0, j = 0; i < rgb.size(); i += 3, j += 4)
+    {
+        rgb[i + 0] = rgba[j + 0];
+        rgb[i + 1] = rgba[j + 1];
+        rgb[i + 2] = rgba[j + 2];
+    }
+    file.write(reinterpret_cast<const char *>(rgb.data()), rgb.size());
+}
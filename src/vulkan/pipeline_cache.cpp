@@ -0,0 +1,188 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <fstream>
+#include <optional>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "vulkan.h"
+
+// On-disk layout: PipelineCacheFileHeader followed by the driver blob. The
+// driver blob starts with the header layout the spec defines for
+// VK_PIPELINE_CACHE_HEADER_VERSION_ONE, which is checked against the current
+// device before the data reaches the driver, since some drivers crash instead
+// of rejecting foreign or damaged caches.
+struct PipelineCacheFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+struct DriverCacheHeader
+{
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static const char pipelineCacheMagic[4] = {'V', 'X', 'P', 'C'};
+static const uint32_t pipelineCacheVersion = 1;
+
+static uint64_t hashBytes(const uint8_t *data, size_t size)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool isPipelineCacheValid(VkPhysicalDevice physicalDevice, const std::vector<uint8_t> &file)
+{
+    if (file.size() < sizeof(PipelineCacheFileHeader))
+    {
+        return false;
+    }
+
+    PipelineCacheFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, pipelineCacheMagic, sizeof(header.magic)) != 0 ||
+        header.version != pipelineCacheVersion ||
+        header.dataSize != file.size() - sizeof(header) ||
+        header.dataSize < sizeof(DriverCacheHeader))
+    {
+        return false;
+    }
+
+    const uint8_t *data = file.data() + sizeof(header);
+    if (hashBytes(data, header.dataSize) != header.dataHash)
+    {
+        return false;
+    }
+
+    DriverCacheHeader driverHeader;
+    std::memcpy(&driverHeader, data, sizeof(driverHeader));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    return driverHeader.headerSize >= sizeof(driverHeader) &&
+           driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           driverHeader.vendorID == properties.vendorID &&
+           driverHeader.deviceID == properties.deviceID &&
+           std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// Creates vulkan.pipelineCache, seeded from filename when it holds a cache
+// written by this driver and device. Returns true when the cache was warm.
+bool VulkanUtils::loadPipelineCache(VulkanContext &vulkan, const std::string &filename)
+{
+    std::vector<uint8_t> file;
+    {
+        std::ifstream in(filename, std::ios::ate | std::ios::binary);
+        if (in.is_open())
+        {
+            file.resize(static_cast<size_t>(in.tellg()));
+            in.seekg(0);
+            in.read(reinterpret_cast<char *>(file.data()), file.size());
+        }
+    }
+
+    bool warm = !file.empty() && isPipelineCacheValid(vulkan.physicalDevice, file);
+    if (!file.empty() && !warm)
+    {
+        std::cout << "pipeline cache: discarding stale or corrupt " << filename << "\n";
+    }
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (warm)
+    {
+        createInfo.initialDataSize = file.size() - sizeof(PipelineCacheFileHeader);
+        createInfo.pInitialData = file.data() + sizeof(PipelineCacheFileHeader);
+    }
+
+    if (vkCreatePipelineCache(vulkan.device, &createInfo, nullptr, &vulkan.pipelineCache) != VK_SUCCESS)
+    {
+        if (!warm)
+        {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+
+        // The driver rejected data that passed our checks, start over empty
+        warm = false;
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        if (vkCreatePipelineCache(vulkan.device, &createInfo, nullptr, &vulkan.pipelineCache) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    return warm;
+}
+
+// Writes vulkan.pipelineCache to filename. A temporary file is renamed over
+// the old cache so an interrupted write never leaves a truncated cache behind.
+void VulkanUtils::savePipelineCache(VulkanContext &vulkan, const std::string &filename)
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(vulkan.device, vulkan.pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+    {
+        return;
+    }
+
+    std::vector<uint8_t> data(dataSize);
+    if (vkGetPipelineCacheData(vulkan.device, vulkan.pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+    {
+        return;
+    }
+    data.resize(dataSize);
+
+    PipelineCacheFileHeader header;
+    std::memcpy(header.magic, pipelineCacheMagic, sizeof(header.magic));
+    header.version = pipelineCacheVersion;
+    header.dataSize = data.size();
+    header.dataHash = hashBytes(data.data(), data.size());
+
+    std::string tempFilename = filename + ".tmp";
+    {
+        std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "pipeline cache: failed to open " << tempFilename << " for writing\n";
+            return;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(data.data()), data.size());
+        if (!out)
+        {
+            std::cerr << "pipeline cache: failed to write " << tempFilename << "\n";
+            return;
+        }
+    }
+
+    // rename replaces the old cache atomically on POSIX, Windows refuses to
+    // rename onto an existing file, so only there is it removed first
+    if (std::rename(tempFilename.c_str(), filename.c_str()) == 0)
+    {
+        return;
+    }
+    std::remove(filename.c_str());
+    if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+    {
+        std::cerr << "pipeline cache: failed to replace " << filename << "\n";
+    }
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "suballocator.h"
+
+uint64_t nextPowerOfTwo(uint64_t value)
+{
+    uint64_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+std::optional<uint64_t> LinearSubAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+    uint64_t offset = alignUp(head, alignment);
+    if (offset + size > capacity)
+    {
+        return std::nullopt;
+    }
+
+    usedBytes += offset + size - head;
+    head = offset + size;
+    allocationCount++;
+    return offset;
+}
+
+void LinearSubAllocator::free(uint64_t, uint64_t)
+{
+    if (allocationCount == 0)
+    {
+        throw std::runtime_error("linear sub-allocator freed more than it allocated!");
+    }
+
+    if (--allocationCount == 0)
+    {
+        head = 0;
+        usedBytes = 0;
+    }
+}
+
+PoolSubAllocator::PoolSubAllocator(uint64_t capacity, uint64_t slotSize)
+    : SubAllocator(capacity), slotSize(slotSize)
+{
+    if (slotSize == 0 || (slotSize & (slotSize - 1)) != 0)
+    {
+        throw std::runtime_error("pool slot size must be a power of two!");
+    }
+
+    uint32_t slotCount = static_cast<uint32_t>(capacity / slotSize);
+    freeSlots.reserve(slotCount);
+    // Pushed in reverse so slots are handed out from the start of the block
+    for (uint32_t i = slotCount; i > 0; i--)
+    {
+        freeSlots.push_back(i - 1);
+    }
+}
+
+std::optional<uint64_t> PoolSubAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+    if (size > slotSize || alignment > slotSize || freeSlots.empty())
+    {
+        return std::nullopt;
+    }
+
+    uint32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    usedBytes += slotSize;
+    allocationCount++;
+    return static_cast<uint64_t>(slot) * slotSize;
+}
+
+void PoolSubAllocator::free(uint64_t offset, uint64_t)
+{
+    freeSlots.push_back(static_cast<uint32_t>(offset / slotSize));
+    usedBytes -= slotSize;
+    allocationCount--;
+}
+
+BuddySubAllocator::BuddySubAllocator(uint64_t capacity, uint64_t minBlockSize)
+    : SubAllocator(capacity), minBlockSize(minBlockSize)
+{
+    if ((capacity & (capacity - 1)) != 0 || (minBlockSize & (minBlockSize - 1)) != 0 || minBlockSize > capacity)
+    {
+        throw std::runtime_error("buddy capacity and minimum block size must be powers of two!");
+    }
+
+    orderCount = 1;
+    while (nodeSize(orderCount - 1) < capacity)
+    {
+        orderCount++;
+    }
+
+    freeLists.resize(orderCount);
+    freeLists[orderCount - 1].insert(0);
+}
+
+std::optional<uint64_t> BuddySubAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+    uint64_t blockSize = std::max({nextPowerOfTwo(size), nextPowerOfTwo(alignment), minBlockSize});
+    if (blockSize > capacity)
+    {
+        return std::nullopt;
+    }
+
+    uint32_t order = 0;
+    while (nodeSize(order) < blockSize)
+    {
+        order++;
+    }
+
+    // Find the smallest free node that fits, then split it down to the wanted order
+    uint32_t available = order;
+    while (available < orderCount && freeLists[available].empty())
+    {
+        available++;
+    }
+    if (available == orderCount)
+    {
+        return std::nullopt;
+    }
+
+    uint64_t offset = *freeLists[available].begin();
+    freeLists[available].erase(freeLists[available].begin());
+
+    while (available > order)
+    {
+        available--;
+        freeLists[available].insert(offset + nodeSize(available));
+    }
+
+    allocatedOrders[offset] = order;
+    usedBytes += nodeSize(order);
+    allocationCount++;
+    return offset;
+}
+
+void BuddySubAllocator::free(uint64_t offset, uint64_t)
+{
+    auto it = allocatedOrders.find(offset);
+    if (it == allocatedOrders.end())
+    {
+        throw std::runtime_error("buddy sub-allocator freed an unknown offset!");
+    }
+
+    uint32_t order = it->second;
+    allocatedOrders.erase(it);
+    usedBytes -= nodeSize(order);
+    allocationCount--;
+
+    // Merge with the buddy for as long as it is free as well
+    while (order + 1 < orderCount)
+    {
+        uint64_t buddy = offset ^ nodeSize(order);
+        auto buddyIt = freeLists[order].find(buddy);
+        if (buddyIt == freeLists[order].end())
+        {
+            break;
+        }
+
+        freeLists[order].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+
+    freeLists[order].insert(offset);
+}
+
+uint64_t BuddySubAllocator::getLargestFreeBlock() const
+{
+    for (uint32_t order = orderCount; order > 0; order--)
+    {
+        if (!freeLists[order - 1].empty())
+        {
+            return nodeSize(order - 1);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef SUBALLOCATOR_H
+#define SUBALLOCATOR_H
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Offset bookkeeping for one device-memory block. These classes never touch
+// Vulkan, they only hand out [offset, offset + size) ranges inside a block of
+// `capacity` bytes, so GpuAllocator can put any of them behind a VkDeviceMemory.
+class SubAllocator
+{
+public:
+    explicit SubAllocator(uint64_t capacity) : capacity(capacity) {}
+    virtual ~SubAllocator() = default;
+
+    virtual std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment) = 0;
+    virtual void free(uint64_t offset, uint64_t size) = 0;
+
+    uint64_t getCapacity() const { return capacity; }
+    uint64_t getUsedBytes() const { return usedBytes; }
+    uint32_t getAllocationCount() const { return allocationCount; }
+    bool isEmpty() const { return allocationCount == 0; }
+
+protected:
+    uint64_t capacity;
+    uint64_t usedBytes = 0;
+    uint32_t allocationCount = 0;
+};
+
+// Bump allocator. Individual frees only count down, the whole block is reused
+// once every allocation in it has been freed. Suited to per-frame or staging data.
+class LinearSubAllocator : public SubAllocator
+{
+public:
+    explicit LinearSubAllocator(uint64_t capacity) : SubAllocator(capacity) {}
+
+    std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment) override;
+    void free(uint64_t offset, uint64_t size) override;
+
+private:
+    uint64_t head = 0;
+};
+
+// Fixed-size slots handed out from a free list. Every slot is slotSize bytes
+// and slotSize-aligned, so slotSize must be a power of two.
+class PoolSubAllocator : public SubAllocator
+{
+public:
+    PoolSubAllocator(uint64_t capacity, uint64_t slotSize);
+
+    std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment) override;
+    void free(uint64_t offset, uint64_t size) override;
+
+    uint64_t getSlotSize() const { return slotSize; }
+
+private:
+    uint64_t slotSize;
+    std::vector<uint32_t> freeSlots;
+};
+
+// Binary buddy allocator over a power-of-two capacity. Allocations are rounded
+// up to a power of two no smaller than minBlockSize and are naturally aligned
+// to their rounded size.
+class BuddySubAllocator : public SubAllocator
+{
+public:
+    BuddySubAllocator(uint64_t capacity, uint64_t minBlockSize);
+
+    std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment) override;
+    void free(uint64_t offset, uint64_t size) override;
+
+    uint64_t getLargestFreeBlock() const;
+
+private:
+    uint64_t minBlockSize;
+    uint32_t orderCount;
+    // freeLists[order] holds offsets of free nodes of size minBlockSize << order
+    std::vector<std::set<uint64_t>> freeLists;
+    std::unordered_map<uint64_t, uint32_t> allocatedOrders;
+
+    uint64_t nodeSize(uint32_t order) const { return minBlockSize << order; }
+};
+
+uint64_t nextPowerOfTwo(uint64_t value);
+
+#endif
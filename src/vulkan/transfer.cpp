@@ -0,0 +1,340 @@
+#define GLFW_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vulkan.h"
+#include "transfer.h"
+
+// Staging offsets stay 16-byte aligned, which satisfies optimalBufferCopyOffsetAlignment on common hardware
+static const VkDeviceSize stagingAlignment = 16;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void TransferUploader::init(VulkanContext &vulkanContext, GpuAllocator &gpuAllocator, VkDeviceSize size)
+{
+    vulkan = &vulkanContext;
+    allocator = &gpuAllocator;
+    transferFamily = vulkan->queueFamilies.transferFamily.value();
+    graphicsFamily = vulkan->queueFamilies.graphicsFamily.value();
+
+    ringSize = alignUp(size, stagingAlignment);
+    ring = allocator->createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   AllocationStrategy::Linear);
+    ringMapped = static_cast<uint8_t *>(ring.allocation.mapped);
+    writeCursor = 0;
+    readCursor = 0;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = transferFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(vulkan->device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+
+    if (vulkan->timelineSemaphores)
+    {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+        if (vkCreateSemaphore(vulkan->device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create transfer timeline semaphore!");
+        }
+    }
+    timelineValue = 0;
+}
+
+void TransferUploader::destroy()
+{
+    if (vulkan == nullptr)
+    {
+        return;
+    }
+
+    waitIdle();
+    for (const Batch &batch : freeBatches)
+    {
+        vkDestroyFence(vulkan->device, batch.fence, nullptr);
+    }
+    freeBatches.clear();
+    pending.clear();
+    released.clear();
+
+    vkDestroyCommandPool(vulkan->device, commandPool, nullptr);
+    vkDestroySemaphore(vulkan->device, timeline, nullptr);
+    allocator->destroyBuffer(ring);
+
+    commandPool = VK_NULL_HANDLE;
+    timeline = VK_NULL_HANDLE;
+    ringMapped = nullptr;
+    vulkan = nullptr;
+}
+
+void TransferUploader::upload(const GpuBuffer &dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size,
+                              VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    if (dstOffset + size > dst.size)
+    {
+        throw std::runtime_error("upload does not fit in the destination buffer!");
+    }
+
+    // Large uploads are split so a single piece always fits into an idle ring
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    VkDeviceSize maxPiece = ringSize / 2;
+    while (size > 0)
+    {
+        VkDeviceSize piece = std::min(size, maxPiece);
+        VkDeviceSize stagingOffset = reserve(piece);
+        memcpy(ringMapped + stagingOffset, bytes, static_cast<size_t>(piece));
+
+        PendingCopy copy{};
+        copy.buffer = dst.buffer;
+        copy.region.srcOffset = stagingOffset;
+        copy.region.dstOffset = dstOffset;
+        copy.region.size = piece;
+        copy.dstStageMask = dstStageMask;
+        copy.dstAccessMask = dstAccessMask;
+        pending.push_back(copy);
+
+        bytes += piece;
+        dstOffset += piece;
+        size -= piece;
+    }
+}
+
+uint64_t TransferUploader::flush()
+{
+    if (pending.empty())
+    {
+        return 0;
+    }
+
+    Batch batch = acquireBatch();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+    for (const PendingCopy &copy : pending)
+    {
+        vkCmdCopyBuffer(batch.commandBuffer, ring.buffer, copy.buffer, 1, &copy.region);
+    }
+
+    // Release the written ranges to the graphics family. The acquire half is
+    // recorded by recordAcquireBarriers() with the same ranges and families.
+    if (transferFamily != graphicsFamily)
+    {
+        std::vector<VkBufferMemoryBarrier> barriers(pending.size());
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[i].dstAccessMask = 0;
+            barriers[i].srcQueueFamilyIndex = transferFamily;
+            barriers[i].dstQueueFamilyIndex = graphicsFamily;
+            barriers[i].buffer = pending[i].buffer;
+            barriers[i].offset = pending[i].region.dstOffset;
+            barriers[i].size = pending[i].region.size;
+        }
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+
+    if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record transfer command buffer!");
+    }
+
+    batch.value = ++timelineValue;
+    batch.ringEnd = writeCursor;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    if (timeline != VK_NULL_HANDLE)
+    {
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &timeline;
+    }
+
+    if (vkQueueSubmit(vulkan->transferQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit transfer command buffer!");
+    }
+
+    // Without timeline semaphores there is nothing graphics could wait on, so
+    // the copies are finished on the CPU before the next frame is submitted
+    if (timeline == VK_NULL_HANDLE)
+    {
+        vkWaitForFences(vulkan->device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    }
+
+    inFlight.push_back(batch);
+    released.insert(released.end(), pending.begin(), pending.end());
+    releasedValue = batch.value;
+    pending.clear();
+
+    return batch.value;
+}
+
+UploadWait TransferUploader::recordAcquireBarriers(VkCommandBuffer commandBuffer)
+{
+    UploadWait wait;
+    if (released.empty())
+    {
+        return wait;
+    }
+
+    bool ownershipTransfer = transferFamily != graphicsFamily;
+    VkPipelineStageFlags dstStageMask = 0;
+    std::vector<VkBufferMemoryBarrier> barriers(released.size());
+    for (size_t i = 0; i < released.size(); i++)
+    {
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = ownershipTransfer ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[i].dstAccessMask = released[i].dstAccessMask;
+        barriers[i].srcQueueFamilyIndex = ownershipTransfer ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = ownershipTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].buffer = released[i].buffer;
+        barriers[i].offset = released[i].region.dstOffset;
+        barriers[i].size = released[i].region.size;
+        dstStageMask |= released[i].dstStageMask;
+    }
+
+    // The semaphore wait already orders the transfer before dstStageMask, so an
+    // acquire only needs to cover the same stages
+    VkPipelineStageFlags srcStageMask = ownershipTransfer ? dstStageMask
+                                                          : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+    wait.semaphore = timeline;
+    wait.value = releasedValue;
+    wait.stageMask = dstStageMask;
+    released.clear();
+    return wait;
+}
+
+void TransferUploader::waitIdle()
+{
+    reclaim(true);
+}
+
+VkDeviceSize TransferUploader::reserve(VkDeviceSize size)
+{
+    while (true)
+    {
+        reclaim(false);
+
+        VkDeviceSize start = alignUp(writeCursor, stagingAlignment);
+        VkDeviceSize offset = start % ringSize;
+        // A piece never wraps around the end of the ring, skip to the start instead
+        if (offset + size > ringSize)
+        {
+            start += ringSize - offset;
+            offset = 0;
+        }
+
+        if (start + size - readCursor <= ringSize)
+        {
+            writeCursor = start + size;
+            return offset;
+        }
+
+        // Out of space: submit what is queued so it can retire, then wait for the oldest batch
+        flush();
+        if (inFlight.empty())
+        {
+            throw std::runtime_error("staging ring is too small for upload!");
+        }
+
+        Batch &oldest = inFlight.front();
+        vkWaitForFences(vulkan->device, 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+    }
+}
+
+void TransferUploader::reclaim(bool wait)
+{
+    while (!inFlight.empty())
+    {
+        Batch &batch = inFlight.front();
+        if (wait)
+        {
+            vkWaitForFences(vulkan->device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        }
+        else if (vkGetFenceStatus(vulkan->device, batch.fence) != VK_SUCCESS)
+        {
+            break;
+        }
+
+        readCursor = batch.ringEnd;
+        freeBatches.push_back(batch);
+        inFlight.pop_front();
+    }
+
+    // An idle ring restarts at offset 0 so a piece of up to half the ring always fits
+    if (inFlight.empty() && pending.empty())
+    {
+        writeCursor = 0;
+        readCursor = 0;
+    }
+}
+
+TransferUploader::Batch TransferUploader::acquireBatch()
+{
+    if (!freeBatches.empty())
+    {
+        Batch batch = freeBatches.back();
+        freeBatches.pop_back();
+        vkResetFences(vulkan->device, 1, &batch.fence);
+        vkResetCommandBuffer(batch.commandBuffer, 0);
+        return batch;
+    }
+
+    Batch batch;
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(vulkan->device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate transfer command buffer!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(vulkan->device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create transfer fence!");
+    }
+
+    return batch;
+}
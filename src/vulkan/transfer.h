@@ -0,0 +1,102 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <vector>
+
+#include "allocator.h"
+
+struct VulkanContext;
+
+// What a graphics submit has to wait on before it may read uploaded data.
+// semaphore is null when there is nothing to wait for.
+struct UploadWait
+{
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    uint64_t value = 0;
+    VkPipelineStageFlags stageMask = 0;
+};
+
+// Streams data into device-local buffers through a persistently mapped staging
+// ring on the transfer queue, so uploads never stall the graphics queue.
+// Copies are batched until flush(), which submits them as one command buffer
+// that signals a timeline semaphore. When the transfer queue belongs to its own
+// family, the batch also releases ownership of every written range, and
+// recordAcquireBarriers() records the matching acquire into the next frame.
+//
+// Uploads are expected to come from the render thread. The destination range
+// must not be in use by the GPU while it is being uploaded.
+class TransferUploader
+{
+public:
+    void init(VulkanContext &vulkan, GpuAllocator &allocator, VkDeviceSize ringSize = 64ull * 1024 * 1024);
+    void destroy();
+
+    // Copies data into the staging ring right away and queues the GPU copy into
+    // dst. dstStageMask and dstAccessMask describe how graphics reads the result.
+    void upload(const GpuBuffer &dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size,
+                VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+    // Submits the queued copies. Returns the timeline value signaled once they
+    // complete, or 0 if nothing was queued.
+    uint64_t flush();
+
+    // Records the acquire side of every flushed upload into a graphics command
+    // buffer, before anything reads the data. The submit of that command buffer
+    // must wait on the returned semaphore.
+    UploadWait recordAcquireBarriers(VkCommandBuffer commandBuffer);
+
+    // Blocks until every flushed upload has completed
+    void waitIdle();
+
+    VkDeviceSize getRingSize() const { return ringSize; }
+
+private:
+    struct PendingCopy
+    {
+        VkBuffer buffer;
+        VkBufferCopy region;
+        VkPipelineStageFlags dstStageMask;
+        VkAccessFlags dstAccessMask;
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t value = 0;
+        // Ring cursor at submit time, the ring can be reclaimed up to here once the fence signals
+        VkDeviceSize ringEnd = 0;
+    };
+
+    VulkanContext *vulkan = nullptr;
+    GpuAllocator *allocator = nullptr;
+    uint32_t transferFamily = 0;
+    uint32_t graphicsFamily = 0;
+
+    GpuBuffer ring;
+    uint8_t *ringMapped = nullptr;
+    VkDeviceSize ringSize = 0;
+    // Monotonic byte cursors, the ring offset is cursor % ringSize
+    VkDeviceSize writeCursor = 0;
+    VkDeviceSize readCursor = 0;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    uint64_t timelineValue = 0;
+
+    std::vector<PendingCopy> pending;
+    // Flushed copies whose acquire has not been recorded on graphics yet
+    std::vector<PendingCopy> released;
+    uint64_t releasedValue = 0;
+
+    std::deque<Batch> inFlight;
+    std::vector<Batch> freeBatches;
+
+    VkDeviceSize reserve(VkDeviceSize size);
+    void reclaim(bool wait);
+    Batch acquireBatch();
+};
+
+#endif
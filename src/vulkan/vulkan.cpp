@@ -2,11 +2,13 @@
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 #include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <fstream>
 #include <optional>
 #include <cstring>
 #include <limits>
+#include <string>
 #include <vector>
 #include <set>
 
@@ -30,13 +32,19 @@ void VulkanUtils::createVulkanInstance(VulkanContext &vulkan)
     uint32_t apiVersion = 0;
     vkEnumerateInstanceVersion(&apiVersion);
     appInfo.apiVersion = apiVersion;
+    vulkan.apiVersion = apiVersion;
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
+    // Headless runs never initialize GLFW, so they need no surface extensions
     uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char **glfwExtensions = nullptr;
+    if (!vulkan.headless)
+    {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
     std::vector<const char *> extensions_list(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
     if (enableValidationLayers)
@@ -102,45 +110,129 @@ void VulkanUtils::createSurface(VulkanContext &vulkan, GLFWwindow *window)
     }
 }
 
-void VulkanUtils::pickPhysicalDevice(VulkanContext &vulkan)
+static const char *deviceTypeName(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+// All digits picks by enumeration index, anything else by a case-insensitive part of the name
+static bool matchesDevice(const std::string &preferred, size_t index, const std::string &name)
 {
+    if (std::all_of(preferred.begin(), preferred.end(), [](unsigned char c) { return std::isdigit(c); }))
     {
-        uint32_t deviceCount = 0;
-        vkEnumeratePhysicalDevices(vulkan.instance, &deviceCount, nullptr);
+        return std::stoul(preferred) == index;
+    }
+    auto lower = [](std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+        return text;
+    };
+    return lower(name).find(lower(preferred)) != std::string::npos;
+}
 
-        if (deviceCount == 0)
+void VulkanUtils::pickPhysicalDevice(VulkanContext &vulkan, const std::string &preferredDevice)
+{
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(vulkan.instance, &deviceCount, nullptr);
+
+    if (deviceCount == 0)
+    {
+        throw std::runtime_error("failed to find GPUs with Vulkan support!");
+    }
+
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(vulkan.instance, &deviceCount, devices.data());
+
+    std::vector<DeviceCapabilities> candidates;
+    std::optional<size_t> best;
+    std::optional<size_t> preferred;
+    uint64_t bestScore = 0;
+
+    std::cout << "vulkan devices:\n";
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        candidates.push_back(probeDevice(devices[i], vulkan.surface, vulkan.apiVersion));
+        const DeviceCapabilities &candidate = candidates.back();
+        uint64_t score = rateDevice(candidate);
+
+        std::cout << '\t' << i << ": " << candidate.name << " (" << deviceTypeName(candidate.type) << ", "
+                  << (candidate.deviceLocalBytes >> 20) << " MiB)";
+        if (candidate.suitable)
         {
-            throw std::runtime_error("failed to find GPUs with Vulkan support!");
+            std::cout << " score " << score << '\n';
+        }
+        else
+        {
+            std::cout << " unsuitable\n";
         }
 
-        std::vector<VkPhysicalDevice> devices(deviceCount);
-        vkEnumeratePhysicalDevices(vulkan.instance, &deviceCount, devices.data());
-
-        for (const auto &device : devices)
+        if (candidate.suitable && (!best.has_value() || score > bestScore))
         {
-            if (isDeviceSuitable(device, vulkan.surface))
-            {
-                vulkan.physicalDevice = device;
-                break;
-            }
+            best = i;
+            bestScore = score;
+        }
+        if (!preferredDevice.empty() && !preferred.has_value() && matchesDevice(preferredDevice, i, candidate.name))
+        {
+            preferred = i;
         }
+    }
 
-        if (vulkan.physicalDevice == VK_NULL_HANDLE)
+    size_t chosen;
+    if (!preferredDevice.empty())
+    {
+        if (!preferred.has_value())
+        {
+            throw std::runtime_error("no vulkan device matches " + preferredDevice + "!");
+        }
+        if (!candidates[preferred.value()].suitable)
+        {
+            throw std::runtime_error(candidates[preferred.value()].name + " can't render this context!");
+        }
+        chosen = preferred.value();
+    }
+    else
+    {
+        if (!best.has_value())
         {
             throw std::runtime_error("Failed to find a suitable GPU!");
         }
+        chosen = best.value();
     }
+
+    vulkan.physicalDevice = devices[chosen];
+    vulkan.capabilities = candidates[chosen];
+    std::cout << "render: device " << chosen << ", " << vulkan.capabilities.name
+              << (preferredDevice.empty() ? " (highest score)\n" : " (--device)\n");
 }
 
 void VulkanUtils::createLogicalDevice(VulkanContext &vulkan)
 {
     QueueFamilyIndices indices = VulkanUtils::findQueueFamilies(vulkan.physicalDevice, vulkan.surface);
 
-    const std::vector<const char *> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char *> enabledExtensions;
+    if (!vulkan.headless)
+    {
+        enabledExtensions = deviceExtensions;
+    }
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.transferFamily.value()};
+    if (indices.presentFamily.has_value())
+    {
+        uniqueQueueFamilies.insert(indices.presentFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -153,16 +245,41 @@ void VulkanUtils::createLogicalDevice(VulkanContext &vulkan)
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // The optional features a path uses are enabled where pickPhysicalDevice found them.
+    // Descriptor indexing only counts towards the device score, nothing uses it yet.
+    // GPU-driven chunk draws need these, ChunkRenderer falls back to direct draws without them
+    const DeviceCapabilities &capabilities = vulkan.capabilities;
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    deviceFeatures.multiDrawIndirect = capabilities.multiDrawIndirect ? VK_TRUE : VK_FALSE;
+    deviceFeatures.drawIndirectFirstInstance = capabilities.drawIndirectFirstInstance ? VK_TRUE : VK_FALSE;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+
+    // Timeline semaphores hand transfer-queue uploads over to graphics. They are
+    // core in Vulkan 1.2; older devices fall back to waiting for uploads on the CPU
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(vulkan.physicalDevice, &properties);
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (std::min(vulkan.apiVersion, properties.apiVersion) >= VK_API_VERSION_1_2)
+    {
+        vulkan12Features.timelineSemaphore = capabilities.timelineSemaphores ? VK_TRUE : VK_FALSE;
+        vulkan12Features.drawIndirectCount = capabilities.drawIndirectCount ? VK_TRUE : VK_FALSE;
+        createInfo.pNext = &vulkan12Features;
+    }
+    vulkan.timelineSemaphores = vulkan12Features.timelineSemaphore == VK_TRUE;
+    vulkan.multiDrawIndirect = deviceFeatures.multiDrawIndirect == VK_TRUE;
+    vulkan.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance == VK_TRUE;
+    vulkan.drawIndirectCount = vulkan12Features.drawIndirectCount == VK_TRUE;
+    vulkan.maxDrawIndirectCount = vulkan.multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     ;
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (enableValidationLayers)
     {
@@ -180,7 +297,12 @@ void VulkanUtils::createLogicalDevice(VulkanContext &vulkan)
     }
 
     vkGetDeviceQueue(vulkan.device, indices.graphicsFamily.value(), 0, &vulkan.graphicsQueue);
-    vkGetDeviceQueue(vulkan.device, indices.presentFamily.value(), 0, &vulkan.presentQueue);
+    if (indices.presentFamily.has_value())
+    {
+        vkGetDeviceQueue(vulkan.device, indices.presentFamily.value(), 0, &vulkan.presentQueue);
+    }
+    vkGetDeviceQueue(vulkan.device, indices.transferFamily.value(), 0, &vulkan.transferQueue);
+    vulkan.queueFamilies = indices;
 }
 
 bool VulkanUtils::checkValidationLayerSupport(const std::vector<const char *> &validationLayers)
@@ -230,27 +352,47 @@ QueueFamilyIndices VulkanUtils::findQueueFamilies(VkPhysicalDevice device, VkSur
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-    int i = 0;
-    for (const auto &queueFamily : queueFamilies)
+    // Every family is visited so a transfer-only family is found even when it
+    // comes after the graphics one
+    std::optional<uint32_t> asyncComputeFamily;
+    for (uint32_t i = 0; i < queueFamilyCount; i++)
     {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value())
         {
             indices.graphicsFamily = i;
         }
 
-        VkBool32 presentSupport = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if (presentSupport == VK_TRUE)
+        // Without a surface (headless) there is nothing to present to
+        if (surface != VK_NULL_HANDLE)
         {
-            indices.presentFamily = i;
+            VkBool32 presentSupport = VK_FALSE;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            // Prefer presenting from the graphics family
+            if (presentSupport == VK_TRUE && (!indices.presentFamily.has_value() || indices.graphicsFamily == i))
+            {
+                indices.presentFamily = i;
+            }
+        }
+
+        // A transfer-only family maps to the copy (DMA) engines, which run alongside graphics
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            !indices.transferFamily.has_value())
+        {
+            indices.transferFamily = i;
         }
 
-        if (indices.isComplete())
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !asyncComputeFamily.has_value())
         {
-            break;
+            asyncComputeFamily = i;
         }
+    }
 
-        i++;
+    // Next best is an async compute family, which can copy as well
+    if (!indices.transferFamily.has_value())
+    {
+        indices.transferFamily = asyncComputeFamily.has_value() ? asyncComputeFamily : indices.graphicsFamily;
     }
 
     return indices;
@@ -276,29 +418,158 @@ bool VulkanUtils::checkDeviceExtensionSupport(VkPhysicalDevice device)
 
 bool VulkanUtils::isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface)
 {
-    VkPhysicalDeviceProperties deviceProperties;
-    VkPhysicalDeviceFeatures deviceFeatures;
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    QueueFamilyIndices indices = VulkanUtils::findQueueFamilies(device, surface);
+
+    // Headless rendering only needs a graphics queue
+    if (surface == VK_NULL_HANDLE)
+    {
+        return indices.isComplete(false);
+    }
+
+    // Any device type that can present is usable, integrated GPUs and CPU
+    // devices (lavapipe) only lose out in rateDevice
+    if (!indices.isComplete() || !VulkanUtils::checkDeviceExtensionSupport(device))
+    {
+        return false;
+    }
+    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
+    return !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+}
+
+DeviceCapabilities VulkanUtils::probeDevice(VkPhysicalDevice device, VkSurfaceKHR surface, uint32_t instanceApiVersion)
+{
+    DeviceCapabilities capabilities;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    capabilities.name = properties.deviceName;
+    capabilities.type = properties.deviceType;
+    capabilities.apiVersion = properties.apiVersion;
+    capabilities.maxComputeWorkGroupInvocations = properties.limits.maxComputeWorkGroupInvocations;
+    capabilities.maxComputeSharedMemorySize = properties.limits.maxComputeSharedMemorySize;
+    capabilities.timestampPeriod = properties.limits.timestampPeriod;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        const VkMemoryHeap &heap = memoryProperties.memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            capabilities.deviceLocalBytes = std::max(capabilities.deviceLocalBytes, heap.size);
+        }
+    }
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+    for (const auto &extension : extensions)
+    {
+        capabilities.extensions.insert(extension.extensionName);
+    }
 
     QueueFamilyIndices indices = VulkanUtils::findQueueFamilies(device, surface);
+    if (indices.graphicsFamily.has_value())
+    {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+
+        const VkQueueFamilyProperties &graphics = families[indices.graphicsFamily.value()];
+        capabilities.graphicsCompute = (graphics.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+        capabilities.timestampValidBits = capabilities.timestampPeriod > 0.0f ? graphics.timestampValidBits : 0;
+    }
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(device, &features);
+    capabilities.multiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
+    capabilities.drawIndirectFirstInstance = features.drawIndirectFirstInstance == VK_TRUE;
+
+    // Timeline semaphores, draw counts and descriptor indexing are core in Vulkan 1.2
+    if (std::min(instanceApiVersion, properties.apiVersion) >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+
+        capabilities.timelineSemaphores = features12.timelineSemaphore == VK_TRUE;
+        capabilities.drawIndirectCount = features12.drawIndirectCount == VK_TRUE;
+        capabilities.descriptorIndexing = features12.runtimeDescriptorArray && features12.descriptorBindingPartiallyBound &&
+                                          features12.shaderSampledImageArrayNonUniformIndexing &&
+                                          features12.shaderStorageBufferArrayNonUniformIndexing;
+    }
+
+    capabilities.suitable = VulkanUtils::isDeviceSuitable(device, surface);
+    return capabilities;
+}
 
-    bool extensionsSupported = VulkanUtils::checkDeviceExtensionSupport(device);
-    bool swapChainAdequate = false;
-    if (extensionsSupported)
+uint64_t VulkanUtils::rateDevice(const DeviceCapabilities &capabilities)
+{
+    if (!capabilities.suitable)
     {
-        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
-        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        return 0;
     }
 
-    if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-        deviceFeatures.geometryShader &&
-        indices.isComplete() && extensionsSupported && swapChainAdequate)
+    // The device type outweighs everything below, so a CPU device is only picked
+    // when nothing else can render
+    uint64_t score;
+    switch (capabilities.type)
     {
-        return true;
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        score = 40000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        score = 30000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        score = 20000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        score = 1;
+        break;
+    default:
+        score = 10000;
+        break;
     }
 
-    return false;
+    // Then the fast paths it turns on: compute culling and raymarching on the
+    // graphics queue, GPU-driven draws, async uploads and GPU timings
+    if (capabilities.graphicsCompute)
+    {
+        score += 2000;
+    }
+    if (capabilities.multiDrawIndirect && capabilities.drawIndirectFirstInstance)
+    {
+        score += 1000;
+    }
+    if (capabilities.drawIndirectCount)
+    {
+        score += 500;
+    }
+    if (capabilities.descriptorIndexing)
+    {
+        score += 500;
+    }
+    if (capabilities.timelineSemaphores)
+    {
+        score += 500;
+    }
+    if (capabilities.timestampValidBits > 0)
+    {
+        score += 100;
+    }
+
+    // Between otherwise equal devices the one with room for more chunk meshes wins,
+    // a point per 64 MiB of device-local memory up to 64 GiB, then the larger compute groups
+    score += std::min<uint64_t>(capabilities.deviceLocalBytes >> 26, 1024);
+    score += capabilities.maxComputeSharedMemorySize >> 12;
+    score += capabilities.maxComputeWorkGroupInvocations >> 8;
+    return score;
 }
 
 SwapChainSupportDetails VulkanUtils::querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface)
@@ -326,4 +597,20 @@ SwapChainSupportDetails VulkanUtils::querySwapChainSupport(VkPhysicalDevice devi
     }
 
     return details;
-}
\ No newline at end of file
+}
+
+uint32_t VulkanUtils::findMemoryType(VkPhysicalDevice device, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
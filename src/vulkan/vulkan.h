@@ -1,36 +1,103 @@
 #ifndef VULKAN_INIT_H
 #define VULKAN_INIT_H
 
+#include <set>
+#include <string>
+
+struct QueueFamilyIndices
+{
+    std::optional<uint32_t> graphicsFamily;
+    std::optional<uint32_t> presentFamily;
+    // Dedicated transfer family if the device has one, the graphics family otherwise
+    std::optional<uint32_t> transferFamily;
+
+    bool isComplete(bool requirePresent = true)
+    {
+        return graphicsFamily.has_value() && (presentFamily.has_value() || !requirePresent);
+    }
+};
+
+// What a physical device offers, probed for every candidate before one is picked
+struct DeviceCapabilities
+{
+    std::string name;
+    VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    uint32_t apiVersion = 0;
+    // Largest DEVICE_LOCAL heap, the whole of system memory on CPU and most integrated devices
+    VkDeviceSize deviceLocalBytes = 0;
+    std::set<std::string> extensions;
+
+    // Hard requirements met for this context, see VulkanUtils::isDeviceSuitable
+    bool suitable = false;
+    // Whether the graphics family also runs the culling and raymarch compute shaders
+    bool graphicsCompute = false;
+    uint32_t maxComputeWorkGroupInvocations = 0;
+    uint32_t maxComputeSharedMemorySize = 0;
+
+    // Zero valid bits means the graphics family has no timestamps
+    uint32_t timestampValidBits = 0;
+    float timestampPeriod = 0.0f;
+
+    bool multiDrawIndirect = false;
+    bool drawIndirectFirstInstance = false;
+    bool drawIndirectCount = false;
+    bool timelineSemaphores = false;
+    // Runtime-sized, partially bound and non-uniformly indexed descriptor arrays
+    bool descriptorIndexing = false;
+};
+
 struct VulkanContext
 {
+    // Headless contexts have no surface or swapchain and render into offscreen images
+    bool headless = false;
+
     VkInstance instance;
-    VkSurfaceKHR surface;
+    uint32_t apiVersion = 0;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
-    VkSwapchainKHR swapChain;
+    // Same handle as graphicsQueue when there is no dedicated transfer family
+    VkQueue transferQueue;
+    QueueFamilyIndices queueFamilies;
+    // Everything the picked device supports, the flags below are what was enabled
+    DeviceCapabilities capabilities;
+    bool timelineSemaphores = false;
+    // Optional draw features enabled on the device, ChunkRenderer picks its draw path from these
+    bool multiDrawIndirect = false;
+    bool drawIndirectFirstInstance = false;
+    bool drawIndirectCount = false;
+    uint32_t maxDrawIndirectCount = 1;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    // In headless mode these are the offscreen images, one per frame in flight
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
+    VkImageUsageFlags swapChainImageUsage = 0;
     VkRenderPass renderPass;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
     std::vector<VkFramebuffer> swapChainFramebuffers;
-    VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-};
 
-struct QueueFamilyIndices
-{
-    std::optional<uint32_t> graphicsFamily;
-    std::optional<uint32_t> presentFamily;
+    // Per-frame resources, indexed by currentFrame
+    uint32_t maxFramesInFlight = 2;
+    uint32_t currentFrame = 0;
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    std::vector<VkFence> inFlightFences;
 
-    bool isComplete()
-    {
-        return graphicsFamily.has_value() && presentFamily.has_value();
-    }
+    // Fence of the frame currently using each swapchain image, indexed by imageIndex
+    std::vector<VkFence> imagesInFlight;
+    // Signaled by the frame rendering into each swapchain image and waited on by
+    // its present, indexed by imageIndex. The frame fence does not cover the
+    // present's wait, so these cannot be reused per frame in flight.
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+
+    // Headless offscreen targets and their host-visible readback buffers, indexed by imageIndex
+    std::vector<VkDeviceMemory> offscreenImageMemory;
+    std::vector<VkBuffer> readbackBuffers;
+    std::vector<VkDeviceMemory> readbackMemory;
+    std::vector<void *> readbackMapped;
 };
 
 struct SwapChainSupportDetails
@@ -45,14 +112,30 @@ class VulkanUtils
 public:
     static void createVulkanInstance(VulkanContext &vulkan);
     static void createSurface(VulkanContext &vulkan, GLFWwindow *window);
-    static void pickPhysicalDevice(VulkanContext &vulkan);
+    // Picks the best scoring suitable device, or the one named by preferredDevice: an
+    // index into the enumeration order or part of the device name
+    static void pickPhysicalDevice(VulkanContext &vulkan, const std::string &preferredDevice = "");
     static void createLogicalDevice(VulkanContext &vulkan);
 
     static bool checkValidationLayerSupport(const std::vector<const char *> &validationLayers);
     static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
     static bool checkDeviceExtensionSupport(VkPhysicalDevice device);
     static bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
+    static DeviceCapabilities probeDevice(VkPhysicalDevice device, VkSurfaceKHR surface, uint32_t instanceApiVersion);
+    static uint64_t rateDevice(const DeviceCapabilities &capabilities);
     static SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
+    static uint32_t findMemoryType(VkPhysicalDevice device, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+    // Headless rendering, see offscreen.cpp
+    static void createOffscreenTargets(VulkanContext &vulkan, VkFormat format, VkExtent2D extent, uint32_t count);
+    static void destroyOffscreenTargets(VulkanContext &vulkan);
+    static void recordReadback(VulkanContext &vulkan, VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    static std::vector<uint8_t> readbackImage(VulkanContext &vulkan, uint32_t imageIndex);
+    static void writePPM(const std::string &filename, VkExtent2D extent, const std::vector<uint8_t> &rgba);
+
+    // Persistent pipeline cache, see pipeline_cache.cpp
+    static bool loadPipelineCache(VulkanContext &vulkan, const std::string &filename);
+    static void savePipelineCache(VulkanContext &vulkan, const std::string &filename);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,434 @@
+#include <algorithm>
+
+#include "chunk.h"
+#include "chunk_codec.h"
+
+static const size_t maxPaletteSize = 256;
+
+Chunk::Chunk(Voxel fill)
+{
+    makeUniform(fill);
+}
+
+uint32_t Chunk::bitsForPaletteSize(size_t size)
+{
+    if (size <= 1)
+    {
+        return 0;
+    }
+    if (size <= 2)
+    {
+        return 1;
+    }
+    if (size <= 4)
+    {
+        return 2;
+    }
+    if (size <= 16)
+    {
+        return 4;
+    }
+    if (size <= maxPaletteSize)
+    {
+        return 8;
+    }
+    return DIRECT_BITS;
+}
+
+// Widths are powers of two that divide 64, so an entry never straddles two words
+uint32_t Chunk::readIndex(int index) const
+{
+    uint64_t bit = static_cast<uint64_t>(index) * bitsPerVoxel;
+    uint64_t mask = (1ull << bitsPerVoxel) - 1;
+    return static_cast<uint32_t>((words[bit >> 6] >> (bit & 63)) & mask);
+}
+
+void Chunk::writeIndex(int index, uint32_t value)
+{
+    uint64_t bit = static_cast<uint64_t>(index) * bitsPerVoxel;
+    uint64_t mask = (1ull << bitsPerVoxel) - 1;
+    uint64_t &word = words[bit >> 6];
+    word = (word & ~(mask << (bit & 63))) | (static_cast<uint64_t>(value) << (bit & 63));
+}
+
+Voxel Chunk::get(int index) const
+{
+    if (bitsPerVoxel == 0)
+    {
+        return palette[0];
+    }
+
+    uint32_t value = readIndex(index);
+    return bitsPerVoxel == DIRECT_BITS ? static_cast<Voxel>(value) : palette[value];
+}
+
+void Chunk::set(int index, Voxel value)
+{
+    if (bitsPerVoxel == DIRECT_BITS)
+    {
+        writeIndex(index, value);
+        return;
+    }
+
+    uint32_t old = bitsPerVoxel == 0 ? 0 : readIndex(index);
+    if (palette[old] == value)
+    {
+        return;
+    }
+
+    uint32_t slot = static_cast<uint32_t>(palette.size());
+    uint32_t freeSlot = slot;
+    for (uint32_t i = 0; i < palette.size(); i++)
+    {
+        if (palette[i] == value)
+        {
+            slot = i;
+            break;
+        }
+        if (paletteCounts[i] == 0 && freeSlot == palette.size())
+        {
+            freeSlot = i;
+        }
+    }
+
+    if (slot == palette.size())
+    {
+        if (freeSlot < palette.size())
+        {
+            slot = freeSlot;
+            palette[slot] = value;
+        }
+        else if (palette.size() < (1u << bitsPerVoxel))
+        {
+            palette.push_back(value);
+            paletteCounts.push_back(0);
+        }
+        else
+        {
+            uint32_t newBits = bitsForPaletteSize(palette.size() + 1);
+            if (newBits == DIRECT_BITS)
+            {
+                std::vector<Voxel> voxels(VOLUME);
+                decode(voxels.data());
+                voxels[index] = value;
+                buildFrom(voxels.data());
+                return;
+            }
+
+            std::vector<uint16_t> indices;
+            unpackIndices(indices);
+            palette.push_back(value);
+            paletteCounts.push_back(0);
+            repack(newBits, indices);
+        }
+    }
+
+    paletteCounts[old]--;
+    paletteCounts[slot]++;
+    writeIndex(index, slot);
+
+    if (paletteCounts[slot] == VOLUME)
+    {
+        makeUniform(value);
+    }
+}
+
+void Chunk::fill(Voxel value)
+{
+    makeUniform(value);
+}
+
+void Chunk::decode(Voxel *out) const
+{
+    if (bitsPerVoxel == 0)
+    {
+        std::fill(out, out + VOLUME, palette[0]);
+        return;
+    }
+
+    // Walk whole words instead of calling get() per voxel
+    uint32_t perWord = 64 / bitsPerVoxel;
+    uint64_t mask = (1ull << bitsPerVoxel) - 1;
+    bool direct = bitsPerVoxel == DIRECT_BITS;
+
+    Voxel *cursor = out;
+    for (uint64_t word : words)
+    {
+        for (uint32_t i = 0; i < perWord; i++)
+        {
+            uint32_t value = static_cast<uint32_t>(word & mask);
+            *cursor++ = direct ? static_cast<Voxel>(value) : palette[value];
+            word >>= bitsPerVoxel;
+        }
+    }
+}
+
+void Chunk::encode(const Voxel *voxels)
+{
+    buildFrom(voxels);
+}
+
+void Chunk::compact()
+{
+    if (bitsPerVoxel == 0)
+    {
+        return;
+    }
+
+    std::vector<Voxel> voxels(VOLUME);
+    decode(voxels.data());
+    buildFrom(voxels.data());
+}
+
+size_t Chunk::memoryUsage() const
+{
+    return sizeof(Chunk) + palette.capacity() * sizeof(Voxel) + paletteCounts.capacity() * sizeof(uint32_t) +
+           words.capacity() * sizeof(uint64_t) + lights.capacity();
+}
+
+void Chunk::setLight(int index, uint8_t value)
+{
+    if (lights.empty())
+    {
+        if (value == uniformLight)
+        {
+            return;
+        }
+        lights.assign(VOLUME, uniformLight);
+    }
+    lights[index] = value;
+}
+
+void Chunk::fillLight(uint8_t value)
+{
+    lights.clear();
+    lights.shrink_to_fit();
+    uniformLight = value;
+}
+
+void Chunk::compactLight()
+{
+    if (lights.empty())
+    {
+        return;
+    }
+    uint8_t first = lights[0];
+    if (std::all_of(lights.begin(), lights.end(), [first](uint8_t light) { return light == first; }))
+    {
+        fillLight(first);
+    }
+}
+
+static const uint8_t codecVersion = 1;
+
+void Chunk::compress(std::vector<uint8_t> &out) const
+{
+    out.clear();
+    out.push_back(codecVersion);
+    writeVarint(out, static_cast<uint32_t>(palette.size()));
+    for (Voxel value : palette)
+    {
+        writeVarint(out, value);
+    }
+
+    // Palette indices, or the voxels themselves in direct mode
+    thread_local std::vector<uint8_t> runs;
+    runs.clear();
+    const uint16_t *order = mortonOrder();
+    uint32_t current = bitsPerVoxel == 0 ? 0 : readIndex(order[0]);
+    uint32_t length = 0;
+    for (int i = 0; i < VOLUME; i++)
+    {
+        uint32_t value = bitsPerVoxel == 0 ? 0 : readIndex(order[i]);
+        if (value != current)
+        {
+            writeVarint(runs, current);
+            writeVarint(runs, length - 1);
+            current = value;
+            length = 0;
+        }
+        length++;
+    }
+    writeVarint(runs, current);
+    writeVarint(runs, length - 1);
+
+    writeVarint(out, static_cast<uint32_t>(runs.size()));
+    lzCompress(runs.data(), runs.size(), out);
+}
+
+bool Chunk::decompress(const uint8_t *data, size_t size)
+{
+    const uint8_t *end = data + size;
+    uint32_t paletteSize = 0;
+    if (size == 0 || *data++ != codecVersion || !readVarint(data, end, paletteSize) ||
+        paletteSize > maxPaletteSize)
+    {
+        return false;
+    }
+    std::vector<Voxel> newPalette(paletteSize);
+    for (Voxel &value : newPalette)
+    {
+        uint32_t read;
+        if (!readVarint(data, end, read) || read > UINT16_MAX)
+        {
+            return false;
+        }
+        value = static_cast<Voxel>(read);
+    }
+
+    // Every run takes at least two bytes
+    uint32_t runBytes = 0;
+    if (!readVarint(data, end, runBytes) || runBytes > 2 * 5 * static_cast<uint32_t>(VOLUME))
+    {
+        return false;
+    }
+    thread_local std::vector<uint8_t> runs;
+    runs.resize(runBytes);
+    if (!lzDecompress(data, end - data, runs.data(), runs.size()))
+    {
+        return false;
+    }
+
+    thread_local std::vector<uint16_t> indices(VOLUME);
+    std::vector<uint32_t> counts(paletteSize, 0);
+    const uint16_t *order = mortonOrder();
+    const uint8_t *run = runs.data();
+    const uint8_t *runsEnd = run + runs.size();
+    uint32_t position = 0;
+    while (run < runsEnd)
+    {
+        uint32_t value, length;
+        if (!readVarint(run, runsEnd, value) || !readVarint(run, runsEnd, length) ||
+            length >= static_cast<uint32_t>(VOLUME) - position || value > UINT16_MAX ||
+            (paletteSize && value >= paletteSize))
+        {
+            return false;
+        }
+        length++;
+        for (uint32_t i = position; i < position + length; i++)
+        {
+            indices[order[i]] = static_cast<uint16_t>(value);
+        }
+        if (paletteSize)
+        {
+            counts[value] += length;
+        }
+        position += length;
+    }
+    if (position != static_cast<uint32_t>(VOLUME))
+    {
+        return false;
+    }
+
+    if (paletteSize == 0)
+    {
+        palette = std::vector<Voxel>();
+        paletteCounts = std::vector<uint32_t>();
+        repack(DIRECT_BITS, indices);
+        return true;
+    }
+    uint32_t bits = bitsForPaletteSize(paletteSize);
+    if (bits == 0)
+    {
+        makeUniform(newPalette[0]);
+        return true;
+    }
+    palette.swap(newPalette);
+    paletteCounts.swap(counts);
+    repack(bits, indices);
+    return true;
+}
+
+void Chunk::unpackIndices(std::vector<uint16_t> &indices) const
+{
+    indices.assign(VOLUME, 0);
+    if (bitsPerVoxel == 0)
+    {
+        return;
+    }
+
+    uint32_t perWord = 64 / bitsPerVoxel;
+    uint64_t mask = (1ull << bitsPerVoxel) - 1;
+    size_t i = 0;
+    for (uint64_t word : words)
+    {
+        for (uint32_t j = 0; j < perWord; j++)
+        {
+            indices[i++] = static_cast<uint16_t>(word & mask);
+            word >>= bitsPerVoxel;
+        }
+    }
+}
+
+void Chunk::repack(uint32_t newBits, const std::vector<uint16_t> &indices)
+{
+    bitsPerVoxel = newBits;
+    words = std::vector<uint64_t>(static_cast<size_t>(VOLUME) * newBits / 64, 0);
+
+    uint32_t perWord = 64 / newBits;
+    for (size_t w = 0; w < words.size(); w++)
+    {
+        uint64_t word = 0;
+        for (uint32_t j = perWord; j > 0; j--)
+        {
+            word = (word << newBits) | indices[w * perWord + j - 1];
+        }
+        words[w] = word;
+    }
+}
+
+void Chunk::makeUniform(Voxel value)
+{
+    bitsPerVoxel = 0;
+    palette.assign(1, value);
+    paletteCounts.assign(1, VOLUME);
+    words = std::vector<uint64_t>();
+}
+
+void Chunk::buildFrom(const Voxel *voxels)
+{
+    std::vector<uint16_t> indices(VOLUME);
+    palette.assign(1, voxels[0]);
+    paletteCounts.assign(1, 0);
+
+    // Neighbouring voxels are usually equal, so only search the palette when the value changes
+    Voxel last = voxels[0];
+    uint16_t lastIndex = 0;
+    for (int i = 0; i < VOLUME; i++)
+    {
+        if (voxels[i] != last)
+        {
+            last = voxels[i];
+            auto it = std::find(palette.begin(), palette.end(), last);
+            if (it == palette.end())
+            {
+                if (palette.size() == maxPaletteSize)
+                {
+                    palette = std::vector<Voxel>();
+                    paletteCounts = std::vector<uint32_t>();
+                    std::vector<uint16_t> direct(voxels, voxels + VOLUME);
+                    repack(DIRECT_BITS, direct);
+                    return;
+                }
+                palette.push_back(last);
+                paletteCounts.push_back(0);
+                it = palette.end() - 1;
+            }
+            lastIndex = static_cast<uint16_t>(it - palette.begin());
+        }
+
+        indices[i] = lastIndex;
+        paletteCounts[lastIndex]++;
+    }
+
+    uint32_t bits = bitsForPaletteSize(palette.size());
+    if (bits == 0)
+    {
+        makeUniform(palette[0]);
+        return;
+    }
+
+    palette.shrink_to_fit();
+    paletteCounts.shrink_to_fit();
+    repack(bits, indices);
+}
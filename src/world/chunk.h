@@ -0,0 +1,91 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Material id of a single voxel, 0 is air
+typedef uint16_t Voxel;
+
+// A cube of SIZE^3 voxels stored as indices into a palette of the distinct
+// values it contains. Indices are bit-packed into 64-bit words at 1, 2, 4 or 8
+// bits each, and the width doubles whenever the palette outgrows it. A chunk
+// holding a single value stores only that value. Past 256 distinct values the
+// palette stops paying off and voxels are stored directly as 16-bit values.
+//
+// Voxels are laid out x-fastest, then y, then z, see index().
+class Chunk
+{
+public:
+    static const int SIZE_BITS = 5;
+    static const int SIZE = 1 << SIZE_BITS;
+    static const int VOLUME = SIZE * SIZE * SIZE;
+
+    explicit Chunk(Voxel fill = 0);
+
+    static int index(int x, int y, int z) { return x | (y << SIZE_BITS) | (z << (2 * SIZE_BITS)); }
+
+    Voxel get(int x, int y, int z) const { return get(index(x, y, z)); }
+    Voxel get(int index) const;
+    void set(int x, int y, int z, Voxel value) { set(index(x, y, z), value); }
+    void set(int index, Voxel value);
+
+    void fill(Voxel value);
+
+    // Bulk conversion to and from VOLUME voxels in index() order
+    void decode(Voxel *out) const;
+    void encode(const Voxel *voxels);
+
+    // Drops palette entries no voxel uses anymore and narrows the bit width,
+    // down to a single value if the chunk became uniform
+    void compact();
+
+    bool isUniform() const { return bitsPerVoxel == 0; }
+    uint32_t getBitsPerVoxel() const { return bitsPerVoxel; }
+    size_t getPaletteSize() const { return palette.size(); }
+    // Heap and inline bytes owned by this chunk
+    size_t memoryUsage() const;
+
+    // Light of each voxel, packed as light.h describes. It is derived from the
+    // voxels by ChunkLighter, so compress() leaves it out and nothing that
+    // replaces the voxels touches it. Stored as a single value until two voxels
+    // differ, like the palette.
+    uint8_t getLight(int index) const { return lights.empty() ? uniformLight : lights[index]; }
+    void setLight(int index, uint8_t value);
+    void fillLight(uint8_t value);
+    bool isLightUniform() const { return lights.empty(); }
+    // Back to a single value if every voxel has the same light
+    void compactLight();
+
+    // Lossless storage form, typically a few hundred bytes for terrain: the
+    // palette, then runs of equal voxels along a Morton curve as varint pairs,
+    // then an LZ pass over the runs, see chunk_codec.h. Replaces out.
+    void compress(std::vector<uint8_t> &out) const;
+    // Replaces the chunk with compressed data, false and unchanged if it is malformed
+    bool decompress(const uint8_t *data, size_t size);
+
+private:
+    static const uint32_t DIRECT_BITS = 16;
+
+    // 0 (uniform), 1, 2, 4, 8 or DIRECT_BITS
+    uint32_t bitsPerVoxel = 0;
+    // Empty in direct mode
+    std::vector<Voxel> palette;
+    // Number of voxels using each palette entry, entries at 0 are reused before the palette grows
+    std::vector<uint32_t> paletteCounts;
+    std::vector<uint64_t> words;
+    // Empty while every voxel has uniformLight
+    std::vector<uint8_t> lights;
+    uint8_t uniformLight = 0;
+
+    uint32_t readIndex(int index) const;
+    void writeIndex(int index, uint32_t value);
+    void repack(uint32_t newBits, const std::vector<uint16_t> &indices);
+    void unpackIndices(std::vector<uint16_t> &indices) const;
+    void makeUniform(Voxel value);
+    void buildFrom(const Voxel *voxels);
+    static uint32_t bitsForPaletteSize(size_t size);
+};
+
+#endif
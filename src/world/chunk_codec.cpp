@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "chunk.h"
+#include "chunk_codec.h"
+
+static const uint32_t minMatch = 4;
+static const uint32_t maxOffset = 65535;
+static const int hashBits = 12;
+
+const uint16_t *mortonOrder()
+{
+    static const std::array<uint16_t, Chunk::VOLUME> order = []
+    {
+        std::array<uint16_t, Chunk::VOLUME> table{};
+        for (uint32_t morton = 0; morton < static_cast<uint32_t>(Chunk::VOLUME); morton++)
+        {
+            int x = 0, y = 0, z = 0;
+            for (int bit = 0; bit < Chunk::SIZE_BITS; bit++)
+            {
+                x |= ((morton >> (3 * bit)) & 1) << bit;
+                y |= ((morton >> (3 * bit + 1)) & 1) << bit;
+                z |= ((morton >> (3 * bit + 2)) & 1) << bit;
+            }
+            table[morton] = static_cast<uint16_t>(Chunk::index(x, y, z));
+        }
+        return table;
+    }();
+    return order.data();
+}
+
+void writeVarint(std::vector<uint8_t> &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (data == end)
+        {
+            return false;
+        }
+        uint8_t byte = *data++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return shift < 28 || byte < 16;
+        }
+    }
+    return false;
+}
+
+static uint32_t read32(const uint8_t *data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Lengths of 15 and more continue in bytes of up to 255
+static void writeLength(std::vector<uint8_t> &out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        out.push_back(255);
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+static void writeSequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t literalCount, uint32_t offset,
+                          size_t matchLength)
+{
+    size_t matchCode = matchLength ? matchLength - minMatch : 0;
+    out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+    if (literalCount >= 15)
+    {
+        writeLength(out, literalCount - 15);
+    }
+    out.insert(out.end(), literals, literals + literalCount);
+    if (!matchLength)
+    {
+        return;
+    }
+    out.push_back(static_cast<uint8_t>(offset));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (matchCode >= 15)
+    {
+        writeLength(out, matchCode - 15);
+    }
+}
+
+// Greedy, one candidate per hash of the next 4 bytes. The stream always ends
+// with a sequence of literals only, possibly empty.
+void lzCompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+    // Positions + 1, 0 is empty
+    uint32_t table[1 << hashBits] = {};
+    size_t anchor = 0;
+    size_t position = 0;
+    while (size >= minMatch && position <= size - minMatch)
+    {
+        uint32_t sequence = read32(data + position);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+        size_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(position + 1);
+
+        if (candidate == 0 || position - (candidate - 1) > maxOffset || read32(data + candidate - 1) != sequence)
+        {
+            position++;
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t length = minMatch;
+        while (position + length < size && data[match + length] == data[position + length])
+        {
+            length++;
+        }
+        writeSequence(out, data + anchor, position - anchor, static_cast<uint32_t>(position - match), length);
+        position += length;
+        anchor = position;
+    }
+    writeSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+static bool readLength(const uint8_t *&data, const uint8_t *end, size_t &length)
+{
+    uint8_t byte;
+    do
+    {
+        if (data == end)
+        {
+            return false;
+        }
+        byte = *data++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool lzDecompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize)
+{
+    const uint8_t *end = data + size;
+    size_t written = 0;
+    while (data < end)
+    {
+        uint8_t token = *data++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(data, end, literals))
+        {
+            return false;
+        }
+        if (literals > static_cast<size_t>(end - data) || literals > outSize - written)
+        {
+            return false;
+        }
+        std::memcpy(out + written, data, literals);
+        data += literals;
+        written += literals;
+
+        if (data == end)
+        {
+            break;
+        }
+        if (end - data < 2)
+        {
+            return false;
+        }
+        size_t offset = data[0] | (data[1] << 8);
+        data += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(data, end, length))
+        {
+            return false;
+        }
+        length += minMatch;
+        if (offset == 0 || offset > written || length > outSize - written)
+        {
+            return false;
+        }
+
+        // Matches may overlap the bytes they produce, which repeats short patterns
+        uint8_t *target = out + written;
+        const uint8_t *source = target - offset;
+        if (offset >= length)
+        {
+            std::memcpy(target, source, length);
+        }
+        else
+        {
+            for (size_t i = 0; i < length; i++)
+            {
+                target[i] = source[i];
+            }
+        }
+        written += length;
+    }
+    return written == outSize;
+}
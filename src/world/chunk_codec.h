@@ -0,0 +1,27 @@
+#ifndef CHUNK_CODEC_H
+#define CHUNK_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Building blocks of Chunk::compress() and Chunk::decompress()
+
+// Chunk::index() of each voxel in Morton (Z-curve) order, Chunk::VOLUME entries.
+// Neighbouring voxels stay close along the curve in all three axes, so runs of
+// equal voxels are longer than in row order.
+const uint16_t *mortonOrder();
+
+// LEB128, 7 bits per byte, low bits first
+void writeVarint(std::vector<uint8_t> &out, uint32_t value);
+// False if the varint runs past end or does not fit 32 bits
+bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value);
+
+// LZ77 in the style of LZ4 blocks: byte-aligned sequences of literals and a
+// match of at least 4 bytes from up to 64 KiB back, without an entropy stage,
+// which keeps decoding close to memcpy speed. Appends to out.
+void lzCompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+// False if the stream is malformed or does not decode to exactly outSize bytes
+bool lzDecompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize);
+
+#endif
@@ -0,0 +1,833 @@
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <unordered_set>
+
+#include "../profile/profiler.h"
+#include "chunk_loader.h"
+#include "terrain.h"
+
+// Chunks within this many chunks of the focus, on every axis, go into the high lane
+static const int32_t nearDistance = 2;
+
+static const ChunkCoord neighbourOffsets[FACE_COUNT] = {
+    {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+static ChunkCoord offsetCoord(const ChunkCoord &coord, const ChunkCoord &offset)
+{
+    return {coord.x + offset.x, coord.y + offset.y, coord.z + offset.z};
+}
+
+static int32_t chunkDistance(const ChunkCoord &a, const ChunkCoord &b)
+{
+    return std::max({std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z)});
+}
+
+void ChunkLoader::init(World &loaderWorld, JobSystem &jobSystem, int32_t lodRadius, RegionStore *regionStore)
+{
+    world = &loaderWorld;
+    jobs = &jobSystem;
+    store = regionStore;
+    streaming = false;
+    unloaded.clear();
+    lod = ChunkLodSelector(lodRadius);
+    cancelled = false;
+}
+
+void ChunkLoader::shutdown()
+{
+    if (!jobs)
+    {
+        return;
+    }
+
+    cancelled = true;
+    // A job that failed must not keep the chunks that are fine from being saved
+    std::exception_ptr error;
+    try
+    {
+        jobs->wait(inFlight);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // Chunks still generating were cancelled and never made it into the world
+    if (store)
+    {
+        for (const auto &entry : entries)
+        {
+            if (entry.second.unsaved && entry.second.state != ChunkState::Generating)
+            {
+                const Chunk *chunk = world->getChunk(entry.first);
+                store->stage(entry.first, chunk ? compress(*chunk) : nullptr);
+            }
+        }
+        store->flushAll();
+    }
+    entries.clear();
+    lightWork.clear();
+    pendingEdits.clear();
+    edited.clear();
+    cold.clear();
+    coldBytes = 0;
+    jobs = nullptr;
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ChunkLoader::requestArea(const ChunkCoord &min, const ChunkCoord &max, const ChunkCoord &focus)
+{
+    std::vector<std::pair<int64_t, ChunkCoord>> requests;
+    for (int32_t z = min.z; z < max.z; z++)
+    {
+        for (int32_t y = min.y; y < max.y; y++)
+        {
+            for (int32_t x = min.x; x < max.x; x++)
+            {
+                ChunkCoord coord{x, y, z};
+                if (entries.count(coord) || world->getChunk(coord))
+                {
+                    continue;
+                }
+                int64_t dx = x - focus.x, dy = y - focus.y, dz = z - focus.z;
+                requests.push_back({dx * dx + dy * dy + dz * dz, coord});
+            }
+        }
+    }
+
+    std::sort(requests.begin(), requests.end(),
+              [](const std::pair<int64_t, ChunkCoord> &a, const std::pair<int64_t, ChunkCoord> &b)
+              { return a.first < b.first; });
+
+    for (const auto &request : requests)
+    {
+        const ChunkCoord coord = request.second;
+        JobPriority priority = chunkDistance(coord, focus) <= nearDistance ? JobPriority::High : JobPriority::Normal;
+        entries[coord] = {ChunkState::Generating, priority};
+
+        std::shared_ptr<const std::vector<uint8_t>> compressed;
+        auto it = cold.find(coord);
+        if (it != cold.end())
+        {
+            compressed = std::move(it->second.data);
+            coldBytes -= compressed->size();
+            cold.erase(it);
+        }
+
+        jobs->submit([this, coord, compressed]
+                     {
+                         if (cancelled)
+                         {
+                             return;
+                         }
+
+                         std::unique_ptr<Chunk> chunk;
+                         if (compressed)
+                         {
+                             PROFILE_SCOPE("decompressChunk");
+                             chunk = std::make_unique<Chunk>();
+                             if (chunk->decompress(compressed->data(), compressed->size()))
+                             {
+                                 generated.push({coord, std::move(chunk), false});
+                                 return;
+                             }
+                             chunk.reset();
+                         }
+                         if (store)
+                         {
+                             PROFILE_SCOPE("loadChunk");
+                             if (store->load(coord, chunk) != StoredChunk::Missing)
+                             {
+                                 generated.push({coord, std::move(chunk), false});
+                                 return;
+                             }
+                         }
+
+                         PROFILE_SCOPE("generateChunk");
+                         thread_local std::vector<Voxel> voxels(Chunk::VOLUME);
+                         if (generateTerrainChunk(coord, voxels.data(), terrainSeed))
+                         {
+                             chunk = std::make_unique<Chunk>();
+                             chunk->encode(voxels.data());
+                         }
+                         generated.push({coord, std::move(chunk), true});
+                     },
+                     priority, &inFlight);
+    }
+}
+
+void ChunkLoader::update(std::vector<LoadedMesh> &out, size_t maxMeshes)
+{
+    // Load and save jobs throw on unreadable or full region files
+    if (std::exception_ptr error = inFlight.takeError())
+    {
+        std::rethrow_exception(error);
+    }
+
+    meshRetries.clear();
+    generatedScratch.clear();
+    generated.drain(generatedScratch);
+    for (GeneratedChunk &result : generatedScratch)
+    {
+        if (result.chunk)
+        {
+            world->insertChunk(result.coord, std::move(result.chunk));
+        }
+        Entry &entry = entries[result.coord];
+        entry.state = ChunkState::Generated;
+        entry.level = static_cast<uint8_t>(lod.levelFor(result.coord));
+        entry.unsaved = result.unsaved;
+        generatedCount++;
+    }
+
+    for (const GeneratedChunk &result : generatedScratch)
+    {
+        queueArrivalLight(result.coord);
+        meshRetries.push_back(result.coord);
+    }
+    collectLit();
+
+    size_t first = out.size();
+    meshed.drain(out, maxMeshes);
+    for (size_t i = first; i < out.size(); i++)
+    {
+        Entry &entry = entries[out[i].coord];
+        entry.state = ChunkState::Done;
+        meshedCount++;
+        if (entry.remesh)
+        {
+            entry.remesh = false;
+            requestRemesh(out[i].coord);
+        }
+    }
+
+    applyPendingEdits();
+    scheduleLighting();
+
+    // A new chunk can complete its own neighbourhood and that of the chunks
+    // around it, and so can light that settled
+    for (const ChunkCoord &coord : meshRetries)
+    {
+        tryScheduleMesh(coord);
+        for (const ChunkCoord &offset : neighbourOffsets)
+        {
+            tryScheduleMesh(offsetCoord(coord, offset));
+        }
+    }
+}
+
+// Every loaded neighbour learns what is across its face now: light to spread
+// into, or open sky. A neighbour lit while this chunk was still unknown open
+// sky above it loses that sky light again.
+void ChunkLoader::queueArrivalLight(const ChunkCoord &coord)
+{
+    bool stored = world->getChunk(coord) != nullptr;
+    if (stored)
+    {
+        ChunkLightWork work;
+        work.initial = true;
+        addLightWork(coord, std::move(work));
+    }
+
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        ChunkCoord neighbourCoord = offsetCoord(coord, neighbourOffsets[face]);
+        auto neighbour = entries.find(neighbourCoord);
+        if (neighbour == entries.end() || neighbour->second.state == ChunkState::Generating)
+        {
+            continue;
+        }
+
+        // The neighbour's face that looks at this chunk
+        uint8_t towards = static_cast<uint8_t>(1u << (face ^ 1));
+        ChunkLightWork work;
+        if (stored)
+        {
+            work.exportFaces = towards;
+            work.closedFaces = neighbour->second.litOpenFaces & towards;
+        }
+        else
+        {
+            work.openedFaces = towards;
+        }
+        addLightWork(neighbourCoord, std::move(work));
+    }
+}
+
+void ChunkLoader::collectLit()
+{
+    litScratch.clear();
+    lit.drain(litScratch);
+    for (LitChunk &done : litScratch)
+    {
+        Entry &entry = entries[done.coord];
+        entry.lighting = false;
+        lightJobCount++;
+        meshRetries.push_back(done.coord);
+
+        ChunkLightResult &result = done.result;
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            ChunkCoord neighbourCoord = offsetCoord(done.coord, neighbourOffsets[face]);
+            if (!result.outgoing[face].empty())
+            {
+                ChunkLightWork work;
+                work.messages = std::move(result.outgoing[face]);
+                addLightWork(neighbourCoord, std::move(work));
+            }
+
+            // Level 0 neighbours light their faces with this chunk's border voxels
+            if ((result.changedFaces & (1u << face)) && entry.level == 0)
+            {
+                auto neighbour = entries.find(neighbourCoord);
+                if (neighbour != entries.end() && neighbour->second.level == 0)
+                {
+                    requestRemesh(neighbourCoord);
+                }
+            }
+        }
+
+        // Coarser levels are meshed as if under open sky
+        if (result.changed && entry.level == 0)
+        {
+            requestRemesh(done.coord);
+        }
+    }
+}
+
+// Air and chunks that are still generating have no light to change, they take
+// in their neighbours' light once they arrive
+void ChunkLoader::addLightWork(const ChunkCoord &coord, ChunkLightWork &&work)
+{
+    auto it = entries.find(coord);
+    if (it == entries.end() || it->second.state == ChunkState::Generating || !world->getChunk(coord))
+    {
+        return;
+    }
+    lightWork[coord].merge(std::move(work));
+}
+
+// Open sky is air that is known not to be stored, or nothing requested above
+uint8_t ChunkLoader::openFacesOf(const ChunkCoord &coord) const
+{
+    uint8_t openFaces = 0;
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        ChunkCoord neighbourCoord = offsetCoord(coord, neighbourOffsets[face]);
+        auto neighbour = entries.find(neighbourCoord);
+        bool open = neighbour == entries.end()
+                        ? face == FACE_POS_Y
+                        : neighbour->second.state != ChunkState::Generating && !world->getChunk(neighbourCoord);
+        if (open)
+        {
+            openFaces |= 1u << face;
+        }
+    }
+    return openFaces;
+}
+
+// One job per chunk with pending light. The job writes the chunk's light, so
+// it waits while the chunk or a neighbour is being meshed.
+void ChunkLoader::scheduleLighting()
+{
+    for (auto it = lightWork.begin(); it != lightWork.end();)
+    {
+        const ChunkCoord coord = it->first;
+        auto entry = entries.find(coord);
+        Chunk *chunk = world->getChunk(coord);
+        if (entry == entries.end() || !chunk)
+        {
+            meshRetries.push_back(coord);
+            it = lightWork.erase(it);
+            continue;
+        }
+
+        bool blocked = entry->second.lighting || entry->second.state == ChunkState::Meshing;
+        for (const ChunkCoord &offset : neighbourOffsets)
+        {
+            auto neighbour = entries.find(offsetCoord(coord, offset));
+            blocked |= neighbour != entries.end() && neighbour->second.state == ChunkState::Meshing;
+        }
+        if (blocked)
+        {
+            ++it;
+            continue;
+        }
+
+        uint8_t openFaces = openFacesOf(coord);
+        entry->second.lighting = true;
+        // A face that closed before its neighbour arrived still holds its sky
+        // until the arrival sends closedFaces, even if the chunk is lit meanwhile
+        entry->second.litOpenFaces = openFaces | (entry->second.litOpenFaces & ~it->second.closedFaces);
+        jobs->submit([this, coord, chunk, openFaces, work = std::move(it->second)]
+                     {
+                         if (cancelled)
+                         {
+                             return;
+                         }
+
+                         PROFILE_SCOPE("lightChunk");
+                         thread_local ChunkLighter lighter;
+                         LitChunk result;
+                         result.coord = coord;
+                         lighter.light(*chunk, work, openFaces, result.result);
+                         lit.push(std::move(result));
+                     },
+                     entry->second.priority, &inFlight);
+        it = lightWork.erase(it);
+    }
+}
+
+bool ChunkLoader::isLightSettled(const ChunkCoord &coord) const
+{
+    for (int32_t i = -1; i < static_cast<int32_t>(FACE_COUNT); i++)
+    {
+        ChunkCoord around = i < 0 ? coord : offsetCoord(coord, neighbourOffsets[i]);
+        auto it = entries.find(around);
+        if ((it != entries.end() && it->second.lighting) || lightWork.count(around))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t ChunkLoader::edit(const VoxelEditBatch &batch)
+{
+    if (batch.empty())
+    {
+        return 0;
+    }
+
+    std::vector<ChunkCoord> coords;
+    batch.collectChunks(coords);
+    auto shared = std::make_shared<const VoxelEditBatch>(batch);
+    uint64_t time = Profiler::now();
+    size_t skipped = 0;
+    for (const ChunkCoord &coord : coords)
+    {
+        // Cold chunks would have to be decompressed first, and chunks that were
+        // never loaded would be overwritten by the generator
+        if (!entries.count(coord))
+        {
+            skipped++;
+            continue;
+        }
+        pendingEdits.push_back({coord, shared, time});
+    }
+    applyPendingEdits();
+    return skipped;
+}
+
+void ChunkLoader::takeEdited(std::vector<EditedChunk> &out)
+{
+    out.insert(out.end(), edited.begin(), edited.end());
+    edited.clear();
+}
+
+// Mesh jobs read the chunk and its neighbours through pointers
+bool ChunkLoader::isEditable(const ChunkCoord &coord) const
+{
+    auto it = entries.find(coord);
+    if (it == entries.end() || it->second.state == ChunkState::Generating || it->second.state == ChunkState::Meshing ||
+        it->second.lighting)
+    {
+        return false;
+    }
+    for (const ChunkCoord &offset : neighbourOffsets)
+    {
+        auto neighbour = entries.find(offsetCoord(coord, offset));
+        if (neighbour != entries.end() && neighbour->second.state == ChunkState::Meshing)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Edits are applied in the order they were made, so once an edit of a chunk
+// has to wait, every later edit of it waits too
+void ChunkLoader::applyPendingEdits()
+{
+    if (pendingEdits.empty())
+    {
+        return;
+    }
+
+    std::unordered_set<ChunkCoord, ChunkCoordHash> blocked;
+    std::unordered_set<ChunkCoord, ChunkCoordHash> remesh;
+    std::vector<PendingEdit> waiting;
+    for (PendingEdit &pending : pendingEdits)
+    {
+        auto it = entries.find(pending.coord);
+        if (it == entries.end())
+        {
+            // Unloaded while it waited
+            continue;
+        }
+        if (blocked.count(pending.coord) || !isEditable(pending.coord))
+        {
+            blocked.insert(pending.coord);
+            waiting.push_back(std::move(pending));
+            continue;
+        }
+
+        bool created = !world->getChunk(pending.coord);
+        Chunk &chunk = world->getOrCreateChunk(pending.coord);
+        if (created)
+        {
+            // It was open sky until now
+            chunk.fillLight(LIGHT_OPEN_SKY);
+        }
+        ChunkLightWork light;
+        ChunkEditResult result = pending.batch->applyToChunk(pending.coord, chunk, &light.edited);
+        if (!result.changed)
+        {
+            if (created)
+            {
+                world->removeChunk(pending.coord);
+            }
+            continue;
+        }
+
+        // A chunk carved down to air is kept, it still has to mesh to nothing
+        chunk.compact();
+        addLightWork(pending.coord, std::move(light));
+        Entry &entry = it->second;
+        entry.unsaved = true;
+        if (entry.editTime == 0 || pending.time < entry.editTime)
+        {
+            entry.editTime = pending.time;
+        }
+        edited.push_back({pending.coord, pending.time});
+        remesh.insert(pending.coord);
+
+        // Only level 0 chunks cull against their neighbours, see the class comment
+        for (uint32_t face = 0; face < FACE_COUNT && entry.level == 0; face++)
+        {
+            if (!(result.borderFaces & (1u << face)))
+            {
+                continue;
+            }
+            ChunkCoord neighbourCoord = offsetCoord(pending.coord, neighbourOffsets[face]);
+            auto neighbour = entries.find(neighbourCoord);
+            if (neighbour == entries.end() || neighbour->second.level != 0)
+            {
+                continue;
+            }
+            if (neighbour->second.editTime == 0 || pending.time < neighbour->second.editTime)
+            {
+                neighbour->second.editTime = pending.time;
+            }
+            remesh.insert(neighbourCoord);
+        }
+    }
+    pendingEdits.swap(waiting);
+
+    for (const ChunkCoord &coord : remesh)
+    {
+        requestRemesh(coord);
+    }
+}
+
+void ChunkLoader::stream(const ChunkCoord &center, int32_t distance, const ChunkCoord &min, const ChunkCoord &max)
+{
+    if (streaming && center == streamCenter)
+    {
+        return;
+    }
+    streaming = true;
+    streamCenter = center;
+    streamCount++;
+
+    ChunkCoord low{std::max(min.x, center.x - distance), std::max(min.y, center.y - distance),
+                   std::max(min.z, center.z - distance)};
+    ChunkCoord high{std::min(max.x, center.x + distance + 1), std::min(max.y, center.y + distance + 1),
+                    std::min(max.z, center.z + distance + 1)};
+    if (low.x < high.x && low.y < high.y && low.z < high.z)
+    {
+        requestArea(low, high, center);
+    }
+    unloadOutside(center, distance);
+}
+
+// Air chunks outside the view distance are always dropped, they cost an entry
+// and nothing else. Chunks with voxels are compressed into the cold tier least
+// recently used first until the world fits the budget again, and cold chunks
+// are dropped the same way once they do not fit either.
+void ChunkLoader::unloadOutside(const ChunkCoord &center, int32_t distance)
+{
+    std::vector<std::pair<uint64_t, ChunkCoord>> candidates;
+    for (auto &entry : entries)
+    {
+        if (chunkDistance(entry.first, center) <= distance)
+        {
+            entry.second.lastUsed = streamCount;
+            continue;
+        }
+        if (entry.second.state != ChunkState::Done || entry.second.lighting)
+        {
+            continue;
+        }
+        // Mesh jobs read their neighbours through pointers
+        bool neighbourMeshing = false;
+        for (const ChunkCoord &offset : neighbourOffsets)
+        {
+            auto neighbour = entries.find(offsetCoord(entry.first, offset));
+            neighbourMeshing |= neighbour != entries.end() && neighbour->second.state == ChunkState::Meshing;
+        }
+        if (!neighbourMeshing)
+        {
+            candidates.push_back({entry.second.lastUsed, entry.first});
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<uint64_t, ChunkCoord> &a, const std::pair<uint64_t, ChunkCoord> &b)
+              { return a.first < b.first; });
+
+    size_t resident = world->getMemoryStats().chunkBytes;
+    for (const auto &candidate : candidates)
+    {
+        const Chunk *chunk = world->getChunk(candidate.second);
+        if (chunk)
+        {
+            if (resident + coldBytes <= memoryBudget)
+            {
+                continue;
+            }
+            resident -= chunk->memoryUsage();
+        }
+        unload(candidate.second);
+    }
+
+    if (resident + coldBytes <= memoryBudget)
+    {
+        return;
+    }
+    candidates.clear();
+    for (const auto &chunk : cold)
+    {
+        candidates.push_back({chunk.second.lastUsed, chunk.first});
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<uint64_t, ChunkCoord> &a, const std::pair<uint64_t, ChunkCoord> &b)
+              { return a.first < b.first; });
+    for (size_t i = 0; i < candidates.size() && resident + coldBytes > memoryBudget; i++)
+    {
+        auto it = cold.find(candidates[i].second);
+        coldBytes -= it->second.data->size();
+        cold.erase(it);
+    }
+}
+
+void ChunkLoader::unload(const ChunkCoord &coord)
+{
+    auto it = entries.find(coord);
+    std::unique_ptr<Chunk> chunk = world->takeChunk(coord);
+    lightWork.erase(coord);
+    std::shared_ptr<const std::vector<uint8_t>> compressed;
+    if (chunk)
+    {
+        unloaded.push_back(coord);
+        compressed = compress(*chunk);
+        coldBytes += compressed->size();
+        cold[coord] = {compressed, it->second.lastUsed};
+    }
+
+    if (store && it->second.unsaved)
+    {
+        store->stage(coord, compressed);
+        jobs->submit([this, coord]
+                     {
+                         // shutdown() flushes what is left
+                         if (cancelled)
+                         {
+                             return;
+                         }
+                         PROFILE_SCOPE("saveChunk");
+                         store->flush(coord);
+                     },
+                     JobPriority::Background, &inFlight);
+    }
+    entries.erase(it);
+}
+
+std::shared_ptr<const std::vector<uint8_t>> ChunkLoader::compress(const Chunk &chunk)
+{
+    auto compressed = std::make_shared<std::vector<uint8_t>>();
+    chunk.compress(*compressed);
+    compressed->shrink_to_fit();
+    return compressed;
+}
+
+void ChunkLoader::takeUnloaded(std::vector<ChunkCoord> &out)
+{
+    out.insert(out.end(), unloaded.begin(), unloaded.end());
+    unloaded.clear();
+}
+
+void ChunkLoader::setLodCenter(const ChunkCoord &center)
+{
+    if (center == lod.getCenter())
+    {
+        return;
+    }
+    lod.setCenter(center);
+
+    // Chunks still generating pick their level once they are done
+    std::vector<ChunkCoord> changed;
+    for (auto &entry : entries)
+    {
+        if (entry.second.state == ChunkState::Generating)
+        {
+            continue;
+        }
+        uint32_t level = lod.update(entry.first, entry.second.level);
+        if (level == entry.second.level)
+        {
+            continue;
+        }
+        // Level 0 neighbours cull against this chunk only while it is level 0 too
+        if ((level == 0) != (entry.second.level == 0))
+        {
+            changed.push_back(entry.first);
+        }
+        entry.second.level = static_cast<uint8_t>(level);
+        requestRemesh(entry.first);
+    }
+
+    for (const ChunkCoord &coord : changed)
+    {
+        for (const ChunkCoord &offset : neighbourOffsets)
+        {
+            ChunkCoord neighbour = offsetCoord(coord, offset);
+            auto it = entries.find(neighbour);
+            if (it != entries.end() && it->second.level == 0)
+            {
+                requestRemesh(neighbour);
+            }
+        }
+    }
+}
+
+void ChunkLoader::requestRemesh(const ChunkCoord &coord)
+{
+    auto it = entries.find(coord);
+    if (it == entries.end())
+    {
+        return;
+    }
+    if (it->second.state == ChunkState::Meshing)
+    {
+        it->second.remesh = true;
+    }
+    else if (it->second.state == ChunkState::Done && world->getChunk(coord))
+    {
+        it->second.state = ChunkState::Generated;
+        tryScheduleMesh(coord);
+    }
+}
+
+std::array<size_t, LOD_LEVEL_COUNT> ChunkLoader::getLevelCounts() const
+{
+    std::array<size_t, LOD_LEVEL_COUNT> counts{};
+    for (const auto &entry : entries)
+    {
+        if (entry.second.state == ChunkState::Done && world->getChunk(entry.first))
+        {
+            counts[entry.second.level]++;
+        }
+    }
+    return counts;
+}
+
+void ChunkLoader::tryScheduleMesh(const ChunkCoord &coord)
+{
+    auto it = entries.find(coord);
+    if (it == entries.end() || it->second.state != ChunkState::Generated)
+    {
+        return;
+    }
+
+    // Neighbours that were never requested count as air
+    for (const ChunkCoord &offset : neighbourOffsets)
+    {
+        auto neighbour = entries.find(offsetCoord(coord, offset));
+        if (neighbour != entries.end() && neighbour->second.state == ChunkState::Generating)
+        {
+            return;
+        }
+    }
+    if (!isLightSettled(coord))
+    {
+        return;
+    }
+
+    const Chunk *chunk = world->getChunk(coord);
+    if (!chunk)
+    {
+        it->second.state = ChunkState::Done;
+        return;
+    }
+
+    // See the class comment for why levels only cull against their own
+    uint32_t level = it->second.level;
+    std::array<const Chunk *, FACE_COUNT> neighbours{};
+    for (uint32_t i = 0; i < FACE_COUNT && level == 0; i++)
+    {
+        ChunkCoord neighbourCoord = offsetCoord(coord, neighbourOffsets[i]);
+        auto neighbour = entries.find(neighbourCoord);
+        if (neighbour == entries.end() || neighbour->second.level == 0)
+        {
+            neighbours[i] = world->getChunk(neighbourCoord);
+        }
+    }
+
+    uint64_t editTime = it->second.editTime;
+    it->second.editTime = 0;
+    it->second.state = ChunkState::Meshing;
+    jobs->submit([this, coord, chunk, neighbours, level, editTime]
+                 {
+                     if (cancelled)
+                     {
+                         return;
+                     }
+
+                     PROFILE_SCOPE("meshChunk");
+                     // Meshers keep scratch memory, one per worker thread
+                     thread_local ChunkMesher mesher;
+                     LoadedMesh result;
+                     result.coord = coord;
+                     result.level = level;
+                     result.editTime = editTime;
+                     if (level == 0 || chunk->isUniform())
+                     {
+                         mesher.mesh(*chunk, neighbours.data(), result.mesh);
+                     }
+                     else
+                     {
+                         thread_local std::vector<Voxel> voxels(Chunk::VOLUME);
+                         thread_local std::vector<Voxel> mip(Chunk::VOLUME);
+                         thread_local Chunk mipChunk;
+                         chunk->decode(voxels.data());
+                         buildChunkLod(voxels.data(), level, mip.data());
+                         mipChunk.encode(mip.data());
+                         mipChunk.fillLight(LIGHT_OPEN_SKY);
+                         mesher.mesh(mipChunk, neighbours.data(), result.mesh);
+                     }
+                     meshed.push(std::move(result));
+                 },
+                 it->second.priority, &inFlight);
+}
+
+bool ChunkLoader::isIdle() const
+{
+    return inFlight.isDone() && generated.empty() && meshed.empty() && lit.empty() && lightWork.empty();
+}
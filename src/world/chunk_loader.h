@@ -0,0 +1,230 @@
+#ifndef CHUNK_LOADER_H
+#define CHUNK_LOADER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../jobs/job_system.h"
+#include "chunk.h"
+#include "chunk_lod.h"
+#include "light.h"
+#include "mesher.h"
+#include "region_store.h"
+#include "terrain.h"
+#include "voxel_edit.h"
+#include "world.h"
+
+struct LoadedMesh
+{
+    ChunkCoord coord;
+    ChunkMesh mesh;
+    uint32_t level = 0; // chunk_lod.h level it was meshed at, replaces any earlier mesh of the chunk
+    // Profiler::now() of the oldest edit this mesh is the first to show, 0 if none
+    uint64_t editTime = 0;
+};
+
+struct EditedChunk
+{
+    ChunkCoord coord;
+    uint64_t editTime; // Profiler::now() when the edit was made
+};
+
+// Generates and meshes chunks on the job system. Chunks near the focus go into
+// the high priority lane and are submitted nearest first. A chunk is meshed
+// once it and all its requested neighbours are generated, so borders are culled
+// against real data.
+//
+// All calls come from the thread owning the world. Mesh jobs read chunks from
+// the world, so a chunk must not be modified or removed while it or one of its
+// neighbours is being meshed.
+//
+// Chunks are meshed at the level a ChunkLodSelector picks around the LOD center
+// and remeshed as it moves. Coarse chunks are meshed without neighbours, so each
+// is a closed shell, and level 0 chunks only cull against level 0 neighbours,
+// so the borders between levels never have holes. The faces hidden inside those
+// borders are the price for that.
+//
+// With a RegionStore, chunks are loaded from it and only generated if it has
+// none. stream() keeps the chunks within a view distance of the camera loaded
+// and unloads the least recently used ones outside it once the world's chunks
+// take more than the memory budget. Unloaded chunks are kept compressed in a
+// cold tier counted against the same budget and only decompressed, by the load
+// job, when they are requested again. Unloaded chunks that are not stored yet
+// are saved by background jobs, and shutdown() saves the rest.
+//
+// edit() changes loaded chunks and remeshes only them, plus the neighbours
+// whose shared border changed. Edits to a chunk that is generating, being
+// lit, or that it or a neighbour is being meshed from, wait in order for that
+// to finish. Edited chunks count as unsaved.
+//
+// Chunks are lit by ChunkLighter jobs, one chunk per job and any number at
+// once. The light that crosses a border is handed to the neighbour's next job,
+// so light spreads chunk by chunk until no job sends any more, and an edit
+// only relights as far as its change reaches. A light job writes its chunk's
+// light, which the mesh jobs of the chunk and its neighbours read, so the two
+// never overlap, and a chunk is only meshed once the light around it settled.
+// Chunks that are not stored count as open sky above the stored ones, and
+// beside or below them once they are known to be air. Coarse levels are
+// meshed as if under open sky.
+class ChunkLoader
+{
+public:
+    // A lodRadius of 0 meshes every chunk at full resolution, see ChunkLodSelector.
+    // store may be null, chunks are then always generated and unloading drops them.
+    void init(World &world, JobSystem &jobs, int32_t lodRadius = 0, RegionStore *store = nullptr);
+    // Cancels jobs that have not started, waits for the running ones and saves
+    // what is unsaved, then rethrows the first exception a job threw
+    void shutdown();
+
+    // Seed of generated chunks, call before requesting any
+    void setTerrainSeed(uint32_t seed) { terrainSeed = seed; }
+
+    // Queues generation of every chunk in [min, max) that is not known yet
+    void requestArea(const ChunkCoord &min, const ChunkCoord &max, const ChunkCoord &focus);
+
+    // Requests the chunks of [min, max) within distance chunks of center, on
+    // every axis, and unloads chunks outside it as the budget requires. Does
+    // nothing while center stays the same.
+    void stream(const ChunkCoord &center, int32_t distance, const ChunkCoord &min, const ChunkCoord &max);
+    // Bytes of chunk data the world and the cold tier may hold before stream() unloads chunks
+    void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+    size_t getColdCount() const { return cold.size(); }
+    size_t getColdBytes() const { return coldBytes; }
+    // Moves the coordinates of chunks unloaded since the last call to out, their meshes are stale
+    void takeUnloaded(std::vector<ChunkCoord> &out);
+
+    // Never waits on jobs. Inserts finished chunks into the world, schedules the
+    // meshes that became possible and moves at most maxMeshes finished meshes to out.
+    // Rethrows the first exception a job threw since the last call.
+    void update(std::vector<LoadedMesh> &out, size_t maxMeshes = SIZE_MAX);
+
+    // Usually the camera's chunk. Chunks whose level changes are remeshed.
+    void setLodCenter(const ChunkCoord &center);
+
+    // Applies the batch to every loaded chunk it reaches, right away or from a
+    // later update(). Chunks that are not loaded, or are unloaded before the
+    // edit could be applied, are skipped. Returns how many were skipped right away.
+    size_t edit(const VoxelEditBatch &batch);
+    // Moves the chunks whose voxels changed since the last call to out
+    void takeEdited(std::vector<EditedChunk> &out);
+    size_t getPendingEditCount() const { return pendingEdits.size(); }
+
+    // Meshed chunks with geometry per level
+    std::array<size_t, LOD_LEVEL_COUNT> getLevelCounts() const;
+
+    // Nothing is generating or meshing and every result was collected
+    bool isIdle() const;
+    size_t getGeneratedCount() const { return generatedCount; }
+    size_t getMeshedCount() const { return meshedCount; }
+    size_t getLightJobCount() const { return lightJobCount; }
+
+private:
+    enum class ChunkState : uint8_t
+    {
+        Generating,
+        Generated,
+        Meshing,
+        Done
+    };
+
+    struct Entry
+    {
+        ChunkState state;
+        JobPriority priority;
+        uint8_t level = 0;
+        // Meshing with an outdated level or neighbourhood, mesh again when it finishes
+        bool remesh = false;
+        // Generated and not in the store yet
+        bool unsaved = false;
+        // stream() call that last found the chunk within the view distance
+        uint64_t lastUsed = 0;
+        // Profiler::now() of the oldest edit no mesh job has picked up yet, 0 if none
+        uint64_t editTime = 0;
+        // A light job is running on the chunk
+        bool lighting = false;
+        // Faces that counted as open sky when the chunk was lit and whose sky
+        // light no closedFaces work has taken out since
+        uint8_t litOpenFaces = 0;
+    };
+
+    struct LitChunk
+    {
+        ChunkCoord coord;
+        ChunkLightResult result;
+    };
+
+    struct PendingEdit
+    {
+        ChunkCoord coord;
+        std::shared_ptr<const VoxelEditBatch> batch;
+        uint64_t time;
+    };
+
+    struct ColdChunk
+    {
+        std::shared_ptr<const std::vector<uint8_t>> data;
+        uint64_t lastUsed;
+    };
+
+    // chunk is null for chunks that came out all air
+    struct GeneratedChunk
+    {
+        ChunkCoord coord;
+        std::unique_ptr<Chunk> chunk;
+        bool unsaved;
+    };
+
+    World *world = nullptr;
+    JobSystem *jobs = nullptr;
+    RegionStore *store = nullptr;
+    ChunkLodSelector lod;
+    uint32_t terrainSeed = DEFAULT_TERRAIN_SEED;
+
+    bool streaming = false;
+    ChunkCoord streamCenter;
+    uint64_t streamCount = 0;
+    size_t memoryBudget = SIZE_MAX;
+    std::vector<ChunkCoord> unloaded;
+    std::unordered_map<ChunkCoord, ColdChunk, ChunkCoordHash> cold;
+    size_t coldBytes = 0;
+
+    std::unordered_map<ChunkCoord, Entry, ChunkCoordHash> entries;
+    std::vector<PendingEdit> pendingEdits;
+    std::vector<EditedChunk> edited;
+    CompletionQueue<GeneratedChunk> generated;
+    CompletionQueue<LoadedMesh> meshed;
+    std::vector<GeneratedChunk> generatedScratch;
+    // Light not applied yet, per chunk, see scheduleLighting()
+    std::unordered_map<ChunkCoord, ChunkLightWork, ChunkCoordHash> lightWork;
+    CompletionQueue<LitChunk> lit;
+    std::vector<LitChunk> litScratch;
+    // Chunks whose mesh may have waited on light that changed this update
+    std::vector<ChunkCoord> meshRetries;
+
+    JobCounter inFlight;
+    std::atomic<bool> cancelled{false};
+    size_t generatedCount = 0;
+    size_t meshedCount = 0;
+    size_t lightJobCount = 0;
+
+    void tryScheduleMesh(const ChunkCoord &coord);
+    bool isLightSettled(const ChunkCoord &coord) const;
+    uint8_t openFacesOf(const ChunkCoord &coord) const;
+    void addLightWork(const ChunkCoord &coord, ChunkLightWork &&work);
+    void queueArrivalLight(const ChunkCoord &coord);
+    void collectLit();
+    void scheduleLighting();
+    bool isEditable(const ChunkCoord &coord) const;
+    void applyPendingEdits();
+    void requestRemesh(const ChunkCoord &coord);
+    void unloadOutside(const ChunkCoord &center, int32_t distance);
+    void unload(const ChunkCoord &coord);
+    static std::shared_ptr<const std::vector<uint8_t>> compress(const Chunk &chunk);
+};
+
+#endif
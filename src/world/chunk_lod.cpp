@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "chunk_lod.h"
+
+void buildChunkLod(const Voxel *voxels, uint32_t level, Voxel *out)
+{
+    if (level == 0)
+    {
+        std::copy(voxels, voxels + Chunk::VOLUME, out);
+        return;
+    }
+
+    // cells holds the current level, size^3 cells laid out like Chunk::index()
+    std::vector<Voxel> cells(voxels, voxels + Chunk::VOLUME);
+    std::vector<Voxel> coarse;
+    int size = Chunk::SIZE;
+    for (uint32_t l = 0; l < level; l++)
+    {
+        int half = size / 2;
+        coarse.assign(static_cast<size_t>(half) * half * half, 0);
+        for (int z = 0; z < half; z++)
+        {
+            for (int y = 0; y < half; y++)
+            {
+                for (int x = 0; x < half; x++)
+                {
+                    int solid = 0;
+                    Voxel material = 0;
+                    // Upper children first, so the first solid one found is the highest
+                    for (int dy = 1; dy >= 0; dy--)
+                    {
+                        for (int dz = 0; dz < 2; dz++)
+                        {
+                            for (int dx = 0; dx < 2; dx++)
+                            {
+                                int cx = 2 * x + dx, cy = 2 * y + dy, cz = 2 * z + dz;
+                                Voxel child = cells[cx + size * (cy + size * cz)];
+                                if (child != 0)
+                                {
+                                    material = material != 0 ? material : child;
+                                    solid++;
+                                }
+                            }
+                        }
+                    }
+                    coarse[x + half * (y + half * z)] = solid >= 4 ? material : 0;
+                }
+            }
+        }
+        cells.swap(coarse);
+        size = half;
+    }
+
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int y = 0; y < Chunk::SIZE; y++)
+        {
+            for (int x = 0; x < Chunk::SIZE; x++)
+            {
+                out[Chunk::index(x, y, z)] = cells[(x >> level) + size * ((y >> level) + size * (z >> level))];
+            }
+        }
+    }
+}
+
+int32_t ChunkLodSelector::distanceTo(const ChunkCoord &coord) const
+{
+    return std::max({std::abs(coord.x - center.x), std::abs(coord.y - center.y), std::abs(coord.z - center.z)});
+}
+
+uint32_t ChunkLodSelector::levelForDistance(int32_t distance) const
+{
+    if (baseRadius <= 0)
+    {
+        return 0;
+    }
+    uint32_t level = 0;
+    int32_t radius = baseRadius;
+    while (distance >= radius && level + 1 < LOD_LEVEL_COUNT)
+    {
+        level++;
+        radius *= 2;
+    }
+    return level;
+}
+
+uint32_t ChunkLodSelector::levelFor(const ChunkCoord &coord) const
+{
+    return levelForDistance(distanceTo(coord));
+}
+
+uint32_t ChunkLodSelector::update(const ChunkCoord &coord, uint32_t current) const
+{
+    int32_t distance = distanceTo(coord);
+    uint32_t target = levelForDistance(distance);
+    if (target <= current)
+    {
+        return target;
+    }
+    return std::max(current, levelForDistance(distance - 1));
+}
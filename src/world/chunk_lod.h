@@ -0,0 +1,52 @@
+#ifndef CHUNK_LOD_H
+#define CHUNK_LOD_H
+
+#include <cstdint>
+
+#include "chunk.h"
+#include "world.h"
+
+// Level 0 is full resolution, level L merges 2^L voxels per axis into one
+static const uint32_t LOD_LEVEL_COUNT = 4;
+
+// Downsamples Chunk::VOLUME voxels in Chunk::index() order to the given level
+// and writes them back out at full resolution, every 2^level block filled with
+// its representative voxel, so the mesher and everything else built for full
+// chunks takes a mip unchanged. The greedy mesher merges each block, so a
+// level L mesh has about 4^-L the quads of the full one.
+//
+// Each level is built from the one below. A 2x2x2 block is solid if at least
+// half of it is, and takes the material of its highest solid voxel, which keeps
+// surfaces the color they are seen with from above.
+void buildChunkLod(const Voxel *voxels, uint32_t level, Voxel *out);
+
+// Picks a level per chunk in rings around the camera's chunk, like a clipmap:
+// level 0 out to baseRadius chunks, and every further level out to twice the
+// radius of the one before, the last level beyond that. Each ring covers about
+// four times the surface of the one inside it at a quarter of the quads per
+// chunk, so the quad count and mesh memory grow only with the number of rings.
+// Distances are Chebyshev distances in chunks.
+class ChunkLodSelector
+{
+public:
+    // A baseRadius of 0 keeps every chunk at level 0
+    explicit ChunkLodSelector(int32_t baseRadius = 4) : baseRadius(baseRadius) {}
+
+    void setCenter(const ChunkCoord &coord) { center = coord; }
+    const ChunkCoord &getCenter() const { return center; }
+
+    uint32_t levelFor(const ChunkCoord &coord) const;
+    // Like levelFor(), but a chunk only turns coarser once it is a full chunk
+    // past the ring edge, so a camera moving along an edge does not remesh the
+    // same chunks back and forth
+    uint32_t update(const ChunkCoord &coord, uint32_t current) const;
+
+private:
+    int32_t baseRadius;
+    ChunkCoord center;
+
+    int32_t distanceTo(const ChunkCoord &coord) const;
+    uint32_t levelForDistance(int32_t distance) const;
+};
+
+#endif
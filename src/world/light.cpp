@@ -0,0 +1,378 @@
+#include "light.h"
+#include "terrain.h"
+
+static const int axisMask = Chunk::SIZE - 1;
+
+uint8_t materialEmission(Voxel material)
+{
+    return material == MATERIAL_LAMP ? LIGHT_MAX : 0;
+}
+
+void ChunkLightWork::merge(ChunkLightWork &&other)
+{
+    initial |= other.initial;
+    exportFaces |= other.exportFaces;
+    openedFaces |= other.openedFaces;
+    closedFaces |= other.closedFaces;
+    edited.insert(edited.end(), other.edited.begin(), other.edited.end());
+    messages.insert(messages.end(), other.messages.begin(), other.messages.end());
+}
+
+void ChunkLightResult::clear()
+{
+    changed = false;
+    changedFaces = 0;
+    for (std::vector<LightMessage> &messages : outgoing)
+    {
+        messages.clear();
+    }
+}
+
+// The voxel next to index across face. If that lies in the neighbouring chunk,
+// crossesBorder is set and the result is its index there.
+static int stepIndex(int index, uint32_t face, bool &crossesBorder)
+{
+    int coords[3] = {index & axisMask, (index >> Chunk::SIZE_BITS) & axisMask, index >> (2 * Chunk::SIZE_BITS)};
+    uint32_t axis = face / 2;
+    int next = coords[axis] + ((face & 1) ? 1 : -1);
+    crossesBorder = next < 0 || next >= Chunk::SIZE;
+    coords[axis] = next & axisMask;
+    return Chunk::index(coords[0], coords[1], coords[2]);
+}
+
+// Bit per face whose border layer holds index
+static uint8_t borderFacesOf(int index)
+{
+    int coords[3] = {index & axisMask, (index >> Chunk::SIZE_BITS) & axisMask, index >> (2 * Chunk::SIZE_BITS)};
+    uint8_t faces = 0;
+    for (uint32_t axis = 0; axis < 3; axis++)
+    {
+        if (coords[axis] == 0)
+        {
+            faces |= 1u << (axis * 2);
+        }
+        if (coords[axis] == axisMask)
+        {
+            faces |= 1u << (axis * 2 + 1);
+        }
+    }
+    return faces;
+}
+
+template <typename F>
+static void forEachFaceVoxel(uint32_t face, F &&function)
+{
+    uint32_t axis = face / 2;
+    int depth = (face & 1) ? axisMask : 0;
+    for (int u = 0; u < Chunk::SIZE; u++)
+    {
+        for (int v = 0; v < Chunk::SIZE; v++)
+        {
+            int coords[3];
+            coords[axis] = depth;
+            coords[(axis + 1) % 3] = u;
+            coords[(axis + 2) % 3] = v;
+            function(Chunk::index(coords[0], coords[1], coords[2]));
+        }
+    }
+}
+
+static uint8_t channelFlag(uint32_t channel)
+{
+    return channel == LIGHT_BLOCK ? LIGHT_MESSAGE_BLOCK : 0;
+}
+
+void ChunkLighter::light(Chunk &target, const ChunkLightWork &work, uint8_t open, ChunkLightResult &out)
+{
+    out.clear();
+    chunk = &target;
+    result = &out;
+    openFaces = open;
+
+    // Solid, dark and emitting nothing: no light can enter, leave or change
+    if (target.isUniform() && target.get(0) != 0 && materialEmission(target.get(0)) == 0 &&
+        target.isLightUniform() && target.getLight(0) == 0)
+    {
+        return;
+    }
+
+    voxels.resize(Chunk::VOLUME);
+    target.decode(voxels.data());
+
+    if (work.initial)
+    {
+        for (int i = 0; i < Chunk::VOLUME; i++)
+        {
+            uint8_t emission = materialEmission(voxels[i]);
+            if (emission > 0)
+            {
+                set(i, LIGHT_BLOCK, emission);
+                spreadQueues[LIGHT_BLOCK].push_back(static_cast<uint16_t>(i));
+            }
+        }
+    }
+
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        if (work.closedFaces & (1u << face))
+        {
+            forEachFaceVoxel(face, [&](int i)
+                             {
+                                 uint8_t level = get(i, LIGHT_SKY);
+                                 if (level > 0)
+                                 {
+                                     set(i, LIGHT_SKY, 0);
+                                     removalQueues[LIGHT_SKY].push_back({static_cast<uint16_t>(i), level});
+                                 }
+                             });
+        }
+    }
+
+    // An edited voxel loses whatever light it had, and if it became air its
+    // neighbours spread into it again
+    for (uint16_t i : work.edited)
+    {
+        for (uint32_t channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+        {
+            uint8_t level = get(i, channel);
+            if (level > 0)
+            {
+                set(i, channel, 0);
+                removalQueues[channel].push_back({i, level});
+            }
+        }
+        uint8_t emission = materialEmission(voxels[i]);
+        if (emission > 0)
+        {
+            set(i, LIGHT_BLOCK, emission);
+            spreadQueues[LIGHT_BLOCK].push_back(i);
+        }
+        if (voxels[i] != 0)
+        {
+            continue;
+        }
+
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            bool crossesBorder;
+            int next = stepIndex(i, face, crossesBorder);
+            if (!crossesBorder)
+            {
+                for (uint32_t channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+                {
+                    if (get(next, channel) > 0)
+                    {
+                        spreadQueues[channel].push_back(static_cast<uint16_t>(next));
+                    }
+                }
+            }
+            else if (openFaces & (1u << face))
+            {
+                seedFromOpenFace(i, face);
+            }
+            else
+            {
+                send(face, next, 0, LIGHT_MESSAGE_REFRESH);
+            }
+        }
+    }
+
+    uint8_t seedFaces = (work.initial ? openFaces : 0) | (work.openedFaces & openFaces);
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        if (seedFaces & (1u << face))
+        {
+            forEachFaceVoxel(face, [&](int i) { seedFromOpenFace(i, face); });
+        }
+        if (work.exportFaces & (1u << face))
+        {
+            forEachFaceVoxel(face, [&](int i)
+                             {
+                                 for (uint32_t channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+                                 {
+                                     if (get(i, channel) > 0)
+                                     {
+                                         spreadQueues[channel].push_back(static_cast<uint16_t>(i));
+                                     }
+                                 }
+                             });
+        }
+    }
+
+    for (const LightMessage &message : work.messages)
+    {
+        receive(message);
+    }
+
+    // Removal first, so light that lost its source is gone before the
+    // surviving light spreads back into the hole
+    for (uint32_t channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+    {
+        removeLight(channel);
+        spreadLight(channel);
+    }
+    target.compactLight();
+}
+
+void ChunkLighter::set(int index, uint32_t channel, uint8_t level)
+{
+    uint8_t light = chunk->getLight(index);
+    uint8_t updated = channel == LIGHT_SKY ? static_cast<uint8_t>((light & LIGHT_MAX) | (level << 4))
+                                           : static_cast<uint8_t>((light & ~LIGHT_MAX) | level);
+    if (updated == light)
+    {
+        return;
+    }
+    chunk->setLight(index, updated);
+    result->changed = true;
+    result->changedFaces |= borderFacesOf(index);
+}
+
+// Open sky above keeps its full level going down, sideways it loses one
+void ChunkLighter::seedFromOpenFace(int index, uint32_t face)
+{
+    uint8_t level = face == FACE_POS_Y ? LIGHT_MAX : LIGHT_MAX - 1;
+    if (voxels[index] == 0 && get(index, LIGHT_SKY) < level)
+    {
+        set(index, LIGHT_SKY, level);
+        spreadQueues[LIGHT_SKY].push_back(static_cast<uint16_t>(index));
+    }
+}
+
+void ChunkLighter::receive(const LightMessage &message)
+{
+    int index = message.index;
+    if (message.flags & LIGHT_MESSAGE_REFRESH)
+    {
+        for (uint32_t channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+        {
+            if (get(index, channel) > 0)
+            {
+                spreadQueues[channel].push_back(message.index);
+            }
+        }
+        return;
+    }
+
+    uint32_t channel = (message.flags & LIGHT_MESSAGE_BLOCK) ? LIGHT_BLOCK : LIGHT_SKY;
+    uint8_t level = get(index, channel);
+    if (message.flags & LIGHT_MESSAGE_REMOVE)
+    {
+        if (level == 0)
+        {
+            return;
+        }
+        bool skyColumn = channel == LIGHT_SKY && (message.flags & LIGHT_MESSAGE_DOWN) && message.value == LIGHT_MAX &&
+                         level == LIGHT_MAX;
+        if (level < message.value || skyColumn)
+        {
+            set(index, channel, 0);
+            removalQueues[channel].push_back({message.index, level});
+        }
+        else
+        {
+            spreadQueues[channel].push_back(message.index);
+        }
+        return;
+    }
+
+    if (voxels[index] == 0 && level < message.value)
+    {
+        set(index, channel, message.value);
+        spreadQueues[channel].push_back(message.index);
+    }
+}
+
+// Every neighbour lit less than a removed voxel, or below it in a full sky
+// column, got its light from it and is cleared too. Brighter neighbours have
+// another source and spread back into the cleared voxels afterwards.
+void ChunkLighter::removeLight(uint32_t channel)
+{
+    std::vector<Removal> &queue = removalQueues[channel];
+    for (size_t q = 0; q < queue.size(); q++)
+    {
+        Removal removal = queue[q];
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            bool crossesBorder;
+            int next = stepIndex(removal.index, face, crossesBorder);
+            if (crossesBorder)
+            {
+                if (!(openFaces & (1u << face)))
+                {
+                    send(face, next, removal.level,
+                         LIGHT_MESSAGE_REMOVE | channelFlag(channel) | (face == FACE_NEG_Y ? LIGHT_MESSAGE_DOWN : 0));
+                }
+                else if (channel == LIGHT_SKY)
+                {
+                    seedFromOpenFace(removal.index, face);
+                }
+                continue;
+            }
+
+            uint8_t level = get(next, channel);
+            if (level == 0)
+            {
+                continue;
+            }
+            bool skyColumn = channel == LIGHT_SKY && face == FACE_NEG_Y && removal.level == LIGHT_MAX && level == LIGHT_MAX;
+            uint8_t emission = channel == LIGHT_BLOCK ? materialEmission(voxels[next]) : 0;
+            if ((level < removal.level || skyColumn) && emission == 0)
+            {
+                set(next, channel, 0);
+                queue.push_back({static_cast<uint16_t>(next), level});
+            }
+            else
+            {
+                spreadQueues[channel].push_back(static_cast<uint16_t>(next));
+            }
+        }
+    }
+    queue.clear();
+}
+
+void ChunkLighter::spreadLight(uint32_t channel)
+{
+    std::vector<uint16_t> &queue = spreadQueues[channel];
+    for (size_t q = 0; q < queue.size(); q++)
+    {
+        int index = queue[q];
+        uint8_t level = get(index, channel);
+        if (level == 0)
+        {
+            continue;
+        }
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            bool skyColumn = channel == LIGHT_SKY && face == FACE_NEG_Y && level == LIGHT_MAX;
+            uint8_t offered = skyColumn ? level : static_cast<uint8_t>(level - 1);
+            if (offered == 0)
+            {
+                continue;
+            }
+
+            bool crossesBorder;
+            int next = stepIndex(index, face, crossesBorder);
+            if (crossesBorder)
+            {
+                // Open sky is as bright as light gets already
+                if (!(openFaces & (1u << face)))
+                {
+                    send(face, next, offered, channelFlag(channel) | (face == FACE_NEG_Y ? LIGHT_MESSAGE_DOWN : 0));
+                }
+                continue;
+            }
+            if (voxels[next] == 0 && get(next, channel) < offered)
+            {
+                set(next, channel, offered);
+                queue.push_back(static_cast<uint16_t>(next));
+            }
+        }
+    }
+    queue.clear();
+}
+
+void ChunkLighter::send(uint32_t face, int index, uint8_t value, uint8_t flags)
+{
+    result->outgoing[face].push_back({static_cast<uint16_t>(index), value, flags});
+}
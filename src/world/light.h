@@ -0,0 +1,123 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "chunk.h"
+#include "mesher.h"
+
+// A voxel's light is one byte, sky light in the high nibble and block light in
+// the low one, each 0 to LIGHT_MAX. Sky light enters from open sky and keeps
+// its full level going straight down, block light comes from emitting
+// materials. Both lose a level per voxel otherwise and only pass through air.
+static const uint8_t LIGHT_MAX = 15;
+// Air that is not stored in any chunk counts as open sky
+static const uint8_t LIGHT_OPEN_SKY = LIGHT_MAX << 4;
+
+enum LightChannel : uint32_t
+{
+    LIGHT_SKY = 0,
+    LIGHT_BLOCK,
+    LIGHT_CHANNEL_COUNT
+};
+
+inline uint8_t lightLevel(uint8_t light, uint32_t channel)
+{
+    return channel == LIGHT_SKY ? light >> 4 : light & LIGHT_MAX;
+}
+
+// Block light a material emits, 0 for most
+uint8_t materialEmission(Voxel material);
+
+// Light crossing a chunk border, sent to the chunk on the other side
+enum LightMessageFlags : uint8_t
+{
+    LIGHT_MESSAGE_BLOCK = 1,   // block channel, sky otherwise
+    LIGHT_MESSAGE_REMOVE = 2,  // the sender lost light of level value next to index
+    LIGHT_MESSAGE_DOWN = 4,    // sent across the receiver's top face
+    LIGHT_MESSAGE_REFRESH = 8, // index's neighbour became air, spread index's light again
+};
+
+struct LightMessage
+{
+    uint16_t index; // voxel of the receiving chunk
+    uint8_t value;  // level offered to index, or the level the sender removed
+    uint8_t flags;
+};
+
+// What changed about a chunk since it was last lit. Faces are FaceDirection bits.
+struct ChunkLightWork
+{
+    // Just loaded, light it from its emitters and open faces
+    bool initial = false;
+    // A neighbour was loaded across these faces and needs this chunk's border light
+    uint8_t exportFaces = 0;
+    // The neighbour across these faces turned out to be air, so open sky
+    uint8_t openedFaces = 0;
+    // The neighbour across these faces was open sky when the chunk was lit and is not anymore
+    uint8_t closedFaces = 0;
+    // Voxels whose material changed
+    std::vector<uint16_t> edited;
+    std::vector<LightMessage> messages;
+
+    bool empty() const
+    {
+        return !initial && exportFaces == 0 && openedFaces == 0 && closedFaces == 0 && edited.empty() &&
+               messages.empty();
+    }
+    void merge(ChunkLightWork &&other);
+};
+
+struct ChunkLightResult
+{
+    // Light of some voxel changed, the chunk has to be remeshed
+    bool changed = false;
+    // Faces whose border layer changed light, the neighbours across them cull
+    // against it and have to be remeshed too
+    uint8_t changedFaces = 0;
+    // Messages for the neighbour across each face
+    std::vector<LightMessage> outgoing[FACE_COUNT];
+
+    void clear();
+};
+
+// Breadth-first flood fill of the light of one chunk, with a removal queue
+// that clears light whose source went away and hands what it runs into back
+// to the spreading queue, so an edit only relights the voxels it affects.
+//
+// A lighter only reads and writes its own chunk. Light that crosses a border
+// comes out as messages for the neighbour, which its own light() call takes
+// in later, so lighters for different chunks run in parallel without locks.
+// Faces in openFaces border open sky and never receive messages.
+//
+// Keeps its queues between calls, so use one instance per thread.
+class ChunkLighter
+{
+public:
+    void light(Chunk &chunk, const ChunkLightWork &work, uint8_t openFaces, ChunkLightResult &out);
+
+private:
+    struct Removal
+    {
+        uint16_t index;
+        uint8_t level;
+    };
+
+    Chunk *chunk = nullptr;
+    ChunkLightResult *result = nullptr;
+    uint8_t openFaces = 0;
+    std::vector<Voxel> voxels;
+    std::vector<uint16_t> spreadQueues[LIGHT_CHANNEL_COUNT];
+    std::vector<Removal> removalQueues[LIGHT_CHANNEL_COUNT];
+
+    uint8_t get(int index, uint32_t channel) const { return lightLevel(chunk->getLight(index), channel); }
+    void set(int index, uint32_t channel, uint8_t level);
+    void seedFromOpenFace(int index, uint32_t face);
+    void receive(const LightMessage &message);
+    void removeLight(uint32_t channel);
+    void spreadLight(uint32_t channel);
+    void send(uint32_t face, int index, uint8_t value, uint8_t flags);
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "light.h"
+#include "mesher.h"
+
+static const uint64_t interiorMask = (1ull << Chunk::SIZE) - 1;
+
+// For a face axis, u and v are the other two axes, ordered so that u x v
+// points along +axis: x -> (y, z), y -> (z, x), z -> (x, y)
+static int voxelIndex(uint32_t axis, uint32_t depth, uint32_t u, uint32_t v)
+{
+    switch (axis)
+    {
+    case 0:
+        return Chunk::index(depth, u, v);
+    case 1:
+        return Chunk::index(v, depth, u);
+    default:
+        return Chunk::index(u, v, depth);
+    }
+}
+
+static uint32_t cornerPosition(uint32_t axis, uint32_t depth, uint32_t u, uint32_t v, uint32_t face)
+{
+    switch (axis)
+    {
+    case 0:
+        return ChunkVertex::pack(depth, u, v, face);
+    case 1:
+        return ChunkVertex::pack(v, depth, u, face);
+    default:
+        return ChunkVertex::pack(u, v, depth, face);
+    }
+}
+
+static int countTrailingZeros(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int count = 0;
+    while ((value & 1) == 0)
+    {
+        value >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+void ChunkMesher::mesh(const World &world, const ChunkCoord &coord, ChunkMesh &out)
+{
+    const Chunk *chunk = world.getChunk(coord);
+    if (!chunk)
+    {
+        out.clear();
+        return;
+    }
+
+    const Chunk *neighbours[FACE_COUNT] = {
+        world.getChunk({coord.x - 1, coord.y, coord.z}),
+        world.getChunk({coord.x + 1, coord.y, coord.z}),
+        world.getChunk({coord.x, coord.y - 1, coord.z}),
+        world.getChunk({coord.x, coord.y + 1, coord.z}),
+        world.getChunk({coord.x, coord.y, coord.z - 1}),
+        world.getChunk({coord.x, coord.y, coord.z + 1}),
+    };
+    mesh(*chunk, neighbours, out);
+}
+
+void ChunkMesher::mesh(const Chunk &chunk, const Chunk *const neighbours[FACE_COUNT], ChunkMesh &out)
+{
+    out.clear();
+
+    // Uniform air has no faces, uniform solid only has faces if a neighbour is open
+    if (chunk.isUniform())
+    {
+        if (chunk.get(0) == 0)
+        {
+            return;
+        }
+
+        bool enclosed = true;
+        for (uint32_t i = 0; i < FACE_COUNT; i++)
+        {
+            enclosed &= neighbours[i] && neighbours[i]->isUniform() && neighbours[i]->get(0) != 0;
+        }
+        if (enclosed)
+        {
+            return;
+        }
+    }
+
+    voxels.resize(Chunk::VOLUME);
+    chunk.decode(voxels.data());
+
+    buildColumns(neighbours);
+    collectFaces(chunk, neighbours);
+    mergePlanes(out);
+}
+
+void ChunkMesher::buildColumns(const Chunk *const neighbours[FACE_COUNT])
+{
+    const uint32_t size = Chunk::SIZE;
+    for (std::vector<uint64_t> &axisColumns : columns)
+    {
+        axisColumns.assign(size * size, 0);
+    }
+
+    for (uint32_t z = 0; z < size; z++)
+    {
+        for (uint32_t y = 0; y < size; y++)
+        {
+            const Voxel *row = &voxels[Chunk::index(0, y, z)];
+            uint64_t &xColumn = columns[0][y * size + z];
+            for (uint32_t x = 0; x < size; x++)
+            {
+                if (row[x] == 0)
+                {
+                    continue;
+                }
+                xColumn |= 1ull << (x + 1);
+                columns[1][z * size + x] |= 1ull << (y + 1);
+                columns[2][x * size + y] |= 1ull << (z + 1);
+            }
+        }
+    }
+
+    // Border voxels of the neighbours go into padding bits 0 and SIZE + 1,
+    // so faces between two solid chunks are culled as well
+    for (uint32_t axis = 0; axis < 3; axis++)
+    {
+        for (uint32_t side = 0; side < 2; side++)
+        {
+            const Chunk *neighbour = neighbours[axis * 2 + side];
+            if (!neighbour)
+            {
+                continue;
+            }
+
+            uint32_t depth = side == 0 ? size - 1 : 0;
+            uint64_t bit = side == 0 ? 1ull : 1ull << (size + 1);
+
+            if (neighbour->isUniform())
+            {
+                if (neighbour->get(0) != 0)
+                {
+                    for (uint64_t &column : columns[axis])
+                    {
+                        column |= bit;
+                    }
+                }
+                continue;
+            }
+
+            for (uint32_t u = 0; u < size; u++)
+            {
+                for (uint32_t v = 0; v < size; v++)
+                {
+                    if (neighbour->get(voxelIndex(axis, depth, u, v)) != 0)
+                    {
+                        columns[axis][u * size + v] |= bit;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ChunkMesher::collectFaces(const Chunk &chunk, const Chunk *const neighbours[FACE_COUNT])
+{
+    const uint32_t size = Chunk::SIZE;
+    for (uint32_t axis = 0; axis < 3; axis++)
+    {
+        for (uint32_t u = 0; u < size; u++)
+        {
+            for (uint32_t v = 0; v < size; v++)
+            {
+                uint64_t column = columns[axis][u * size + v];
+                if (column == 0)
+                {
+                    continue;
+                }
+
+                // A face is visible where a solid bit has an empty bit next to it
+                uint64_t faces[2] = {
+                    ((column & ~(column << 1)) >> 1) & interiorMask,
+                    ((column & ~(column >> 1)) >> 1) & interiorMask,
+                };
+
+                for (uint32_t side = 0; side < 2; side++)
+                {
+                    uint32_t direction = axis * 2 + side;
+                    uint64_t bits = faces[side];
+                    while (bits != 0)
+                    {
+                        uint32_t depth = static_cast<uint32_t>(countTrailingZeros(bits));
+                        bits &= bits - 1;
+
+                        Voxel material = voxels[voxelIndex(axis, depth, u, v)];
+                        std::vector<MaterialPlane> &slice = planes[direction * size + depth];
+
+                        // Light of the air voxel the face looks at
+                        uint8_t light = LIGHT_OPEN_SKY;
+                        if (side == 0 ? depth > 0 : depth + 1 < size)
+                        {
+                            light = chunk.getLight(voxelIndex(axis, side == 0 ? depth - 1 : depth + 1, u, v));
+                        }
+                        else if (const Chunk *neighbour = neighbours[direction])
+                        {
+                            light = neighbour->getLight(voxelIndex(axis, side == 0 ? size - 1 : 0, u, v));
+                        }
+
+                        MaterialPlane *plane = nullptr;
+                        for (MaterialPlane &candidate : slice)
+                        {
+                            if (candidate.material == material && candidate.light == light)
+                            {
+                                plane = &candidate;
+                                break;
+                            }
+                        }
+                        if (!plane)
+                        {
+                            slice.push_back(MaterialPlane{material, light, {}});
+                            plane = &slice.back();
+                        }
+
+                        plane->rows[u] |= 1u << v;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ChunkMesher::mergePlanes(ChunkMesh &out)
+{
+    const uint32_t size = Chunk::SIZE;
+    for (uint32_t direction = 0; direction < FACE_COUNT; direction++)
+    {
+        for (uint32_t depth = 0; depth < size; depth++)
+        {
+            std::vector<MaterialPlane> &slice = planes[direction * size + depth];
+            for (MaterialPlane &plane : slice)
+            {
+                for (uint32_t u = 0; u < size; u++)
+                {
+                    while (plane.rows[u] != 0)
+                    {
+                        // Run of set bits along v starting at the lowest one
+                        uint32_t v = static_cast<uint32_t>(countTrailingZeros(plane.rows[u]));
+                        uint64_t shifted = static_cast<uint64_t>(plane.rows[u]) >> v;
+                        uint32_t height = static_cast<uint32_t>(countTrailingZeros(~shifted));
+                        uint32_t runMask = static_cast<uint32_t>(((1ull << height) - 1) << v);
+
+                        // Grow along u while the next rows contain the whole run
+                        uint32_t width = 1;
+                        while (u + width < size && (plane.rows[u + width] & runMask) == runMask)
+                        {
+                            plane.rows[u + width] &= ~runMask;
+                            width++;
+                        }
+                        plane.rows[u] &= ~runMask;
+
+                        emitQuad(out, direction, depth, u, v, width, height, plane.material, plane.light);
+                    }
+                }
+            }
+            slice.clear();
+        }
+    }
+}
+
+void ChunkMesher::emitQuad(ChunkMesh &out, uint32_t direction, uint32_t depth, uint32_t u, uint32_t v,
+                           uint32_t width, uint32_t height, Voxel material, uint8_t light)
+{
+    uint32_t axis = direction / 2;
+    bool positive = (direction & 1) != 0;
+    uint32_t plane = depth + (positive ? 1 : 0);
+
+    uint32_t corners[4] = {
+        cornerPosition(axis, plane, u, v, direction),
+        cornerPosition(axis, plane, u + width, v, direction),
+        cornerPosition(axis, plane, u + width, v + height, direction),
+        cornerPosition(axis, plane, u, v + height, direction),
+    };
+
+    // Walking u then v is counter-clockwise seen from +axis, so negative faces go the other way
+    uint32_t base = static_cast<uint32_t>(out.vertices.size());
+    uint32_t packedMaterial = ChunkVertex::packMaterial(material, light);
+    if (positive)
+    {
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            out.vertices.push_back({corners[i], packedMaterial});
+        }
+    }
+    else
+    {
+        out.vertices.push_back({corners[0], packedMaterial});
+        out.vertices.push_back({corners[3], packedMaterial});
+        out.vertices.push_back({corners[2], packedMaterial});
+        out.vertices.push_back({corners[1], packedMaterial});
+    }
+
+    const uint32_t quadIndices[6] = {0, 1, 2, 2, 3, 0};
+    for (uint32_t index : quadIndices)
+    {
+        out.indices.push_back(base + index);
+    }
+}
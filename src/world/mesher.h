@@ -0,0 +1,92 @@
+#ifndef MESHER_H
+#define MESHER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "chunk.h"
+#include "world.h"
+
+// Face directions, also the order of the neighbour array passed to ChunkMesher
+enum FaceDirection : uint32_t
+{
+    FACE_NEG_X = 0,
+    FACE_POS_X,
+    FACE_NEG_Y,
+    FACE_POS_Y,
+    FACE_NEG_Z,
+    FACE_POS_Z,
+    FACE_COUNT
+};
+
+// 8 bytes per vertex. position packs the chunk-local corner (0..32 on each
+// axis, 6 bits each) and the face direction:
+//   x | y << 6 | z << 12 | face << 18
+// material packs the voxel and the light of the air voxel in front of the
+// face, see light.h:
+//   voxel | light << 16
+struct ChunkVertex
+{
+    uint32_t position;
+    uint32_t material;
+
+    static uint32_t pack(uint32_t x, uint32_t y, uint32_t z, uint32_t face)
+    {
+        return x | (y << 6) | (z << 12) | (face << 18);
+    }
+    static uint32_t packMaterial(Voxel voxel, uint8_t light) { return voxel | (static_cast<uint32_t>(light) << 16); }
+};
+
+struct ChunkMesh
+{
+    std::vector<ChunkVertex> vertices;
+    // Two counter-clockwise triangles per quad, seen from outside the solid
+    std::vector<uint32_t> indices;
+
+    size_t quadCount() const { return vertices.size() / 4; }
+    bool empty() const { return vertices.empty(); }
+    void clear()
+    {
+        vertices.clear();
+        indices.clear();
+    }
+};
+
+// Binary greedy mesher. Solid voxels are turned into one 64-bit mask per
+// column along each axis, with the neighbouring chunks' border voxels in the
+// padding bits, so all visible faces of a column come out of one shift and
+// and-not. Faces are then sorted into 32x32 bit planes per direction, depth,
+// material and light, and each plane is merged into rectangles with bit scans.
+// Faces bordering a missing neighbour are lit as open sky.
+//
+// Pure CPU code with no Vulkan dependency. A mesher keeps its scratch memory
+// between calls, so use one instance per thread.
+class ChunkMesher
+{
+public:
+    // neighbours are indexed by FaceDirection, null neighbours count as air
+    void mesh(const Chunk &chunk, const Chunk *const neighbours[FACE_COUNT], ChunkMesh &out);
+    void mesh(const World &world, const ChunkCoord &coord, ChunkMesh &out);
+
+private:
+    struct MaterialPlane
+    {
+        Voxel material;
+        uint8_t light;
+        uint32_t rows[Chunk::SIZE];
+    };
+
+    std::vector<Voxel> voxels;
+    // columns[axis][u * SIZE + v], bit p + 1 is the voxel at depth p along axis
+    std::vector<uint64_t> columns[3];
+    // planes[direction * SIZE + depth]
+    std::vector<MaterialPlane> planes[FACE_COUNT * Chunk::SIZE];
+
+    void buildColumns(const Chunk *const neighbours[FACE_COUNT]);
+    void collectFaces(const Chunk &chunk, const Chunk *const neighbours[FACE_COUNT]);
+    void mergePlanes(ChunkMesh &out);
+    static void emitQuad(ChunkMesh &out, uint32_t direction, uint32_t depth, uint32_t u, uint32_t v,
+                         uint32_t width, uint32_t height, Voxel material, uint8_t light);
+};
+
+#endif
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "region_file.h"
+
+static const char regionMagic[4] = {'V', 'X', 'R', 'G'};
+static const uint32_t regionVersion = 2;
+// Magic, version, then the index
+static const size_t headerSize = 8 + RegionFile::CHUNK_COUNT * 8;
+// Index offset of chunks stored as air
+static const uint32_t airOffset = UINT32_MAX;
+
+RegionFile::~RegionFile()
+{
+    close();
+}
+
+void RegionFile::open(const std::string &filePath)
+{
+    close();
+    path = filePath;
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("failed to open region file " + path + "!");
+    }
+    file = handle;
+    LARGE_INTEGER size;
+    GetFileSizeEx(handle, &size);
+    fileSize = static_cast<size_t>(size.QuadPart);
+#else
+    file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file < 0)
+    {
+        throw std::runtime_error("failed to open region file " + path + "!");
+    }
+    struct stat status;
+    fstat(file, &status);
+    fileSize = static_cast<size_t>(status.st_size);
+#endif
+
+    if (fileSize == 0)
+    {
+        std::vector<uint8_t> header(headerSize, 0);
+        std::memcpy(header.data(), regionMagic, sizeof(regionMagic));
+        std::memcpy(header.data() + 4, &regionVersion, sizeof(regionVersion));
+        writeAt(0, header.data(), header.size());
+        fileSize = headerSize;
+    }
+    map();
+
+    uint32_t version = 0;
+    if (fileSize >= headerSize)
+    {
+        std::memcpy(&version, mapping + 4, sizeof(version));
+    }
+    if (version != regionVersion || std::memcmp(mapping, regionMagic, sizeof(regionMagic)) != 0)
+    {
+        close();
+        throw std::runtime_error("region file " + filePath + " is damaged or from another version!");
+    }
+    findFreeExtents();
+}
+
+void RegionFile::close()
+{
+    unmap();
+#ifdef _WIN32
+    if (file)
+    {
+        CloseHandle(file);
+        file = nullptr;
+    }
+#else
+    if (file >= 0)
+    {
+        ::close(file);
+        file = -1;
+    }
+#endif
+    fileSize = 0;
+    freeExtents.clear();
+}
+
+void RegionFile::map()
+{
+    if (fileSize == 0)
+    {
+        return;
+    }
+#ifdef _WIN32
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *view = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        throw std::runtime_error("failed to map region file " + path + "!");
+    }
+#else
+    void *view = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED)
+    {
+        throw std::runtime_error("failed to map region file " + path + "!");
+    }
+#endif
+    mapping = static_cast<const uint8_t *>(view);
+    mappedSize = fileSize;
+}
+
+void RegionFile::unmap()
+{
+    if (!mapping)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(mappingHandle);
+    mappingHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(mapping), mappedSize);
+#endif
+    mapping = nullptr;
+    mappedSize = 0;
+}
+
+void RegionFile::writeAt(uint64_t offset, const void *data, size_t size)
+{
+#ifdef _WIN32
+    OVERLAPPED overlapped{};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD written = 0;
+    bool ok = WriteFile(file, data, static_cast<DWORD>(size), &written, &overlapped) && written == size;
+#else
+    bool ok = pwrite(file, data, size, static_cast<off_t>(offset)) == static_cast<ssize_t>(size);
+#endif
+    if (!ok)
+    {
+        throw std::runtime_error("failed to write region file " + path + "!");
+    }
+}
+
+RegionFile::Entry RegionFile::entry(uint32_t index) const
+{
+    Entry result;
+    std::memcpy(&result, mapping + 8 + index * sizeof(Entry), sizeof(Entry));
+    return result;
+}
+
+StoredChunk RegionFile::read(uint32_t index, Chunk &out) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    Entry stored = entry(index);
+    if (stored.offset == 0)
+    {
+        return StoredChunk::Missing;
+    }
+    if (stored.offset == airOffset)
+    {
+        return StoredChunk::Air;
+    }
+    if (static_cast<size_t>(stored.offset) + stored.size > mappedSize ||
+        !out.decompress(mapping + stored.offset, stored.size))
+    {
+        return StoredChunk::Missing;
+    }
+    return StoredChunk::Present;
+}
+
+void RegionFile::findFreeExtents()
+{
+    std::vector<Extent> used;
+    for (uint32_t index = 0; index < CHUNK_COUNT; index++)
+    {
+        Entry stored = entry(index);
+        if (stored.offset != 0 && stored.offset != airOffset && stored.size > 0 &&
+            static_cast<size_t>(stored.offset) + stored.size <= fileSize)
+        {
+            used.push_back({stored.offset, stored.size});
+        }
+    }
+    std::sort(used.begin(), used.end(), [](const Extent &a, const Extent &b)
+              { return a.offset < b.offset; });
+
+    freeExtents.clear();
+    size_t end = headerSize;
+    for (const Extent &extent : used)
+    {
+        if (extent.offset > end)
+        {
+            freeExtents.push_back({end, extent.offset - end});
+        }
+        end = std::max(end, extent.offset + extent.size);
+    }
+    if (fileSize > end)
+    {
+        freeExtents.push_back({end, fileSize - end});
+    }
+}
+
+size_t RegionFile::takeFreeSpace(size_t size)
+{
+    for (size_t i = 0; i < freeExtents.size(); i++)
+    {
+        Extent &extent = freeExtents[i];
+        if (extent.size < size)
+        {
+            continue;
+        }
+        size_t offset = extent.offset;
+        extent.offset += size;
+        extent.size -= size;
+        if (extent.size == 0)
+        {
+            freeExtents.erase(freeExtents.begin() + i);
+        }
+        return offset;
+    }
+    return fileSize;
+}
+
+void RegionFile::releaseSpace(size_t offset, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    auto next = std::lower_bound(freeExtents.begin(), freeExtents.end(), offset,
+                                 [](const Extent &extent, size_t value) { return extent.offset < value; });
+    next = freeExtents.insert(next, {offset, size});
+
+    // Merge with the gaps right after and right before
+    if (next + 1 != freeExtents.end() && next->offset + next->size == (next + 1)->offset)
+    {
+        next->size += (next + 1)->size;
+        freeExtents.erase(next + 1);
+    }
+    if (next != freeExtents.begin() && (next - 1)->offset + (next - 1)->size == next->offset)
+    {
+        (next - 1)->size += next->size;
+        freeExtents.erase(next);
+    }
+}
+
+void RegionFile::write(uint32_t index, const uint8_t *data, size_t size)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    Entry stored = entry(index);
+    Entry updated{airOffset, 0};
+    if (data)
+    {
+        size_t offset = takeFreeSpace(size);
+        if (offset == fileSize && fileSize + size >= airOffset)
+        {
+            throw std::runtime_error("region file " + path + " is full!");
+        }
+        updated.offset = static_cast<uint32_t>(offset);
+        updated.size = static_cast<uint32_t>(size);
+        writeAt(updated.offset, data, size);
+        fileSize = std::max(fileSize, offset + size);
+    }
+
+    // The old data is never overwritten and the index is written last, so an
+    // interrupted write keeps the old chunk
+    writeAt(8 + index * sizeof(Entry), &updated, sizeof(updated));
+    if (stored.offset != 0 && stored.offset != airOffset && static_cast<size_t>(stored.offset) + stored.size <= fileSize)
+    {
+        releaseSpace(stored.offset, stored.size);
+    }
+    if (fileSize > mappedSize)
+    {
+        unmap();
+        map();
+    }
+}
+
+ChunkCoord RegionFile::regionOf(const ChunkCoord &coord)
+{
+    return {coord.x >> SIZE_BITS, coord.y >> SIZE_BITS, coord.z >> SIZE_BITS};
+}
+
+uint32_t RegionFile::indexOf(const ChunkCoord &coord)
+{
+    uint32_t mask = SIZE - 1;
+    return (coord.x & mask) | ((coord.y & mask) << SIZE_BITS) | ((coord.z & mask) << (2 * SIZE_BITS));
+}
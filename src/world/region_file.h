@@ -0,0 +1,92 @@
+#ifndef REGION_FILE_H
+#define REGION_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "chunk.h"
+#include "world.h"
+
+enum class StoredChunk
+{
+    Missing, // never written
+    Air,     // written as all air, there is no chunk
+    Present
+};
+
+// One file holding the chunks of a SIZE^3 block of chunk coordinates. A fixed
+// header with a magic, a version and an (offset, size) index entry per chunk is
+// followed by the chunks as Chunk::compress() wrote them. A rewritten chunk never
+// overwrites its old data: it goes into the first free gap it fits, or is
+// appended, and the index entry is written last, so an interrupted write keeps
+// the old chunk. The old data's space becomes free only then. Free gaps are
+// found again from the index when the file is opened.
+//
+// The file is mapped into memory and chunks are decompressed straight from the
+// mapping. Reads and writes may come from any thread, writes are exclusive.
+class RegionFile
+{
+public:
+    static const int32_t SIZE_BITS = 3;
+    static const int32_t SIZE = 1 << SIZE_BITS;
+    static const uint32_t CHUNK_COUNT = SIZE * SIZE * SIZE;
+
+    RegionFile() = default;
+    ~RegionFile();
+    RegionFile(const RegionFile &) = delete;
+    RegionFile &operator=(const RegionFile &) = delete;
+
+    // Creates the file if it does not exist
+    void open(const std::string &path);
+    void close();
+
+    // Present fills out, a damaged chunk reads as Missing
+    StoredChunk read(uint32_t index, Chunk &out) const;
+    // Takes compressed chunk data, null stores the chunk as all air
+    void write(uint32_t index, const uint8_t *data, size_t size);
+
+    static ChunkCoord regionOf(const ChunkCoord &coord);
+    // Index of a chunk within its region
+    static uint32_t indexOf(const ChunkCoord &coord);
+
+private:
+    struct Entry
+    {
+        uint32_t offset; // 0 if missing
+        uint32_t size;   // 0 for air
+    };
+
+    struct Extent
+    {
+        size_t offset;
+        size_t size;
+    };
+
+    std::string path;
+    mutable std::shared_mutex mutex;
+    const uint8_t *mapping = nullptr;
+    size_t mappedSize = 0;
+    size_t fileSize = 0;
+    // Unused space between the header and fileSize, sorted by offset
+    std::vector<Extent> freeExtents;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mappingHandle = nullptr;
+#else
+    int file = -1;
+#endif
+
+    void map();
+    void unmap();
+    void writeAt(uint64_t offset, const void *data, size_t size);
+    Entry entry(uint32_t index) const;
+    void findFreeExtents();
+    // Offset of size bytes of free space, fileSize if no gap is large enough
+    size_t takeFreeSpace(size_t size);
+    void releaseSpace(size_t offset, size_t size);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+#include "region_store.h"
+
+void RegionStore::open(const std::string &path)
+{
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    if (error)
+    {
+        throw std::runtime_error("failed to create world directory " + path + "!");
+    }
+    directory = path;
+}
+
+RegionStore::Region &RegionStore::region(const ChunkCoord &coord)
+{
+    ChunkCoord regionCoord = RegionFile::regionOf(coord);
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<Region> &slot = regions[regionCoord];
+    if (!slot)
+    {
+        auto opened = std::make_unique<Region>();
+        opened->file.open(directory + "/r." + std::to_string(regionCoord.x) + "." + std::to_string(regionCoord.y) +
+                          "." + std::to_string(regionCoord.z) + ".vxr");
+        slot = std::move(opened);
+    }
+    return *slot;
+}
+
+StoredChunk RegionStore::load(const ChunkCoord &coord, std::unique_ptr<Chunk> &out)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = staged.find(coord);
+        if (it != staged.end())
+        {
+            if (!it->second)
+            {
+                return StoredChunk::Air;
+            }
+            auto chunk = std::make_unique<Chunk>();
+            if (!chunk->decompress(it->second->data(), it->second->size()))
+            {
+                return StoredChunk::Missing;
+            }
+            out = std::move(chunk);
+            return StoredChunk::Present;
+        }
+    }
+
+    auto chunk = std::make_unique<Chunk>();
+    StoredChunk stored = region(coord).file.read(RegionFile::indexOf(coord), *chunk);
+    if (stored == StoredChunk::Present)
+    {
+        out = std::move(chunk);
+    }
+    return stored;
+}
+
+void RegionStore::stage(const ChunkCoord &coord, std::shared_ptr<const std::vector<uint8_t>> compressed)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    staged[coord] = std::move(compressed);
+}
+
+void RegionStore::flush(const ChunkCoord &coord)
+{
+    Region &target = region(coord);
+    std::lock_guard<std::mutex> writeLock(target.writeMutex);
+
+    std::shared_ptr<const std::vector<uint8_t>> chunk;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = staged.find(coord);
+        if (it == staged.end())
+        {
+            return;
+        }
+        chunk = it->second;
+    }
+
+    target.file.write(RegionFile::indexOf(coord), chunk ? chunk->data() : nullptr, chunk ? chunk->size() : 0);
+
+    // Only unstage what was written, a newer chunk gets its own flush
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = staged.find(coord);
+    if (it != staged.end() && it->second == chunk)
+    {
+        staged.erase(it);
+    }
+}
+
+void RegionStore::flushAll()
+{
+    std::vector<ChunkCoord> coords;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &entry : staged)
+        {
+            coords.push_back(entry.first);
+        }
+    }
+    for (const ChunkCoord &coord : coords)
+    {
+        flush(coord);
+    }
+}
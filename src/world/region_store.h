@@ -0,0 +1,55 @@
+#ifndef REGION_STORE_H
+#define REGION_STORE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.h"
+#include "region_file.h"
+#include "world.h"
+
+// Directory of region files making up a saved world, opened on first use.
+//
+// Saving is split so it can run in the background: stage() hands over a chunk
+// compressed with Chunk::compress() and returns at once, flush() later writes
+// it out. Loads see staged chunks, so
+// a chunk that is saved and loaded again before its write finished still comes
+// back as saved. All calls may come from any thread.
+class RegionStore
+{
+public:
+    // Creates the directory if needed
+    void open(const std::string &directory);
+    bool isOpen() const { return !directory.empty(); }
+
+    // Present fills out
+    StoredChunk load(const ChunkCoord &coord, std::unique_ptr<Chunk> &out);
+
+    // Null stores the chunk as all air. Replaces an earlier staged chunk.
+    void stage(const ChunkCoord &coord, std::shared_ptr<const std::vector<uint8_t>> compressed);
+    // Writes the latest chunk staged for coord, if any
+    void flush(const ChunkCoord &coord);
+    void flushAll();
+
+private:
+    struct Region
+    {
+        RegionFile file;
+        // Held from picking a staged chunk until it is written, so two flushes
+        // of one chunk cannot finish in the wrong order
+        std::mutex writeMutex;
+    };
+
+    std::string directory;
+    std::mutex mutex;
+    std::unordered_map<ChunkCoord, std::unique_ptr<Region>, ChunkCoordHash> regions;
+    // Null data stands for air
+    std::unordered_map<ChunkCoord, std::shared_ptr<const std::vector<uint8_t>>, ChunkCoordHash> staged;
+
+    Region &region(const ChunkCoord &coord);
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "terrain.h"
+#include "terrain_kernel.h"
+#include "terrain_noise.h"
+
+namespace
+{
+    // One lane in plain C++, each operation matching its SSE/AVX counterpart
+    // bit for bit, see cpu_raytracer.cpp
+    struct ScalarLanes
+    {
+        typedef float F;
+        typedef int32_t I;
+        static const int WIDTH = 1;
+
+        static F set(float value) { return value; }
+        static F load(const float *values) { return *values; }
+        static void store(float *out, F a) { *out = a; }
+        static F add(F a, F b) { return a + b; }
+        static F sub(F a, F b) { return a - b; }
+        static F mul(F a, F b) { return a * b; }
+        static F floor(F a) { return std::floor(a); }
+        static I gt(F a, F b) { return a > b ? -1 : 0; }
+        static I lt(F a, F b) { return a < b ? -1 : 0; }
+        static F selectf(I mask, F a, F b) { return mask ? a : b; }
+
+        // cvttps returns INT32_MIN for NaN and anything out of range
+        static I toInt(F a)
+        {
+            if (!(a >= -2147483648.0f && a < 2147483648.0f))
+            {
+                return INT32_MIN;
+            }
+            return static_cast<int32_t>(a);
+        }
+
+        static I seti(int32_t value) { return value; }
+        static I addi(I a, I b) { return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+        static I mullo(I a, I b) { return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); }
+        static I xori(I a, I b) { return a ^ b; }
+        static I andi(I a, I b) { return a & b; }
+        static I ori(I a, I b) { return a | b; }
+        static I srl(I a, int count) { return static_cast<int32_t>(static_cast<uint32_t>(a) >> count); }
+        static I eqi(I a, I b) { return a == b ? -1 : 0; }
+        static I gti(I a, I b) { return a > b ? -1 : 0; }
+        static I select(I mask, I a, I b) { return mask ? a : b; }
+        static void storei(int32_t *out, I a) { *out = a; }
+    };
+
+    struct TerrainKernels
+    {
+        TerrainHeightsFunction heights;
+        TerrainMaskFunction mask;
+    };
+
+    TerrainKernels terrainKernels(SimdLevel level)
+    {
+        switch (level)
+        {
+#ifdef TERRAIN_X86
+        case SimdLevel::Avx2:
+            return {terrainHeightsAvx2, terrainMaskAvx2};
+        case SimdLevel::Sse41:
+            return {terrainHeightsSse41, terrainMaskSse41};
+#endif
+        default:
+            return {terrainHeightsScalar, terrainMaskScalar};
+        }
+    }
+
+    SimdLevel terrainLevel = detectSimdLevel();
+    TerrainKernels kernels = terrainKernels(terrainLevel);
+}
+
+void terrainHeightsScalar(uint32_t seed, int32_t originX, int32_t originZ, float *heights)
+{
+    terrainHeights<ScalarLanes>(seed, originX, originZ, heights);
+}
+
+void terrainMaskScalar(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid)
+{
+    terrainMask<ScalarLanes>(seed, origin, heights, solid);
+}
+
+void setTerrainSimdLevel(SimdLevel level)
+{
+    if (!isSimdLevelSupported(level))
+    {
+        throw std::runtime_error(std::string("terrain: ") + simdLevelName(level) + " is not supported here!");
+    }
+    terrainLevel = level;
+    kernels = terrainKernels(level);
+}
+
+SimdLevel getTerrainSimdLevel()
+{
+    return terrainLevel;
+}
+
+bool generateTerrainChunk(const ChunkCoord &coord, Voxel *voxels, uint32_t seed)
+{
+    const int32_t origin[3] = {coord.x * Chunk::SIZE, coord.y * Chunk::SIZE, coord.z * Chunk::SIZE};
+    alignas(32) float heights[Chunk::SIZE * Chunk::SIZE];
+    kernels.heights(seed, origin[0], origin[2], heights);
+
+    // Chunks entirely above the column's surface band skip the 3D noise
+    float highest = *std::max_element(heights, heights + Chunk::SIZE * Chunk::SIZE);
+    if (origin[1] > highest + TERRAIN_DETAIL_AMPLITUDE)
+    {
+        std::fill(voxels, voxels + Chunk::VOLUME, MATERIAL_AIR);
+        return false;
+    }
+
+    thread_local std::vector<uint8_t> solid(Chunk::SIZE * TERRAIN_MASK_HEIGHT * Chunk::SIZE);
+    kernels.mask(seed, origin, heights, solid.data());
+
+    // Grass where the voxel above is air, dirt down to TERRAIN_MASK_EXTRA below the surface
+    bool any = false;
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        for (int y = 0; y < Chunk::SIZE; y++)
+        {
+            const uint8_t *row = solid.data() + Chunk::SIZE * (y + TERRAIN_MASK_HEIGHT * z);
+            Voxel *out = voxels + Chunk::index(0, y, z);
+            for (int x = 0; x < Chunk::SIZE; x++)
+            {
+                Voxel value = MATERIAL_AIR;
+                if (row[x])
+                {
+                    bool covered = true;
+                    for (int above = 2; above <= TERRAIN_MASK_EXTRA; above++)
+                    {
+                        covered &= row[x + above * Chunk::SIZE] != 0;
+                    }
+                    value = !row[x + Chunk::SIZE] ? MATERIAL_GRASS : covered ? MATERIAL_STONE : MATERIAL_DIRT;
+                }
+                out[x] = value;
+                any |= value != MATERIAL_AIR;
+            }
+        }
+    }
+    return any;
+}
+
+void generateTerrain(World &world, const ChunkCoord &min, const ChunkCoord &max, uint32_t seed)
+{
+    std::vector<Voxel> voxels(Chunk::VOLUME);
+    for (int32_t z = min.z; z < max.z; z++)
+    {
+        for (int32_t y = min.y; y < max.y; y++)
+        {
+            for (int32_t x = min.x; x < max.x; x++)
+            {
+                if (generateTerrainChunk({x, y, z}, voxels.data(), seed))
+                {
+                    world.getOrCreateChunk({x, y, z}).encode(voxels.data());
+                }
+            }
+        }
+    }
+}
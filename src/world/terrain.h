@@ -0,0 +1,38 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <cstdint>
+
+#include "../math/simd.h"
+#include "chunk.h"
+#include "world.h"
+
+// Heightmap terrain from fractal gradient noise with 3D noise for overhangs
+// near the surface: stone, a few layers of dirt, grass on top and air above.
+// The noise runs in SIMD batches across each chunk column, see terrain_noise.h,
+// and every SimdLevel generates the same voxels for a seed.
+enum TerrainMaterial : Voxel
+{
+    MATERIAL_AIR = 0,
+    MATERIAL_STONE = 1,
+    MATERIAL_DIRT = 2,
+    MATERIAL_GRASS = 3,
+    // Never generated, placed by edits. Emits block light, see light.h
+    MATERIAL_LAMP = 4
+};
+
+static const uint32_t DEFAULT_TERRAIN_SEED = 1337;
+
+// Fills Chunk::VOLUME voxels for the chunk at coord. Returns false if the chunk
+// is all air. Safe to call from any number of threads at once.
+bool generateTerrainChunk(const ChunkCoord &coord, Voxel *voxels, uint32_t seed = DEFAULT_TERRAIN_SEED);
+
+// Generates every chunk in [min, max) that is not all air
+void generateTerrain(World &world, const ChunkCoord &min, const ChunkCoord &max, uint32_t seed = DEFAULT_TERRAIN_SEED);
+
+// Defaults to detectSimdLevel(), unsupported levels throw. Must not change
+// while chunks are being generated.
+void setTerrainSimdLevel(SimdLevel level);
+SimdLevel getTerrainSimdLevel();
+
+#endif
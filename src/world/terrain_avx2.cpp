@@ -0,0 +1,71 @@
+#include <cstdint>
+
+#include "terrain_kernel.h"
+
+#ifdef TERRAIN_X86
+
+#include <immintrin.h>
+
+// Built for AVX2 whatever the compiler flags, generateTerrainChunk() only
+// calls in here after checking the CPU supports it. FMA is left off on
+// purpose, fused multiply-adds would round differently from the other paths.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "terrain_noise.h"
+
+namespace
+{
+    struct Avx2Lanes
+    {
+        typedef __m256 F;
+        typedef __m256i I;
+        static const int WIDTH = 8;
+
+        static F set(float value) { return _mm256_set1_ps(value); }
+        static F load(const float *values) { return _mm256_loadu_ps(values); }
+        static void store(float *out, F a) { _mm256_storeu_ps(out, a); }
+        static F add(F a, F b) { return _mm256_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static F floor(F a) { return _mm256_floor_ps(a); }
+        static I gt(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+        static I lt(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+        static F selectf(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+        static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+
+        static I seti(int32_t value) { return _mm256_set1_epi32(value); }
+        static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+        static I mullo(I a, I b) { return _mm256_mullo_epi32(a, b); }
+        static I xori(I a, I b) { return _mm256_xor_si256(a, b); }
+        static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+        static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+        static I srl(I a, int count) { return _mm256_srli_epi32(a, count); }
+        static I eqi(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+        static I gti(I a, I b) { return _mm256_cmpgt_epi32(a, b); }
+        static I select(I mask, I a, I b) { return _mm256_blendv_epi8(b, a, mask); }
+        static void storei(int32_t *out, I a) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), a); }
+    };
+}
+
+void terrainHeightsAvx2(uint32_t seed, int32_t originX, int32_t originZ, float *heights)
+{
+    terrainHeights<Avx2Lanes>(seed, originX, originZ, heights);
+}
+
+void terrainMaskAvx2(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid)
+{
+    terrainMask<Avx2Lanes>(seed, origin, heights, solid);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
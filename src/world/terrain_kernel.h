@@ -0,0 +1,36 @@
+#ifndef TERRAIN_KERNEL_H
+#define TERRAIN_KERNEL_H
+
+#include <cstdint>
+
+#include "chunk.h"
+
+// Entry points of the per-ISA noise kernels behind generateTerrainChunk(), see
+// terrain_noise.h for the noise itself. Only terrain*.cpp include this.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TERRAIN_X86 1
+#endif
+
+// The mask covers the chunk and this many layers above it, which decide how
+// deep the top soil of the chunk's highest voxels goes
+static const int TERRAIN_MASK_EXTRA = 4;
+static const int TERRAIN_MASK_HEIGHT = Chunk::SIZE + TERRAIN_MASK_EXTRA;
+
+// Fills Chunk::SIZE^2 surface heights of the column starting at (originX,
+// originZ), x fastest
+typedef void (*TerrainHeightsFunction)(uint32_t seed, int32_t originX, int32_t originZ, float *heights);
+// Fills 1 for solid and 0 for air at x + SIZE * (y + TERRAIN_MASK_HEIGHT * z),
+// from the heights the column's TerrainHeightsFunction returned
+typedef void (*TerrainMaskFunction)(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid);
+
+void terrainHeightsScalar(uint32_t seed, int32_t originX, int32_t originZ, float *heights);
+void terrainMaskScalar(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid);
+#ifdef TERRAIN_X86
+void terrainHeightsSse41(uint32_t seed, int32_t originX, int32_t originZ, float *heights);
+void terrainMaskSse41(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid);
+void terrainHeightsAvx2(uint32_t seed, int32_t originX, int32_t originZ, float *heights);
+void terrainMaskAvx2(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid);
+#endif
+
+#endif
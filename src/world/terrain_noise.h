@@ -0,0 +1,234 @@
+#ifndef TERRAIN_NOISE_H
+#define TERRAIN_NOISE_H
+
+#include <cstdint>
+
+#include "terrain_kernel.h"
+
+// Included by each per-ISA translation unit after it switched the target
+// instruction set, so the templates below are compiled for that set.
+//
+// Gradient noise with hashed lattice gradients, no permutation table, so every
+// lane computes its corners with plain integer math instead of gathers. S
+// provides float lanes F, int32 lanes I and masks as I with all bits set for
+// true, as in cpu_raytracer_packet.h. Every float operation is a separate IEEE
+// op in the same order for all widths, never fused, so every lane width
+// produces the same bits and a seed always gives the same world.
+
+// Surface height is BASE + fBm of HEIGHT_OCTAVES octaves of 2D noise, the
+// first at HEIGHT_FREQUENCY and HEIGHT_AMPLITUDE, each further one at twice the
+// frequency and half the amplitude
+static const float TERRAIN_BASE_HEIGHT = 96.0f;
+static const float TERRAIN_HEIGHT_FREQUENCY = 1.0f / 160.0f;
+static const float TERRAIN_HEIGHT_AMPLITUDE = 36.0f;
+static const int TERRAIN_HEIGHT_OCTAVES = 5;
+// 3D noise moves the surface by up to DETAIL_AMPLITUDE voxels, for overhangs
+// and ledges. Voxels further from the heightmap surface skip it.
+static const float TERRAIN_DETAIL_FREQUENCY = 1.0f / 20.0f;
+static const float TERRAIN_DETAIL_AMPLITUDE = 5.0f;
+
+static const float terrainLaneOffsets[8] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+
+template <typename S>
+typename S::I terrainHash(typename S::I seed, typename S::I x, typename S::I y, typename S::I z)
+{
+    typedef typename S::I I;
+    I h = S::xori(seed, S::mullo(x, S::seti(static_cast<int32_t>(0x27d4eb2du))));
+    h = S::xori(h, S::mullo(y, S::seti(static_cast<int32_t>(0x165667b1u))));
+    h = S::xori(h, S::mullo(z, S::seti(static_cast<int32_t>(0x9e3779b1u))));
+    h = S::mullo(S::xori(h, S::srl(h, 15)), S::seti(static_cast<int32_t>(0x2c1b3c6du)));
+    h = S::mullo(S::xori(h, S::srl(h, 12)), S::seti(static_cast<int32_t>(0x297a2d39u)));
+    return S::xori(h, S::srl(h, 15));
+}
+
+template <typename S>
+typename S::I terrainBit(typename S::I hash, int32_t bit)
+{
+    return S::eqi(S::andi(hash, S::seti(bit)), S::seti(bit));
+}
+
+template <typename S>
+typename S::F terrainNegateIf(typename S::I mask, typename S::F value)
+{
+    return S::selectf(mask, S::sub(S::set(0.0f), value), value);
+}
+
+// t^3 (t (6t - 15) + 10)
+template <typename S>
+typename S::F terrainFade(typename S::F t)
+{
+    typename S::F inner = S::add(S::mul(t, S::sub(S::mul(t, S::set(6.0f)), S::set(15.0f))), S::set(10.0f));
+    return S::mul(S::mul(S::mul(t, t), t), inner);
+}
+
+template <typename S>
+typename S::F terrainLerp(typename S::F a, typename S::F b, typename S::F t)
+{
+    return S::add(a, S::mul(t, S::sub(b, a)));
+}
+
+// Four diagonal and four axis gradients
+template <typename S>
+typename S::F terrainGradient2(typename S::I hash, typename S::F x, typename S::F z)
+{
+    typename S::F a = terrainNegateIf<S>(terrainBit<S>(hash, 1), x);
+    typename S::F b = terrainNegateIf<S>(terrainBit<S>(hash, 2), z);
+    typename S::F axis = S::selectf(terrainBit<S>(hash, 8), a, b);
+    return S::selectf(terrainBit<S>(hash, 4), axis, S::add(a, b));
+}
+
+// The twelve cube edge gradients of improved Perlin noise, 4 of them twice
+template <typename S>
+typename S::F terrainGradient3(typename S::I hash, typename S::F x, typename S::F y, typename S::F z)
+{
+    typedef typename S::I I;
+    I h = S::andi(hash, S::seti(15));
+    I below8 = S::gti(S::seti(8), h);
+    I below4 = S::gti(S::seti(4), h);
+    I useX = S::ori(S::eqi(h, S::seti(12)), S::eqi(h, S::seti(14)));
+    typename S::F u = S::selectf(below8, x, y);
+    typename S::F v = S::selectf(below4, y, S::selectf(useX, x, z));
+    return S::add(terrainNegateIf<S>(terrainBit<S>(h, 1), u), terrainNegateIf<S>(terrainBit<S>(h, 2), v));
+}
+
+template <typename S>
+typename S::F terrainNoise2(typename S::I seed, typename S::F x, typename S::F z)
+{
+    typedef typename S::F F;
+    typedef typename S::I I;
+    F x0 = S::floor(x), z0 = S::floor(z);
+    I ix = S::toInt(x0), iz = S::toInt(z0);
+    I ix1 = S::addi(ix, S::seti(1)), iz1 = S::addi(iz, S::seti(1));
+    I zeroI = S::seti(0);
+    F tx = S::sub(x, x0), tz = S::sub(z, z0);
+    F tx1 = S::sub(tx, S::set(1.0f)), tz1 = S::sub(tz, S::set(1.0f));
+
+    F n00 = terrainGradient2<S>(terrainHash<S>(seed, ix, zeroI, iz), tx, tz);
+    F n10 = terrainGradient2<S>(terrainHash<S>(seed, ix1, zeroI, iz), tx1, tz);
+    F n01 = terrainGradient2<S>(terrainHash<S>(seed, ix, zeroI, iz1), tx, tz1);
+    F n11 = terrainGradient2<S>(terrainHash<S>(seed, ix1, zeroI, iz1), tx1, tz1);
+    F u = terrainFade<S>(tx), v = terrainFade<S>(tz);
+    return terrainLerp<S>(terrainLerp<S>(n00, n10, u), terrainLerp<S>(n01, n11, u), v);
+}
+
+template <typename S>
+typename S::F terrainNoise3(typename S::I seed, typename S::F x, typename S::F y, typename S::F z)
+{
+    typedef typename S::F F;
+    typedef typename S::I I;
+    F x0 = S::floor(x), y0 = S::floor(y), z0 = S::floor(z);
+    I ix = S::toInt(x0), iy = S::toInt(y0), iz = S::toInt(z0);
+    I one = S::seti(1);
+    I ix1 = S::addi(ix, one), iy1 = S::addi(iy, one), iz1 = S::addi(iz, one);
+    F tx = S::sub(x, x0), ty = S::sub(y, y0), tz = S::sub(z, z0);
+    F tx1 = S::sub(tx, S::set(1.0f)), ty1 = S::sub(ty, S::set(1.0f)), tz1 = S::sub(tz, S::set(1.0f));
+
+    F n000 = terrainGradient3<S>(terrainHash<S>(seed, ix, iy, iz), tx, ty, tz);
+    F n100 = terrainGradient3<S>(terrainHash<S>(seed, ix1, iy, iz), tx1, ty, tz);
+    F n010 = terrainGradient3<S>(terrainHash<S>(seed, ix, iy1, iz), tx, ty1, tz);
+    F n110 = terrainGradient3<S>(terrainHash<S>(seed, ix1, iy1, iz), tx1, ty1, tz);
+    F n001 = terrainGradient3<S>(terrainHash<S>(seed, ix, iy, iz1), tx, ty, tz1);
+    F n101 = terrainGradient3<S>(terrainHash<S>(seed, ix1, iy, iz1), tx1, ty, tz1);
+    F n011 = terrainGradient3<S>(terrainHash<S>(seed, ix, iy1, iz1), tx, ty1, tz1);
+    F n111 = terrainGradient3<S>(terrainHash<S>(seed, ix1, iy1, iz1), tx1, ty1, tz1);
+    F u = terrainFade<S>(tx), v = terrainFade<S>(ty), w = terrainFade<S>(tz);
+    F near = terrainLerp<S>(terrainLerp<S>(n000, n100, u), terrainLerp<S>(n010, n110, u), v);
+    F far = terrainLerp<S>(terrainLerp<S>(n001, n101, u), terrainLerp<S>(n011, n111, u), v);
+    return terrainLerp<S>(near, far, w);
+}
+
+// Octaves get their own seeds, so they do not line up at the origin
+static inline uint32_t terrainOctaveSeed(uint32_t seed, int octave)
+{
+    return seed + static_cast<uint32_t>(octave) * 0x9e3779b9u;
+}
+
+template <typename S>
+void terrainHeights(uint32_t seed, int32_t originX, int32_t originZ, float *heights)
+{
+    typedef typename S::F F;
+    const F lanes = S::load(terrainLaneOffsets);
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        F worldZ = S::set(static_cast<float>(originZ + z));
+        for (int x = 0; x < Chunk::SIZE; x += S::WIDTH)
+        {
+            F worldX = S::add(S::set(static_cast<float>(originX + x)), lanes);
+            F height = S::set(0.0f);
+            float frequency = TERRAIN_HEIGHT_FREQUENCY;
+            float amplitude = TERRAIN_HEIGHT_AMPLITUDE;
+            for (int octave = 0; octave < TERRAIN_HEIGHT_OCTAVES; octave++)
+            {
+                F noise = terrainNoise2<S>(S::seti(static_cast<int32_t>(terrainOctaveSeed(seed, octave))),
+                                           S::mul(worldX, S::set(frequency)), S::mul(worldZ, S::set(frequency)));
+                height = S::add(height, S::mul(noise, S::set(amplitude)));
+                frequency *= 2.0f;
+                amplitude *= 0.5f;
+            }
+            S::store(heights + z * Chunk::SIZE + x, S::add(height, S::set(TERRAIN_BASE_HEIGHT)));
+        }
+    }
+}
+
+// A voxel is solid below height - DETAIL_AMPLITUDE, air above height +
+// DETAIL_AMPLITUDE and solid in between where height - y + detail noise is
+// positive. Whole batches outside that band skip the noise, mixed batches
+// decide per lane, so the result does not depend on the lane width.
+template <typename S>
+void terrainMask(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid)
+{
+    typedef typename S::F F;
+    typedef typename S::I I;
+    const F lanes = S::load(terrainLaneOffsets);
+    const F frequency = S::set(TERRAIN_DETAIL_FREQUENCY);
+    const F amplitude = S::set(TERRAIN_DETAIL_AMPLITUDE);
+    const I detailSeed = S::seti(static_cast<int32_t>(terrainOctaveSeed(seed, TERRAIN_HEIGHT_OCTAVES)));
+
+    for (int z = 0; z < Chunk::SIZE; z++)
+    {
+        F worldZ = S::mul(S::set(static_cast<float>(origin[2] + z)), frequency);
+        for (int x = 0; x < Chunk::SIZE; x += S::WIDTH)
+        {
+            const float *batchHeights = heights + z * Chunk::SIZE + x;
+            float lowest = batchHeights[0], highest = batchHeights[0];
+            for (int i = 1; i < S::WIDTH; i++)
+            {
+                lowest = lowest < batchHeights[i] ? lowest : batchHeights[i];
+                highest = highest > batchHeights[i] ? highest : batchHeights[i];
+            }
+            F height = S::load(batchHeights);
+            F worldX = S::mul(S::add(S::set(static_cast<float>(origin[0] + x)), lanes), frequency);
+
+            for (int y = 0; y < TERRAIN_MASK_HEIGHT; y++)
+            {
+                uint8_t *out = solid + x + Chunk::SIZE * (y + TERRAIN_MASK_HEIGHT * z);
+                float worldY = static_cast<float>(origin[1] + y);
+                if (worldY > highest + TERRAIN_DETAIL_AMPLITUDE || worldY < lowest - TERRAIN_DETAIL_AMPLITUDE)
+                {
+                    uint8_t value = worldY < lowest ? 1 : 0;
+                    for (int i = 0; i < S::WIDTH; i++)
+                    {
+                        out[i] = value;
+                    }
+                    continue;
+                }
+
+                F layer = S::set(worldY);
+                F noise = terrainNoise3<S>(detailSeed, worldX, S::mul(layer, frequency), worldZ);
+                F density = S::add(S::sub(height, layer), S::mul(noise, amplitude));
+                I mask = S::gt(density, S::set(0.0f));
+                mask = S::select(S::gt(layer, S::add(height, amplitude)), S::seti(0), mask);
+                mask = S::select(S::lt(layer, S::sub(height, amplitude)), S::seti(-1), mask);
+
+                alignas(32) int32_t values[S::WIDTH];
+                S::storei(values, mask);
+                for (int i = 0; i < S::WIDTH; i++)
+                {
+                    out[i] = values[i] ? 1 : 0;
+                }
+            }
+        }
+    }
+}
+
+#endif
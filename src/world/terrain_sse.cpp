@@ -0,0 +1,70 @@
+#include <cstdint>
+
+#include "terrain_kernel.h"
+
+#ifdef TERRAIN_X86
+
+#include <immintrin.h>
+
+// Built for SSE4.1 whatever the compiler flags, generateTerrainChunk() only
+// calls in here after checking the CPU supports it
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#include "terrain_noise.h"
+
+namespace
+{
+    struct Sse41Lanes
+    {
+        typedef __m128 F;
+        typedef __m128i I;
+        static const int WIDTH = 4;
+
+        static F set(float value) { return _mm_set1_ps(value); }
+        static F load(const float *values) { return _mm_loadu_ps(values); }
+        static void store(float *out, F a) { _mm_storeu_ps(out, a); }
+        static F add(F a, F b) { return _mm_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static F floor(F a) { return _mm_floor_ps(a); }
+        static I gt(F a, F b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+        static I lt(F a, F b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+        static F selectf(I mask, F a, F b) { return _mm_blendv_ps(b, a, _mm_castsi128_ps(mask)); }
+        static I toInt(F a) { return _mm_cvttps_epi32(a); }
+
+        static I seti(int32_t value) { return _mm_set1_epi32(value); }
+        static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+        static I mullo(I a, I b) { return _mm_mullo_epi32(a, b); }
+        static I xori(I a, I b) { return _mm_xor_si128(a, b); }
+        static I andi(I a, I b) { return _mm_and_si128(a, b); }
+        static I ori(I a, I b) { return _mm_or_si128(a, b); }
+        static I srl(I a, int count) { return _mm_srli_epi32(a, count); }
+        static I eqi(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+        static I gti(I a, I b) { return _mm_cmpgt_epi32(a, b); }
+        static I select(I mask, I a, I b) { return _mm_blendv_epi8(b, a, mask); }
+        static void storei(int32_t *out, I a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(out), a); }
+    };
+}
+
+void terrainHeightsSse41(uint32_t seed, int32_t originX, int32_t originZ, float *heights)
+{
+    terrainHeights<Sse41Lanes>(seed, originX, originZ, heights);
+}
+
+void terrainMaskSse41(uint32_t seed, const int32_t origin[3], const float *heights, uint8_t *solid)
+{
+    terrainMask<Sse41Lanes>(seed, origin, heights, solid);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+#include "mesher.h"
+#include "voxel_edit.h"
+
+void VoxelEditBatch::setVoxel(int32_t x, int32_t y, int32_t z, Voxel value)
+{
+    fillBox(x, y, z, x, y, z, value);
+}
+
+void VoxelEditBatch::fillBox(int32_t minX, int32_t minY, int32_t minZ, int32_t maxX, int32_t maxY, int32_t maxZ,
+                             Voxel value)
+{
+    if (minX > maxX || minY > maxY || minZ > maxZ)
+    {
+        return;
+    }
+    Edit edit{};
+    edit.shape = Shape::Box;
+    edit.value = value;
+    edit.min[0] = minX;
+    edit.min[1] = minY;
+    edit.min[2] = minZ;
+    edit.max[0] = maxX;
+    edit.max[1] = maxY;
+    edit.max[2] = maxZ;
+    edits.push_back(edit);
+}
+
+void VoxelEditBatch::sphere(float x, float y, float z, float radius, Voxel value)
+{
+    if (radius <= 0.0f)
+    {
+        return;
+    }
+    Edit edit{};
+    edit.shape = Shape::Sphere;
+    edit.value = value;
+    edit.center[0] = x;
+    edit.center[1] = y;
+    edit.center[2] = z;
+    edit.radiusSquared = radius * radius;
+    // Voxel v spans [v, v + 1), its center is v + 0.5
+    for (int axis = 0; axis < 3; axis++)
+    {
+        edit.min[axis] = static_cast<int32_t>(std::floor(edit.center[axis] - radius));
+        edit.max[axis] = static_cast<int32_t>(std::floor(edit.center[axis] + radius));
+    }
+    edits.push_back(edit);
+}
+
+void VoxelEditBatch::collectChunks(std::vector<ChunkCoord> &out) const
+{
+    std::unordered_set<ChunkCoord, ChunkCoordHash> seen;
+    for (const ChunkCoord &coord : out)
+    {
+        seen.insert(coord);
+    }
+
+    for (const Edit &edit : edits)
+    {
+        ChunkCoord first = World::chunkCoordOf(edit.min[0], edit.min[1], edit.min[2]);
+        ChunkCoord last = World::chunkCoordOf(edit.max[0], edit.max[1], edit.max[2]);
+        for (int32_t z = first.z; z <= last.z; z++)
+        {
+            for (int32_t y = first.y; y <= last.y; y++)
+            {
+                for (int32_t x = first.x; x <= last.x; x++)
+                {
+                    ChunkCoord coord{x, y, z};
+                    if (seen.insert(coord).second)
+                    {
+                        out.push_back(coord);
+                    }
+                }
+            }
+        }
+    }
+}
+
+ChunkEditResult VoxelEditBatch::applyToChunk(const ChunkCoord &coord, Chunk &chunk,
+                                             std::vector<uint16_t> *changedVoxels) const
+{
+    const int32_t origin[3] = {coord.x * Chunk::SIZE, coord.y * Chunk::SIZE, coord.z * Chunk::SIZE};
+    ChunkEditResult result;
+
+    for (const Edit &edit : edits)
+    {
+        // The edit's bounds in chunk-local voxels
+        int32_t low[3];
+        int32_t high[3];
+        bool overlaps = true;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            low[axis] = std::max(edit.min[axis] - origin[axis], 0);
+            high[axis] = std::min(edit.max[axis] - origin[axis], Chunk::SIZE - 1);
+            overlaps &= low[axis] <= high[axis];
+        }
+        if (!overlaps)
+        {
+            continue;
+        }
+
+        // A box covering the whole chunk leaves it uniform
+        bool wholeChunk = edit.shape == Shape::Box;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            wholeChunk &= low[axis] == 0 && high[axis] == Chunk::SIZE - 1;
+        }
+        if (wholeChunk)
+        {
+            if (!chunk.isUniform() || chunk.get(0) != edit.value)
+            {
+                chunk.fill(edit.value);
+                result.changed = true;
+                result.borderFaces = (1u << FACE_COUNT) - 1;
+                for (int index = 0; changedVoxels && index < Chunk::VOLUME; index++)
+                {
+                    changedVoxels->push_back(static_cast<uint16_t>(index));
+                }
+            }
+            continue;
+        }
+
+        for (int32_t z = low[2]; z <= high[2]; z++)
+        {
+            for (int32_t y = low[1]; y <= high[1]; y++)
+            {
+                for (int32_t x = low[0]; x <= high[0]; x++)
+                {
+                    if (edit.shape == Shape::Sphere)
+                    {
+                        float dx = origin[0] + x + 0.5f - edit.center[0];
+                        float dy = origin[1] + y + 0.5f - edit.center[1];
+                        float dz = origin[2] + z + 0.5f - edit.center[2];
+                        if (dx * dx + dy * dy + dz * dz > edit.radiusSquared)
+                        {
+                            continue;
+                        }
+                    }
+
+                    int index = Chunk::index(x, y, z);
+                    if (chunk.get(index) == edit.value)
+                    {
+                        continue;
+                    }
+                    chunk.set(index, edit.value);
+                    result.changed = true;
+                    if (changedVoxels)
+                    {
+                        changedVoxels->push_back(static_cast<uint16_t>(index));
+                    }
+
+                    const int32_t local[3] = {x, y, z};
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        if (local[axis] == 0)
+                        {
+                            result.borderFaces |= 1u << (axis * 2);
+                        }
+                        if (local[axis] == Chunk::SIZE - 1)
+                        {
+                            result.borderFaces |= 1u << (axis * 2 + 1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,62 @@
+#ifndef VOXEL_EDIT_H
+#define VOXEL_EDIT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "chunk.h"
+#include "world.h"
+
+// Bit per chunk face whose outermost layer of voxels an edit changed, in the
+// mesher's face order (-x, +x, -y, +y, -z, +z). The neighbour across such a
+// face culls its border against those voxels and has to be remeshed too.
+struct ChunkEditResult
+{
+    bool changed = false;
+    uint8_t borderFaces = 0;
+};
+
+// Voxel edits applied together by ChunkLoader::edit(), in the order they were
+// added. Shapes are kept as shapes and only rasterized chunk by chunk, so a
+// large brush costs nothing for the chunks it does not touch.
+class VoxelEditBatch
+{
+public:
+    void setVoxel(int32_t x, int32_t y, int32_t z, Voxel value);
+    // Every voxel from min to max, both inclusive
+    void fillBox(int32_t minX, int32_t minY, int32_t minZ, int32_t maxX, int32_t maxY, int32_t maxZ, Voxel value);
+    // Every voxel whose center lies within radius of (x, y, z)
+    void sphere(float x, float y, float z, float radius, Voxel value);
+
+    bool empty() const { return edits.empty(); }
+    size_t size() const { return edits.size(); }
+    void clear() { edits.clear(); }
+
+    // Chunks any of the edits reaches into, each once
+    void collectChunks(std::vector<ChunkCoord> &out) const;
+    // Applies the part of every edit that falls into the chunk at coord. The
+    // indices of voxels that changed are appended to changedVoxels if given.
+    ChunkEditResult applyToChunk(const ChunkCoord &coord, Chunk &chunk, std::vector<uint16_t> *changedVoxels = nullptr) const;
+
+private:
+    enum class Shape : uint8_t
+    {
+        Box,
+        Sphere
+    };
+
+    struct Edit
+    {
+        Shape shape;
+        Voxel value;
+        // Voxel bounds, inclusive, of the box or the sphere
+        int32_t min[3];
+        int32_t max[3];
+        float center[3];
+        float radiusSquared;
+    };
+
+    std::vector<Edit> edits;
+};
+
+#endif
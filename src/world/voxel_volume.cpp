@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "voxel_volume.h"
+
+void VoxelVolume::clear()
+{
+    slotCount = 0;
+    minChunk = {};
+    chunkCount = {};
+    slots.clear();
+    brickMasks.clear();
+    voxelWords.clear();
+}
+
+void VoxelVolume::build(const World &world)
+{
+    clear();
+
+    ChunkCoord minCoord{std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max(),
+                        std::numeric_limits<int32_t>::max()};
+    ChunkCoord maxCoord{std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min(),
+                        std::numeric_limits<int32_t>::min()};
+    std::vector<std::pair<ChunkCoord, const Chunk *>> solidChunks;
+    world.forEachChunk([&](const ChunkCoord &coord, const Chunk &chunk)
+                       {
+                           if (chunk.isUniform() && chunk.get(0) == 0)
+                           {
+                               return;
+                           }
+                           solidChunks.push_back({coord, &chunk});
+                           minCoord = {std::min(minCoord.x, coord.x), std::min(minCoord.y, coord.y), std::min(minCoord.z, coord.z)};
+                           maxCoord = {std::max(maxCoord.x, coord.x), std::max(maxCoord.y, coord.y), std::max(maxCoord.z, coord.z)};
+                       });
+    if (solidChunks.empty())
+    {
+        return;
+    }
+
+    minChunk = minCoord;
+    chunkCount = {maxCoord.x - minCoord.x + 1, maxCoord.y - minCoord.y + 1, maxCoord.z - minCoord.z + 1};
+    slotCount = static_cast<uint32_t>(solidChunks.size());
+
+    slots.assign(static_cast<size_t>(chunkCount.x) * chunkCount.y * chunkCount.z, static_cast<uint32_t>(EMPTY_SLOT));
+    brickMasks.assign(static_cast<size_t>(slotCount) * 2, 0);
+    voxelWords.assign(static_cast<size_t>(slotCount) * WORDS_PER_SLOT, 0);
+
+    for (uint32_t slot = 0; slot < slotCount; slot++)
+    {
+        const ChunkCoord &coord = solidChunks[slot].first;
+        size_t x = coord.x - minChunk.x, y = coord.y - minChunk.y, z = coord.z - minChunk.z;
+        slots[x + chunkCount.x * (y + chunkCount.y * z)] = slot;
+
+        encodeChunk(*solidChunks[slot].second, &voxelWords[static_cast<size_t>(slot) * WORDS_PER_SLOT],
+                    &brickMasks[static_cast<size_t>(slot) * 2]);
+    }
+}
+
+void VoxelVolume::encodeChunk(const Chunk &chunk, uint32_t *words, uint32_t *masks)
+{
+    thread_local std::vector<Voxel> decoded(Chunk::VOLUME);
+    chunk.decode(decoded.data());
+
+    std::fill(words, words + WORDS_PER_SLOT, 0u);
+    masks[0] = 0;
+    masks[1] = 0;
+    for (int i = 0; i < Chunk::VOLUME; i++)
+    {
+        if (decoded[i] == 0)
+        {
+            continue;
+        }
+        words[i >> 1] |= static_cast<uint32_t>(decoded[i]) << ((i & 1) * 16);
+
+        uint32_t localX = i & (Chunk::SIZE - 1);
+        uint32_t localY = (i >> Chunk::SIZE_BITS) & (Chunk::SIZE - 1);
+        uint32_t localZ = i >> (2 * Chunk::SIZE_BITS);
+        uint32_t brick = localX / BRICK_SIZE + BRICKS_PER_AXIS * (localY / BRICK_SIZE + BRICKS_PER_AXIS * (localZ / BRICK_SIZE));
+        masks[brick >> 5] |= 1u << (brick & 31);
+    }
+}
+
+size_t VoxelVolume::memoryUsage() const
+{
+    return (slots.capacity() + brickMasks.capacity() + voxelWords.capacity()) * sizeof(uint32_t);
+}
@@ -0,0 +1,58 @@
+#ifndef VOXEL_VOLUME_H
+#define VOXEL_VOLUME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chunk.h"
+#include "world.h"
+
+// Flat copy of a world for ray traversal, the layout raymarch.comp reads:
+//   slots       one entry per chunk of the bounding box, x fastest, EMPTY_SLOT
+//               for chunks without a solid voxel
+//   brickMasks  two words per slot, bit b set if 8^3 brick b (x + 4y + 16z)
+//               holds a solid voxel
+//   voxelWords  Chunk::VOLUME 16-bit voxels per slot in Chunk::index() order,
+//               two per word with the even index in the low half
+// CpuRaytracer traverses the same data, so both produce the same image.
+class VoxelVolume
+{
+public:
+    static const uint32_t EMPTY_SLOT = 0xFFFFFFFFu;
+    static const uint32_t BRICK_SIZE = 8;
+    static const uint32_t BRICKS_PER_AXIS = Chunk::SIZE / BRICK_SIZE;
+    static const uint32_t WORDS_PER_SLOT = Chunk::VOLUME / 2;
+
+    // Replaces the contents with every chunk of the world that is not all air
+    void build(const World &world);
+    void clear();
+
+    // One slot's voxelWords (WORDS_PER_SLOT) and brickMasks (2) for chunk,
+    // e.g. to patch a chunk of an uploaded volume after an edit
+    static void encodeChunk(const Chunk &chunk, uint32_t *words, uint32_t *masks);
+
+    bool empty() const { return slotCount == 0; }
+    uint32_t getSlotCount() const { return slotCount; }
+    const ChunkCoord &getMinChunk() const { return minChunk; }
+    const ChunkCoord &getChunkCount() const { return chunkCount; }
+    // Every traversal step crosses at least one voxel plane, a ray can cross at most this many
+    int32_t getStepLimit() const { return (chunkCount.x + chunkCount.y + chunkCount.z) * Chunk::SIZE; }
+
+    const std::vector<uint32_t> &getSlots() const { return slots; }
+    const std::vector<uint32_t> &getBrickMasks() const { return brickMasks; }
+    const std::vector<uint32_t> &getVoxelWords() const { return voxelWords; }
+
+    size_t memoryUsage() const;
+
+private:
+    ChunkCoord minChunk;
+    ChunkCoord chunkCount;
+    uint32_t slotCount = 0;
+
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> brickMasks;
+    std::vector<uint32_t> voxelWords;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "world.h"
+
+static const size_t initialCapacity = 64;
+
+ChunkMap::ChunkMap()
+    : slots(initialCapacity)
+{
+}
+
+uint64_t ChunkMap::hash(const ChunkCoord &coord)
+{
+    // Spread the three coordinates over 64 bits, then finish with the splitmix64 mixer
+    uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(coord.x)) * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(coord.y)) * 0xC2B2AE3D27D4EB4Full;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(coord.z)) * 0x165667B19E3779F9ull;
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+// Index of the slot holding coord, or of the empty slot where it would go
+size_t ChunkMap::probe(const ChunkCoord &coord) const
+{
+    size_t mask = slots.size() - 1;
+    size_t i = hash(coord) & mask;
+    while (slots[i].chunk && slots[i].coord != coord)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+Chunk *ChunkMap::find(const ChunkCoord &coord) const
+{
+    return slots[probe(coord)].chunk.get();
+}
+
+Chunk &ChunkMap::insert(const ChunkCoord &coord, std::unique_ptr<Chunk> chunk)
+{
+    size_t i = probe(coord);
+    if (slots[i].chunk)
+    {
+        return *slots[i].chunk;
+    }
+
+    if ((count + 1) * 10 > slots.size() * 7)
+    {
+        grow();
+        i = probe(coord);
+    }
+
+    slots[i].coord = coord;
+    slots[i].chunk = std::move(chunk);
+    count++;
+    return *slots[i].chunk;
+}
+
+std::unique_ptr<Chunk> ChunkMap::take(const ChunkCoord &coord)
+{
+    size_t mask = slots.size() - 1;
+    size_t hole = probe(coord);
+    if (!slots[hole].chunk)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<Chunk> taken = std::move(slots[hole].chunk);
+    count--;
+
+    // Shift later members of the probe run back into the hole, unless they
+    // already sit between their home slot and the hole
+    size_t i = hole;
+    while (true)
+    {
+        i = (i + 1) & mask;
+        if (!slots[i].chunk)
+        {
+            break;
+        }
+
+        size_t home = hash(slots[i].coord) & mask;
+        bool reachable = ((i - home) & mask) >= ((i - hole) & mask);
+        if (reachable)
+        {
+            slots[hole] = std::move(slots[i]);
+            hole = i;
+        }
+    }
+
+    return taken;
+}
+
+void ChunkMap::clear()
+{
+    slots = std::vector<Slot>(initialCapacity);
+    count = 0;
+}
+
+void ChunkMap::grow()
+{
+    std::vector<Slot> old = std::move(slots);
+    slots = std::vector<Slot>(old.size() * 2);
+
+    size_t mask = slots.size() - 1;
+    for (Slot &slot : old)
+    {
+        if (slot.chunk)
+        {
+            size_t i = hash(slot.coord) & mask;
+            while (slots[i].chunk)
+            {
+                i = (i + 1) & mask;
+            }
+            slots[i] = std::move(slot);
+        }
+    }
+}
+
+// Arithmetic shift floors negative coordinates, so -1 lands in chunk -1
+ChunkCoord World::chunkCoordOf(int32_t x, int32_t y, int32_t z)
+{
+    return {x >> Chunk::SIZE_BITS, y >> Chunk::SIZE_BITS, z >> Chunk::SIZE_BITS};
+}
+
+Chunk &World::getOrCreateChunk(const ChunkCoord &coord)
+{
+    Chunk *chunk = chunks.find(coord);
+    if (chunk)
+    {
+        return *chunk;
+    }
+    return chunks.insert(coord, std::make_unique<Chunk>());
+}
+
+Voxel World::getVoxel(int32_t x, int32_t y, int32_t z) const
+{
+    const Chunk *chunk = chunks.find(chunkCoordOf(x, y, z));
+    if (!chunk)
+    {
+        return 0;
+    }
+
+    const int32_t mask = Chunk::SIZE - 1;
+    return chunk->get(x & mask, y & mask, z & mask);
+}
+
+void World::setVoxel(int32_t x, int32_t y, int32_t z, Voxel value)
+{
+    ChunkCoord coord = chunkCoordOf(x, y, z);
+    Chunk *chunk = chunks.find(coord);
+    if (!chunk)
+    {
+        // Writing air into a missing chunk changes nothing
+        if (value == 0)
+        {
+            return;
+        }
+        chunk = &chunks.insert(coord, std::make_unique<Chunk>());
+    }
+
+    const int32_t mask = Chunk::SIZE - 1;
+    chunk->set(x & mask, y & mask, z & mask, value);
+}
+
+void World::compact()
+{
+    std::vector<ChunkCoord> empty;
+    chunks.forEach([&](const ChunkCoord &coord, Chunk &chunk)
+                   {
+                       chunk.compact();
+                       if (chunk.isUniform() && chunk.get(0) == 0)
+                       {
+                           empty.push_back(coord);
+                       }
+                   });
+
+    for (const ChunkCoord &coord : empty)
+    {
+        chunks.erase(coord);
+    }
+}
+
+WorldMemoryStats World::getMemoryStats() const
+{
+    WorldMemoryStats stats;
+    chunks.forEach([&](const ChunkCoord &, const Chunk &chunk)
+                   {
+                       stats.chunkCount++;
+                       stats.uniformChunks += chunk.isUniform() ? 1 : 0;
+                       stats.chunkBytes += chunk.memoryUsage();
+                   });
+    stats.mapBytes = chunks.capacity() * sizeof(ChunkCoord) + chunks.capacity() * sizeof(std::unique_ptr<Chunk>);
+    stats.rawBytes = stats.chunkCount * Chunk::VOLUME * sizeof(Voxel);
+    return stats;
+}
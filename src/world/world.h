@@ -0,0 +1,123 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "chunk.h"
+
+struct ChunkCoord
+{
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t z = 0;
+
+    bool operator==(const ChunkCoord &other) const { return x == other.x && y == other.y && z == other.z; }
+    bool operator!=(const ChunkCoord &other) const { return !(*this == other); }
+};
+
+// Open-addressing hash map from chunk coordinates to chunks, with linear
+// probing and backward-shift deletion so lookups never walk tombstones.
+// Capacity is a power of two and grows at 70% load.
+class ChunkMap
+{
+public:
+    ChunkMap();
+
+    Chunk *find(const ChunkCoord &coord) const;
+    // Returns the existing chunk if one is already stored at coord
+    Chunk &insert(const ChunkCoord &coord, std::unique_ptr<Chunk> chunk);
+    bool erase(const ChunkCoord &coord) { return take(coord) != nullptr; }
+    // Removes the chunk and hands it to the caller, null if there is none
+    std::unique_ptr<Chunk> take(const ChunkCoord &coord);
+    void clear();
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+
+    template <typename F>
+    void forEach(F &&function) const
+    {
+        for (const Slot &slot : slots)
+        {
+            if (slot.chunk)
+            {
+                function(slot.coord, *slot.chunk);
+            }
+        }
+    }
+
+    static uint64_t hash(const ChunkCoord &coord);
+
+private:
+    struct Slot
+    {
+        ChunkCoord coord;
+        // Null marks an empty slot
+        std::unique_ptr<Chunk> chunk;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    size_t probe(const ChunkCoord &coord) const;
+    void grow();
+};
+
+// For std::unordered_map keyed on chunk coordinates
+struct ChunkCoordHash
+{
+    size_t operator()(const ChunkCoord &coord) const { return static_cast<size_t>(ChunkMap::hash(coord)); }
+};
+
+struct WorldMemoryStats
+{
+    size_t chunkCount = 0;
+    size_t uniformChunks = 0;
+    size_t chunkBytes = 0; // sum of Chunk::memoryUsage()
+    size_t mapBytes = 0;   // hash map slots
+    // What the same chunks would take at two bytes per voxel
+    size_t rawBytes = 0;
+};
+
+// Voxel world made of Chunk::SIZE^3 chunks. Voxel coordinates are signed and
+// unbounded, chunks that were never written read as air.
+//
+// Chunks are heap objects that keep their address until removed, even when the
+// map grows, so jobs may read chunks through pointers while the owning thread
+// inserts other chunks.
+class World
+{
+public:
+    static ChunkCoord chunkCoordOf(int32_t x, int32_t y, int32_t z);
+
+    Chunk *getChunk(const ChunkCoord &coord) const { return chunks.find(coord); }
+    Chunk &getOrCreateChunk(const ChunkCoord &coord);
+    // Takes over a chunk built elsewhere, e.g. by a generation job. Returns the
+    // existing chunk instead if coord is already present.
+    Chunk &insertChunk(const ChunkCoord &coord, std::unique_ptr<Chunk> chunk) { return chunks.insert(coord, std::move(chunk)); }
+    bool removeChunk(const ChunkCoord &coord) { return chunks.erase(coord); }
+    std::unique_ptr<Chunk> takeChunk(const ChunkCoord &coord) { return chunks.take(coord); }
+    size_t getChunkCount() const { return chunks.size(); }
+
+    Voxel getVoxel(int32_t x, int32_t y, int32_t z) const;
+    void setVoxel(int32_t x, int32_t y, int32_t z, Voxel value);
+
+    template <typename F>
+    void forEachChunk(F &&function) const
+    {
+        chunks.forEach(function);
+    }
+
+    // Compacts every chunk and drops chunks that became all air
+    void compact();
+
+    WorldMemoryStats getMemoryStats() const;
+
+private:
+    ChunkMap chunks;
+};
+
+#endif